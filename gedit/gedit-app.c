@@ -41,6 +41,7 @@
 #include "gedit-notebook.h"
 #include "gedit-debug.h"
 #include "gedit-utils.h"
+#include "gedit-file-index.h"
 #include "gedit-enum-types.h"
 #include "gedit-dirs.h"
 #include "gedit-settings.h"
@@ -374,7 +375,14 @@ extension_added (PeasExtensionSet *extensions,
 		 PeasExtension    *exten,
 		 GeditApp         *app)
 {
+	gint64 span;
+
+	span = gedit_debug_span_begin (GEDIT_DEBUG_PLUGINS);
+
 	gedit_app_activatable_activate (GEDIT_APP_ACTIVATABLE (exten));
+
+	gedit_debug_span_end (GEDIT_DEBUG_PLUGINS, span, "app-activate",
+			      peas_plugin_info_get_module_name (info));
 }
 
 static void
@@ -1199,6 +1207,11 @@ gedit_app_shutdown (GApplication *app)
 #endif
 
 	gedit_dirs_shutdown ();
+
+	_gedit_utils_regex_cache_shutdown ();
+	_gedit_file_index_shutdown ();
+
+	_gedit_debug_shutdown ();
 }
 
 static gboolean
@@ -37,6 +37,7 @@
 #include "gedit-document.h"
 #include "gedit-statusbar.h"
 #include "gedit-debug.h"
+#include "gedit-settings.h"
 #include "gedit-utils.h"
 #include "gedit-file-chooser-dialog.h"
 #include "gedit-close-confirmation-dialog.h"
@@ -1268,6 +1269,336 @@ save_as_documents_list (SaveAsData *data)
 			   data);
 }
 
+typedef struct _SaveAllData SaveAllData;
+
+/* Saves several titled documents, with at most max_running file savers at the
+ * same time. The progress is shown in the statusbar and the names of the
+ * documents that failed to be saved are reported together at the end.
+ */
+struct _SaveAllData
+{
+	/* Reffed */
+	GeditWindow *window;
+
+	/* Reffed GeditTab's waiting to be saved */
+	GQueue *tabs_to_save;
+
+	/* Names of the documents not saved */
+	GSList *failed_names;
+
+	guint ref_count;
+	guint context_id;
+
+	guint n_total;
+	guint n_done;
+	guint n_saved;
+	guint n_running;
+	guint max_running;
+};
+
+typedef struct _SaveAllJob SaveAllJob;
+
+struct _SaveAllJob
+{
+	SaveAllData *data;
+
+	/* Reffed */
+	GeditTab *tab;
+
+	gulong state_handler_id;
+
+	guint finished : 1;
+};
+
+static void save_all_next (SaveAllData *data);
+
+static SaveAllData *
+save_all_data_new (GeditWindow *window)
+{
+	SaveAllData *data;
+
+	data = g_slice_new0 (SaveAllData);
+	data->ref_count = 1;
+	data->window = g_object_ref (window);
+	data->tabs_to_save = g_queue_new ();
+	data->max_running = g_settings_get_uint (window->priv->editor_settings,
+						 GEDIT_SETTINGS_MAX_CONCURRENT_SAVES);
+	data->max_running = MAX (data->max_running, 1);
+	data->context_id = gtk_statusbar_get_context_id (GTK_STATUSBAR (window->priv->statusbar),
+							 "save_all_message");
+
+	return data;
+}
+
+static SaveAllData *
+save_all_data_ref (SaveAllData *data)
+{
+	data->ref_count++;
+	return data;
+}
+
+static void
+save_all_data_unref (SaveAllData *data)
+{
+	g_return_if_fail (data->ref_count > 0);
+
+	data->ref_count--;
+
+	if (data->ref_count > 0)
+	{
+		return;
+	}
+
+	g_queue_free_full (data->tabs_to_save, g_object_unref);
+	g_slist_free_full (data->failed_names, g_free);
+	g_clear_object (&data->window);
+	g_slice_free (SaveAllData, data);
+}
+
+static void
+save_all_update_progress (SaveAllData *data)
+{
+	GtkStatusbar *statusbar;
+	gchar *msg;
+
+	if (data->window->priv->statusbar == NULL)
+	{
+		return;
+	}
+
+	statusbar = GTK_STATUSBAR (data->window->priv->statusbar);
+
+	gtk_statusbar_remove_all (statusbar, data->context_id);
+
+	msg = g_strdup_printf (ngettext ("Saving %u of %u file\342\200\246",
+					 "Saving %u of %u files\342\200\246",
+					 data->n_total),
+			       MIN (data->n_done + 1, data->n_total),
+			       data->n_total);
+
+	gtk_statusbar_push (statusbar, data->context_id, msg);
+
+	g_free (msg);
+}
+
+static void
+save_all_finished (SaveAllData *data)
+{
+	GeditStatusbar *statusbar;
+	guint n_failed;
+
+	gedit_debug (DEBUG_COMMANDS);
+
+	if (data->window->priv->statusbar == NULL)
+	{
+		g_clear_object (&data->window);
+		return;
+	}
+
+	statusbar = GEDIT_STATUSBAR (data->window->priv->statusbar);
+
+	gtk_statusbar_remove_all (GTK_STATUSBAR (statusbar), data->context_id);
+
+	n_failed = g_slist_length (data->failed_names);
+
+	/* The tabs which no longer needed saving when their turn came are
+	 * not counted.
+	 */
+	if (n_failed == 0 && data->n_saved > 0)
+	{
+		gedit_statusbar_flash_message (statusbar,
+					       data->window->priv->generic_message_cid,
+					       ngettext ("Saved %u file",
+							 "Saved %u files",
+							 data->n_saved),
+					       data->n_saved);
+	}
+	else if (n_failed > 0)
+	{
+		GString *names;
+		GSList *l;
+		gchar *msg;
+
+		names = g_string_new (NULL);
+		data->failed_names = g_slist_reverse (data->failed_names);
+
+		for (l = data->failed_names; l != NULL; l = l->next)
+		{
+			if (names->len > 0)
+			{
+				g_string_append (names, ", ");
+			}
+
+			g_string_append (names, l->data);
+		}
+
+		msg = g_strdup_printf (ngettext ("%u file could not be saved: %s",
+						 "%u files could not be saved: %s",
+						 n_failed),
+				       n_failed,
+				       names->str);
+
+		gedit_statusbar_flash_message (statusbar,
+					       data->window->priv->generic_message_cid,
+					       "%s", msg);
+
+		g_free (msg);
+		g_string_free (names, TRUE);
+	}
+
+	/* A tab closed while showing a saving error never completes its task,
+	 * so do not keep the window alive until then.
+	 */
+	g_clear_object (&data->window);
+}
+
+static void
+save_all_job_finish (SaveAllJob *job,
+		     gboolean    success)
+{
+	SaveAllData *data = job->data;
+
+	if (job->finished)
+	{
+		return;
+	}
+
+	job->finished = TRUE;
+
+	if (job->state_handler_id != 0)
+	{
+		g_signal_handler_disconnect (job->tab, job->state_handler_id);
+		job->state_handler_id = 0;
+	}
+
+	if (!success)
+	{
+		GeditDocument *doc = gedit_tab_get_document (job->tab);
+
+		data->failed_names = g_slist_prepend (data->failed_names,
+						      gedit_document_get_short_name_for_display (doc));
+	}
+	else
+	{
+		data->n_saved++;
+	}
+
+	data->n_running--;
+	data->n_done++;
+
+	save_all_next (data);
+}
+
+static void
+save_all_job_free (SaveAllJob *job)
+{
+	save_all_data_unref (job->data);
+	g_object_unref (job->tab);
+	g_slice_free (SaveAllJob, job);
+}
+
+/* A failed saving task is completed only when the user has dealt with the
+ * error info bar, so the slot is released as soon as the tab shows the error.
+ */
+static void
+save_all_tab_state_notify_cb (GeditTab   *tab,
+			      GParamSpec *pspec,
+			      SaveAllJob *job)
+{
+	if (gedit_tab_get_state (tab) == GEDIT_TAB_STATE_SAVING_ERROR)
+	{
+		save_all_job_finish (job, FALSE);
+	}
+}
+
+static void
+save_all_tab_ready_cb (GeditTab     *tab,
+		       GAsyncResult *result,
+		       SaveAllJob   *job)
+{
+	gboolean success = _gedit_tab_save_finish (tab, result);
+
+	save_all_job_finish (job, success);
+	save_all_job_free (job);
+}
+
+static gboolean
+save_all_can_save_tab (SaveAllData *data,
+		       GeditTab    *tab)
+{
+	GeditTabState state;
+	GeditDocument *doc;
+
+	/* The tab may have been closed or moved while waiting. */
+	if (gtk_widget_get_toplevel (GTK_WIDGET (tab)) != GTK_WIDGET (data->window))
+	{
+		return FALSE;
+	}
+
+	state = gedit_tab_get_state (tab);
+
+	if (state != GEDIT_TAB_STATE_NORMAL &&
+	    state != GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION &&
+	    state != GEDIT_TAB_STATE_SHOWING_PRINT_PREVIEW)
+	{
+		return FALSE;
+	}
+
+	doc = gedit_tab_get_document (tab);
+
+	return _gedit_document_needs_saving (doc) &&
+	       !gedit_document_is_untitled (doc) &&
+	       !gedit_document_get_readonly (doc);
+}
+
+static void
+save_all_next (SaveAllData *data)
+{
+	while (data->n_running < data->max_running &&
+	       !g_queue_is_empty (data->tabs_to_save))
+	{
+		GeditTab *tab = g_queue_pop_head (data->tabs_to_save);
+
+		if (save_all_can_save_tab (data, tab))
+		{
+			SaveAllJob *job;
+
+			job = g_slice_new0 (SaveAllJob);
+			job->data = save_all_data_ref (data);
+			job->tab = g_object_ref (tab);
+
+			job->state_handler_id =
+				g_signal_connect (tab,
+						  "notify::state",
+						  G_CALLBACK (save_all_tab_state_notify_cb),
+						  job);
+
+			data->n_running++;
+
+			_gedit_tab_set_batch_saving (tab, TRUE);
+			_gedit_tab_save_async (tab,
+					       NULL,
+					       (GAsyncReadyCallback) save_all_tab_ready_cb,
+					       job);
+		}
+		else
+		{
+			data->n_done++;
+		}
+
+		g_object_unref (tab);
+	}
+
+	if (data->n_running == 0 && g_queue_is_empty (data->tabs_to_save))
+	{
+		save_all_finished (data);
+	}
+	else
+	{
+		save_all_update_progress (data);
+	}
+}
+
 /*
  * The docs in the list must belong to the same GeditWindow.
  */
@@ -1276,12 +1607,15 @@ save_documents_list (GeditWindow *window,
 		     GList       *docs)
 {
 	SaveAsData *data = NULL;
+	SaveAllData *save_all_data;
 	GList *l;
 
 	gedit_debug (DEBUG_COMMANDS);
 
 	g_return_if_fail ((gedit_window_get_state (window) & GEDIT_WINDOW_STATE_PRINTING) == 0);
 
+	save_all_data = save_all_data_new (window);
+
 	for (l = docs; l != NULL; l = l->next)
 	{
 		GeditDocument *doc;
@@ -1322,7 +1656,8 @@ save_documents_list (GeditWindow *window,
 				}
 				else
 				{
-					save_tab (tab, window);
+					g_queue_push_tail (save_all_data->tabs_to_save,
+							   g_object_ref (tab));
 				}
 			}
 		}
@@ -1360,6 +1695,15 @@ save_documents_list (GeditWindow *window,
 		}
 	}
 
+	save_all_data->n_total = g_queue_get_length (save_all_data->tabs_to_save);
+
+	if (save_all_data->n_total > 0)
+	{
+		save_all_next (save_all_data);
+	}
+
+	save_all_data_unref (save_all_data);
+
 	if (data != NULL)
 	{
 		data->tabs_to_save_as = g_slist_reverse (data->tabs_to_save_as);
@@ -31,6 +31,7 @@
 #include <glib/gi18n.h>
 #include <gdk/gdkkeysyms.h>
 
+#include "gedit-app.h"
 #include "gedit-debug.h"
 #include "gedit-statusbar.h"
 #include "gedit-view-frame.h"
@@ -41,6 +42,10 @@
 
 #define GEDIT_REPLACE_DIALOG_KEY	"gedit-replace-dialog-key"
 #define GEDIT_LAST_SEARCH_DATA_KEY	"gedit-last-search-data-key"
+#define GEDIT_REPLACE_ALL_DATA_KEY	"gedit-replace-all-data-key"
+
+/* Replace All gives the control back to the main loop after this time. */
+#define REPLACE_ALL_TIME_SLICE_USEC	20000
 
 typedef struct _LastSearchData LastSearchData;
 struct _LastSearchData
@@ -55,6 +60,79 @@ last_search_data_free (LastSearchData *data)
 	g_slice_free (LastSearchData, data);
 }
 
+/* Replace All is done a slice at a time, in a single user action so that it
+ * can be undone at once. When it lasts more than one slice, the highlighting
+ * is suspended and the views of the document are not editable until it is
+ * finished, so that no other edit joins the user action.
+ */
+typedef struct
+{
+	GeditView *view;
+	gboolean editable;
+} ReplaceAllView;
+
+typedef struct _ReplaceAllData ReplaceAllData;
+struct _ReplaceAllData
+{
+	GeditReplaceDialog *dialog;
+	GeditWindow *window;
+	GeditDocument *doc;
+	GtkSourceSearchContext *search_context;
+	gchar *replace_text;
+
+	/* After the last replaced occurrence */
+	GtkTextMark *position;
+
+	gint n_replaced;
+	guint idle_id;
+
+	/* Profiling span of the whole Replace All */
+	gint64 span;
+
+	guint suspended : 1;
+	guint highlight_syntax : 1;
+	guint highlight_search : 1;
+
+	/* The ReplaceAllView of the views made not editable */
+	GSList *views;
+};
+
+static void
+replace_all_data_free (ReplaceAllData *data)
+{
+	if (data->idle_id != 0)
+	{
+		g_source_remove (data->idle_id);
+	}
+
+	gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (data->doc), data->position);
+	gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (data->doc));
+
+	if (data->suspended)
+	{
+		gtk_source_buffer_set_highlight_syntax (GTK_SOURCE_BUFFER (data->doc),
+							data->highlight_syntax);
+		gtk_source_search_context_set_highlight (data->search_context,
+							 data->highlight_search);
+	}
+
+	while (data->views != NULL)
+	{
+		ReplaceAllView *view = data->views->data;
+
+		gtk_text_view_set_editable (GTK_TEXT_VIEW (view->view), view->editable);
+		g_object_unref (view->view);
+		g_slice_free (ReplaceAllView, view);
+
+		data->views = g_slist_delete_link (data->views, data->views);
+	}
+
+	g_object_unref (data->search_context);
+	g_object_unref (data->doc);
+	g_free (data->replace_text);
+	g_slice_free (ReplaceAllData, data);
+}
+
 static void
 last_search_data_restore_position (GeditReplaceDialog *dlg)
 {
@@ -437,17 +515,239 @@ do_replace (GeditReplaceDialog *dialog,
 	do_find (dialog, window);
 }
 
+/* Returns TRUE when there are no more occurrences to replace. */
+static gboolean
+replace_all_step (ReplaceAllData  *data,
+		  GError         **error)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (data->doc);
+	gint64 deadline;
+	gint64 span;
+	gboolean done = FALSE;
+
+	span = gedit_debug_span_begin (GEDIT_DEBUG_SEARCH);
+	deadline = g_get_monotonic_time () + REPLACE_ALL_TIME_SLICE_USEC;
+
+	do
+	{
+		GtkTextIter iter;
+		GtkTextIter match_start;
+		GtkTextIter match_end;
+		gboolean empty_match;
+
+		gtk_text_buffer_get_iter_at_mark (buffer, &iter, data->position);
+
+		/* Stop when the search wraps around */
+		if (!gtk_source_search_context_forward (data->search_context,
+							&iter,
+							&match_start,
+							&match_end) ||
+		    gtk_text_iter_compare (&match_start, &iter) < 0)
+		{
+			done = TRUE;
+			break;
+		}
+
+		empty_match = gtk_text_iter_equal (&match_start, &match_end);
+
+		/* The mark has a right gravity, it goes after the
+		 * replacement.
+		 */
+		gtk_text_buffer_move_mark (buffer, data->position, &match_start);
+
+		if (!gtk_source_search_context_replace (data->search_context,
+							&match_start,
+							&match_end,
+							data->replace_text,
+							-1,
+							error))
+		{
+			done = TRUE;
+			break;
+		}
+
+		data->n_replaced++;
+
+		if (empty_match)
+		{
+			gtk_text_buffer_get_iter_at_mark (buffer, &iter, data->position);
+
+			if (!gtk_text_iter_forward_char (&iter))
+			{
+				done = TRUE;
+				break;
+			}
+
+			gtk_text_buffer_move_mark (buffer, data->position, &iter);
+		}
+	}
+	while (g_get_monotonic_time () < deadline);
+
+	gedit_debug_span_end (GEDIT_DEBUG_SEARCH, span, "replace-all-step", NULL);
+
+	return done;
+}
+
+static void
+suspend_highlighting (ReplaceAllData *data)
+{
+	data->suspended = TRUE;
+
+	data->highlight_syntax = gtk_source_buffer_get_highlight_syntax (GTK_SOURCE_BUFFER (data->doc));
+	data->highlight_search = gtk_source_search_context_get_highlight (data->search_context);
+
+	gtk_source_buffer_set_highlight_syntax (GTK_SOURCE_BUFFER (data->doc), FALSE);
+	gtk_source_search_context_set_highlight (data->search_context, FALSE);
+}
+
+/* The document can be shown in the views of several windows. */
+static void
+make_views_not_editable (ReplaceAllData *data)
+{
+	GList *views;
+	GList *l;
+
+	views = gedit_app_get_views (GEDIT_APP (g_application_get_default ()));
+
+	for (l = views; l != NULL; l = l->next)
+	{
+		GtkTextView *text_view = GTK_TEXT_VIEW (l->data);
+		ReplaceAllView *view;
+
+		if (gtk_text_view_get_buffer (text_view) != GTK_TEXT_BUFFER (data->doc))
+		{
+			continue;
+		}
+
+		view = g_slice_new (ReplaceAllView);
+		view->view = g_object_ref (l->data);
+		view->editable = gtk_text_view_get_editable (text_view);
+		data->views = g_slist_prepend (data->views, view);
+
+		gtk_text_view_set_editable (text_view, FALSE);
+	}
+
+	g_list_free (views);
+}
+
+static void
+update_replace_all_progress (ReplaceAllData *data)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (data->doc);
+	GtkTextIter iter;
+	gint char_count;
+
+	gtk_text_buffer_get_iter_at_mark (buffer, &iter, data->position);
+	char_count = gtk_text_buffer_get_char_count (buffer);
+
+	gedit_replace_dialog_show_progress (data->dialog,
+					    char_count > 0 ? (gdouble) gtk_text_iter_get_offset (&iter) / char_count : 1.0,
+					    data->n_replaced);
+}
+
+/* If @cancelled, the replacements are undone. */
+static void
+finish_replace_all (ReplaceAllData *data,
+		    GError         *error,
+		    gboolean        cancelled)
+{
+	GeditReplaceDialog *dialog = data->dialog;
+	GeditWindow *window = data->window;
+	GeditDocument *doc = g_object_ref (data->doc);
+	gint n_replaced = data->n_replaced;
+	gint64 span = data->span;
+
+	/* Ends the user action and restores the highlighting */
+	data->idle_id = 0;
+	g_object_set_data (G_OBJECT (dialog), GEDIT_REPLACE_ALL_DATA_KEY, NULL);
+
+	gedit_replace_dialog_hide_progress (dialog);
+
+	if (span != 0)
+	{
+		gchar *detail;
+
+		detail = g_strdup_printf ("%d replaced%s", n_replaced,
+					  cancelled ? ", cancelled" : "");
+		gedit_debug_span_end (GEDIT_DEBUG_SEARCH, span, "replace-all", detail);
+		g_free (detail);
+	}
+
+	if (cancelled)
+	{
+		if (n_replaced > 0 && gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER (doc)))
+		{
+			gtk_source_buffer_undo (GTK_SOURCE_BUFFER (doc));
+		}
+
+		gedit_statusbar_flash_message (GEDIT_STATUSBAR (window->priv->statusbar),
+					       window->priv->generic_message_cid,
+					       _("Replace All has been stopped"));
+	}
+	else if (n_replaced > 0)
+	{
+		text_found (window, n_replaced);
+	}
+	else if (error == NULL)
+	{
+		text_not_found (window, dialog);
+	}
+
+	if (error != NULL)
+	{
+		gedit_replace_dialog_set_replace_error (dialog, error->message);
+	}
+
+	g_object_unref (doc);
+}
+
+static gboolean
+replace_all_idle_cb (ReplaceAllData *data)
+{
+	GError *error = NULL;
+
+	if (replace_all_step (data, &error))
+	{
+		finish_replace_all (data, error, FALSE);
+		g_clear_error (&error);
+
+		return G_SOURCE_REMOVE;
+	}
+
+	update_replace_all_progress (data);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+stop_replace_all (GeditReplaceDialog *dialog)
+{
+	ReplaceAllData *data;
+
+	data = g_object_get_data (G_OBJECT (dialog), GEDIT_REPLACE_ALL_DATA_KEY);
+
+	if (data != NULL)
+	{
+		finish_replace_all (data, NULL, TRUE);
+	}
+}
+
 static void
 do_replace_all (GeditReplaceDialog *dialog,
 		GeditWindow        *window)
 {
 	GeditDocument *doc;
 	GtkSourceSearchContext *search_context;
+	ReplaceAllData *data;
 	const gchar *replace_entry_text;
-	gchar *unescaped_replace_text;
-	gint count;
+	GtkTextIter start;
 	GError *error = NULL;
 
+	if (g_object_get_data (G_OBJECT (dialog), GEDIT_REPLACE_ALL_DATA_KEY) != NULL)
+	{
+		return;
+	}
+
 	doc = gedit_window_get_active_document (window);
 
 	if (doc == NULL)
@@ -466,29 +766,40 @@ do_replace_all (GeditReplaceDialog *dialog,
 	replace_entry_text = gedit_replace_dialog_get_replace_text (dialog);
 	g_return_if_fail (replace_entry_text != NULL);
 
-	unescaped_replace_text = gtk_source_utils_unescape_search_text (replace_entry_text);
+	data = g_slice_new0 (ReplaceAllData);
+	data->span = gedit_debug_span_begin (GEDIT_DEBUG_SEARCH);
+	data->dialog = dialog;
+	data->window = window;
+	data->doc = g_object_ref (doc);
+	data->search_context = g_object_ref (search_context);
+	data->replace_text = gtk_source_utils_unescape_search_text (replace_entry_text);
 
-	count = gtk_source_search_context_replace_all (search_context,
-						       unescaped_replace_text,
-						       -1,
-						       &error);
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (doc), &start);
+	data->position = gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (doc),
+						      NULL,
+						      &start,
+						      FALSE);
 
-	g_free (unescaped_replace_text);
+	gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (doc));
 
-	if (count > 0)
-	{
-		text_found (window, count);
-	}
-	else if (error == NULL)
-	{
-		text_not_found (window, dialog);
-	}
+	g_object_set_data_full (G_OBJECT (dialog),
+				GEDIT_REPLACE_ALL_DATA_KEY,
+				data,
+				(GDestroyNotify) replace_all_data_free);
 
-	if (error != NULL)
+	/* Most of the time, all the occurrences are replaced at once. */
+	if (replace_all_step (data, &error))
 	{
-		gedit_replace_dialog_set_replace_error (dialog, error->message);
-		g_error_free (error);
+		finish_replace_all (data, error, FALSE);
+		g_clear_error (&error);
+		return;
 	}
+
+	suspend_highlighting (data);
+	make_views_not_editable (data);
+	update_replace_all_progress (data);
+
+	data->idle_id = g_idle_add ((GSourceFunc) replace_all_idle_cb, data);
 }
 
 static void
@@ -512,6 +823,10 @@ replace_dialog_response_cb (GeditReplaceDialog *dialog,
 			do_replace_all (dialog, window);
 			break;
 
+		case GEDIT_REPLACE_DIALOG_STOP_RESPONSE:
+			stop_replace_all (dialog);
+			break;
+
 		default:
 			last_search_data_store_position (dialog);
 			gtk_widget_hide (GTK_WIDGET (dialog));
@@ -27,6 +27,11 @@
 #include "gedit-debug.h"
 
 #include <stdio.h>
+#include <string.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
 
 #define ENABLE_PROFILING
 
@@ -39,6 +44,80 @@ static GeditDebugSection debug = GEDIT_NO_DEBUG;
 
 #define DEBUG_IS_ENABLED(section_rval) (debug & (section_rval))
 
+/* Each thread records its spans in its own ring, so that recording never
+ * takes a lock: when a ring is full the oldest spans are overwritten. The
+ * ring of a thread which exits is given to the next thread needing one.
+ * Every event is guarded by a sequence number which is odd while the event
+ * is being written, so that the export can skip the events it would read
+ * half written.
+ */
+#define TRACE_RING_SIZE		2048
+#define TRACE_NAME_SIZE		32
+#define TRACE_DETAIL_SIZE	64
+
+typedef struct
+{
+	volatile gint seq;
+	gint tid;
+	GeditDebugSection section;
+	gint64 start;
+	gint64 duration;
+	gchar name[TRACE_NAME_SIZE];
+	gchar detail[TRACE_DETAIL_SIZE];
+} TraceEvent;
+
+typedef struct
+{
+	/* Of the thread using the ring, the events keep the one of the
+	 * thread which recorded them.
+	 */
+	gint tid;
+	guint next;
+	TraceEvent events[TRACE_RING_SIZE];
+} TraceRing;
+
+static const struct
+{
+	GeditDebugSection section;
+	const gchar *name;
+} section_names[] = {
+	{ GEDIT_DEBUG_VIEW, "view" },
+	{ GEDIT_DEBUG_SEARCH, "search" },
+	{ GEDIT_DEBUG_PRINT, "print" },
+	{ GEDIT_DEBUG_PREFS, "prefs" },
+	{ GEDIT_DEBUG_PLUGINS, "plugins" },
+	{ GEDIT_DEBUG_TAB, "tab" },
+	{ GEDIT_DEBUG_DOCUMENT, "document" },
+	{ GEDIT_DEBUG_COMMANDS, "commands" },
+	{ GEDIT_DEBUG_APP, "app" },
+	{ GEDIT_DEBUG_SESSION, "session" },
+	{ GEDIT_DEBUG_UTILS, "utils" },
+	{ GEDIT_DEBUG_METADATA, "metadata" },
+	{ GEDIT_DEBUG_WINDOW, "window" },
+	{ GEDIT_DEBUG_LOADER, "loader" },
+	{ GEDIT_DEBUG_SAVER, "saver" },
+	{ GEDIT_DEBUG_PANEL, "panel" },
+	{ GEDIT_DEBUG_DBUS, "dbus" },
+	{ GEDIT_DEBUG_MESSAGE_BUS, "message-bus" }
+};
+
+static GeditDebugSection trace = GEDIT_NO_DEBUG;
+static gchar *trace_filename = NULL;
+static gint64 trace_origin = 0;
+static GThread *trace_main_thread = NULL;
+static gint trace_main_tid = 0;
+
+static void release_trace_ring (gpointer data);
+
+/* The rings are never freed, so that the spans of the threads which
+ * already exited are still exported, but they are reused.
+ */
+static GPrivate trace_ring_key = G_PRIVATE_INIT (release_trace_ring);
+static GMutex trace_rings_lock;
+static GSList *trace_rings = NULL;
+static GSList *trace_free_rings = NULL;
+static gint trace_last_tid = 0;
+
 /**
  * gedit_debug_init:
  *
@@ -52,6 +131,11 @@ static GeditDebugSection debug = GEDIT_NO_DEBUG;
  * for all debug sections, set the <code>GEDIT_DEBUG</code> environment
  * variable.
  *
+ * Setting the <code>GEDIT_TRACE</code> environment variable to a file name
+ * records the spans of all the sections (see gedit_debug_span_begin()), and
+ * writes them to that file in the Chrome trace event format when gedit
+ * quits.
+ *
  * This function must be called before any of the other debug functions are
  * called. It must only be called once.
  */
@@ -99,8 +183,18 @@ gedit_debug_init (void)
 		debug = debug | GEDIT_DEBUG_PANEL;
 	if (g_getenv ("GEDIT_DEBUG_DBUS") != NULL)
 		debug = debug | GEDIT_DEBUG_DBUS;
+	if (g_getenv ("GEDIT_DEBUG_MESSAGE_BUS") != NULL)
+		debug = debug | GEDIT_DEBUG_MESSAGE_BUS;
 out:
 
+	if (g_getenv ("GEDIT_TRACE") != NULL)
+	{
+		trace = ~GEDIT_NO_DEBUG;
+		trace_filename = g_strdup (g_getenv ("GEDIT_TRACE"));
+		trace_origin = g_get_monotonic_time ();
+		trace_main_thread = g_thread_self ();
+	}
+
 #ifdef ENABLE_PROFILING
 	if (debug != GEDIT_NO_DEBUG)
 		timer = g_timer_new ();
@@ -108,6 +202,21 @@ out:
 	return;
 }
 
+/**
+ * gedit_debug_is_enabled:
+ * @section: Debug section.
+ *
+ * Checks whether output for debug section @section is enabled, for code
+ * which only collects debugging data when asked to.
+ *
+ * Returns: %TRUE if output for @section is enabled.
+ */
+gboolean
+gedit_debug_is_enabled (GeditDebugSection section)
+{
+	return DEBUG_IS_ENABLED (section) != 0;
+}
+
 /**
  * gedit_debug:
  * @section: Debug section.
@@ -236,4 +345,397 @@ gedit_debug_plugin_message (const gchar       *file,
 			     message);
 }
 
+static const gchar *
+get_section_name (GeditDebugSection section)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (section_names); i++)
+	{
+		if (section_names[i].section & section)
+		{
+			return section_names[i].name;
+		}
+	}
+
+	return "gedit";
+}
+
+/* Called when a thread which recorded spans exits */
+static void
+release_trace_ring (gpointer data)
+{
+	g_mutex_lock (&trace_rings_lock);
+	trace_free_rings = g_slist_prepend (trace_free_rings, data);
+	g_mutex_unlock (&trace_rings_lock);
+}
+
+static TraceRing *
+get_trace_ring (void)
+{
+	TraceRing *ring;
+
+	ring = g_private_get (&trace_ring_key);
+
+	if (G_UNLIKELY (ring == NULL))
+	{
+		g_mutex_lock (&trace_rings_lock);
+
+		if (trace_free_rings != NULL)
+		{
+			ring = trace_free_rings->data;
+			trace_free_rings = g_slist_delete_link (trace_free_rings,
+								trace_free_rings);
+		}
+		else
+		{
+			ring = g_new0 (TraceRing, 1);
+			trace_rings = g_slist_prepend (trace_rings, ring);
+		}
+
+		ring->tid = ++trace_last_tid;
+
+		if (g_thread_self () == trace_main_thread)
+		{
+			trace_main_tid = ring->tid;
+		}
+
+		g_mutex_unlock (&trace_rings_lock);
+
+		g_private_set (&trace_ring_key, ring);
+	}
+
+	return ring;
+}
+
+/* Copies @src into @dest, truncating it on a character boundary */
+static void
+copy_truncated (gchar       *dest,
+		const gchar *src,
+		gsize        size)
+{
+	const gchar *end;
+
+	if (src == NULL)
+	{
+		dest[0] = '\0';
+		return;
+	}
+
+	g_strlcpy (dest, src, size);
+
+	if (!g_utf8_validate (dest, -1, &end))
+	{
+		dest[end - dest] = '\0';
+	}
+}
+
+static void
+record_span (GeditDebugSection  section,
+	     gint64             start,
+	     gint64             duration,
+	     const gchar       *name,
+	     const gchar       *detail)
+{
+	TraceRing *ring;
+	TraceEvent *event;
+
+	ring = get_trace_ring ();
+	event = &ring->events[ring->next % TRACE_RING_SIZE];
+	ring->next++;
+
+	g_atomic_int_inc (&event->seq);
+
+	event->tid = ring->tid;
+	event->section = section;
+	event->start = start;
+	event->duration = duration;
+	copy_truncated (event->name, name, TRACE_NAME_SIZE);
+	copy_truncated (event->detail, detail, TRACE_DETAIL_SIZE);
+
+	g_atomic_int_inc (&event->seq);
+}
+
+/**
+ * gedit_debug_span_begin:
+ * @section: Debug section.
+ *
+ * Starts timing a span of the @section debug section, to be finished with
+ * gedit_debug_span_end(). The span can end in another function, as long as
+ * it is the same thread which ends it.
+ *
+ * The call is cheap when neither tracing nor the output for @section are
+ * enabled: it returns 0 and gedit_debug_span_end() then does nothing, so
+ * the callers should only compute the details of the span when the returned
+ * value is not 0.
+ *
+ * Returns: the opaque start of the span, or 0 when it is not recorded.
+ *
+ * Since: 3.16
+ */
+gint64
+gedit_debug_span_begin (GeditDebugSection section)
+{
+	if (G_LIKELY (((debug | trace) & section) == 0))
+	{
+		return 0;
+	}
+
+	return g_get_monotonic_time ();
+}
+
+/**
+ * gedit_debug_span_end:
+ * @section: Debug section.
+ * @begin: The value returned by gedit_debug_span_begin().
+ * @name: The name of the span.
+ * @detail: (allow-none): Details about the span, such as a file name.
+ *
+ * Finishes the span started by gedit_debug_span_begin(). The span is recorded
+ * for the trace if tracing is enabled, and its duration is logged if output
+ * for @section is enabled. Only the first bytes of @name and @detail are
+ * kept in the trace.
+ *
+ * Since: 3.16
+ */
+void
+gedit_debug_span_end (GeditDebugSection  section,
+		      gint64             begin,
+		      const gchar       *name,
+		      const gchar       *detail)
+{
+	gint64 duration;
+
+	if (G_LIKELY (begin == 0))
+	{
+		return;
+	}
+
+	g_return_if_fail (name != NULL);
+
+	duration = g_get_monotonic_time () - begin;
+
+	if (trace & section)
+	{
+		record_span (section, begin, duration, name, detail);
+	}
+
+	if (G_UNLIKELY (DEBUG_IS_ENABLED (section)))
+	{
+		g_print ("[span] %s%s%s%s: %.3f ms\n",
+			 name,
+			 detail != NULL ? " (" : "",
+			 detail != NULL ? detail : "",
+			 detail != NULL ? ")" : "",
+			 duration / 1000.0);
+
+		fflush (stdout);
+	}
+}
+
+static void
+append_json_string (GString     *json,
+		    const gchar *str)
+{
+	const gchar *p;
+
+	g_string_append_c (json, '"');
+
+	for (p = str; *p != '\0'; p++)
+	{
+		switch (*p)
+		{
+			case '"':
+				g_string_append (json, "\\\"");
+				break;
+			case '\\':
+				g_string_append (json, "\\\\");
+				break;
+			default:
+				if ((guchar) *p < 0x20)
+				{
+					g_string_append_printf (json, "\\u%04x", (guchar) *p);
+				}
+				else
+				{
+					g_string_append_c (json, *p);
+				}
+				break;
+		}
+	}
+
+	g_string_append_c (json, '"');
+}
+
+static void
+append_thread_name (GString *json,
+		    gint     tid,
+		    gint     pid)
+{
+	g_string_append_printf (json,
+				"{\"name\":\"thread_name\",\"ph\":\"M\","
+				"\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+				pid, tid);
+
+	if (tid == trace_main_tid)
+	{
+		append_json_string (json, "main");
+	}
+	else
+	{
+		gchar *name;
+
+		name = g_strdup_printf ("thread %d", tid);
+		append_json_string (json, name);
+		g_free (name);
+	}
+
+	g_string_append (json, "}}");
+}
+
+/* Adds the threads which recorded the events of @ring to @tids */
+static void
+append_trace_ring (GString    *json,
+		   TraceRing  *ring,
+		   gint        pid,
+		   GHashTable *tids)
+{
+	guint i;
+
+	for (i = 0; i < TRACE_RING_SIZE; i++)
+	{
+		TraceEvent *event = &ring->events[i];
+		TraceEvent copy;
+		gint seq;
+
+		/* Skip the empty events and the ones being written */
+		seq = g_atomic_int_get (&event->seq);
+		if (seq == 0 || seq % 2 != 0)
+		{
+			continue;
+		}
+
+		memcpy (&copy, event, sizeof (TraceEvent));
+
+		if (g_atomic_int_get (&event->seq) != seq)
+		{
+			continue;
+		}
+
+		g_hash_table_add (tids, GINT_TO_POINTER (copy.tid));
+
+		g_string_append (json, "{\"name\":");
+		append_json_string (json, copy.name);
+		g_string_append (json, ",\"cat\":");
+		append_json_string (json, get_section_name (copy.section));
+		g_string_append_printf (json,
+					",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT
+					",\"dur\":%" G_GINT64_FORMAT
+					",\"pid\":%d,\"tid\":%d",
+					copy.start - trace_origin,
+					copy.duration,
+					pid,
+					copy.tid);
+
+		if (copy.detail[0] != '\0')
+		{
+			g_string_append (json, ",\"args\":{\"detail\":");
+			append_json_string (json, copy.detail);
+			g_string_append_c (json, '}');
+		}
+
+		g_string_append (json, "},\n");
+	}
+}
+
+/**
+ * gedit_debug_trace_export:
+ * @filename: The file to write.
+ * @error: a #GError, or %NULL.
+ *
+ * Writes the spans recorded so far to @filename, in the Chrome trace event
+ * format, which can be loaded in chrome://tracing among others. The spans
+ * are only recorded when the <code>GEDIT_TRACE</code> environment variable
+ * is set, see gedit_debug_init().
+ *
+ * Returns: %TRUE if the file was written.
+ *
+ * Since: 3.16
+ */
+gboolean
+gedit_debug_trace_export (const gchar  *filename,
+			  GError      **error)
+{
+	GString *json;
+	GHashTable *tids;
+	GHashTableIter iter;
+	gpointer tid;
+	GSList *l;
+	gboolean ret;
+	gint pid = 0;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+#ifdef G_OS_UNIX
+	pid = getpid ();
+#endif
+
+	json = g_string_new ("{\"traceEvents\":[\n");
+	tids = g_hash_table_new (NULL, NULL);
+
+	g_mutex_lock (&trace_rings_lock);
+
+	for (l = trace_rings; l != NULL; l = l->next)
+	{
+		append_trace_ring (json, l->data, pid, tids);
+	}
+
+	g_mutex_unlock (&trace_rings_lock);
+
+	/* The names of the threads, after their events */
+	g_hash_table_iter_init (&iter, tids);
+
+	while (g_hash_table_iter_next (&iter, &tid, NULL))
+	{
+		append_thread_name (json, GPOINTER_TO_INT (tid), pid);
+		g_string_append (json, ",\n");
+	}
+
+	g_hash_table_destroy (tids);
+
+	/* Not followed by a comma */
+	g_string_append (json, "{\"name\":\"process_name\",\"ph\":\"M\",");
+	g_string_append_printf (json, "\"pid\":%d,\"args\":{\"name\":\"gedit\"}}", pid);
+
+	g_string_append (json, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	ret = g_file_set_contents (filename, json->str, json->len, error);
+
+	g_string_free (json, TRUE);
+
+	return ret;
+}
+
+void
+_gedit_debug_shutdown (void)
+{
+	GError *error = NULL;
+
+	if (trace_filename == NULL)
+	{
+		return;
+	}
+
+	if (!gedit_debug_trace_export (trace_filename, &error))
+	{
+		g_warning ("Could not write the trace to '%s': %s",
+			   trace_filename, error->message);
+		g_error_free (error);
+	}
+
+	g_free (trace_filename);
+	trace_filename = NULL;
+}
+
 /* ex:set ts=8 noet: */
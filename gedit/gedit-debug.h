@@ -54,7 +54,8 @@ typedef enum {
 	GEDIT_DEBUG_LOADER   = 1 << 13,
 	GEDIT_DEBUG_SAVER    = 1 << 14,
 	GEDIT_DEBUG_PANEL    = 1 << 15,
-	GEDIT_DEBUG_DBUS     = 1 << 16
+	GEDIT_DEBUG_DBUS     = 1 << 16,
+	GEDIT_DEBUG_MESSAGE_BUS = 1 << 17
 } GeditDebugSection;
 
 #define	DEBUG_VIEW	GEDIT_DEBUG_VIEW,    __FILE__, __LINE__, G_STRFUNC
@@ -74,9 +75,12 @@ typedef enum {
 #define	DEBUG_SAVER	GEDIT_DEBUG_SAVER,   __FILE__, __LINE__, G_STRFUNC
 #define	DEBUG_PANEL	GEDIT_DEBUG_PANEL,   __FILE__, __LINE__, G_STRFUNC
 #define	DEBUG_DBUS	GEDIT_DEBUG_DBUS,    __FILE__, __LINE__, G_STRFUNC
+#define	DEBUG_MESSAGE_BUS	GEDIT_DEBUG_MESSAGE_BUS, __FILE__, __LINE__, G_STRFUNC
 
 void gedit_debug_init (void);
 
+gboolean gedit_debug_is_enabled (GeditDebugSection section);
+
 void gedit_debug (GeditDebugSection  section,
 		  const gchar       *file,
 		  gint               line,
@@ -93,5 +97,18 @@ void gedit_debug_plugin_message (const gchar       *file,
 				 const gchar       *function,
 				 const gchar       *message);
 
+gint64 gedit_debug_span_begin (GeditDebugSection  section);
+
+void gedit_debug_span_end (GeditDebugSection  section,
+			   gint64             begin,
+			   const gchar       *name,
+			   const gchar       *detail);
+
+gboolean gedit_debug_trace_export (const gchar  *filename,
+				   GError      **error);
+
+/* Private */
+void _gedit_debug_shutdown (void);
+
 #endif /* __GEDIT_DEBUG_H__ */
 /* ex:set ts=8 noet: */
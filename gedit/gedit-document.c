@@ -35,6 +35,7 @@
 #include "gedit-utils.h"
 #include "gedit-marshal.h"
 #include "gedit-enum-types.h"
+#include "gedit-undo-manager.h"
 
 #ifndef ENABLE_GVFS_METADATA
 #include "gedit-metadata-manager.h"
@@ -44,6 +45,17 @@
 
 #define NO_LANGUAGE_NAME "_NORMAL_"
 
+#define LINE_COUNT_BUFFER_SIZE (64 * 1024)
+
+/* Same amount of text that was taken from the buffer to guess the content type
+ * of compressed files.
+ */
+#define CONTENT_SNIFF_SIZE 255
+
+#define DETECTION_CACHE_MAX_SIZE 1024
+
+static void	gedit_document_load_real	(GeditDocument *doc);
+
 static void	gedit_document_loaded_real	(GeditDocument *doc);
 
 static void	gedit_document_saved_real	(GeditDocument *doc);
@@ -61,6 +73,11 @@ struct _GeditDocumentPrivate
 
 	gchar	    *content_type;
 
+	/* Content type guessed from the beginning of the loaded text, without
+	 * the file name. Used for compressed files.
+	 */
+	gchar       *sniffed_content_type;
+
 	GTimeVal     mtime;
 	GTimeVal     time_of_last_save_or_load;
 
@@ -69,6 +86,12 @@ struct _GeditDocumentPrivate
 	 */
 	GtkSourceSearchContext *search_context;
 
+	/* Number of lines of the file being loaded, counted in a thread while
+	 * the file loader fills the buffer. -1 if unknown.
+	 */
+	gint expected_line_count;
+	GCancellable *line_count_cancellable;
+
 	guint readonly : 1;
 	guint externally_modified : 1;
 	guint deleted : 1;
@@ -85,6 +108,14 @@ struct _GeditDocumentPrivate
 	 * when opened from the command line).
 	 */
 	guint create : 1;
+
+	/* Whether a file loading is in progress. */
+	guint loading : 1;
+
+	/* Whether the first chunk of the last file loading has been inserted,
+	 * i.e. whether the content type has been guessed from it.
+	 */
+	guint first_chunk_inserted : 1;
 };
 
 enum
@@ -101,6 +132,7 @@ enum
 {
 	CURSOR_MOVED,
 	LOAD,
+	LOAD_PREVIEW,
 	LOADED,
 	SAVE,
 	SAVED,
@@ -111,6 +143,13 @@ static guint document_signals[LAST_SIGNAL] = { 0 };
 
 static GHashTable *allocated_untitled_numbers = NULL;
 
+/* The content type and language guesses only depend on the file name and on
+ * the beginning of the content, and are done several times for each file
+ * loading. Remember them for the whole application.
+ */
+static GHashTable *content_type_cache = NULL;
+static GHashTable *language_cache = NULL;
+
 G_DEFINE_TYPE_WITH_PRIVATE (GeditDocument, gedit_document, GTK_SOURCE_TYPE_BUFFER)
 
 static gint
@@ -146,6 +185,118 @@ release_untitled_number (gint n)
 	g_hash_table_remove (allocated_untitled_numbers, GINT_TO_POINTER (n));
 }
 
+static GHashTable *
+get_detection_cache (GHashTable **cache)
+{
+	if (*cache == NULL)
+	{
+		*cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	}
+	else if (g_hash_table_size (*cache) >= DETECTION_CACHE_MAX_SIZE)
+	{
+		g_hash_table_remove_all (*cache);
+	}
+
+	return *cache;
+}
+
+static gchar *
+guess_content_type_cached (const gchar  *basename,
+			   const guchar *data,
+			   gsize         data_size)
+{
+	GHashTable *cache;
+	gchar *checksum = NULL;
+	gchar *key;
+	const gchar *cached_type;
+	gchar *content_type;
+
+	if (data_size > 0)
+	{
+		checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5, data, data_size);
+	}
+
+	key = g_strconcat (basename != NULL ? basename : "", "\n",
+			   checksum != NULL ? checksum : "",
+			   NULL);
+
+	g_free (checksum);
+
+	cache = get_detection_cache (&content_type_cache);
+	cached_type = g_hash_table_lookup (cache, key);
+
+	if (cached_type != NULL)
+	{
+		g_free (key);
+		return g_strdup (cached_type);
+	}
+
+	content_type = g_content_type_guess (basename, data, data_size, NULL);
+
+	/* The key is owned by the cache. */
+	g_hash_table_insert (cache, key, g_strdup (content_type));
+
+	return content_type;
+}
+
+static GtkSourceLanguage *
+guess_language_cached (const gchar *basename,
+		       const gchar *content_type)
+{
+	GtkSourceLanguageManager *manager = gtk_source_language_manager_get_default ();
+	GHashTable *cache;
+	gchar *key;
+	const gchar *language_id;
+	GtkSourceLanguage *language;
+
+	key = g_strconcat (basename != NULL ? basename : "", "\n",
+			   content_type != NULL ? content_type : "",
+			   NULL);
+
+	cache = get_detection_cache (&language_cache);
+	language_id = g_hash_table_lookup (cache, key);
+
+	/* The language ID is stored instead of the language, since the
+	 * languages are owned by the manager. An empty ID means no language.
+	 */
+	if (language_id != NULL)
+	{
+		g_free (key);
+
+		if (language_id[0] == '\0')
+		{
+			return NULL;
+		}
+
+		return gtk_source_language_manager_get_language (manager, language_id);
+	}
+
+	language = gtk_source_language_manager_guess_language (manager,
+							       basename,
+							       content_type);
+
+	g_hash_table_insert (cache,
+			     key,
+			     g_strdup (language != NULL ? gtk_source_language_get_id (language) : ""));
+
+	return language;
+}
+
+static gchar *
+get_basename_for_guess (GeditDocument *doc)
+{
+	GFile *location;
+
+	location = gtk_source_file_get_location (doc->priv->file);
+
+	if (location != NULL)
+	{
+		return g_file_get_basename (location);
+	}
+
+	return g_strdup (doc->priv->short_name);
+}
+
 static const gchar *
 get_language_string (GeditDocument *doc)
 {
@@ -211,6 +362,12 @@ gedit_document_dispose (GObject *object)
 	g_clear_object (&doc->priv->metadata_info);
 	g_clear_object (&doc->priv->search_context);
 
+	if (doc->priv->line_count_cancellable != NULL)
+	{
+		g_cancellable_cancel (doc->priv->line_count_cancellable);
+		g_clear_object (&doc->priv->line_count_cancellable);
+	}
+
 	G_OBJECT_CLASS (gedit_document_parent_class)->dispose (object);
 }
 
@@ -227,6 +384,7 @@ gedit_document_finalize (GObject *object)
 	}
 
 	g_free (doc->priv->content_type);
+	g_free (doc->priv->sniffed_content_type);
 	g_free (doc->priv->short_name);
 
 	G_OBJECT_CLASS (gedit_document_parent_class)->finalize (object);
@@ -318,10 +476,60 @@ gedit_document_changed (GtkTextBuffer *buffer)
 	GTK_TEXT_BUFFER_CLASS (gedit_document_parent_class)->changed (buffer);
 }
 
+/* The content type and the language are guessed from the first chunk inserted
+ * by the file loader, before it is in the buffer, so that the syntax
+ * highlighting starts with the right language instead of being redone at the
+ * end of the loading.
+ */
+static void
+detect_from_first_chunk (GeditDocument *doc,
+			 const gchar   *text,
+			 gint           len)
+{
+	gsize sniff_size;
+	gchar *basename;
+	gchar *content_type;
+
+	sniff_size = MIN ((gsize) len, CONTENT_SNIFF_SIZE);
+
+	g_free (doc->priv->sniffed_content_type);
+	doc->priv->sniffed_content_type = guess_content_type_cached (NULL,
+								     (const guchar *) text,
+								     sniff_size);
+
+	basename = get_basename_for_guess (doc);
+	content_type = guess_content_type_cached (basename,
+						  (const guchar *) text,
+						  sniff_size);
+
+	gedit_document_set_content_type (doc, content_type);
+
+	g_free (basename);
+	g_free (content_type);
+}
+
+static void
+gedit_document_insert_text (GtkTextBuffer *buffer,
+			    GtkTextIter   *pos,
+			    const gchar   *text,
+			    gint           len)
+{
+	GeditDocument *doc = GEDIT_DOCUMENT (buffer);
+
+	if (doc->priv->loading && !doc->priv->first_chunk_inserted && len > 0)
+	{
+		doc->priv->first_chunk_inserted = TRUE;
+		detect_from_first_chunk (doc, text, len);
+	}
+
+	GTK_TEXT_BUFFER_CLASS (gedit_document_parent_class)->insert_text (buffer, pos, text, len);
+}
+
 static void
 gedit_document_constructed (GObject *object)
 {
 	GeditDocument *doc = GEDIT_DOCUMENT (object);
+	GeditUndoManager *undo_manager;
 
 	/* Bind construct properties. */
 	g_settings_bind (doc->priv->editor_settings,
@@ -331,6 +539,21 @@ gedit_document_constructed (GObject *object)
 			 G_SETTINGS_BIND_GET | G_SETTINGS_BIND_NO_SENSITIVITY);
 
 	G_OBJECT_CLASS (gedit_document_parent_class)->constructed (object);
+
+	/* The undo manager is a construct property of the buffer, so it is
+	 * replaced only now.
+	 */
+	undo_manager = gedit_undo_manager_new (GTK_SOURCE_BUFFER (doc));
+
+	g_settings_bind (doc->priv->editor_settings,
+			 GEDIT_SETTINGS_MAX_UNDO_MEMORY,
+			 undo_manager,
+			 "max-memory",
+			 G_SETTINGS_BIND_GET);
+
+	gtk_source_buffer_set_undo_manager (GTK_SOURCE_BUFFER (doc),
+					    GTK_SOURCE_UNDO_MANAGER (undo_manager));
+	g_object_unref (undo_manager);
 }
 
 static void
@@ -347,7 +570,9 @@ gedit_document_class_init (GeditDocumentClass *klass)
 
 	buf_class->mark_set = gedit_document_mark_set;
 	buf_class->changed = gedit_document_changed;
+	buf_class->insert_text = gedit_document_insert_text;
 
+	klass->load = gedit_document_load_real;
 	klass->loaded = gedit_document_loaded_real;
 	klass->saved = gedit_document_saved_real;
 
@@ -437,6 +662,32 @@ gedit_document_class_init (GeditDocumentClass *klass)
 			      NULL, NULL, NULL,
 			      G_TYPE_NONE, 0);
 
+	/**
+	 * GeditDocument::load-preview:
+	 * @document: the #GeditDocument.
+	 * @head: the first lines of the file.
+	 * @tail: (allow-none): the last lines of the file, or %NULL if @head
+	 * contains the whole file.
+	 *
+	 * The "load-preview" signal is emitted during a file loading, before
+	 * the content is inserted in the buffer. It is emitted only when the
+	 * beginning and the end of the file can be read in advance, for local
+	 * UTF-8 files. The view can be configured in the handler, so that the
+	 * content is laid out only once.
+	 *
+	 * Since: 3.16
+	 */
+	document_signals[LOAD_PREVIEW] =
+		g_signal_new ("load-preview",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL, NULL,
+			      G_TYPE_NONE,
+			      2,
+			      G_TYPE_STRING,
+			      G_TYPE_STRING);
+
 	/**
 	 * GeditDocument::loaded:
 	 * @document: the #GeditDocument.
@@ -615,25 +866,12 @@ guess_language (GeditDocument *doc)
 	}
 	else
 	{
-		GFile *location;
-		gchar *basename = NULL;
+		gchar *basename;
 
-		location = gtk_source_file_get_location (doc->priv->file);
 		gedit_debug_message (DEBUG_DOCUMENT, "Sniffing Language");
 
-		if (location != NULL)
-		{
-			basename = g_file_get_basename (location);
-		}
-		else if (doc->priv->short_name != NULL)
-		{
-			basename = g_strdup (doc->priv->short_name);
-		}
-
-		language = gtk_source_language_manager_guess_language (manager,
-								       basename,
-								       doc->priv->content_type);
-
+		basename = get_basename_for_guess (doc);
+		language = guess_language_cached (basename, doc->priv->content_type);
 		g_free (basename);
 	}
 
@@ -748,6 +986,8 @@ gedit_document_init (GeditDocument *doc)
 
 	priv->empty_search = TRUE;
 
+	priv->expected_line_count = -1;
+
 	g_get_current_time (&doc->priv->time_of_last_save_or_load);
 
 	priv->file = gtk_source_file_new ();
@@ -836,7 +1076,14 @@ set_content_type_no_guess (GeditDocument *doc,
 	if (gedit_utils_get_compression_type_from_content_type (content_type) !=
 	    GTK_SOURCE_COMPRESSION_TYPE_NONE)
 	{
-		dupped_content_type = get_content_type_from_content (doc);
+		if (doc->priv->sniffed_content_type != NULL)
+		{
+			dupped_content_type = g_strdup (doc->priv->sniffed_content_type);
+		}
+		else
+		{
+			dupped_content_type = get_content_type_from_content (doc);
+		}
 	}
 	else
 	{
@@ -882,7 +1129,7 @@ gedit_document_set_content_type (GeditDocument *doc,
 			gchar *basename;
 
 			basename = g_file_get_basename (location);
-			guessed_type = g_content_type_guess (basename, NULL, 0, NULL);
+			guessed_type = guess_content_type_cached (basename, NULL, 0);
 
 			g_free (basename);
 		}
@@ -1089,7 +1336,12 @@ loaded_query_info_cb (GFile         *location,
 
 	if (info != NULL)
 	{
-		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
+		/* The content type guessed from the first chunk is reused: a
+		 * different guess here would change the language, and
+		 * highlight the whole buffer a second time.
+		 */
+		if (!doc->priv->first_chunk_inserted &&
+		    g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
 		{
 			const gchar *content_type;
 
@@ -1120,11 +1372,178 @@ loaded_query_info_cb (GFile         *location,
 	g_object_unref (doc);
 }
 
+static void
+count_lines_thread (GTask        *task,
+		    gpointer      source_object,
+		    GFile        *location,
+		    GCancellable *cancellable)
+{
+	GFileInputStream *stream;
+	gchar *buffer;
+	gssize n_read;
+	gint n_lines = 1;
+	gchar last_char = '\0';
+	gint64 span;
+	GError *error = NULL;
+
+	span = gedit_debug_span_begin (GEDIT_DEBUG_DOCUMENT);
+
+	stream = g_file_read (location, cancellable, &error);
+
+	if (stream == NULL)
+	{
+		g_task_return_error (task, error);
+		return;
+	}
+
+	buffer = g_malloc (LINE_COUNT_BUFFER_SIZE);
+
+	while ((n_read = g_input_stream_read (G_INPUT_STREAM (stream),
+					      buffer,
+					      LINE_COUNT_BUFFER_SIZE,
+					      cancellable,
+					      &error)) > 0)
+	{
+		const gchar *p = buffer;
+		const gchar *end = buffer + n_read;
+
+		while ((p = memchr (p, '\n', end - p)) != NULL)
+		{
+			n_lines++;
+			p++;
+		}
+
+		last_char = buffer[n_read - 1];
+	}
+
+	/* With the implicit trailing newline (the default), the file loader
+	 * removes the trailing newline, it doesn't start a new line in the
+	 * buffer.
+	 */
+	if (last_char == '\n')
+	{
+		n_lines--;
+	}
+
+	g_free (buffer);
+	g_object_unref (stream);
+
+	if (span != 0)
+	{
+		gchar *detail;
+
+		detail = g_strdup_printf ("%d lines", n_lines);
+		gedit_debug_span_end (GEDIT_DEBUG_DOCUMENT, span, "count-lines", detail);
+		g_free (detail);
+	}
+
+	if (error != NULL)
+	{
+		g_task_return_error (task, error);
+	}
+	else
+	{
+		g_task_return_int (task, n_lines);
+	}
+}
+
+static void
+count_lines_cb (GeditDocument *doc,
+		GAsyncResult  *result,
+		gpointer       user_data)
+{
+	gssize n_lines;
+	GError *error = NULL;
+
+	/* The count of a previous loading */
+	if (g_task_get_cancellable (G_TASK (result)) != doc->priv->line_count_cancellable)
+	{
+		return;
+	}
+
+	n_lines = g_task_propagate_int (G_TASK (result), &error);
+
+	if (error != NULL)
+	{
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			gedit_debug_message (DEBUG_DOCUMENT, "Line count error: %s", error->message);
+		}
+
+		g_error_free (error);
+		return;
+	}
+
+	if (doc->priv->loading)
+	{
+		gedit_debug_message (DEBUG_DOCUMENT, "Expected line count: %d", (gint) n_lines);
+		doc->priv->expected_line_count = n_lines;
+	}
+}
+
+/* The count is only a hint: compressed files or encodings where '\n' is not
+ * a single byte give a wrong result. It lets the goto-line entry know the size
+ * of a big file while it is still loading. Only local files are read twice.
+ */
+static void
+start_counting_lines (GeditDocument *doc)
+{
+	GFile *location;
+	GTask *task;
+
+	location = gtk_source_file_get_location (doc->priv->file);
+
+	if (location == NULL || !g_file_is_native (location))
+	{
+		return;
+	}
+
+	doc->priv->line_count_cancellable = g_cancellable_new ();
+
+	task = g_task_new (doc,
+			   doc->priv->line_count_cancellable,
+			   (GAsyncReadyCallback) count_lines_cb,
+			   NULL);
+
+	g_task_set_task_data (task, g_object_ref (location), g_object_unref);
+	g_task_run_in_thread (task, (GTaskThreadFunc) count_lines_thread);
+	g_object_unref (task);
+}
+
+static void
+stop_counting_lines (GeditDocument *doc)
+{
+	if (doc->priv->line_count_cancellable != NULL)
+	{
+		g_cancellable_cancel (doc->priv->line_count_cancellable);
+		g_clear_object (&doc->priv->line_count_cancellable);
+	}
+
+	doc->priv->expected_line_count = -1;
+}
+
+static void
+gedit_document_load_real (GeditDocument *doc)
+{
+	stop_counting_lines (doc);
+
+	doc->priv->loading = TRUE;
+	doc->priv->first_chunk_inserted = FALSE;
+
+	g_free (doc->priv->sniffed_content_type);
+	doc->priv->sniffed_content_type = NULL;
+
+	start_counting_lines (doc);
+}
+
 static void
 gedit_document_loaded_real (GeditDocument *doc)
 {
 	GFile *location;
 
+	doc->priv->loading = FALSE;
+	stop_counting_lines (doc);
+
 	if (!doc->priv->language_set_by_user)
 	{
 		GtkSourceLanguage *language = guess_language (doc);
@@ -1143,7 +1562,13 @@ gedit_document_loaded_real (GeditDocument *doc)
 
 	set_readonly (doc, FALSE);
 
-	gedit_document_set_content_type (doc, NULL);
+	/* Keep the content type guessed from the first chunk, the language
+	 * has already been chosen from it.
+	 */
+	if (!doc->priv->first_chunk_inserted)
+	{
+		gedit_document_set_content_type (doc, NULL);
+	}
 
 	location = gtk_source_file_get_location (doc->priv->file);
 
@@ -1227,6 +1652,10 @@ gedit_document_saved_real (GeditDocument *doc)
 {
 	GFile *location = gtk_source_file_get_location (doc->priv->file);
 
+	/* The content may have changed since it was loaded. */
+	g_free (doc->priv->sniffed_content_type);
+	doc->priv->sniffed_content_type = NULL;
+
 	/* Keep the doc alive during the async operation. */
 	g_object_ref (doc);
 
@@ -1453,6 +1882,31 @@ gedit_document_goto_line_offset (GeditDocument *doc,
 	return ret;
 }
 
+/*
+ * Whether @line is not yet in the buffer but should be once the file loading
+ * finishes. Used to defer a goto-line instead of reporting it as out of range.
+ */
+gboolean
+_gedit_document_line_is_pending (GeditDocument *doc,
+				 gint           line)
+{
+	g_return_val_if_fail (GEDIT_IS_DOCUMENT (doc), FALSE);
+
+	if (!doc->priv->loading)
+	{
+		return FALSE;
+	}
+
+	if (line < gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (doc)))
+	{
+		return FALSE;
+	}
+
+	/* Without the line count, any line may still come. */
+	return (doc->priv->expected_line_count == -1 ||
+		line < doc->priv->expected_line_count);
+}
+
 /**
  * gedit_document_set_language:
  * @doc:
@@ -1678,6 +2132,7 @@ gedit_document_set_metadata (GeditDocument *doc,
 	if (location != NULL)
 	{
 		GError *error = NULL;
+		gint64 span;
 
 		/* We save synchronously since metadata is always local so it
 		 * should be fast. Moreover this function can be called on
@@ -1685,12 +2140,16 @@ gedit_document_set_metadata (GeditDocument *doc,
 		 * so an async operation would not terminate.
 		 * https://bugzilla.gnome.org/show_bug.cgi?id=736591
 		 */
+		span = gedit_debug_span_begin (GEDIT_DEBUG_METADATA);
+
 		g_file_set_attributes_from_info (location,
 						 info,
 						 G_FILE_QUERY_INFO_NONE,
 						 NULL,
 						 &error);
 
+		gedit_debug_span_end (GEDIT_DEBUG_METADATA, span, "metadata-set", first_key);
+
 		if (error != NULL)
 		{
 			g_warning ("Set document metadata failed: %s", error->message);
@@ -1819,6 +2278,46 @@ gedit_document_get_search_context (GeditDocument *doc)
 	return doc->priv->search_context;
 }
 
+/**
+ * gedit_document_get_undo_usage:
+ * @doc: a #GeditDocument.
+ * @memory: (out) (allow-none): return location for the memory used by the
+ * undo history, in bytes.
+ * @disk: (out) (allow-none): return location for the size of the undo history
+ * moved to a temporary file, in bytes.
+ *
+ * Gets the resources used by the undo history of @doc. Both are 0 if the
+ * undo manager has been replaced by one that is not provided by gedit.
+ *
+ * Since: 3.16
+ */
+void
+gedit_document_get_undo_usage (GeditDocument *doc,
+			       guint64       *memory,
+			       guint64       *disk)
+{
+	GtkSourceUndoManager *manager;
+
+	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
+
+	if (memory != NULL)
+	{
+		*memory = 0;
+	}
+
+	if (disk != NULL)
+	{
+		*disk = 0;
+	}
+
+	manager = gtk_source_buffer_get_undo_manager (GTK_SOURCE_BUFFER (doc));
+
+	if (GEDIT_IS_UNDO_MANAGER (manager))
+	{
+		gedit_undo_manager_get_usage (GEDIT_UNDO_MANAGER (manager), memory, disk);
+	}
+}
+
 gboolean
 _gedit_document_get_empty_search (GeditDocument *doc)
 {
@@ -153,6 +153,10 @@ GtkSourceSearchContext *
 		 gedit_document_get_search_context
 						(GeditDocument       *doc);
 
+void		 gedit_document_get_undo_usage	(GeditDocument       *doc,
+						 guint64             *memory,
+						 guint64             *disk);
+
 /* Non exported functions */
 
 glong		 _gedit_document_get_seconds_since_last_save_or_load
@@ -172,6 +176,10 @@ void		 _gedit_document_set_create	(GeditDocument       *doc,
 
 gboolean	 _gedit_document_get_create	(GeditDocument       *doc);
 
+gboolean	 _gedit_document_line_is_pending
+						(GeditDocument       *doc,
+						 gint                 line);
+
 G_END_DECLS
 
 #endif /* __GEDIT_DOCUMENT_H__ */
@@ -0,0 +1,1161 @@
+/*
+ * gedit-file-index.c
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-file-index.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gedit-debug.h"
+
+/**
+ * SECTION:gedit-file-index
+ * @short_description: Fuzzy index of the files of a directory tree
+ *
+ * A #GeditFileIndex lists the text files of a local directory tree, and finds
+ * the best matching paths for a fuzzy query, like "gfi" for
+ * "gedit/gedit-file-index.c". The tree is scanned in a thread, and the index
+ * is kept up to date with file monitors.
+ */
+
+/* Bounds of each index, and of all the indexes together, to not exhaust the
+ * memory or the inotify watches */
+#define MAX_FILES 1000000
+#define MAX_INDEXES 4
+#define MAX_MONITORS 1024
+
+/* Interval between the deliveries of the scanned files, in milliseconds */
+#define FLUSH_INTERVAL 100
+
+/* Scores of the matched characters */
+#define SCORE_MATCH 1
+#define BONUS_SEGMENT_START 10
+#define BONUS_WORD_START 8
+#define BONUS_CAMEL_CASE 8
+#define BONUS_CONSECUTIVE 5
+#define BONUS_BASENAME 20
+#define MAX_GAP_PENALTY 3
+
+typedef struct
+{
+	/* Relative to the root, NULL if the file has been removed */
+	const gchar *path;
+	guint basename_offset;
+
+	/* See get_char_mask() */
+	guint32 mask;
+} FileEntry;
+
+typedef struct
+{
+	GeditFileIndex *index;
+	gchar *root_path;
+
+	/* Relative path of the directory to scan, "" for the root */
+	gchar *start;
+} ScanData;
+
+typedef struct
+{
+	guint entry;
+	gint score;
+} QueryResult;
+
+struct _GeditFileIndexPrivate
+{
+	GFile *root;
+	gchar *root_path;
+
+	GArray *entries;
+	GStringChunk *paths;
+
+	/* Path -> index + 1 in entries */
+	GHashTable *entries_by_path;
+	guint n_removed;
+
+	/* Relative path of a directory -> GFileMonitor */
+	GHashTable *monitors;
+
+	GCancellable *cancellable;
+	guint n_scans;
+	guint flush_id;
+	guint changed_id;
+
+	/* Filled by the scan threads */
+	GMutex mutex;
+	GPtrArray *pending_files;
+	GPtrArray *pending_dirs;
+	gint n_scanned;
+};
+
+enum
+{
+	CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+/* The shared indexes, the most recently used first */
+static GQueue indexes = G_QUEUE_INIT;
+
+/* Number of directories monitored by all the indexes */
+static guint n_monitors = 0;
+
+G_DEFINE_TYPE_WITH_PRIVATE (GeditFileIndex, gedit_file_index, G_TYPE_OBJECT)
+
+static void start_scan (GeditFileIndex *index, const gchar *start);
+
+static void
+monitor_free (GFileMonitor *monitor)
+{
+	g_file_monitor_cancel (monitor);
+	g_object_unref (monitor);
+
+	n_monitors--;
+}
+
+/* Stops the scan and the monitoring of the tree, the files already found
+ * are kept.
+ */
+static void
+stop_index (GeditFileIndex *index)
+{
+	GeditFileIndexPrivate *priv = index->priv;
+
+	if (priv->cancellable != NULL)
+	{
+		g_cancellable_cancel (priv->cancellable);
+		g_clear_object (&priv->cancellable);
+	}
+
+	if (priv->monitors != NULL)
+	{
+		g_hash_table_remove_all (priv->monitors);
+	}
+}
+
+static void
+gedit_file_index_dispose (GObject *object)
+{
+	GeditFileIndexPrivate *priv = GEDIT_FILE_INDEX (object)->priv;
+
+	stop_index (GEDIT_FILE_INDEX (object));
+
+	if (priv->flush_id != 0)
+	{
+		g_source_remove (priv->flush_id);
+		priv->flush_id = 0;
+	}
+
+	if (priv->changed_id != 0)
+	{
+		g_source_remove (priv->changed_id);
+		priv->changed_id = 0;
+	}
+
+	if (priv->monitors != NULL)
+	{
+		g_hash_table_destroy (priv->monitors);
+		priv->monitors = NULL;
+	}
+
+	g_clear_object (&priv->root);
+
+	G_OBJECT_CLASS (gedit_file_index_parent_class)->dispose (object);
+}
+
+static void
+gedit_file_index_finalize (GObject *object)
+{
+	GeditFileIndexPrivate *priv = GEDIT_FILE_INDEX (object)->priv;
+
+	g_free (priv->root_path);
+	g_array_free (priv->entries, TRUE);
+	g_string_chunk_free (priv->paths);
+	g_hash_table_destroy (priv->entries_by_path);
+	g_ptr_array_free (priv->pending_files, TRUE);
+	g_ptr_array_free (priv->pending_dirs, TRUE);
+	g_mutex_clear (&priv->mutex);
+
+	G_OBJECT_CLASS (gedit_file_index_parent_class)->finalize (object);
+}
+
+static void
+gedit_file_index_class_init (GeditFileIndexClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gedit_file_index_dispose;
+	object_class->finalize = gedit_file_index_finalize;
+
+	/**
+	 * GeditFileIndex::changed:
+	 * @index: the #GeditFileIndex emitting the signal.
+	 *
+	 * Emitted when files have been added to or removed from the index,
+	 * and when the scan of the tree is finished.
+	 */
+	signals[CHANGED] =
+		g_signal_new ("changed",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GeditFileIndexClass, changed),
+			      NULL, NULL, NULL,
+			      G_TYPE_NONE, 0);
+}
+
+static void
+gedit_file_index_init (GeditFileIndex *index)
+{
+	GeditFileIndexPrivate *priv;
+
+	index->priv = gedit_file_index_get_instance_private (index);
+	priv = index->priv;
+
+	priv->entries = g_array_new (FALSE, FALSE, sizeof (FileEntry));
+	priv->paths = g_string_chunk_new (64 * 1024);
+	priv->entries_by_path = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->monitors = g_hash_table_new_full (g_str_hash,
+						g_str_equal,
+						g_free,
+						(GDestroyNotify) monitor_free);
+	priv->cancellable = g_cancellable_new ();
+
+	g_mutex_init (&priv->mutex);
+	priv->pending_files = g_ptr_array_new_with_free_func (g_free);
+	priv->pending_dirs = g_ptr_array_new_with_free_func (g_free);
+}
+
+/* One bit for each letter, case insensitively, and a few for the other
+ * characters. An entry can match a query only if its mask contains the mask
+ * of the query.
+ */
+static guint32
+get_char_mask (guchar c)
+{
+	c = g_ascii_tolower (c);
+
+	if (c >= 'a' && c <= 'z')
+		return 1u << (c - 'a');
+
+	if (c >= '0' && c <= '9')
+		return 1u << 26;
+
+	switch (c)
+	{
+		case '.':
+			return 1u << 27;
+		case '_':
+			return 1u << 28;
+		case '-':
+			return 1u << 29;
+		case '/':
+			return 1u << 30;
+		default:
+			return 1u << 31;
+	}
+}
+
+static guint32
+get_mask (const gchar *str)
+{
+	guint32 mask = 0;
+
+	for (; *str != '\0'; str++)
+	{
+		mask |= get_char_mask ((guchar) *str);
+	}
+
+	return mask;
+}
+
+static gboolean
+is_hidden_name (const gchar *name)
+{
+	return name[0] == '.' || g_str_has_suffix (name, "~");
+}
+
+/* Called from the scan threads, @cache avoids guessing the content type of
+ * each file with the same extension.
+ */
+static gboolean
+is_text_file_name (const gchar *name,
+		   GHashTable  *cache)
+{
+	const gchar *extension;
+	gchar *content_type;
+	gpointer cached;
+	gboolean ret;
+
+	extension = strrchr (name, '.');
+
+	if (extension != NULL &&
+	    g_hash_table_lookup_extended (cache, extension, NULL, &cached))
+	{
+		return GPOINTER_TO_INT (cached);
+	}
+
+	content_type = g_content_type_guess (name, NULL, 0, NULL);
+
+	ret = content_type == NULL ||
+	      g_content_type_is_unknown (content_type) ||
+	      g_content_type_is_a (content_type, "text/plain");
+
+	g_free (content_type);
+
+	if (extension != NULL)
+	{
+		g_hash_table_insert (cache,
+				     g_strdup (extension),
+				     GINT_TO_POINTER (ret));
+	}
+
+	return ret;
+}
+
+static void
+scan_directory (ScanData    *data,
+		const gchar *dir,
+		GQueue      *dirs,
+		GHashTable  *text_cache,
+		GPtrArray   *files)
+{
+	GeditFileIndexPrivate *priv = data->index->priv;
+	GDir *gdir;
+	gchar *dir_path;
+	const gchar *name;
+
+	dir_path = g_build_filename (data->root_path, dir, NULL);
+	gdir = g_dir_open (dir_path, 0, NULL);
+
+	if (gdir == NULL)
+	{
+		g_free (dir_path);
+		return;
+	}
+
+	while ((name = g_dir_read_name (gdir)) != NULL)
+	{
+		gchar *path;
+		GStatBuf buf;
+
+		if (is_hidden_name (name))
+		{
+			continue;
+		}
+
+		path = g_build_filename (dir_path, name, NULL);
+
+		/* Symbolic links are not followed, to avoid cycles. */
+		if (g_lstat (path, &buf) == 0)
+		{
+			gchar *relative_path;
+
+			relative_path = dir[0] == '\0' ?
+			                g_strdup (name) :
+			                g_build_filename (dir, name, NULL);
+
+			if (S_ISDIR (buf.st_mode))
+			{
+				g_queue_push_tail (dirs, relative_path);
+			}
+			else if (S_ISREG (buf.st_mode) &&
+				 is_text_file_name (name, text_cache))
+			{
+				g_ptr_array_add (files, relative_path);
+			}
+			else
+			{
+				g_free (relative_path);
+			}
+		}
+
+		g_free (path);
+	}
+
+	g_dir_close (gdir);
+	g_free (dir_path);
+
+	/* Deliver the files by batches */
+	g_mutex_lock (&priv->mutex);
+
+	while (files->len > 0)
+	{
+		g_ptr_array_add (priv->pending_files,
+				 g_ptr_array_remove_index_fast (files, files->len - 1));
+	}
+
+	g_ptr_array_add (priv->pending_dirs, g_strdup (dir));
+
+	g_mutex_unlock (&priv->mutex);
+}
+
+/* Walks the tree breadth first, so that the directories near the root are
+ * monitored first.
+ */
+static void
+scan_thread (GTask        *task,
+	     gpointer      source_object,
+	     ScanData     *data,
+	     GCancellable *cancellable)
+{
+	GQueue dirs = G_QUEUE_INIT;
+	GHashTable *text_cache;
+	GPtrArray *files;
+	guint n_dirs = 0;
+	gint64 span;
+
+	span = gedit_debug_span_begin (GEDIT_DEBUG_UTILS);
+
+	text_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	files = g_ptr_array_new_with_free_func (g_free);
+
+	g_queue_push_tail (&dirs, g_strdup (data->start));
+
+	while (!g_queue_is_empty (&dirs))
+	{
+		gchar *dir = g_queue_pop_head (&dirs);
+
+		if (!g_cancellable_is_cancelled (cancellable) &&
+		    g_atomic_int_get (&data->index->priv->n_scanned) < MAX_FILES)
+		{
+			scan_directory (data, dir, &dirs, text_cache, files);
+			n_dirs++;
+		}
+
+		g_free (dir);
+	}
+
+	gedit_debug_message (DEBUG_UTILS,
+			     "Scanned %u directories in %s/%s",
+			     n_dirs,
+			     data->root_path,
+			     data->start);
+
+	gedit_debug_span_end (GEDIT_DEBUG_UTILS, span, "file-index-scan", data->root_path);
+
+	g_ptr_array_free (files, TRUE);
+	g_hash_table_destroy (text_cache);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+scan_data_free (ScanData *data)
+{
+	g_free (data->root_path);
+	g_free (data->start);
+	g_slice_free (ScanData, data);
+}
+
+static gboolean
+emit_changed_cb (GeditFileIndex *index)
+{
+	index->priv->changed_id = 0;
+
+	g_signal_emit (index, signals[CHANGED], 0);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Coalesces the notifications of the file monitors */
+static void
+queue_changed (GeditFileIndex *index)
+{
+	if (index->priv->changed_id == 0)
+	{
+		index->priv->changed_id = g_idle_add ((GSourceFunc) emit_changed_cb,
+						      index);
+	}
+}
+
+static void
+add_file (GeditFileIndex *index,
+	  const gchar    *relative_path)
+{
+	GeditFileIndexPrivate *priv = index->priv;
+	FileEntry entry;
+	const gchar *basename;
+
+	if (g_hash_table_contains (priv->entries_by_path, relative_path))
+	{
+		return;
+	}
+
+	entry.path = g_string_chunk_insert (priv->paths, relative_path);
+	entry.mask = get_mask (entry.path);
+
+	basename = strrchr (entry.path, G_DIR_SEPARATOR);
+	entry.basename_offset = basename != NULL ? basename - entry.path + 1 : 0;
+
+	g_array_append_val (priv->entries, entry);
+
+	g_hash_table_insert (priv->entries_by_path,
+			     (gpointer) entry.path,
+			     GUINT_TO_POINTER (priv->entries->len));
+}
+
+/* Drops the removed entries, when they are too many. */
+static void
+compact_entries (GeditFileIndex *index)
+{
+	GeditFileIndexPrivate *priv = index->priv;
+	guint i;
+	guint j = 0;
+
+	if (priv->n_removed < priv->entries->len / 4)
+	{
+		return;
+	}
+
+	g_hash_table_remove_all (priv->entries_by_path);
+
+	for (i = 0; i < priv->entries->len; i++)
+	{
+		FileEntry *entry = &g_array_index (priv->entries, FileEntry, i);
+
+		if (entry->path != NULL)
+		{
+			g_array_index (priv->entries, FileEntry, j) = *entry;
+			g_hash_table_insert (priv->entries_by_path,
+					     (gpointer) entry->path,
+					     GUINT_TO_POINTER (j + 1));
+			j++;
+		}
+	}
+
+	g_array_set_size (priv->entries, j);
+	priv->n_removed = 0;
+}
+
+static void
+remove_entry (GeditFileIndex *index,
+	      guint           i)
+{
+	FileEntry *entry = &g_array_index (index->priv->entries, FileEntry, i);
+
+	g_hash_table_remove (index->priv->entries_by_path, entry->path);
+	entry->path = NULL;
+	index->priv->n_removed++;
+}
+
+/* Removes a file, or all the files of a directory. */
+static void
+remove_path (GeditFileIndex *index,
+	     const gchar    *relative_path)
+{
+	GeditFileIndexPrivate *priv = index->priv;
+	gpointer value;
+	gsize length;
+	guint i;
+
+	value = g_hash_table_lookup (priv->entries_by_path, relative_path);
+
+	if (value != NULL)
+	{
+		remove_entry (index, GPOINTER_TO_UINT (value) - 1);
+		compact_entries (index);
+		return;
+	}
+
+	length = strlen (relative_path);
+
+	for (i = 0; i < priv->entries->len; i++)
+	{
+		FileEntry *entry = &g_array_index (priv->entries, FileEntry, i);
+
+		if (entry->path != NULL &&
+		    strncmp (entry->path, relative_path, length) == 0 &&
+		    entry->path[length] == G_DIR_SEPARATOR)
+		{
+			remove_entry (index, i);
+		}
+	}
+
+	compact_entries (index);
+}
+
+static void
+monitor_changed_cb (GFileMonitor      *monitor,
+		    GFile             *file,
+		    GFile             *other_file,
+		    GFileMonitorEvent  event,
+		    GeditFileIndex    *index)
+{
+	gchar *relative_path;
+	gchar *basename;
+
+	relative_path = g_file_get_relative_path (index->priv->root, file);
+	basename = g_file_get_basename (file);
+
+	if (relative_path == NULL || is_hidden_name (basename))
+	{
+		g_free (relative_path);
+		g_free (basename);
+		return;
+	}
+
+	if (event == G_FILE_MONITOR_EVENT_CREATED)
+	{
+		GFileType type;
+
+		type = g_file_query_file_type (file,
+					       G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+					       NULL);
+
+		if (type == G_FILE_TYPE_DIRECTORY)
+		{
+			start_scan (index, relative_path);
+		}
+		else if (type == G_FILE_TYPE_REGULAR)
+		{
+			GHashTable *cache;
+
+			cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+			if (is_text_file_name (basename, cache))
+			{
+				add_file (index, relative_path);
+				queue_changed (index);
+			}
+
+			g_hash_table_destroy (cache);
+		}
+	}
+	else if (event == G_FILE_MONITOR_EVENT_DELETED)
+	{
+		remove_path (index, relative_path);
+		g_hash_table_remove (index->priv->monitors, relative_path);
+		queue_changed (index);
+	}
+
+	g_free (relative_path);
+	g_free (basename);
+}
+
+/* Stops the least recently used index other than @index, to give its
+ * monitors to @index. Returns FALSE if there is none.
+ */
+static gboolean
+evict_index (GeditFileIndex *index)
+{
+	GList *l;
+
+	for (l = indexes.tail; l != NULL; l = l->prev)
+	{
+		GeditFileIndex *evicted = l->data;
+
+		if (evicted != index)
+		{
+			gedit_debug_message (DEBUG_UTILS,
+					     "Evicting the index of %s",
+					     evicted->priv->root_path);
+
+			g_queue_delete_link (&indexes, l);
+			stop_index (evicted);
+			g_object_unref (evicted);
+
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+monitor_directory (GeditFileIndex *index,
+		   gchar          *relative_path)
+{
+	GFile *dir;
+	GFileMonitor *monitor;
+
+	if (index->priv->cancellable == NULL ||
+	    g_hash_table_contains (index->priv->monitors, relative_path))
+	{
+		g_free (relative_path);
+		return;
+	}
+
+	while (n_monitors >= MAX_MONITORS)
+	{
+		if (!evict_index (index))
+		{
+			g_free (relative_path);
+			return;
+		}
+	}
+
+	dir = relative_path[0] == '\0' ?
+	      g_object_ref (index->priv->root) :
+	      g_file_resolve_relative_path (index->priv->root, relative_path);
+
+	monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref (dir);
+
+	if (monitor == NULL)
+	{
+		g_free (relative_path);
+		return;
+	}
+
+	g_signal_connect (monitor,
+			  "changed",
+			  G_CALLBACK (monitor_changed_cb),
+			  index);
+
+	g_hash_table_insert (index->priv->monitors, relative_path, monitor);
+	n_monitors++;
+}
+
+/* Moves the files found by the scan threads to the index. */
+static void
+flush_pending (GeditFileIndex *index)
+{
+	GeditFileIndexPrivate *priv = index->priv;
+	GPtrArray *files;
+	GPtrArray *dirs;
+	guint i;
+
+	g_mutex_lock (&priv->mutex);
+
+	files = priv->pending_files;
+	dirs = priv->pending_dirs;
+	priv->pending_files = g_ptr_array_new_with_free_func (g_free);
+	priv->pending_dirs = g_ptr_array_new_with_free_func (g_free);
+
+	g_mutex_unlock (&priv->mutex);
+
+	for (i = 0; i < files->len && priv->entries->len < MAX_FILES; i++)
+	{
+		add_file (index, g_ptr_array_index (files, i));
+	}
+
+	g_atomic_int_set (&priv->n_scanned, priv->entries->len - priv->n_removed);
+
+	for (i = 0; i < dirs->len; i++)
+	{
+		monitor_directory (index, g_ptr_array_index (dirs, i));
+		dirs->pdata[i] = NULL;
+	}
+
+	if (files->len > 0)
+	{
+		g_signal_emit (index, signals[CHANGED], 0);
+	}
+
+	g_ptr_array_free (files, TRUE);
+	g_ptr_array_free (dirs, TRUE);
+}
+
+static gboolean
+flush_pending_cb (GeditFileIndex *index)
+{
+	flush_pending (index);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+scan_finished_cb (GeditFileIndex *index,
+		  GAsyncResult   *result,
+		  gpointer        user_data)
+{
+	g_task_propagate_boolean (G_TASK (result), NULL);
+
+	if (--index->priv->n_scans > 0)
+	{
+		return;
+	}
+
+	if (index->priv->flush_id != 0)
+	{
+		g_source_remove (index->priv->flush_id);
+		index->priv->flush_id = 0;
+	}
+
+	flush_pending (index);
+
+	gedit_debug_message (DEBUG_UTILS,
+			     "%u files indexed in %s",
+			     gedit_file_index_get_n_files (index),
+			     index->priv->root_path);
+
+	/* Now ready */
+	g_signal_emit (index, signals[CHANGED], 0);
+}
+
+static void
+start_scan (GeditFileIndex *index,
+	    const gchar    *start)
+{
+	ScanData *data;
+	GTask *task;
+
+	if (index->priv->cancellable == NULL)
+	{
+		return;
+	}
+
+	data = g_slice_new (ScanData);
+	data->index = index;
+	data->root_path = g_strdup (index->priv->root_path);
+	data->start = g_strdup (start);
+
+	/* The task keeps a reference to the index until it is finished. */
+	task = g_task_new (index,
+			   index->priv->cancellable,
+			   (GAsyncReadyCallback) scan_finished_cb,
+			   NULL);
+
+	g_task_set_task_data (task, data, (GDestroyNotify) scan_data_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc) scan_thread);
+	g_object_unref (task);
+
+	index->priv->n_scans++;
+
+	if (index->priv->flush_id == 0)
+	{
+		index->priv->flush_id = g_timeout_add (FLUSH_INTERVAL,
+						       (GSourceFunc) flush_pending_cb,
+						       index);
+	}
+}
+
+/**
+ * gedit_file_index_new:
+ * @root: a local directory.
+ *
+ * Creates a new index of the text files under @root, and starts to scan the
+ * tree. The hidden files and directories are not indexed.
+ *
+ * Returns: a new #GeditFileIndex.
+ *
+ * Since: 3.16
+ */
+GeditFileIndex *
+gedit_file_index_new (GFile *root)
+{
+	GeditFileIndex *index;
+
+	g_return_val_if_fail (G_IS_FILE (root), NULL);
+	g_return_val_if_fail (g_file_is_native (root), NULL);
+
+	index = g_object_new (GEDIT_TYPE_FILE_INDEX, NULL);
+
+	index->priv->root = g_object_ref (root);
+	index->priv->root_path = g_file_get_path (root);
+
+	start_scan (index, "");
+
+	return index;
+}
+
+/**
+ * gedit_file_index_get_for_root:
+ * @root: a directory.
+ *
+ * Gets an index containing @root, shared by the whole application. It may be
+ * the index of a parent directory of @root. The last few used indexes are
+ * kept up to date between the calls, the older ones are dropped when there
+ * are too many, or when the directories they monitor are needed by a more
+ * recent index.
+ *
+ * Returns: (transfer full) (allow-none): a #GeditFileIndex containing @root,
+ * or %NULL if @root is not a local directory.
+ *
+ * Since: 3.16
+ */
+GeditFileIndex *
+gedit_file_index_get_for_root (GFile *root)
+{
+	GeditFileIndex *index;
+	GList *l;
+
+	g_return_val_if_fail (G_IS_FILE (root), NULL);
+
+	if (!g_file_is_native (root))
+	{
+		return NULL;
+	}
+
+	for (l = indexes.head; l != NULL; l = l->next)
+	{
+		GFile *index_root = GEDIT_FILE_INDEX (l->data)->priv->root;
+
+		if (g_file_equal (root, index_root) ||
+		    g_file_has_prefix (root, index_root))
+		{
+			break;
+		}
+	}
+
+	if (l != NULL)
+	{
+		index = l->data;
+		g_queue_unlink (&indexes, l);
+		g_queue_push_head_link (&indexes, l);
+	}
+	else
+	{
+		while (indexes.length >= MAX_INDEXES)
+		{
+			evict_index (NULL);
+		}
+
+		index = gedit_file_index_new (root);
+		g_queue_push_head (&indexes, index);
+	}
+
+	return g_object_ref (index);
+}
+
+/**
+ * gedit_file_index_get_root:
+ * @index: a #GeditFileIndex.
+ *
+ * Returns: (transfer none): the root directory of @index.
+ *
+ * Since: 3.16
+ */
+GFile *
+gedit_file_index_get_root (GeditFileIndex *index)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_INDEX (index), NULL);
+
+	return index->priv->root;
+}
+
+/**
+ * gedit_file_index_is_ready:
+ * @index: a #GeditFileIndex.
+ *
+ * Returns: %TRUE if the scan of the tree is finished.
+ *
+ * Since: 3.16
+ */
+gboolean
+gedit_file_index_is_ready (GeditFileIndex *index)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_INDEX (index), FALSE);
+
+	return index->priv->n_scans == 0;
+}
+
+/**
+ * gedit_file_index_get_n_files:
+ * @index: a #GeditFileIndex.
+ *
+ * Returns: the number of files in @index.
+ *
+ * Since: 3.16
+ */
+guint
+gedit_file_index_get_n_files (GeditFileIndex *index)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_INDEX (index), 0);
+
+	return index->priv->entries->len - index->priv->n_removed;
+}
+
+static gboolean
+is_word_separator (gchar c)
+{
+	return c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+/* Matches @query as a subsequence of @str from @start, greedily. Returns the
+ * score, or -1 if @query doesn't match.
+ */
+static gint
+score_subsequence (const gchar *str,
+		   guint        start,
+		   const gchar *query)
+{
+	gint score = 0;
+	gint prev = -1;
+	guint i = start;
+
+	for (; *query != '\0'; query++)
+	{
+		while (str[i] != '\0' && g_ascii_tolower (str[i]) != *query)
+			i++;
+
+		if (str[i] == '\0')
+			return -1;
+
+		score += SCORE_MATCH;
+
+		if (i == 0 || str[i - 1] == G_DIR_SEPARATOR)
+			score += BONUS_SEGMENT_START;
+		else if (is_word_separator (str[i - 1]))
+			score += BONUS_WORD_START;
+		else if (g_ascii_isupper (str[i]) && g_ascii_islower (str[i - 1]))
+			score += BONUS_CAMEL_CASE;
+
+		if (prev >= 0)
+		{
+			if ((gint) i == prev + 1)
+				score += BONUS_CONSECUTIVE;
+			else
+				score -= MIN ((gint) i - prev - 1, MAX_GAP_PENALTY);
+		}
+
+		prev = i;
+		i++;
+	}
+
+	return score;
+}
+
+static gint
+score_entry (const FileEntry *entry,
+	     const gchar     *query)
+{
+	gint score;
+	gint basename_score;
+
+	score = score_subsequence (entry->path, 0, query);
+
+	if (score < 0)
+		return -1;
+
+	/* Prefer the matches in the file name */
+	basename_score = score_subsequence (entry->path, entry->basename_offset, query);
+
+	if (basename_score >= 0)
+		score = MAX (score, basename_score + BONUS_BASENAME);
+
+	/* and the shorter paths */
+	return score * 16 - (gint) MIN (strlen (entry->path), 255) / 16;
+}
+
+static gboolean
+result_is_better (GeditFileIndex    *index,
+		  const QueryResult *a,
+		  const QueryResult *b)
+{
+	if (a->score != b->score)
+		return a->score > b->score;
+
+	return strcmp (g_array_index (index->priv->entries, FileEntry, a->entry).path,
+		       g_array_index (index->priv->entries, FileEntry, b->entry).path) < 0;
+}
+
+/**
+ * gedit_file_index_query:
+ * @index: a #GeditFileIndex.
+ * @query: the text to search for.
+ * @max_results: the maximum number of results.
+ *
+ * Finds the paths containing the characters of @query in the same order, case
+ * insensitively. The paths are ranked by the positions of the matched
+ * characters: at the start of a path component, of a word or of a camelCase
+ * hump, consecutive, or in the file name.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): the best matching paths,
+ * relative to the root, the best first.
+ *
+ * Since: 3.16
+ */
+gchar **
+gedit_file_index_query (GeditFileIndex *index,
+			const gchar    *query,
+			guint           max_results)
+{
+	GeditFileIndexPrivate *priv;
+	QueryResult *results;
+	guint n_results = 0;
+	gchar *lower_query;
+	guint32 query_mask;
+	gchar **paths;
+	guint i;
+
+	g_return_val_if_fail (GEDIT_IS_FILE_INDEX (index), NULL);
+	g_return_val_if_fail (query != NULL, NULL);
+
+	priv = index->priv;
+
+	lower_query = g_ascii_strdown (query, -1);
+	query_mask = get_mask (lower_query);
+
+	/* Sorted, the best first */
+	results = g_new (QueryResult, max_results + 1);
+
+	for (i = 0; i < priv->entries->len && max_results > 0; i++)
+	{
+		const FileEntry *entry = &g_array_index (priv->entries, FileEntry, i);
+		QueryResult result;
+		guint pos;
+
+		if (entry->path == NULL ||
+		    (entry->mask & query_mask) != query_mask)
+		{
+			continue;
+		}
+
+		result.entry = i;
+		result.score = score_entry (entry, lower_query);
+
+		if (result.score < 0 ||
+		    (n_results == max_results &&
+		     !result_is_better (index, &result, &results[n_results - 1])))
+		{
+			continue;
+		}
+
+		pos = n_results;
+
+		while (pos > 0 && result_is_better (index, &result, &results[pos - 1]))
+		{
+			results[pos] = results[pos - 1];
+			pos--;
+		}
+
+		results[pos] = result;
+		n_results = MIN (n_results + 1, max_results);
+	}
+
+	paths = g_new (gchar *, n_results + 1);
+
+	for (i = 0; i < n_results; i++)
+	{
+		paths[i] = g_strdup (g_array_index (priv->entries, FileEntry, results[i].entry).path);
+	}
+
+	paths[n_results] = NULL;
+
+	g_free (results);
+	g_free (lower_query);
+
+	return paths;
+}
+
+void
+_gedit_file_index_shutdown (void)
+{
+	/* The scan threads keep a reference */
+	while (evict_index (NULL))
+		;
+}
+
+/* ex:set ts=8 noet: */
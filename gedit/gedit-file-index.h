@@ -0,0 +1,75 @@
+/*
+ * gedit-file-index.h
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_FILE_INDEX_H__
+#define __GEDIT_FILE_INDEX_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_FILE_INDEX			(gedit_file_index_get_type ())
+#define GEDIT_FILE_INDEX(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_FILE_INDEX, GeditFileIndex))
+#define GEDIT_FILE_INDEX_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GEDIT_TYPE_FILE_INDEX, GeditFileIndexClass))
+#define GEDIT_IS_FILE_INDEX(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_FILE_INDEX))
+#define GEDIT_IS_FILE_INDEX_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_FILE_INDEX))
+#define GEDIT_FILE_INDEX_GET_CLASS(obj)		(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_FILE_INDEX, GeditFileIndexClass))
+
+typedef struct _GeditFileIndex		GeditFileIndex;
+typedef struct _GeditFileIndexClass	GeditFileIndexClass;
+typedef struct _GeditFileIndexPrivate	GeditFileIndexPrivate;
+
+struct _GeditFileIndex
+{
+	GObject parent;
+
+	GeditFileIndexPrivate *priv;
+};
+
+struct _GeditFileIndexClass
+{
+	GObjectClass parent_class;
+
+	/* Signals */
+	void (* changed) (GeditFileIndex *index);
+};
+
+GType		 gedit_file_index_get_type		(void) G_GNUC_CONST;
+
+GeditFileIndex	*gedit_file_index_new			(GFile          *root);
+
+GeditFileIndex	*gedit_file_index_get_for_root		(GFile          *root);
+
+GFile		*gedit_file_index_get_root		(GeditFileIndex *index);
+
+gboolean	 gedit_file_index_is_ready		(GeditFileIndex *index);
+
+guint		 gedit_file_index_get_n_files		(GeditFileIndex *index);
+
+gchar		**gedit_file_index_query		(GeditFileIndex *index,
+							 const gchar    *query,
+							 guint           max_results);
+
+/* Private */
+void		 _gedit_file_index_shutdown		(void);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FILE_INDEX_H__ */
+
+/* ex:set ts=8 noet: */
@@ -39,12 +39,65 @@ enum {
 
 #define GEDIT_HISTORY_ENTRY_HISTORY_LENGTH_DEFAULT 10
 
+/* Number of items kept in the history, only the first history_length are
+ * shown in the combo box. */
+#define MAX_INDEXED_ITEMS 10000
+
+/* Each use of an item counts as much as this number of more recent uses of
+ * other items, up to MAX_FREQUENCY_BONUS uses. */
+#define FREQUENCY_WEIGHT 16
+#define MAX_FREQUENCY_BONUS 16
+
+#define SAVE_TIMEOUT 5 /* in seconds */
+
+typedef struct _HistoryItem HistoryItem;
+typedef struct _HistoryNode HistoryNode;
+
+struct _HistoryItem
+{
+	gchar       *text;
+	HistoryNode *node;
+
+	/* Next item with the same case folded text */
+	HistoryItem *next;
+
+	/* Higher is better, it only increases */
+	guint64      rank;
+	guint        n_uses;
+};
+
+/* Node of a trie on the bytes of the case folded items, so that the
+ * completion is case insensitive like GtkEntryCompletion. */
+struct _HistoryNode
+{
+	HistoryNode *parent;
+	HistoryNode *children;
+	HistoryNode *next;
+
+	/* The items ending at this node, if any */
+	HistoryItem *items;
+
+	/* The best ranked item of the subtree */
+	HistoryItem *best;
+
+	guchar       byte;
+};
+
 struct _GeditHistoryEntryPrivate
 {
 	gchar              *history_id;
 	guint               history_length;
 
-	GtkEntryCompletion *completion;
+	HistoryNode        *root;
+	GPtrArray          *items;
+	guint64             clock;
+
+	gboolean            completion_enabled;
+	gulong              insert_text_handler_id;
+	gulong              changed_handler_id;
+	guint               complete_pending : 1;
+
+	guint               save_timeout_id;
 
 	GSettings          *settings;
 };
@@ -109,15 +162,450 @@ gedit_history_entry_get_property (GObject    *object,
 	}
 }
 
+static HistoryNode *
+history_node_new (HistoryNode *parent,
+		  guchar       byte)
+{
+	HistoryNode *node = g_slice_new0 (HistoryNode);
+
+	node->parent = parent;
+	node->byte = byte;
+
+	if (parent != NULL)
+	{
+		node->next = parent->children;
+		parent->children = node;
+	}
+
+	return node;
+}
+
+static void
+history_node_free (HistoryNode *node)
+{
+	while (node->children != NULL)
+	{
+		HistoryNode *child = node->children;
+
+		node->children = child->next;
+		history_node_free (child);
+	}
+
+	g_slice_free (HistoryNode, node);
+}
+
+static HistoryNode *
+history_node_get_child (HistoryNode *node,
+			guchar       byte)
+{
+	HistoryNode *child;
+
+	for (child = node->children; child != NULL; child = child->next)
+	{
+		if (child->byte == byte)
+			return child;
+	}
+
+	return NULL;
+}
+
+/* Returns the node of @text, or NULL if @text is not a prefix of an item,
+ * or if @create is TRUE, creates the missing nodes. */
+static HistoryNode *
+history_node_lookup (HistoryNode *root,
+		     const gchar *text,
+		     gboolean     create)
+{
+	HistoryNode *node = root;
+	const guchar *p;
+
+	for (p = (const guchar *) text; *p != '\0' && node != NULL; p++)
+	{
+		HistoryNode *child = history_node_get_child (node, *p);
+
+		if (child == NULL && create)
+			child = history_node_new (node, *p);
+
+		node = child;
+	}
+
+	return node;
+}
+
+static HistoryItem *
+history_node_get_best_child (HistoryNode *node)
+{
+	HistoryNode *child;
+	HistoryItem *best = NULL;
+
+	for (child = node->children; child != NULL; child = child->next)
+	{
+		if (child->best != NULL &&
+		    (best == NULL || child->best->rank > best->rank))
+		{
+			best = child->best;
+		}
+	}
+
+	return best;
+}
+
+static void
+history_node_update_best (HistoryNode *node)
+{
+	HistoryItem *best;
+	HistoryItem *item;
+
+	best = history_node_get_best_child (node);
+
+	for (item = node->items; item != NULL; item = item->next)
+	{
+		if (best == NULL || item->rank > best->rank)
+			best = item;
+	}
+
+	node->best = best;
+}
+
+static HistoryItem *
+history_node_get_item (HistoryNode *node,
+		       const gchar *text)
+{
+	HistoryItem *item;
+
+	for (item = node->items; item != NULL; item = item->next)
+	{
+		if (strcmp (item->text, text) == 0)
+			return item;
+	}
+
+	return NULL;
+}
+
+static void
+history_item_free (HistoryItem *item)
+{
+	g_free (item->text);
+	g_slice_free (HistoryItem, item);
+}
+
+static void
+set_item_rank (HistoryItem *item,
+	       guint64      rank)
+{
+	HistoryNode *node;
+
+	item->rank = rank;
+
+	/* The rank only increases, so the ancestors already having a better
+	 * item don't need to be updated. */
+	for (node = item->node; node != NULL; node = node->parent)
+	{
+		if (node->best != NULL &&
+		    node->best != item &&
+		    node->best->rank >= rank)
+		{
+			break;
+		}
+
+		node->best = item;
+	}
+}
+
+static void
+remove_indexed_item (GeditHistoryEntry *entry,
+		     guint              index)
+{
+	HistoryItem *item;
+	HistoryItem **item_link;
+	HistoryNode *node;
+
+	item = g_ptr_array_index (entry->priv->items, index);
+
+	node = item->node;
+
+	item_link = &node->items;
+
+	while (*item_link != item)
+		item_link = &(*item_link)->next;
+
+	*item_link = item->next;
+
+	/* Prune the branch, then update the best items above it */
+	while (node != entry->priv->root &&
+	       node->children == NULL &&
+	       node->items == NULL)
+	{
+		HistoryNode *parent = node->parent;
+		HistoryNode **link = &parent->children;
+
+		while (*link != node)
+			link = &(*link)->next;
+
+		*link = node->next;
+		g_slice_free (HistoryNode, node);
+
+		node = parent;
+	}
+
+	for (; node != NULL; node = node->parent)
+	{
+		history_node_update_best (node);
+	}
+
+	/* Frees the item */
+	g_ptr_array_remove_index_fast (entry->priv->items, index);
+}
+
+static void
+evict_worst_item (GeditHistoryEntry *entry)
+{
+	guint worst = 0;
+	guint i;
+
+	for (i = 1; i < entry->priv->items->len; i++)
+	{
+		HistoryItem *item = g_ptr_array_index (entry->priv->items, i);
+		HistoryItem *worst_item = g_ptr_array_index (entry->priv->items, worst);
+
+		if (item->rank < worst_item->rank)
+			worst = i;
+	}
+
+	remove_indexed_item (entry, worst);
+}
+
+/* If @recent is FALSE, a new item is ranked after all the others. */
+static void
+index_item (GeditHistoryEntry *entry,
+	    const gchar       *text,
+	    gboolean           recent)
+{
+	HistoryNode *node;
+	HistoryItem *item;
+	gchar *key;
+
+	key = g_utf8_casefold (text, -1);
+
+	node = history_node_lookup (entry->priv->root, key, FALSE);
+	item = node != NULL ? history_node_get_item (node, text) : NULL;
+
+	if (item == NULL)
+	{
+		if (entry->priv->items->len >= MAX_INDEXED_ITEMS)
+		{
+			evict_worst_item (entry);
+		}
+
+		node = history_node_lookup (entry->priv->root, key, TRUE);
+
+		item = g_slice_new0 (HistoryItem);
+		item->text = g_strdup (text);
+		item->node = node;
+
+		item->next = node->items;
+		node->items = item;
+		g_ptr_array_add (entry->priv->items, item);
+
+		if (!recent)
+		{
+			set_item_rank (item, 0);
+			g_free (key);
+			return;
+		}
+	}
+
+	g_free (key);
+
+	item->n_uses++;
+	entry->priv->clock++;
+
+	set_item_rank (item,
+		       entry->priv->clock +
+		       FREQUENCY_WEIGHT * MIN (item->n_uses - 1, MAX_FREQUENCY_BONUS));
+}
+
+static void
+clear_index (GeditHistoryEntry *entry)
+{
+	GeditHistoryEntryPrivate *priv = entry->priv;
+
+	if (priv->root != NULL)
+	{
+		history_node_free (priv->root);
+		priv->root = NULL;
+	}
+
+	if (priv->items != NULL)
+	{
+		g_ptr_array_free (priv->items, TRUE);
+		priv->items = NULL;
+	}
+
+	priv->clock = 0;
+}
+
+static void
+reset_index (GeditHistoryEntry *entry)
+{
+	clear_index (entry);
+
+	entry->priv->root = history_node_new (NULL, 0);
+	entry->priv->items = g_ptr_array_new_with_free_func ((GDestroyNotify) history_item_free);
+}
+
+/* Returns the part of @text following the characters whose case folded
+ * text is @key_len bytes long, or NULL if a character straddles it. */
+static const gchar *
+skip_folded_prefix (const gchar *text,
+		    gsize        key_len)
+{
+	const gchar *p = text;
+	gsize len = 0;
+
+	while (len < key_len && *p != '\0')
+	{
+		const gchar *next = g_utf8_next_char (p);
+		gchar *folded;
+
+		folded = g_utf8_casefold (p, next - p);
+		len += strlen (folded);
+		g_free (folded);
+
+		p = next;
+	}
+
+	return len == key_len ? p : NULL;
+}
+
+/* Returns the rest of the best ranked item starting with @prefix, ignoring
+ * the case, and longer than it. */
+static const gchar *
+complete_text (GeditHistoryEntry *entry,
+	       const gchar       *prefix)
+{
+	HistoryNode *node;
+	HistoryItem *best;
+	gchar *key;
+	const gchar *completion = NULL;
+
+	key = g_utf8_casefold (prefix, -1);
+
+	node = history_node_lookup (entry->priv->root, key, FALSE);
+	best = node != NULL ? history_node_get_best_child (node) : NULL;
+
+	if (best != NULL)
+		completion = skip_folded_prefix (best->text, strlen (key));
+
+	g_free (key);
+
+	return completion;
+}
+
+static gint
+compare_items_rank (gconstpointer a,
+		    gconstpointer b)
+{
+	const HistoryItem *item_a = *(HistoryItem * const *) a;
+	const HistoryItem *item_b = *(HistoryItem * const *) b;
+
+	if (item_a->rank == item_b->rank)
+		return 0;
+
+	return item_a->rank > item_b->rank ? -1 : 1;
+}
+
+/* Returns the items, the best ranked first */
+static gchar **
+get_history_items (GeditHistoryEntry *entry)
+{
+	GPtrArray *sorted;
+	gchar **items;
+	guint i;
+
+	sorted = g_ptr_array_sized_new (entry->priv->items->len);
+
+	for (i = 0; i < entry->priv->items->len; i++)
+	{
+		g_ptr_array_add (sorted, g_ptr_array_index (entry->priv->items, i));
+	}
+
+	g_ptr_array_sort (sorted, compare_items_rank);
+
+	items = g_new (gchar *, sorted->len + 1);
+
+	for (i = 0; i < sorted->len; i++)
+	{
+		HistoryItem *item = g_ptr_array_index (sorted, i);
+
+		items[i] = g_strdup (item->text);
+	}
+
+	items[i] = NULL;
+
+	g_ptr_array_free (sorted, TRUE);
+
+	return items;
+}
+
+static void
+gedit_history_entry_save_history (GeditHistoryEntry *entry)
+{
+	gchar **items;
+
+	g_return_if_fail (GEDIT_IS_HISTORY_ENTRY (entry));
+
+	if (entry->priv->save_timeout_id != 0)
+	{
+		g_source_remove (entry->priv->save_timeout_id);
+		entry->priv->save_timeout_id = 0;
+	}
+
+	items = get_history_items (entry);
+
+	g_settings_set_strv (entry->priv->settings,
+			     entry->priv->history_id,
+			     (const gchar * const *)items);
+
+	g_strfreev (items);
+}
+
+static gboolean
+save_history_timeout (GeditHistoryEntry *entry)
+{
+	entry->priv->save_timeout_id = 0;
+
+	gedit_history_entry_save_history (entry);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* The history is written in batches, to not hit the settings backend on each
+ * insertion. */
+static void
+queue_save_history (GeditHistoryEntry *entry)
+{
+	if (entry->priv->save_timeout_id == 0)
+	{
+		entry->priv->save_timeout_id =
+			g_timeout_add_seconds (SAVE_TIMEOUT,
+					       (GSourceFunc) save_history_timeout,
+					       entry);
+	}
+}
+
 static void
 gedit_history_entry_dispose (GObject *object)
 {
-	GeditHistoryEntryPrivate *priv;
+	GeditHistoryEntry *entry = GEDIT_HISTORY_ENTRY (object);
+	GeditHistoryEntryPrivate *priv = entry->priv;
 
-	priv = GEDIT_HISTORY_ENTRY (object)->priv;
+	if (priv->save_timeout_id != 0)
+	{
+		gedit_history_entry_save_history (entry);
+	}
 
-	gedit_history_entry_set_enable_completion (GEDIT_HISTORY_ENTRY (object),
-						   FALSE);
+	gedit_history_entry_set_enable_completion (entry, FALSE);
 
 	g_clear_object (&priv->settings);
 
@@ -127,11 +615,11 @@ gedit_history_entry_dispose (GObject *object)
 static void
 gedit_history_entry_finalize (GObject *object)
 {
-	GeditHistoryEntryPrivate *priv;
+	GeditHistoryEntry *entry = GEDIT_HISTORY_ENTRY (object);
 
-	priv = GEDIT_HISTORY_ENTRY (object)->priv;
+	clear_index (entry);
 
-	g_free (priv->history_id);
+	g_free (entry->priv->history_id);
 
 	G_OBJECT_CLASS (gedit_history_entry_parent_class)->finalize (object);
 }
@@ -140,21 +628,31 @@ static void
 gedit_history_entry_load_history (GeditHistoryEntry *entry)
 {
 	gchar **items;
-	gsize i;
+	guint n_items;
+	gint i;
 
 	items = g_settings_get_strv (entry->priv->settings,
 				     entry->priv->history_id);
-	i = 0;
+	n_items = g_strv_length (items);
 
 	gtk_combo_box_text_remove_all (GTK_COMBO_BOX_TEXT (entry));
+	reset_index (entry);
+
+	/* The items are saved the best ranked first. Now the default value is
+	   an empty string so we have to take care of it to not add the empty
+	   string in the search list */
+	for (i = (gint) MIN (n_items, MAX_INDEXED_ITEMS) - 1; i >= 0; i--)
+	{
+		if (*items[i] != '\0')
+		{
+			index_item (entry, items[i], TRUE);
+		}
+	}
 
-	/* Now the default value is an empty string so we have to take care
-	   of it to not add the empty string in the search list */
-	while (items[i] != NULL && *items[i] != '\0' &&
-	       i < entry->priv->history_length)
+	for (i = 0; items[i] != NULL && *items[i] != '\0' &&
+	     (guint) i < entry->priv->history_length; i++)
 	{
 		gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (entry), items[i]);
-		i++;
 	}
 
 	g_strfreev (items);
@@ -212,62 +710,6 @@ get_history_store (GeditHistoryEntry *entry)
 	return (GtkListStore *) store;
 }
 
-static gchar **
-get_history_items (GeditHistoryEntry *entry)
-{
-	GtkListStore *store;
-	GtkTreeIter iter;
-	GPtrArray *array;
-	gboolean valid;
-	gint n_children;
-	gint text_column;
-
-	store = get_history_store (entry);
-	text_column = gtk_combo_box_get_entry_text_column (GTK_COMBO_BOX (entry));
-
-	valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store),
-					       &iter);
-	n_children = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (store),
-						     NULL);
-
-	array = g_ptr_array_sized_new (n_children + 1);
-
-	while (valid)
-	{
-		gchar *str;
-
-		gtk_tree_model_get (GTK_TREE_MODEL (store),
-				    &iter,
-				    text_column, &str,
-				    -1);
-
-		g_ptr_array_add (array, str);
-
-		valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (store),
-						  &iter);
-	}
-
-	g_ptr_array_add (array, NULL);
-
-	return (gchar **)g_ptr_array_free (array, FALSE);
-}
-
-static void
-gedit_history_entry_save_history (GeditHistoryEntry *entry)
-{
-	gchar **items;
-
-	g_return_if_fail (GEDIT_IS_HISTORY_ENTRY (entry));
-
-	items = get_history_items (entry);
-
-	g_settings_set_strv (entry->priv->settings,
-			     entry->priv->history_id,
-			     (const gchar * const *)items);
-
-	g_strfreev (items);
-}
-
 static gboolean
 remove_item (GeditHistoryEntry *entry,
 	     const gchar       *text)
@@ -357,7 +799,9 @@ insert_history_item (GeditHistoryEntry *entry,
 	else
 		gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (entry), text);
 
-	gedit_history_entry_save_history (entry);
+	index_item (entry, text, prepend);
+
+	queue_save_history (entry);
 }
 
 void
@@ -386,8 +830,9 @@ gedit_history_entry_clear (GeditHistoryEntry *entry)
 	g_return_if_fail (GEDIT_IS_HISTORY_ENTRY (entry));
 
 	gtk_combo_box_text_remove_all (GTK_COMBO_BOX_TEXT (entry));
+	reset_index (entry);
 
-	gedit_history_entry_save_history (entry);
+	queue_save_history (entry);
 }
 
 static void
@@ -401,7 +846,7 @@ gedit_history_entry_init (GeditHistoryEntry *entry)
 	priv->history_id = NULL;
 	priv->history_length = GEDIT_HISTORY_ENTRY_HISTORY_LENGTH_DEFAULT;
 
-	priv->completion = NULL;
+	reset_index (entry);
 
 	priv->settings = g_settings_new ("org.gnome.gedit.state.history-entry");
 }
@@ -426,45 +871,100 @@ gedit_history_entry_get_history_length (GeditHistoryEntry *entry)
 	return entry->priv->history_length;
 }
 
+static void
+entry_insert_text_cb (GtkEditable       *editable,
+		      const gchar       *text,
+		      gint               length,
+		      gint              *position,
+		      GeditHistoryEntry *entry)
+{
+	entry->priv->complete_pending = TRUE;
+}
+
+/* Inline completion: the rest of the best ranked item is inserted and
+ * selected, so that it is replaced if the user continues to type. */
+static void
+entry_changed_cb (GtkEditable       *editable,
+		  GeditHistoryEntry *entry)
+{
+	const gchar *text;
+	const gchar *completion;
+	gint n_chars;
+	gint position;
+
+	if (!entry->priv->complete_pending)
+		return;
+
+	entry->priv->complete_pending = FALSE;
+
+	text = gtk_entry_get_text (GTK_ENTRY (editable));
+	n_chars = g_utf8_strlen (text, -1);
+
+	if (n_chars < MIN_ITEM_LEN ||
+	    gtk_editable_get_position (editable) != n_chars)
+	{
+		return;
+	}
+
+	completion = complete_text (entry, text);
+
+	if (completion == NULL)
+		return;
+
+	position = n_chars;
+
+	g_signal_handler_block (editable, entry->priv->insert_text_handler_id);
+
+	gtk_editable_insert_text (editable,
+				  completion,
+				  -1,
+				  &position);
+
+	g_signal_handler_unblock (editable, entry->priv->insert_text_handler_id);
+
+	gtk_editable_select_region (editable, n_chars, -1);
+}
+
 void
 gedit_history_entry_set_enable_completion (GeditHistoryEntry *entry,
 					   gboolean           enable)
 {
-	g_return_if_fail (GEDIT_IS_HISTORY_ENTRY (entry));
+	GtkWidget *text_entry;
 
-	if (enable)
-	{
-		if (entry->priv->completion != NULL)
-			return;
+	g_return_if_fail (GEDIT_IS_HISTORY_ENTRY (entry));
 
-		entry->priv->completion = gtk_entry_completion_new ();
-		gtk_entry_completion_set_model (entry->priv->completion,
-						GTK_TREE_MODEL (get_history_store (entry)));
+	enable = (enable != FALSE);
 
-		/* Use model column 0 as the text column */
-		gtk_entry_completion_set_text_column (entry->priv->completion, 0);
+	if (entry->priv->completion_enabled == enable)
+		return;
 
-		gtk_entry_completion_set_minimum_key_length (entry->priv->completion,
-							     MIN_ITEM_LEN);
+	entry->priv->completion_enabled = enable;
+	entry->priv->complete_pending = FALSE;
 
-		gtk_entry_completion_set_popup_completion (entry->priv->completion, FALSE);
-		gtk_entry_completion_set_inline_completion (entry->priv->completion, TRUE);
+	text_entry = gedit_history_entry_get_entry (entry);
 
-		/* Assign the completion to the entry */
-		gtk_entry_set_completion (GTK_ENTRY (gedit_history_entry_get_entry (entry)),
-					  entry->priv->completion);
+	/* The completion is not done by a GtkEntryCompletion, which does a
+	 * linear scan of the model, but with the trie of the history. */
+	if (enable)
+	{
+		entry->priv->insert_text_handler_id =
+			g_signal_connect_after (text_entry,
+						"insert-text",
+						G_CALLBACK (entry_insert_text_cb),
+						entry);
+
+		entry->priv->changed_handler_id =
+			g_signal_connect (text_entry,
+					  "changed",
+					  G_CALLBACK (entry_changed_cb),
+					  entry);
 	}
-	else
+	else if (text_entry != NULL)
 	{
-		if (entry->priv->completion == NULL)
-			return;
-
-		gtk_entry_set_completion (GTK_ENTRY (gedit_history_entry_get_entry (entry)),
-					  NULL);
-
-		g_object_unref (entry->priv->completion);
-
-		entry->priv->completion = NULL;
+		g_signal_handler_disconnect (text_entry, entry->priv->insert_text_handler_id);
+		g_signal_handler_disconnect (text_entry, entry->priv->changed_handler_id);
+		entry->priv->insert_text_handler_id = 0;
+		entry->priv->changed_handler_id = 0;
 	}
 }
 
@@ -473,7 +973,7 @@ gedit_history_entry_get_enable_completion (GeditHistoryEntry *entry)
 {
 	g_return_val_if_fail (GEDIT_IS_HISTORY_ENTRY (entry), FALSE);
 
-	return entry->priv->completion != NULL;
+	return entry->priv->completion_enabled;
 }
 
 GtkWidget *
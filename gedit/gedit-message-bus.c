@@ -20,6 +20,15 @@
  * Boston, MA  02110-1301  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_DLADDR
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#endif
+
 #include "gedit-message-bus.h"
 
 #include <string.h>
@@ -27,6 +36,7 @@
 #include <gobject/gvaluecollector.h>
 
 #include "gedit-marshal.h"
+#include "gedit-debug.h"
 
 /**
  * GeditMessageCallback:
@@ -115,12 +125,13 @@
  *
  */
 
+/* The object path and the method are interned strings: identifiers are hashed
+ * and compared by pointer, and lookups use an identifier on the stack.
+ */
 typedef struct
 {
-	gchar *object_path;
-	gchar *method;
-
-	gchar *identifier;
+	const gchar *object_path;
+	const gchar *method;
 } MessageIdentifier;
 
 typedef struct
@@ -138,25 +149,112 @@ typedef struct
 	GDestroyNotify destroy_data;
 	GeditMessageCallback callback;
 	gpointer user_data;
+
+	/* Listeners called in another context are referenced by the pending
+	 * deliveries, and must not be called anymore once disconnected.
+	 */
+	GMainContext *context;
+	gint ref_count;
+	gint removed;
 } Listener;
 
+typedef struct
+{
+	GeditMessageBus *bus;
+	GeditMessage *message;
+	Listener *listener;
+} ContextDelivery;
+
+/* Node of the queue of the asynchronously sent messages. Senders push on
+ * the head with an atomic compare and exchange, and the main context takes
+ * the whole list at once, so sending from other threads does not need locks.
+ */
+typedef struct _QueuedMessage QueuedMessage;
+
+struct _QueuedMessage
+{
+	QueuedMessage *next;
+	GeditMessage *message;
+	gint priority;
+	guint serial;
+};
+
 typedef struct
 {
 	Message *message;
 	GList *listener;
 } IdMap;
 
+/* Time in microseconds spent dispatching a message, or in a listener. */
+typedef struct
+{
+	guint64 count;
+	gint64 total_time;
+	gint64 max_time;
+} DispatchStats;
+
+/* Kept apart from the Message, which is freed with its last listener. */
+typedef struct
+{
+	MessageIdentifier *identifier;
+	DispatchStats dispatch;
+
+	/* mapping from listener callback to DispatchStats */
+	GHashTable *listeners;
+} MessageStats;
+
 struct _GeditMessageBusPrivate
 {
 	GHashTable *messages;
 	GHashTable *idmap;
 
-	GList *message_queue;
-	guint idle_id;
+	QueuedMessage *message_queue; /* atomic */
+	gint scheduled_priority; /* atomic, G_MAXINT when nothing is scheduled */
+	guint queue_serial; /* atomic */
+
+	/* Delivery priorities set with gedit_message_bus_set_priority(), read
+	 * from the sending threads.
+	 */
+	GHashTable *priorities;
+	GRWLock priorities_lock;
 
 	guint next_id;
 
 	GHashTable *types; /* mapping from identifier to GeditMessageType */
+
+	/* The types are only changed from the main thread, which takes the
+	 * writer lock. The other threads take the reader lock to look them up
+	 * when sending messages.
+	 */
+	GRWLock types_lock;
+
+	/* Bumped when the types or the messages tables change, to invalidate
+	 * the lookups cached in the message handles.
+	 */
+	guint types_serial;
+	guint messages_serial;
+
+	/* Statistics recorded when tracing, see gedit_message_bus_set_tracing() */
+	GHashTable *stats;
+	guint64 n_queue_dispatches;
+	guint64 total_queue_length;
+	guint max_queue_length;
+
+	guint tracing : 1;
+};
+
+struct _GeditMessageHandle
+{
+	GeditMessageBus *bus;
+	MessageIdentifier identifier;
+
+	GType type;
+	guint types_serial;
+
+	Message *message;
+	guint messages_serial;
+
+	gint ref_count;
 };
 
 /* signals */
@@ -175,57 +273,88 @@ static void gedit_message_bus_dispatch_real (GeditMessageBus *bus,
 
 G_DEFINE_TYPE_WITH_PRIVATE (GeditMessageBus, gedit_message_bus, G_TYPE_OBJECT)
 
-static MessageIdentifier *
-message_identifier_new (const gchar *object_path,
-                        const gchar *method)
-{
-	MessageIdentifier *ret;
-
-	ret = g_slice_new (MessageIdentifier);
-
-	ret->object_path = g_strdup (object_path);
-	ret->method = g_strdup (method);
+G_DEFINE_BOXED_TYPE (GeditMessageHandle,
+                     gedit_message_handle,
+                     gedit_message_handle_ref,
+                     gedit_message_handle_unref)
 
-	ret->identifier = gedit_message_type_identifier (object_path, method);
+static void
+message_identifier_init (MessageIdentifier *identifier,
+                         const gchar       *object_path,
+                         const gchar       *method)
+{
+	identifier->object_path = g_intern_string (object_path);
+	identifier->method = g_intern_string (method);
+}
 
-	return ret;
+static MessageIdentifier *
+message_identifier_copy (const MessageIdentifier *identifier)
+{
+	return g_slice_dup (MessageIdentifier, identifier);
 }
 
 static void
 message_identifier_free (MessageIdentifier *identifier)
 {
-	g_free (identifier->object_path);
-	g_free (identifier->method);
-	g_free (identifier->identifier);
-
 	g_slice_free (MessageIdentifier, identifier);
 }
 
 static guint
 message_identifier_hash (gconstpointer id)
 {
-	return g_str_hash (((MessageIdentifier *)id)->identifier);
+	const MessageIdentifier *identifier = id;
+
+	return g_direct_hash (identifier->object_path) * 31 +
+	       g_direct_hash (identifier->method);
 }
 
 static gboolean
 message_identifier_equal (gconstpointer id1,
                           gconstpointer id2)
 {
-	return g_str_equal (((MessageIdentifier *)id1)->identifier,
-	                    ((MessageIdentifier *)id2)->identifier);
+	const MessageIdentifier *identifier1 = id1;
+	const MessageIdentifier *identifier2 = id2;
+
+	return identifier1->object_path == identifier2->object_path &&
+	       identifier1->method == identifier2->method;
+}
+
+static Listener *
+listener_ref (Listener *listener)
+{
+	g_atomic_int_inc (&listener->ref_count);
+
+	return listener;
 }
 
 static void
-listener_free (Listener *listener)
+listener_unref (Listener *listener)
 {
+	if (!g_atomic_int_dec_and_test (&listener->ref_count))
+	{
+		return;
+	}
+
 	if (listener->destroy_data)
 	{
 		listener->destroy_data (listener->user_data);
 	}
 
+	if (listener->context)
+	{
+		g_main_context_unref (listener->context);
+	}
+
 	g_slice_free (Listener, listener);
 }
 
+static void
+listener_free (Listener *listener)
+{
+	g_atomic_int_set (&listener->removed, TRUE);
+	listener_unref (listener);
+}
+
 static void
 message_free (Message *message)
 {
@@ -236,9 +365,86 @@ message_free (Message *message)
 }
 
 static void
-message_queue_free (GList *queue)
+dispatch_stats_add (DispatchStats *stats,
+                    gint64         time)
+{
+	stats->count++;
+	stats->total_time += time;
+	stats->max_time = MAX (stats->max_time, time);
+}
+
+static void
+dispatch_stats_free (DispatchStats *stats)
+{
+	g_slice_free (DispatchStats, stats);
+}
+
+static void
+message_stats_free (MessageStats *stats)
+{
+	message_identifier_free (stats->identifier);
+	g_hash_table_destroy (stats->listeners);
+	g_slice_free (MessageStats, stats);
+}
+
+static MessageStats *
+lookup_stats (GeditMessageBus         *bus,
+              const MessageIdentifier *identifier)
+{
+	MessageStats *stats;
+
+	stats = g_hash_table_lookup (bus->priv->stats, identifier);
+
+	if (stats == NULL)
+	{
+		stats = g_slice_new0 (MessageStats);
+		stats->identifier = message_identifier_copy (identifier);
+		stats->listeners = g_hash_table_new_full (g_direct_hash,
+		                                          g_direct_equal,
+		                                          NULL,
+		                                          (GDestroyNotify) dispatch_stats_free);
+
+		g_hash_table_insert (bus->priv->stats, stats->identifier, stats);
+	}
+
+	return stats;
+}
+
+static void
+add_listener_stats (MessageStats         *stats,
+                    GeditMessageCallback  callback,
+                    gint64                time)
+{
+	DispatchStats *listener_stats;
+
+	listener_stats = g_hash_table_lookup (stats->listeners, (gpointer) callback);
+
+	if (listener_stats == NULL)
+	{
+		listener_stats = g_slice_new0 (DispatchStats);
+		g_hash_table_insert (stats->listeners, (gpointer) callback, listener_stats);
+	}
+
+	dispatch_stats_add (listener_stats, time);
+}
+
+static void
+queued_message_free (QueuedMessage *queued)
+{
+	g_object_unref (queued->message);
+	g_slice_free (QueuedMessage, queued);
+}
+
+static void
+message_queue_free (QueuedMessage *queue)
 {
-	g_list_free_full (queue, g_object_unref);
+	while (queue != NULL)
+	{
+		QueuedMessage *next = queue->next;
+
+		queued_message_free (queue);
+		queue = next;
+	}
 }
 
 static void
@@ -246,16 +452,26 @@ gedit_message_bus_finalize (GObject *object)
 {
 	GeditMessageBus *bus = GEDIT_MESSAGE_BUS (object);
 
-	if (bus->priv->idle_id != 0)
+	if (bus->priv->tracing)
 	{
-		g_source_remove (bus->priv->idle_id);
+		gchar *stats;
+
+		stats = gedit_message_bus_dump_stats (bus);
+		gedit_debug_message (DEBUG_MESSAGE_BUS, "%s", stats);
+		g_free (stats);
 	}
 
+	/* the dispatch sources keep a reference on the bus, so the queue is
+	   empty unless it is finalized from a dispatch */
 	message_queue_free (bus->priv->message_queue);
 
 	g_hash_table_destroy (bus->priv->messages);
 	g_hash_table_destroy (bus->priv->idmap);
 	g_hash_table_destroy (bus->priv->types);
+	g_hash_table_destroy (bus->priv->priorities);
+	g_hash_table_destroy (bus->priv->stats);
+	g_rw_lock_clear (&bus->priv->priorities_lock);
+	g_rw_lock_clear (&bus->priv->types_lock);
 
 	G_OBJECT_CLASS (gedit_message_bus_parent_class)->finalize (object);
 }
@@ -340,34 +556,31 @@ gedit_message_bus_class_init (GeditMessageBusClass *klass)
 }
 
 static Message *
-message_new (GeditMessageBus *bus,
-             const gchar     *object_path,
-             const gchar     *method)
+message_new (GeditMessageBus         *bus,
+             const MessageIdentifier *identifier)
 {
 	Message *message = g_slice_new (Message);
 
-	message->identifier = message_identifier_new (object_path, method);
+	message->identifier = message_identifier_copy (identifier);
 	message->listeners = NULL;
 
 	g_hash_table_insert (bus->priv->messages,
 	                     message->identifier,
 	                     message);
 
+	bus->priv->messages_serial++;
+
 	return message;
 }
 
 static Message *
-lookup_message (GeditMessageBus *bus,
-                const gchar      *object_path,
-                const gchar      *method,
-                gboolean          create)
+lookup_message (GeditMessageBus         *bus,
+                const MessageIdentifier *identifier,
+                gboolean                 create)
 {
-	MessageIdentifier *identifier;
 	Message *message;
 
-	identifier = message_identifier_new (object_path, method);
 	message = g_hash_table_lookup (bus->priv->messages, identifier);
-	message_identifier_free (identifier);
 
 	if (!message && !create)
 	{
@@ -376,15 +589,41 @@ lookup_message (GeditMessageBus *bus,
 
 	if (!message)
 	{
-		message = message_new (bus, object_path, method);
+		message = message_new (bus, identifier);
 	}
 
 	return message;
 }
 
+/* Called with types_lock held */
+static GType
+lookup_type_locked (GeditMessageBus         *bus,
+                    const MessageIdentifier *identifier)
+{
+	GType *message_type;
+
+	message_type = g_hash_table_lookup (bus->priv->types, identifier);
+
+	return message_type != NULL ? *message_type : G_TYPE_INVALID;
+}
+
+static GType
+lookup_type (GeditMessageBus         *bus,
+             const MessageIdentifier *identifier)
+{
+	GType ret;
+
+	g_rw_lock_reader_lock (&bus->priv->types_lock);
+	ret = lookup_type_locked (bus, identifier);
+	g_rw_lock_reader_unlock (&bus->priv->types_lock);
+
+	return ret;
+}
+
 static guint
 add_listener (GeditMessageBus      *bus,
               Message		   *message,
+              GMainContext         *context,
               GeditMessageCallback  callback,
               gpointer		    user_data,
               GDestroyNotify        destroy_data)
@@ -398,6 +637,9 @@ add_listener (GeditMessageBus      *bus,
 	listener->user_data = user_data;
 	listener->blocked = FALSE;
 	listener->destroy_data = destroy_data;
+	listener->context = context != NULL ? g_main_context_ref (context) : NULL;
+	listener->ref_count = 1;
+	listener->removed = FALSE;
 
 	message->listeners = g_list_append (message->listeners, listener);
 
@@ -430,6 +672,7 @@ remove_listener (GeditMessageBus *bus,
 	{
 		/* remove message because it does not have any listeners */
 		g_hash_table_remove (bus->priv->messages, message->identifier);
+		bus->priv->messages_serial++;
 	}
 }
 
@@ -455,18 +698,85 @@ unblock_listener (GeditMessageBus *bus,
 	lst->blocked = FALSE;
 }
 
+static gboolean
+context_delivery_cb (ContextDelivery *delivery)
+{
+	Listener *listener = delivery->listener;
+
+	if (!g_atomic_int_get (&listener->removed))
+	{
+		listener->callback (delivery->bus, delivery->message, listener->user_data);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+context_delivery_free (ContextDelivery *delivery)
+{
+	listener_unref (delivery->listener);
+	g_object_unref (delivery->message);
+	g_object_unref (delivery->bus);
+	g_slice_free (ContextDelivery, delivery);
+}
+
+static void
+deliver_in_context (GeditMessageBus *bus,
+                    Listener        *listener,
+                    GeditMessage    *message)
+{
+	ContextDelivery *delivery;
+	GSource *source;
+
+	delivery = g_slice_new (ContextDelivery);
+	delivery->bus = g_object_ref (bus);
+	delivery->message = g_object_ref (message);
+	delivery->listener = listener_ref (listener);
+
+	source = g_idle_source_new ();
+	g_source_set_priority (source, G_PRIORITY_DEFAULT);
+	g_source_set_callback (source,
+	                       (GSourceFunc) context_delivery_cb,
+	                       delivery,
+	                       (GDestroyNotify) context_delivery_free);
+	g_source_attach (source, listener->context);
+	g_source_unref (source);
+}
+
 static void
 dispatch_message_real (GeditMessageBus *bus,
                        Message         *msg,
                        GeditMessage    *message)
 {
+	MessageIdentifier identifier = *msg->identifier;
 	GList *item;
 
 	for (item = msg->listeners; item; item = item->next)
 	{
 		Listener *listener = (Listener *)item->data;
 
-		if (!listener->blocked)
+		if (listener->blocked)
+		{
+			continue;
+		}
+
+		if (listener->context != NULL)
+		{
+			deliver_in_context (bus, listener, message);
+		}
+		else if (bus->priv->tracing)
+		{
+			GeditMessageCallback callback = listener->callback;
+			gint64 start = g_get_monotonic_time ();
+
+			callback (bus, message, listener->user_data);
+
+			/* the callback can disconnect itself or reset the stats */
+			add_listener_stats (lookup_stats (bus, &identifier),
+			                    callback,
+			                    g_get_monotonic_time () - start);
+		}
+		else
 		{
 			listener->callback (bus, message, listener->user_data);
 		}
@@ -477,17 +787,17 @@ static void
 gedit_message_bus_dispatch_real (GeditMessageBus *bus,
                                  GeditMessage    *message)
 {
-	const gchar *object_path;
-	const gchar *method;
+	MessageIdentifier identifier;
 	Message *msg;
 
-	object_path = gedit_message_get_object_path (message);
-	method = gedit_message_get_method (message);
+	/* the message keeps interned strings, no need to intern them again */
+	identifier.object_path = gedit_message_get_object_path (message);
+	identifier.method = gedit_message_get_method (message);
 
-	g_return_if_fail (object_path != NULL);
-	g_return_if_fail (method != NULL);
+	g_return_if_fail (identifier.object_path != NULL);
+	g_return_if_fail (identifier.method != NULL);
 
-	msg = lookup_message (bus, object_path, method, FALSE);
+	msg = lookup_message (bus, &identifier, FALSE);
 
 	if (msg)
 	{
@@ -499,32 +809,97 @@ static void
 dispatch_message (GeditMessageBus *bus,
                   GeditMessage    *message)
 {
+	MessageIdentifier identifier;
+	MessageStats *stats;
+	gint64 start;
+
+	if (!bus->priv->tracing)
+	{
+		g_signal_emit (bus, message_bus_signals[DISPATCH], 0, message);
+		return;
+	}
+
+	identifier.object_path = gedit_message_get_object_path (message);
+	identifier.method = gedit_message_get_method (message);
+
+	start = g_get_monotonic_time ();
 	g_signal_emit (bus, message_bus_signals[DISPATCH], 0, message);
+
+	/* lookup after the dispatch, which can reset the stats */
+	stats = lookup_stats (bus, &identifier);
+	dispatch_stats_add (&stats->dispatch, g_get_monotonic_time () - start);
+}
+
+static gint
+compare_queued_messages (gconstpointer a,
+                         gconstpointer b)
+{
+	const QueuedMessage *queued_a = *(QueuedMessage * const *)a;
+	const QueuedMessage *queued_b = *(QueuedMessage * const *)b;
+
+	if (queued_a->priority != queued_b->priority)
+	{
+		return queued_a->priority < queued_b->priority ? -1 : 1;
+	}
+
+	/* keep the order in which they were sent */
+	if (queued_a->serial != queued_b->serial)
+	{
+		return (gint) (queued_a->serial - queued_b->serial);
+	}
+
+	return 0;
 }
 
 static gboolean
 idle_dispatch (GeditMessageBus *bus)
 {
-	GList *list;
-	GList *item;
+	QueuedMessage *list;
+	GPtrArray *messages;
+	guint i;
+
+	/* make sure to reset the scheduled priority first so that any new
+	   async messages will be scheduled properly */
+	g_atomic_int_set (&bus->priv->scheduled_priority, G_MAXINT);
+
+	do
+	{
+		list = g_atomic_pointer_get (&bus->priv->message_queue);
+	}
+	while (!g_atomic_pointer_compare_and_exchange (&bus->priv->message_queue, list, NULL));
 
-	/* make sure to set idle_id to 0 first so that any new async messages
-	   will be queued properly */
-	bus->priv->idle_id = 0;
+	if (list == NULL)
+	{
+		return G_SOURCE_REMOVE;
+	}
 
-	/* reverse queue to get correct delivery order */
-	list = g_list_reverse (bus->priv->message_queue);
-	bus->priv->message_queue = NULL;
+	messages = g_ptr_array_new_with_free_func ((GDestroyNotify) queued_message_free);
 
-	for (item = list; item; item = item->next)
+	for (; list != NULL; list = list->next)
 	{
-		GeditMessage *msg = GEDIT_MESSAGE (item->data);
+		g_ptr_array_add (messages, list);
+	}
 
-		dispatch_message (bus, msg);
+	if (bus->priv->tracing)
+	{
+		bus->priv->n_queue_dispatches++;
+		bus->priv->total_queue_length += messages->len;
+		bus->priv->max_queue_length = MAX (bus->priv->max_queue_length, messages->len);
 	}
 
-	message_queue_free (list);
-	return FALSE;
+	/* deliver by priority, then in the order they were sent */
+	g_ptr_array_sort (messages, compare_queued_messages);
+
+	for (i = 0; i < messages->len; i++)
+	{
+		QueuedMessage *queued = g_ptr_array_index (messages, i);
+
+		dispatch_message (bus, queued->message);
+	}
+
+	g_ptr_array_unref (messages);
+
+	return G_SOURCE_REMOVE;
 }
 
 typedef void (*MatchCallback) (GeditMessageBus *, Message *, GList *);
@@ -555,10 +930,12 @@ process_by_match (GeditMessageBus      *bus,
                   gpointer              user_data,
                   MatchCallback         processor)
 {
+	MessageIdentifier identifier;
 	Message *message;
 	GList *item;
 
-	message = lookup_message (bus, object_path, method, FALSE);
+	message_identifier_init (&identifier, object_path, method);
+	message = lookup_message (bus, &identifier, FALSE);
 
 	if (!message)
 	{
@@ -606,6 +983,25 @@ gedit_message_bus_init (GeditMessageBus *self)
 	                                           message_identifier_equal,
 	                                           (GDestroyNotify) message_identifier_free,
 	                                           (GDestroyNotify) free_type);
+
+	self->priv->types_serial = 1;
+	self->priv->messages_serial = 1;
+
+	self->priv->scheduled_priority = G_MAXINT;
+
+	self->priv->priorities = g_hash_table_new_full (message_identifier_hash,
+	                                                message_identifier_equal,
+	                                                (GDestroyNotify) message_identifier_free,
+	                                                NULL);
+	g_rw_lock_init (&self->priv->priorities_lock);
+	g_rw_lock_init (&self->priv->types_lock);
+
+	self->priv->stats = g_hash_table_new_full (message_identifier_hash,
+	                                           message_identifier_equal,
+	                                           NULL,
+	                                           (GDestroyNotify) message_stats_free);
+
+	self->priv->tracing = gedit_debug_is_enabled (GEDIT_DEBUG_MESSAGE_BUS);
 }
 
 /**
@@ -666,25 +1062,15 @@ gedit_message_bus_lookup (GeditMessageBus *bus,
                           const gchar	  *object_path,
                           const gchar	  *method)
 {
-	MessageIdentifier *identifier;
-	GType *message_type;
+	MessageIdentifier identifier;
 
 	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), G_TYPE_INVALID);
 	g_return_val_if_fail (object_path != NULL, G_TYPE_INVALID);
 	g_return_val_if_fail (method != NULL, G_TYPE_INVALID);
 
-	identifier = message_identifier_new (object_path, method);
-	message_type = g_hash_table_lookup (bus->priv->types, identifier);
-	message_identifier_free (identifier);
+	message_identifier_init (&identifier, object_path, method);
 
-	if (!message_type)
-	{
-		return G_TYPE_INVALID;
-	}
-	else
-	{
-		return *message_type;
-	}
+	return lookup_type (bus, &identifier);
 }
 
 /**
@@ -707,7 +1093,7 @@ gedit_message_bus_register (GeditMessageBus *bus,
                             const gchar     *object_path,
                             const gchar	    *method)
 {
-	MessageIdentifier *identifier;
+	MessageIdentifier identifier;
 	GType *ntype;
 
 	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
@@ -721,15 +1107,21 @@ gedit_message_bus_register (GeditMessageBus *bus,
 		           method);
 	}
 
-	identifier = message_identifier_new (object_path, method);
+	message_identifier_init (&identifier, object_path, method);
 	ntype = g_slice_new (GType);
 
 	*ntype = message_type;
 
+	g_rw_lock_writer_lock (&bus->priv->types_lock);
+
 	g_hash_table_insert (bus->priv->types,
-	                     identifier,
+	                     message_identifier_copy (&identifier),
 	                     ntype);
 
+	bus->priv->types_serial++;
+
+	g_rw_lock_writer_unlock (&bus->priv->types_lock);
+
 	g_signal_emit (bus,
 	               message_bus_signals[REGISTERED],
 	               0,
@@ -740,15 +1132,25 @@ gedit_message_bus_register (GeditMessageBus *bus,
 static void
 gedit_message_bus_unregister_real (GeditMessageBus  *bus,
                                    const gchar      *object_path,
-                                   const gchar      *method,
-                                   gboolean          remove_from_store)
+                                   const gchar      *method)
 {
-	MessageIdentifier *identifier;
+	MessageIdentifier identifier;
+	gboolean removed;
 
-	identifier = message_identifier_new (object_path, method);
+	message_identifier_init (&identifier, object_path, method);
 
-	if (!remove_from_store || g_hash_table_remove (bus->priv->types,
-	                                               identifier))
+	g_rw_lock_writer_lock (&bus->priv->types_lock);
+
+	removed = g_hash_table_remove (bus->priv->types, &identifier);
+
+	if (removed)
+	{
+		bus->priv->types_serial++;
+	}
+
+	g_rw_lock_writer_unlock (&bus->priv->types_lock);
+
+	if (removed)
 	{
 		g_signal_emit (bus,
 		               message_bus_signals[UNREGISTERED],
@@ -756,8 +1158,6 @@ gedit_message_bus_unregister_real (GeditMessageBus  *bus,
 		               object_path,
 		               method);
 	}
-
-	message_identifier_free (identifier);
 }
 
 /**
@@ -783,14 +1183,15 @@ gedit_message_bus_unregister (GeditMessageBus  *bus,
 
 	gedit_message_bus_unregister_real (bus,
 	                                   object_path,
-	                                   method,
-	                                   TRUE);
+	                                   method);
 }
 
 typedef struct
 {
-	GeditMessageBus *bus;
 	const gchar *object_path;
+
+	/* The interned methods removed */
+	GSList *methods;
 } UnregisterInfo;
 
 static gboolean
@@ -798,12 +1199,10 @@ unregister_each (MessageIdentifier *identifier,
                  GType             *gtype,
                  UnregisterInfo    *info)
 {
-	if (g_strcmp0 (identifier->object_path, info->object_path) == 0)
+	if (identifier->object_path == info->object_path)
 	{
-		gedit_message_bus_unregister_real (info->bus,
-		                                   identifier->object_path,
-		                                   identifier->method,
-		                                   FALSE);
+		info->methods = g_slist_prepend (info->methods,
+		                                 (gpointer) identifier->method);
 
 		return TRUE;
 	}
@@ -827,14 +1226,40 @@ void
 gedit_message_bus_unregister_all (GeditMessageBus *bus,
                                   const gchar     *object_path)
 {
-	UnregisterInfo info = {bus, object_path};
+	UnregisterInfo info = {NULL, NULL};
+	GSList *l;
 
 	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
 	g_return_if_fail (object_path != NULL);
 
-	g_hash_table_foreach_remove (bus->priv->types,
-	                             (GHRFunc)unregister_each,
-	                             &info);
+	info.object_path = g_intern_string (object_path);
+
+	g_rw_lock_writer_lock (&bus->priv->types_lock);
+
+	if (g_hash_table_foreach_remove (bus->priv->types,
+	                                 (GHRFunc)unregister_each,
+	                                 &info) > 0)
+	{
+		bus->priv->types_serial++;
+	}
+
+	g_rw_lock_writer_unlock (&bus->priv->types_lock);
+
+	/* The signals are emitted without the lock, the handlers can use the
+	 * bus.
+	 */
+	info.methods = g_slist_reverse (info.methods);
+
+	for (l = info.methods; l != NULL; l = l->next)
+	{
+		g_signal_emit (bus,
+		               message_bus_signals[UNREGISTERED],
+		               0,
+		               info.object_path,
+		               l->data);
+	}
+
+	g_slist_free (info.methods);
 }
 
 /**
@@ -855,18 +1280,52 @@ gedit_message_bus_is_registered (GeditMessageBus  *bus,
                                  const gchar	  *object_path,
                                  const gchar      *method)
 {
-	MessageIdentifier *identifier;
-	gboolean ret;
+	MessageIdentifier identifier;
 
 	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), FALSE);
 	g_return_val_if_fail (object_path != NULL, FALSE);
 	g_return_val_if_fail (method != NULL, FALSE);
 
-	identifier = message_identifier_new (object_path, method);
-	ret = g_hash_table_lookup (bus->priv->types, identifier) != NULL;
-	message_identifier_free (identifier);
+	message_identifier_init (&identifier, object_path, method);
 
-	return ret;
+	return lookup_type (bus, &identifier) != G_TYPE_INVALID;
+}
+
+/**
+ * gedit_message_bus_set_priority:
+ * @bus: a #GeditMessageBus
+ * @object_path: the object path
+ * @method: the method
+ * @priority: the priority at which to dispatch the message
+ *
+ * Sets the main loop priority at which messages @method at @object_path,
+ * sent asynchronously, are dispatched. Pending messages with a higher
+ * priority are dispatched first, and in the order they were sent for the
+ * same priority. The default is %G_PRIORITY_HIGH, a plugin streaming many
+ * messages from a worker thread could use %G_PRIORITY_DEFAULT_IDLE to keep
+ * the user interface responsive.
+ *
+ * Since: 3.16
+ */
+void
+gedit_message_bus_set_priority (GeditMessageBus *bus,
+                                const gchar     *object_path,
+                                const gchar     *method,
+                                gint             priority)
+{
+	MessageIdentifier identifier;
+
+	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
+	g_return_if_fail (object_path != NULL);
+	g_return_if_fail (method != NULL);
+
+	message_identifier_init (&identifier, object_path, method);
+
+	g_rw_lock_writer_lock (&bus->priv->priorities_lock);
+	g_hash_table_replace (bus->priv->priorities,
+	                      message_identifier_copy (&identifier),
+	                      GINT_TO_POINTER (priority));
+	g_rw_lock_writer_unlock (&bus->priv->priorities_lock);
 }
 
 typedef struct
@@ -931,6 +1390,7 @@ gedit_message_bus_connect (GeditMessageBus	*bus,
                            gpointer		 user_data,
                            GDestroyNotify	 destroy_data)
 {
+	MessageIdentifier identifier;
 	Message *message;
 
 	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), 0);
@@ -939,19 +1399,66 @@ gedit_message_bus_connect (GeditMessageBus	*bus,
 	g_return_val_if_fail (callback != NULL, 0);
 
 	/* lookup the message and create if it does not exist yet */
-	message = lookup_message (bus, object_path, method, TRUE);
+	message_identifier_init (&identifier, object_path, method);
+	message = lookup_message (bus, &identifier, TRUE);
 
-	return add_listener (bus, message, callback, user_data, destroy_data);
+	return add_listener (bus, message, NULL, callback, user_data, destroy_data);
 }
 
 /**
- * gedit_message_bus_disconnect:
+ * gedit_message_bus_connect_in_context:
  * @bus: a #GeditMessageBus
- * @id: the callback id as returned by gedit_message_bus_connect()
- *
- * Disconnects a previously connected message callback.
- *
- */
+ * @object_path: the object path
+ * @method: the method
+ * @context: the #GMainContext in which to call @callback
+ * @callback: function to be called when message @method at @object_path is sent
+ * @user_data: (allow-none): user_data to use for the callback
+ * @destroy_data: (allow-none): function to evoke with @user_data as argument when @user_data
+ *                needs to be freed
+ *
+ * Like gedit_message_bus_connect(), but @callback is invoked from @context,
+ * typically the context of a worker thread, instead of the context in which
+ * the message is dispatched. The delivery is asynchronous even for messages
+ * sent with gedit_message_bus_send_sync(), so @callback cannot return values
+ * in the message. Once disconnected, @callback is not called anymore, but
+ * @destroy_data may be called from @context.
+ *
+ * Return value: the callback identifier
+ *
+ * Since: 3.16
+ */
+guint
+gedit_message_bus_connect_in_context (GeditMessageBus      *bus,
+                                      const gchar          *object_path,
+                                      const gchar          *method,
+                                      GMainContext         *context,
+                                      GeditMessageCallback  callback,
+                                      gpointer              user_data,
+                                      GDestroyNotify        destroy_data)
+{
+	MessageIdentifier identifier;
+	Message *message;
+
+	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), 0);
+	g_return_val_if_fail (object_path != NULL, 0);
+	g_return_val_if_fail (method != NULL, 0);
+	g_return_val_if_fail (context != NULL, 0);
+	g_return_val_if_fail (callback != NULL, 0);
+
+	message_identifier_init (&identifier, object_path, method);
+	message = lookup_message (bus, &identifier, TRUE);
+
+	return add_listener (bus, message, context, callback, user_data, destroy_data);
+}
+
+/**
+ * gedit_message_bus_disconnect:
+ * @bus: a #GeditMessageBus
+ * @id: the callback id as returned by gedit_message_bus_connect()
+ *
+ * Disconnects a previously connected message callback.
+ *
+ */
 void
 gedit_message_bus_disconnect (GeditMessageBus *bus,
                               guint            id)
@@ -1083,20 +1590,70 @@ gedit_message_bus_unblock_by_func (GeditMessageBus      *bus,
 	                  unblock_listener);
 }
 
+static gint
+get_priority (GeditMessageBus *bus,
+              GeditMessage    *message)
+{
+	MessageIdentifier identifier;
+	gpointer priority;
+	gboolean found;
+
+	identifier.object_path = gedit_message_get_object_path (message);
+	identifier.method = gedit_message_get_method (message);
+
+	g_rw_lock_reader_lock (&bus->priv->priorities_lock);
+	found = g_hash_table_lookup_extended (bus->priv->priorities,
+	                                      &identifier,
+	                                      NULL,
+	                                      &priority);
+	g_rw_lock_reader_unlock (&bus->priv->priorities_lock);
+
+	return found ? GPOINTER_TO_INT (priority) : G_PRIORITY_HIGH;
+}
+
+/* Can be called from any thread. */
 static void
 send_message_real (GeditMessageBus *bus,
                    GeditMessage    *message)
 {
-	bus->priv->message_queue = g_list_prepend (bus->priv->message_queue,
-	                                           g_object_ref (message));
+	QueuedMessage *queued;
+	gint priority;
+	gint scheduled;
 
-	if (bus->priv->idle_id == 0)
+	priority = get_priority (bus, message);
+
+	queued = g_slice_new (QueuedMessage);
+	queued->message = g_object_ref (message);
+	queued->priority = priority;
+	queued->serial = (guint) g_atomic_int_add (&bus->priv->queue_serial, 1);
+
+	do
+	{
+		queued->next = g_atomic_pointer_get (&bus->priv->message_queue);
+	}
+	while (!g_atomic_pointer_compare_and_exchange (&bus->priv->message_queue,
+	                                               queued->next,
+	                                               queued));
+
+	/* wake up the main context, unless a dispatch with at least the same
+	   priority is already scheduled */
+	do
 	{
-		bus->priv->idle_id = g_idle_add_full (G_PRIORITY_HIGH,
-		                                      (GSourceFunc)idle_dispatch,
-		                                      bus,
-		                                      NULL);
+		scheduled = g_atomic_int_get (&bus->priv->scheduled_priority);
+
+		if (scheduled <= priority)
+		{
+			return;
+		}
 	}
+	while (!g_atomic_int_compare_and_exchange (&bus->priv->scheduled_priority,
+	                                           scheduled,
+	                                           priority));
+
+	g_idle_add_full (priority,
+	                 (GSourceFunc)idle_dispatch,
+	                 g_object_ref (bus),
+	                 g_object_unref);
 }
 
 /**
@@ -1109,6 +1666,11 @@ send_message_real (GeditMessageBus *bus,
  * convenience function gedit_message_bus_send() can be used to easily send
  * a message without constructing the message object explicitly first.
  *
+ * This function can be called from any thread, for instance by a plugin
+ * doing work in the background, with a message created with g_object_new().
+ * The message is dispatched from the default main context, and should not
+ * be modified after being sent.
+ *
  */
 void
 gedit_message_bus_send_message (GeditMessageBus *bus,
@@ -1130,6 +1692,9 @@ gedit_message_bus_send_message (GeditMessageBus *bus,
  * convenience function gedit_message_bus_send_sync() can be used to easily send
  * a message without constructing the message object explicitly first.
  *
+ * The listeners are called in the calling thread, so this function must be
+ * called from the main thread.
+ *
  */
 void
 gedit_message_bus_send_message_sync (GeditMessageBus *bus,
@@ -1142,22 +1707,18 @@ gedit_message_bus_send_message_sync (GeditMessageBus *bus,
 }
 
 static GeditMessage *
-create_message (GeditMessageBus *bus,
-                const gchar     *object_path,
-                const gchar     *method,
-                const gchar     *first_property,
-                va_list          var_args)
+create_message (GType                    message_type,
+                const MessageIdentifier *identifier,
+                const gchar             *first_property,
+                va_list                  var_args)
 {
-	GType message_type;
 	GeditMessage *msg;
 
-	message_type = gedit_message_bus_lookup (bus, object_path, method);
-
 	if (message_type == G_TYPE_INVALID)
 	{
 		g_warning ("Could not find message type for '%s.%s'",
-		           object_path,
-		           method);
+		           identifier->object_path,
+		           identifier->method);
 
 		return NULL;
 	}
@@ -1168,12 +1729,9 @@ create_message (GeditMessageBus *bus,
 
 	if (msg)
 	{
-		g_object_set (msg,
-		              "object_path",
-		              object_path,
-		              "method",
-		              method,
-		              NULL);
+		_gedit_message_set_identifier (msg,
+		                               identifier->object_path,
+		                               identifier->method);
 	}
 
 	return msg;
@@ -1191,6 +1749,9 @@ create_message (GeditMessageBus *bus,
  * @object_path asynchronously over the bus. The variable argument list
  * specifies key (string) value pairs used to construct the message arguments.
  * To send a message synchronously use gedit_message_bus_send_sync().
+ *
+ * Like gedit_message_bus_send_message(), this function can be called from
+ * any thread.
  */
 void
 gedit_message_bus_send (GeditMessageBus *bus,
@@ -1200,13 +1761,19 @@ gedit_message_bus_send (GeditMessageBus *bus,
                         ...)
 {
 	va_list var_args;
+	MessageIdentifier identifier;
 	GeditMessage *message;
 
+	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
+	g_return_if_fail (object_path != NULL);
+	g_return_if_fail (method != NULL);
+
+	message_identifier_init (&identifier, object_path, method);
+
 	va_start (var_args, first_property);
 
-	message = create_message (bus,
-	                          object_path,
-	                          method,
+	message = create_message (lookup_type (bus, &identifier),
+	                          &identifier,
 	                          first_property,
 	                          var_args);
 
@@ -1236,6 +1803,9 @@ gedit_message_bus_send (GeditMessageBus *bus,
  * specifies key (string) value pairs used to construct the message
  * arguments. To send a message asynchronously use gedit_message_bus_send().
  *
+ * The listeners are called in the calling thread, so this function must be
+ * called from the main thread.
+ *
  * Return value: (allow-none) (transfer full): the constructed #GeditMessage.
  *               The caller owns a reference to the #GeditMessage and should
  *               call g_object_unref() when it is no longer needed.
@@ -1248,12 +1818,18 @@ gedit_message_bus_send_sync (GeditMessageBus *bus,
                              ...)
 {
 	va_list var_args;
+	MessageIdentifier identifier;
 	GeditMessage *message;
 
+	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), NULL);
+	g_return_val_if_fail (object_path != NULL, NULL);
+	g_return_val_if_fail (method != NULL, NULL);
+
+	message_identifier_init (&identifier, object_path, method);
+
 	va_start (var_args, first_property);
-	message = create_message (bus,
-	                          object_path,
-	                          method,
+	message = create_message (lookup_type (bus, &identifier),
+	                          &identifier,
 	                          first_property,
 	                          var_args);
 
@@ -1267,4 +1843,474 @@ gedit_message_bus_send_sync (GeditMessageBus *bus,
 	return message;
 }
 
+/**
+ * gedit_message_bus_set_tracing:
+ * @bus: a #GeditMessageBus
+ * @tracing: whether to record dispatch statistics
+ *
+ * Sets whether @bus records, for each message and each listener callback,
+ * how many times it was dispatched and the time spent doing so, as well as
+ * the length of the queue of asynchronous messages. Tracing is enabled by
+ * default when the <code>GEDIT_DEBUG_MESSAGE_BUS</code> environment
+ * variable is set, in which case the statistics are also printed when the
+ * bus is finalized. Listeners connected with
+ * gedit_message_bus_connect_in_context() are not timed.
+ *
+ * Since: 3.16
+ */
+void
+gedit_message_bus_set_tracing (GeditMessageBus *bus,
+                               gboolean         tracing)
+{
+	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
+
+	bus->priv->tracing = tracing != FALSE;
+}
+
+/**
+ * gedit_message_bus_reset_stats:
+ * @bus: a #GeditMessageBus
+ *
+ * Clears the statistics recorded since tracing was enabled.
+ *
+ * Since: 3.16
+ */
+void
+gedit_message_bus_reset_stats (GeditMessageBus *bus)
+{
+	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
+
+	g_hash_table_remove_all (bus->priv->stats);
+
+	bus->priv->n_queue_dispatches = 0;
+	bus->priv->total_queue_length = 0;
+	bus->priv->max_queue_length = 0;
+}
+
+static void
+append_json_string (GString     *json,
+                    const gchar *str)
+{
+	g_string_append_c (json, '"');
+
+	for (; *str != '\0'; str++)
+	{
+		if (*str == '"' || *str == '\\')
+		{
+			g_string_append_c (json, '\\');
+			g_string_append_c (json, *str);
+		}
+		else if ((guchar) *str < 0x20)
+		{
+			g_string_append_printf (json, "\\u%04x", (guchar) *str);
+		}
+		else
+		{
+			g_string_append_c (json, *str);
+		}
+	}
+
+	g_string_append_c (json, '"');
+}
+
+static void
+append_json_stats (GString             *json,
+                   const DispatchStats *stats)
+{
+	g_string_append_printf (json,
+	                        "\"count\": %" G_GUINT64_FORMAT ", "
+	                        "\"total_us\": %" G_GINT64_FORMAT ", "
+	                        "\"max_us\": %" G_GINT64_FORMAT,
+	                        stats->count,
+	                        stats->total_time,
+	                        stats->max_time);
+}
+
+static gint
+compare_message_stats (gconstpointer a,
+                       gconstpointer b)
+{
+	const MessageStats *stats_a = a;
+	const MessageStats *stats_b = b;
+
+	if (stats_a->dispatch.total_time == stats_b->dispatch.total_time)
+	{
+		return 0;
+	}
+
+	return stats_a->dispatch.total_time > stats_b->dispatch.total_time ? -1 : 1;
+}
+
+static gchar *
+get_callback_name (gpointer callback)
+{
+#ifdef HAVE_DLADDR
+	Dl_info info;
+
+	if (dladdr (callback, &info) != 0 && info.dli_fname != NULL)
+	{
+		gchar *module;
+		gchar *name;
+
+		module = g_path_get_basename (info.dli_fname);
+
+		/* The nearest symbol of a static function is another function */
+		if (info.dli_sname != NULL && info.dli_saddr == callback)
+		{
+			name = g_strdup_printf ("%s (%s)", info.dli_sname, module);
+		}
+		else
+		{
+			name = g_strdup_printf ("%s+0x%" G_GINTPTR_MODIFIER "x",
+			                        module,
+			                        (guintptr) callback - (guintptr) info.dli_fbase);
+		}
+
+		g_free (module);
+
+		return name;
+	}
+#endif
+
+	return g_strdup_printf ("%p", callback);
+}
+
+/**
+ * gedit_message_bus_dump_stats:
+ * @bus: a #GeditMessageBus
+ *
+ * Gets the statistics recorded while tracing as a JSON object, with the
+ * messages sorted by the total time spent dispatching them. Listeners are
+ * identified by the name of their callback when it is exported, or else by
+ * the library containing it and the offset in that library, which can be
+ * resolved with addr2line. The callbacks of the plugins written in other
+ * languages are only identified by their address. See
+ * gedit_message_bus_set_tracing().
+ *
+ * Return value: (transfer full): the statistics as JSON. Free with g_free().
+ *
+ * Since: 3.16
+ */
+gchar *
+gedit_message_bus_dump_stats (GeditMessageBus *bus)
+{
+	GeditMessageBusPrivate *priv;
+	GString *json;
+	GList *messages;
+	GList *item;
+
+	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), NULL);
+
+	priv = bus->priv;
+	json = g_string_new ("{\n");
+
+	g_string_append_printf (json,
+	                        "  \"queue\": { \"dispatches\": %" G_GUINT64_FORMAT ", "
+	                        "\"average_length\": %.1f, \"max_length\": %u },\n",
+	                        priv->n_queue_dispatches,
+	                        priv->n_queue_dispatches > 0 ?
+	                        (gdouble) priv->total_queue_length / priv->n_queue_dispatches : 0.0,
+	                        priv->max_queue_length);
+
+	g_string_append (json, "  \"messages\": [");
+
+	messages = g_hash_table_get_values (priv->stats);
+	messages = g_list_sort (messages, compare_message_stats);
+
+	for (item = messages; item; item = item->next)
+	{
+		MessageStats *stats = item->data;
+		GHashTableIter iter;
+		gpointer callback;
+		gpointer listener_stats;
+		gboolean first = TRUE;
+
+		g_string_append (json, item == messages ? "\n    { " : ",\n    { ");
+
+		g_string_append (json, "\"object_path\": ");
+		append_json_string (json, stats->identifier->object_path);
+		g_string_append (json, ", \"method\": ");
+		append_json_string (json, stats->identifier->method);
+		g_string_append (json, ", ");
+		append_json_stats (json, &stats->dispatch);
+
+		g_string_append (json, ",\n      \"listeners\": [");
+
+		g_hash_table_iter_init (&iter, stats->listeners);
+
+		while (g_hash_table_iter_next (&iter, &callback, &listener_stats))
+		{
+			gchar *name;
+
+			name = get_callback_name (callback);
+
+			g_string_append_printf (json,
+			                        "%s\n        { \"callback\": ",
+			                        first ? "" : ",");
+			append_json_string (json, name);
+			g_string_append (json, ", ");
+			append_json_stats (json, listener_stats);
+
+			g_free (name);
+			g_string_append (json, " }");
+
+			first = FALSE;
+		}
+
+		g_string_append (json, first ? "] }" : "\n      ] }");
+	}
+
+	g_string_append (json, messages != NULL ? "\n  ]\n}\n" : "]\n}\n");
+
+	g_list_free (messages);
+
+	return g_string_free (json, FALSE);
+}
+
+/* The cached type of a handle is read under the reader lock and only
+ * written under the writer lock, since the handle can be shared by several
+ * threads sending messages.
+ */
+static GType
+handle_lookup_type (GeditMessageHandle *handle)
+{
+	GeditMessageBusPrivate *priv = handle->bus->priv;
+	GType type;
+
+	g_rw_lock_reader_lock (&priv->types_lock);
+
+	if (handle->types_serial == priv->types_serial)
+	{
+		type = handle->type;
+		g_rw_lock_reader_unlock (&priv->types_lock);
+
+		return type;
+	}
+
+	g_rw_lock_reader_unlock (&priv->types_lock);
+
+	g_rw_lock_writer_lock (&priv->types_lock);
+
+	type = lookup_type_locked (handle->bus, &handle->identifier);
+	handle->type = type;
+	handle->types_serial = priv->types_serial;
+
+	g_rw_lock_writer_unlock (&priv->types_lock);
+
+	return type;
+}
+
+static Message *
+handle_lookup_message (GeditMessageHandle *handle)
+{
+	GeditMessageBusPrivate *priv = handle->bus->priv;
+
+	if (handle->messages_serial != priv->messages_serial)
+	{
+		handle->message = lookup_message (handle->bus, &handle->identifier, FALSE);
+		handle->messages_serial = priv->messages_serial;
+	}
+
+	return handle->message;
+}
+
+/**
+ * gedit_message_bus_get_handle:
+ * @bus: a #GeditMessageBus
+ * @object_path: the object path
+ * @method: the method
+ *
+ * Get a handle for @method at @object_path. The handle caches the lookups
+ * which are otherwise done each time a message is sent, so it is the
+ * preferred way to send the same message many times. The message does not
+ * need to be registered yet when the handle is created.
+ *
+ * Return value: (transfer full): a new #GeditMessageHandle. Free it with
+ *               gedit_message_handle_unref().
+ *
+ * Since: 3.16
+ */
+GeditMessageHandle *
+gedit_message_bus_get_handle (GeditMessageBus *bus,
+                              const gchar     *object_path,
+                              const gchar     *method)
+{
+	GeditMessageHandle *handle;
+
+	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), NULL);
+	g_return_val_if_fail (object_path != NULL, NULL);
+	g_return_val_if_fail (method != NULL, NULL);
+
+	/* the serials of the bus start at 1, so the first use does the lookups */
+	handle = g_slice_new0 (GeditMessageHandle);
+	handle->bus = g_object_ref (bus);
+	handle->ref_count = 1;
+
+	message_identifier_init (&handle->identifier, object_path, method);
+
+	return handle;
+}
+
+/**
+ * gedit_message_handle_ref:
+ * @handle: a #GeditMessageHandle
+ *
+ * Increases the reference count of @handle.
+ *
+ * Return value: (transfer full): @handle
+ */
+GeditMessageHandle *
+gedit_message_handle_ref (GeditMessageHandle *handle)
+{
+	g_return_val_if_fail (handle != NULL, NULL);
+
+	g_atomic_int_inc (&handle->ref_count);
+
+	return handle;
+}
+
+/**
+ * gedit_message_handle_unref:
+ * @handle: a #GeditMessageHandle
+ *
+ * Decreases the reference count of @handle, and frees it when the count
+ * drops to zero.
+ */
+void
+gedit_message_handle_unref (GeditMessageHandle *handle)
+{
+	g_return_if_fail (handle != NULL);
+
+	if (g_atomic_int_dec_and_test (&handle->ref_count))
+	{
+		g_object_unref (handle->bus);
+		g_slice_free (GeditMessageHandle, handle);
+	}
+}
+
+/**
+ * gedit_message_handle_is_registered:
+ * @handle: a #GeditMessageHandle
+ *
+ * Check whether the message type of @handle is registered on its bus.
+ *
+ * Return value: %TRUE if the message type is registered
+ */
+gboolean
+gedit_message_handle_is_registered (GeditMessageHandle *handle)
+{
+	g_return_val_if_fail (handle != NULL, FALSE);
+
+	return handle_lookup_type (handle) != G_TYPE_INVALID;
+}
+
+/**
+ * gedit_message_handle_has_listeners:
+ * @handle: a #GeditMessageHandle
+ *
+ * Check whether a callback which is not blocked is connected to the message
+ * of @handle. Senders can use it to avoid building messages nobody receives.
+ *
+ * Return value: %TRUE if the message has listeners
+ */
+gboolean
+gedit_message_handle_has_listeners (GeditMessageHandle *handle)
+{
+	Message *message;
+	GList *item;
+
+	g_return_val_if_fail (handle != NULL, FALSE);
+
+	message = handle_lookup_message (handle);
+
+	if (message == NULL)
+	{
+		return FALSE;
+	}
+
+	for (item = message->listeners; item; item = item->next)
+	{
+		if (!((Listener *)item->data)->blocked)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * gedit_message_handle_send:
+ * @handle: a #GeditMessageHandle
+ * @first_property: the first property
+ * @...: NULL terminated list of key/value pairs
+ *
+ * Like gedit_message_bus_send(), for the message of @handle.
+ */
+void
+gedit_message_handle_send (GeditMessageHandle *handle,
+                           const gchar        *first_property,
+                           ...)
+{
+	va_list var_args;
+	GeditMessage *message;
+
+	g_return_if_fail (handle != NULL);
+
+	va_start (var_args, first_property);
+
+	message = create_message (handle_lookup_type (handle),
+	                          &handle->identifier,
+	                          first_property,
+	                          var_args);
+
+	if (message)
+	{
+		send_message_real (handle->bus, message);
+		g_object_unref (message);
+	}
+	else
+	{
+		g_warning ("Could not instantiate message");
+	}
+
+	va_end (var_args);
+}
+
+/**
+ * gedit_message_handle_send_sync:
+ * @handle: a #GeditMessageHandle
+ * @first_property: the first property
+ * @...: (allow-none): %NULL terminated list of key/value pairs
+ *
+ * Like gedit_message_bus_send_sync(), for the message of @handle.
+ *
+ * Return value: (allow-none) (transfer full): the constructed #GeditMessage.
+ */
+GeditMessage *
+gedit_message_handle_send_sync (GeditMessageHandle *handle,
+                                const gchar        *first_property,
+                                ...)
+{
+	va_list var_args;
+	GeditMessage *message;
+
+	g_return_val_if_fail (handle != NULL, NULL);
+
+	va_start (var_args, first_property);
+	message = create_message (handle_lookup_type (handle),
+	                          &handle->identifier,
+	                          first_property,
+	                          var_args);
+
+	if (message)
+	{
+		dispatch_message (handle->bus, message);
+	}
+
+	va_end (var_args);
+
+	return message;
+}
+
 /* ex:set ts=8 noet: */
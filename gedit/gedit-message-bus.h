@@ -36,9 +36,12 @@ G_BEGIN_DECLS
 #define GEDIT_IS_MESSAGE_BUS_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_MESSAGE_BUS))
 #define GEDIT_MESSAGE_BUS_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_MESSAGE_BUS, GeditMessageBusClass))
 
+#define GEDIT_TYPE_MESSAGE_HANDLE		(gedit_message_handle_get_type ())
+
 typedef struct _GeditMessageBus		GeditMessageBus;
 typedef struct _GeditMessageBusClass	GeditMessageBusClass;
 typedef struct _GeditMessageBusPrivate	GeditMessageBusPrivate;
+typedef struct _GeditMessageHandle	GeditMessageHandle;
 
 struct _GeditMessageBus
 {
@@ -98,6 +101,11 @@ void              gedit_message_bus_foreach            (GeditMessageBus        *
                                                         GeditMessageBusForeach  func,
                                                         gpointer                user_data);
 
+void              gedit_message_bus_set_priority       (GeditMessageBus        *bus,
+                                                        const gchar            *object_path,
+                                                        const gchar            *method,
+                                                        gint                    priority);
+
 guint             gedit_message_bus_connect            (GeditMessageBus        *bus,
                                                         const gchar            *object_path,
                                                         const gchar            *method,
@@ -105,6 +113,14 @@ guint             gedit_message_bus_connect            (GeditMessageBus        *
                                                         gpointer                user_data,
                                                         GDestroyNotify          destroy_data);
 
+guint             gedit_message_bus_connect_in_context (GeditMessageBus        *bus,
+                                                        const gchar            *object_path,
+                                                        const gchar            *method,
+                                                        GMainContext           *context,
+                                                        GeditMessageCallback    callback,
+                                                        gpointer                user_data,
+                                                        GDestroyNotify          destroy_data);
+
 void              gedit_message_bus_disconnect         (GeditMessageBus        *bus,
                                                         guint                   id);
 
@@ -147,6 +163,31 @@ GeditMessage     *gedit_message_bus_send_sync          (GeditMessageBus        *
                                                         const gchar            *first_property,
                                                         ...) G_GNUC_NULL_TERMINATED;
 
+void              gedit_message_bus_set_tracing        (GeditMessageBus        *bus,
+                                                        gboolean                tracing);
+void              gedit_message_bus_reset_stats        (GeditMessageBus        *bus);
+gchar            *gedit_message_bus_dump_stats         (GeditMessageBus        *bus);
+
+GType               gedit_message_handle_get_type      (void) G_GNUC_CONST;
+
+GeditMessageHandle *gedit_message_bus_get_handle       (GeditMessageBus        *bus,
+                                                        const gchar            *object_path,
+                                                        const gchar            *method);
+
+GeditMessageHandle *gedit_message_handle_ref           (GeditMessageHandle     *handle);
+void                gedit_message_handle_unref         (GeditMessageHandle     *handle);
+
+gboolean            gedit_message_handle_is_registered (GeditMessageHandle     *handle);
+gboolean            gedit_message_handle_has_listeners (GeditMessageHandle     *handle);
+
+void                gedit_message_handle_send          (GeditMessageHandle     *handle,
+                                                        const gchar            *first_property,
+                                                        ...) G_GNUC_NULL_TERMINATED;
+
+GeditMessage       *gedit_message_handle_send_sync     (GeditMessageHandle     *handle,
+                                                        const gchar            *first_property,
+                                                        ...) G_GNUC_NULL_TERMINATED;
+
 G_END_DECLS
 
 #endif /* __GEDIT_MESSAGE_BUS_H__ */
@@ -51,23 +51,13 @@ enum
 
 struct _GeditMessagePrivate
 {
-	gchar *object_path;
-	gchar *method;
+	/* Interned strings, so that the bus can use them as keys directly */
+	const gchar *object_path;
+	const gchar *method;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GeditMessage, gedit_message, G_TYPE_OBJECT)
 
-static void
-gedit_message_finalize (GObject *object)
-{
-	GeditMessage *message = GEDIT_MESSAGE (object);
-
-	g_free (message->priv->object_path);
-	g_free (message->priv->method);
-
-	G_OBJECT_CLASS (gedit_message_parent_class)->finalize (object);
-}
-
 static void
 gedit_message_get_property (GObject    *object,
                             guint       prop_id,
@@ -103,12 +93,10 @@ gedit_message_set_property (GObject      *object,
 	switch (prop_id)
 	{
 		case PROP_OBJECT_PATH:
-			g_free (msg->priv->object_path);
-			msg->priv->object_path = g_value_dup_string (value);
+			msg->priv->object_path = g_intern_string (g_value_get_string (value));
 			break;
 		case PROP_METHOD:
-			g_free (msg->priv->method);
-			msg->priv->method = g_value_dup_string (value);
+			msg->priv->method = g_intern_string (g_value_get_string (value));
 			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -121,8 +109,6 @@ gedit_message_class_init (GeditMessageClass *klass)
 {
 	GObjectClass *object_class = G_OBJECT_CLASS(klass);
 
-	object_class->finalize = gedit_message_finalize;
-
 	object_class->get_property = gedit_message_get_property;
 	object_class->set_property = gedit_message_set_property;
 
@@ -199,6 +185,26 @@ gedit_message_get_object_path (GeditMessage *message)
 	return message->priv->object_path;
 }
 
+/*
+ * _gedit_message_set_identifier:
+ * @message: the #GeditMessage
+ * @object_path: the interned object path
+ * @method: the interned method
+ *
+ * Sets the object path and the method without going through the GObject
+ * property machinery, for the messages created by the bus.
+ */
+void
+_gedit_message_set_identifier (GeditMessage *message,
+                               const gchar  *object_path,
+                               const gchar  *method)
+{
+	g_return_if_fail (GEDIT_IS_MESSAGE (message));
+
+	message->priv->object_path = object_path;
+	message->priv->method = method;
+}
+
 /**
  * gedit_message_is_valid_object_path:
  * @object_path: (allow-none): the object path
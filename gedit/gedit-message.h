@@ -70,6 +70,13 @@ gboolean     gedit_message_is_valid_object_path (const gchar  *object_path);
 gchar       *gedit_message_type_identifier      (const gchar  *object_path,
                                                  const gchar  *method);
 
+/*
+ * Non exported functions
+ */
+void         _gedit_message_set_identifier      (GeditMessage *message,
+                                                 const gchar  *object_path,
+                                                 const gchar  *method);
+
 G_END_DECLS
 
 #endif /* __GEDIT_MESSAGE_H__ */
@@ -232,6 +232,7 @@ load_values (void)
 {
 	xmlDocPtr doc;
 	xmlNodePtr cur;
+	gint64 span;
 
 	gedit_debug (DEBUG_METADATA);
 
@@ -249,7 +250,9 @@ load_values (void)
 		return FALSE;
 	}
 
+	span = gedit_debug_span_begin (GEDIT_DEBUG_METADATA);
 	doc = xmlParseFile (gedit_metadata_manager->metadata_filename);
+	gedit_debug_span_end (GEDIT_DEBUG_METADATA, span, "metadata-parse", NULL);
 
 	if (doc == NULL)
 	{
@@ -278,6 +281,8 @@ load_values (void)
 	cur = xmlDocGetRootElement (doc);
 	cur = cur->xmlChildrenNode;
 
+	span = gedit_debug_span_begin (GEDIT_DEBUG_METADATA);
+
 	while (cur != NULL)
 	{
 		parseItem (doc, cur);
@@ -285,6 +290,8 @@ load_values (void)
 		cur = cur->next;
 	}
 
+	gedit_debug_span_end (GEDIT_DEBUG_METADATA, span, "metadata-load-items", NULL);
+
 	xmlFreeDoc (doc);
 
 	return TRUE;
@@ -534,11 +541,14 @@ gedit_metadata_manager_save (gpointer data)
 {
 	xmlDocPtr  doc;
 	xmlNodePtr root;
+	gint64     span;
 
 	gedit_debug (DEBUG_METADATA);
 
 	gedit_metadata_manager->timeout_id = 0;
 
+	span = gedit_debug_span_begin (GEDIT_DEBUG_METADATA);
+
 	resize_items ();
 
 	xmlIndentTreeOutput = TRUE;
@@ -576,6 +586,8 @@ gedit_metadata_manager_save (gpointer data)
 
 	xmlFreeDoc (doc);
 
+	gedit_debug_span_end (GEDIT_DEBUG_METADATA, span, "metadata-save", NULL);
+
 	gedit_debug_message (DEBUG_METADATA, "DONE");
 
 	return FALSE;
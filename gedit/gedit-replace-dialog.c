@@ -48,10 +48,14 @@ struct _GeditReplaceDialogPrivate
 	GtkWidget *regex_checkbutton;
 	GtkWidget *backwards_checkbutton;
 	GtkWidget *wrap_around_checkbutton;
+	GtkWidget *progress_box;
+	GtkWidget *progress_bar;
 
 	GeditDocument *active_document;
 
 	guint idle_update_sensitivity_id;
+
+	guint replacing_all : 1;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GeditReplaceDialog, gedit_replace_dialog, GTK_TYPE_DIALOG)
@@ -266,7 +270,7 @@ update_replace_response_sensitivity_cb (GeditReplaceDialog *dialog)
 	GtkTextIter end;
 	gint pos;
 
-	if (has_replace_error (dialog))
+	if (has_replace_error (dialog) || dialog->priv->replacing_all)
 	{
 		gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
 						   GEDIT_REPLACE_DIALOG_REPLACE_RESPONSE,
@@ -346,7 +350,8 @@ update_responses_sensitivity (GeditReplaceDialog *dialog)
 
 	search_text = gtk_entry_get_text (GTK_ENTRY (dialog->priv->search_text_entry));
 
-	if (search_text[0] == '\0')
+	/* The document must not change while replacing all the occurrences */
+	if (search_text[0] == '\0' || dialog->priv->replacing_all)
 	{
 		gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
 						   GEDIT_REPLACE_DIALOG_FIND_RESPONSE,
@@ -660,6 +665,48 @@ hide_cb (GeditReplaceDialog *dialog)
 	disconnect_document (dialog);
 }
 
+static void
+stop_button_clicked_cb (GtkButton          *button,
+			GeditReplaceDialog *dialog)
+{
+	gtk_dialog_response (GTK_DIALOG (dialog), GEDIT_REPLACE_DIALOG_STOP_RESPONSE);
+}
+
+static void
+create_progress_box (GeditReplaceDialog *dlg)
+{
+	GtkWidget *content_area;
+	GtkWidget *stop_button;
+
+	dlg->priv->progress_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+	gtk_container_set_border_width (GTK_CONTAINER (dlg->priv->progress_box), 5);
+
+	dlg->priv->progress_bar = gtk_progress_bar_new ();
+	gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (dlg->priv->progress_bar), TRUE);
+	gtk_widget_set_valign (dlg->priv->progress_bar, GTK_ALIGN_CENTER);
+	gtk_box_pack_start (GTK_BOX (dlg->priv->progress_box),
+			    dlg->priv->progress_bar,
+			    TRUE, TRUE, 0);
+
+	stop_button = gtk_button_new_with_mnemonic (_("_Stop"));
+	gtk_box_pack_start (GTK_BOX (dlg->priv->progress_box),
+			    stop_button,
+			    FALSE, FALSE, 0);
+
+	g_signal_connect (stop_button,
+			  "clicked",
+			  G_CALLBACK (stop_button_clicked_cb),
+			  dlg);
+
+	content_area = gtk_dialog_get_content_area (GTK_DIALOG (dlg));
+	gtk_box_pack_start (GTK_BOX (content_area),
+			    dlg->priv->progress_box,
+			    FALSE, FALSE, 0);
+
+	gtk_widget_show_all (dlg->priv->progress_box);
+	gtk_widget_hide (dlg->priv->progress_box);
+}
+
 static void
 gedit_replace_dialog_init (GeditReplaceDialog *dlg)
 {
@@ -688,6 +735,8 @@ gedit_replace_dialog_init (GeditReplaceDialog *dlg)
 				 GTK_POS_RIGHT, 1, 1);
 	gtk_widget_show_all (dlg->priv->replace_entry);
 
+	create_progress_box (dlg);
+
 	gtk_label_set_mnemonic_widget (GTK_LABEL (dlg->priv->search_label),
 				       dlg->priv->search_entry);
 	gtk_label_set_mnemonic_widget (GTK_LABEL (dlg->priv->replace_label),
@@ -772,6 +821,52 @@ gedit_replace_dialog_get_backwards (GeditReplaceDialog *dialog)
 	return gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->priv->backwards_checkbutton));
 }
 
+/* Shows the progress of "Replace All" with a button to stop it, and makes the
+ * other responses insensitive until gedit_replace_dialog_hide_progress() is
+ * called.
+ */
+void
+gedit_replace_dialog_show_progress (GeditReplaceDialog *dialog,
+				    gdouble             fraction,
+				    gint                n_replaced)
+{
+	gchar *text;
+
+	g_return_if_fail (GEDIT_IS_REPLACE_DIALOG (dialog));
+
+	if (!dialog->priv->replacing_all)
+	{
+		dialog->priv->replacing_all = TRUE;
+		update_responses_sensitivity (dialog);
+		gtk_widget_show (dialog->priv->progress_box);
+	}
+
+	text = g_strdup_printf (ngettext ("%d occurrence replaced",
+					  "%d occurrences replaced",
+					  n_replaced),
+				n_replaced);
+
+	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (dialog->priv->progress_bar), fraction);
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (dialog->priv->progress_bar), text);
+
+	g_free (text);
+}
+
+void
+gedit_replace_dialog_hide_progress (GeditReplaceDialog *dialog)
+{
+	g_return_if_fail (GEDIT_IS_REPLACE_DIALOG (dialog));
+
+	if (!dialog->priv->replacing_all)
+	{
+		return;
+	}
+
+	dialog->priv->replacing_all = FALSE;
+	gtk_widget_hide (dialog->priv->progress_box);
+	update_responses_sensitivity (dialog);
+}
+
 /* This function returns the original search text. The search text from the
  * search settings has been unescaped, and the escape function is not
  * reciprocal. So to avoid bugs, we have to deal with the original search text.
@@ -68,7 +68,8 @@ enum
 {
 	GEDIT_REPLACE_DIALOG_FIND_RESPONSE = 100,
 	GEDIT_REPLACE_DIALOG_REPLACE_RESPONSE,
-	GEDIT_REPLACE_DIALOG_REPLACE_ALL_RESPONSE
+	GEDIT_REPLACE_DIALOG_REPLACE_ALL_RESPONSE,
+	GEDIT_REPLACE_DIALOG_STOP_RESPONSE
 };
 
 /*
@@ -90,6 +91,12 @@ gboolean		 gedit_replace_dialog_get_backwards		(GeditReplaceDialog *dialog);
 void			 gedit_replace_dialog_set_replace_error		(GeditReplaceDialog *dialog,
 									 const gchar        *error_msg);
 
+void			 gedit_replace_dialog_show_progress		(GeditReplaceDialog *dialog,
+									 gdouble             fraction,
+									 gint                n_replaced);
+
+void			 gedit_replace_dialog_hide_progress		(GeditReplaceDialog *dialog);
+
 G_END_DECLS
 
 #endif  /* __GEDIT_REPLACE_DIALOG_H__  */
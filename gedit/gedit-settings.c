@@ -31,6 +31,7 @@
 #include <gtksourceview/gtksource.h>
 
 #include "gedit-app.h"
+#include "gedit-utils.h"
 #include "gedit-view.h"
 #include "gedit-window.h"
 
@@ -47,8 +48,15 @@ struct _GeditSettingsPrivate
 	GSettings *interface;
 	GSettings *editor;
 	GSettings *ui;
+	GSettings *encodings;
 
 	gchar *old_scheme;
+
+	/* The auto-detected encodings, converted from the GSettings key only
+	 * when it changes instead of for each file loading.
+	 */
+	GSList *candidate_encodings;
+	guint candidate_encodings_valid : 1;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GeditSettings, gedit_settings, G_TYPE_OBJECT)
@@ -59,6 +67,7 @@ gedit_settings_finalize (GObject *object)
 	GeditSettings *gs = GEDIT_SETTINGS (object);
 
 	g_free (gs->priv->old_scheme);
+	g_slist_free (gs->priv->candidate_encodings);
 
 	G_OBJECT_CLASS (gedit_settings_parent_class)->finalize (object);
 }
@@ -72,6 +81,7 @@ gedit_settings_dispose (GObject *object)
 	g_clear_object (&priv->interface);
 	g_clear_object (&priv->editor);
 	g_clear_object (&priv->ui);
+	g_clear_object (&priv->encodings);
 
 	G_OBJECT_CLASS (gedit_settings_parent_class)->dispose (object);
 }
@@ -329,6 +339,16 @@ on_syntax_highlighting_changed (GSettings     *settings,
 	g_list_free (windows);
 }
 
+static void
+on_auto_detected_encodings_changed (GSettings     *settings,
+				    const gchar   *key,
+				    GeditSettings *gs)
+{
+	g_slist_free (gs->priv->candidate_encodings);
+	gs->priv->candidate_encodings = NULL;
+	gs->priv->candidate_encodings_valid = FALSE;
+}
+
 static void
 gedit_settings_init (GeditSettings *gs)
 {
@@ -337,6 +357,7 @@ gedit_settings_init (GeditSettings *gs)
 	gs->priv->old_scheme = NULL;
 	gs->priv->editor = g_settings_new ("org.gnome.gedit.preferences.editor");
 	gs->priv->ui = g_settings_new ("org.gnome.gedit.preferences.ui");
+	gs->priv->encodings = g_settings_new ("org.gnome.gedit.preferences.encodings");
 
 	/* Load settings */
 	gs->priv->lockdown = g_settings_new ("org.gnome.desktop.lockdown");
@@ -378,6 +399,12 @@ gedit_settings_init (GeditSettings *gs)
 			  "changed::syntax-highlighting",
 			  G_CALLBACK (on_syntax_highlighting_changed),
 			  gs);
+
+	/* encodings changes */
+	g_signal_connect (gs->priv->encodings,
+			  "changed::auto-detected",
+			  G_CALLBACK (on_auto_detected_encodings_changed),
+			  gs);
 }
 
 static void
@@ -438,6 +465,40 @@ gedit_settings_get_system_font (GeditSettings *gs)
 	return system_font;
 }
 
+/**
+ * gedit_settings_get_candidate_encodings:
+ * @gs: a #GeditSettings
+ *
+ * Gets the list of encodings used for the automatic detection when loading a
+ * file.
+ *
+ * Returns: (transfer none) (element-type GtkSource.Encoding): the list of
+ * #GtkSourceEncoding, owned by @gs. It is valid until the auto-detected
+ * encodings setting changes, so copy it if it must be kept.
+ *
+ * Since: 3.16
+ */
+const GSList *
+gedit_settings_get_candidate_encodings (GeditSettings *gs)
+{
+	g_return_val_if_fail (GEDIT_IS_SETTINGS (gs), NULL);
+
+	if (!gs->priv->candidate_encodings_valid)
+	{
+		gchar **enc_strv;
+
+		enc_strv = g_settings_get_strv (gs->priv->encodings,
+						GEDIT_SETTINGS_ENCODING_AUTO_DETECTED);
+
+		gs->priv->candidate_encodings = _gedit_utils_encoding_strv_to_list ((const gchar * const *)enc_strv);
+		gs->priv->candidate_encodings_valid = TRUE;
+
+		g_strfreev (enc_strv);
+	}
+
+	return gs->priv->candidate_encodings;
+}
+
 GSList *
 gedit_settings_get_list (GSettings   *settings,
 			 const gchar *key)
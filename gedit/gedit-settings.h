@@ -63,6 +63,8 @@ GeditLockdownMask	 gedit_settings_get_lockdown			(GeditSettings *gs);
 
 gchar			*gedit_settings_get_system_font			(GeditSettings *gs);
 
+const GSList		*gedit_settings_get_candidate_encodings		(GeditSettings *gs);
+
 /* Utility functions */
 GSList			*gedit_settings_get_list			(GSettings     *settings,
 									 const gchar   *key);
@@ -78,7 +80,9 @@ void			 gedit_settings_set_list			(GSettings     *settings,
 #define GEDIT_SETTINGS_CREATE_BACKUP_COPY		"create-backup-copy"
 #define GEDIT_SETTINGS_AUTO_SAVE			"auto-save"
 #define GEDIT_SETTINGS_AUTO_SAVE_INTERVAL		"auto-save-interval"
+#define GEDIT_SETTINGS_MAX_CONCURRENT_SAVES		"max-concurrent-saves"
 #define GEDIT_SETTINGS_MAX_UNDO_ACTIONS			"max-undo-actions"
+#define GEDIT_SETTINGS_MAX_UNDO_MEMORY			"max-undo-memory"
 #define GEDIT_SETTINGS_WRAP_MODE			"wrap-mode"
 #define GEDIT_SETTINGS_WRAP_LAST_SPLIT_MODE		"wrap-last-split-mode"
 #define GEDIT_SETTINGS_TABS_SIZE			"tabs-size"
@@ -26,6 +26,7 @@
 #include "gedit-tab.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <glib/gi18n.h>
 
 #include "gedit-app.h"
@@ -42,6 +43,14 @@
 
 #define GEDIT_TAB_KEY "GEDIT_TAB_KEY"
 
+/* Number of bytes checked to know if a file is UTF-8 before loading it. */
+#define ENCODING_PRESCAN_SIZE (64 * 1024)
+
+/* Number of bytes at each end of a file given to the "load-preview" signal. */
+#define LOAD_PREVIEW_SIZE (8 * 1024)
+
+#define DIRECTORY_ENCODINGS_MAX_SIZE 256
+
 struct _GeditTabPrivate
 {
 	GSettings	       *editor;
@@ -64,9 +73,14 @@ struct _GeditTabPrivate
 	gint                    tmp_line_pos;
 	gint                    tmp_column_pos;
 	guint			idle_scroll;
+	gulong                  loading_insert_text_id;
 
 	GTimer 		       *timer;
 
+	/* Profiling spans of the current file loading and saving */
+	gint64                  load_span;
+	gint64                  save_span;
+
 	gint                    auto_save_interval;
 	guint                   auto_save_timeout;
 
@@ -75,6 +89,9 @@ struct _GeditTabPrivate
 
 	gint                    ask_if_externally_modified : 1;
 
+	/* The saving progress is shown by the caller, e.g. "Save All". */
+	guint			batch_saving : 1;
+
 	/* tmp data for loading */
 	guint			user_requested_encoding : 1;
 };
@@ -126,6 +143,11 @@ enum
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
+/* Encodings detected for the last files loaded in each directory. Files of the
+ * same directory often share the same encoding.
+ */
+static GHashTable *directory_encodings = NULL;
+
 static gboolean gedit_tab_auto_save (GeditTab *tab);
 
 static void load (GeditTab                *tab,
@@ -135,6 +157,9 @@ static void load (GeditTab                *tab,
 
 static void save (GeditTab *tab);
 
+static void remember_directory_encoding (GFile                   *location,
+					 const GtkSourceEncoding *encoding);
+
 static SaverData *
 saver_data_new (void)
 {
@@ -266,9 +291,23 @@ gedit_tab_set_property (GObject      *object,
 	}
 }
 
+static void
+stop_watching_loaded_lines (GeditTab *tab)
+{
+	if (tab->priv->loading_insert_text_id != 0)
+	{
+		GeditDocument *doc = gedit_tab_get_document (tab);
+
+		g_signal_handler_disconnect (doc, tab->priv->loading_insert_text_id);
+		tab->priv->loading_insert_text_id = 0;
+	}
+}
+
 static void
 clear_loading (GeditTab *tab)
 {
+	stop_watching_loaded_lines (tab);
+
 	g_clear_object (&tab->priv->loader);
 	g_clear_object (&tab->priv->cancellable);
 }
@@ -1729,6 +1768,29 @@ goto_line (GeditTab *tab)
 	gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (doc), &iter);
 }
 
+static void
+end_span (gint64      *span,
+	  const gchar *name,
+	  GFile       *location)
+{
+	gchar *basename = NULL;
+
+	if (*span == 0)
+	{
+		return;
+	}
+
+	if (location != NULL)
+	{
+		basename = g_file_get_basename (location);
+	}
+
+	gedit_debug_span_end (GEDIT_DEBUG_TAB, *span, name, basename);
+	*span = 0;
+
+	g_free (basename);
+}
+
 static void
 load_cb (GtkSourceFileLoader *loader,
 	 GAsyncResult        *result,
@@ -1742,8 +1804,12 @@ load_cb (GtkSourceFileLoader *loader,
 	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_LOADING ||
 			  tab->priv->state == GEDIT_TAB_STATE_REVERTING);
 
+	stop_watching_loaded_lines (tab);
+
 	gtk_source_file_loader_load_finish (loader, result, &error);
 
+	end_span (&tab->priv->load_span, "tab-load", location);
+
 	if (error != NULL)
 	{
 		gedit_debug_message (DEBUG_TAB, "File loading error: %s", error->message);
@@ -1771,6 +1837,11 @@ load_cb (GtkSourceFileLoader *loader,
 						     GEDIT_METADATA_ATTRIBUTE_ENCODING, charset,
 						     NULL);
 		}
+		else if (error == NULL)
+		{
+			remember_directory_encoding (location,
+						     gtk_source_file_loader_get_encoding (loader));
+		}
 
 		goto_line (tab);
 	}
@@ -1955,24 +2026,169 @@ end:
 	}
 }
 
+/* The file loader fills the buffer chunk by chunk, so the line requested on
+ * the command line is often available long before the end of the loading.
+ * Jump to it as soon as it is complete, instead of waiting for the whole file.
+ */
+static void
+loading_insert_text_cb (GtkTextBuffer *buffer,
+			GtkTextIter   *location,
+			gchar         *text,
+			gint           len,
+			GeditTab      *tab)
+{
+	if (gtk_text_buffer_get_line_count (buffer) <= tab->priv->tmp_line_pos)
+	{
+		return;
+	}
+
+	stop_watching_loaded_lines (tab);
+
+	goto_line (tab);
+
+	if (tab->priv->idle_scroll == 0)
+	{
+		tab->priv->idle_scroll = g_idle_add ((GSourceFunc)scroll_to_cursor, tab);
+	}
+}
+
+static gchar *
+get_directory_key (GFile *location)
+{
+	GFile *parent;
+	gchar *key;
+
+	parent = g_file_get_parent (location);
+
+	if (parent == NULL)
+	{
+		return NULL;
+	}
+
+	key = g_file_get_uri (parent);
+	g_object_unref (parent);
+
+	return key;
+}
+
+static void
+remember_directory_encoding (GFile                   *location,
+			     const GtkSourceEncoding *encoding)
+{
+	gchar *key;
+
+	/* Only the other encodings are worth remembering, UTF-8 is recognized
+	 * by the prescan.
+	 */
+	if (location == NULL ||
+	    encoding == NULL ||
+	    encoding == gtk_source_encoding_get_utf8 ())
+	{
+		return;
+	}
+
+	key = get_directory_key (location);
+
+	if (key == NULL)
+	{
+		return;
+	}
+
+	if (directory_encodings == NULL)
+	{
+		directory_encodings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	}
+	else if (g_hash_table_size (directory_encodings) >= DIRECTORY_ENCODINGS_MAX_SIZE)
+	{
+		g_hash_table_remove_all (directory_encodings);
+	}
+
+	g_hash_table_insert (directory_encodings, key, (gpointer) encoding);
+}
+
+static const GtkSourceEncoding *
+get_directory_encoding (GFile *location)
+{
+	const GtkSourceEncoding *encoding;
+	gchar *key;
+
+	if (location == NULL || directory_encodings == NULL)
+	{
+		return NULL;
+	}
+
+	key = get_directory_key (location);
+
+	if (key == NULL)
+	{
+		return NULL;
+	}
+
+	encoding = g_hash_table_lookup (directory_encodings, key);
+	g_free (key);
+
+	return encoding;
+}
+
 static GSList *
-get_candidate_encodings (GeditTab *tab)
+prepend_encoding (GSList                  *encodings,
+		  const GtkSourceEncoding *encoding)
+{
+	if (encoding == NULL)
+	{
+		return encodings;
+	}
+
+	encodings = g_slist_remove (encodings, encoding);
+
+	return g_slist_prepend (encodings, (gpointer) encoding);
+}
+
+typedef enum
+{
+	PRESCAN_UNKNOWN,
+	PRESCAN_UTF8,
+	PRESCAN_NOT_UTF8
+} PrescanResult;
+
+/* The candidates are tried in order by the file loader, the first one that
+ * converts the content without errors is chosen. So the most probable
+ * encodings are put first, by increasing order of precedence: the
+ * auto-detected encodings, the encoding learned for the directory, UTF-8 if
+ * the content is known to be valid UTF-8, the encoding chosen by the user
+ * (metadata), and the current encoding of the file (when reverting).
+ */
+static GSList *
+get_candidate_encodings (GeditTab      *tab,
+			 PrescanResult  prescan)
 {
 	GeditDocument *doc;
-	GSettings *enc_settings;
-	gchar **enc_strv;
+	GeditSettings *settings;
 	gchar *metadata_charset;
 	GtkSourceFile *file;
+	GFile *location;
 	const GtkSourceEncoding *file_encoding;
 	GSList *encodings;
 
-	enc_settings = g_settings_new ("org.gnome.gedit.preferences.encodings");
+	settings = GEDIT_SETTINGS (_gedit_app_get_settings (GEDIT_APP (g_application_get_default ())));
+	encodings = g_slist_copy ((GSList *) gedit_settings_get_candidate_encodings (settings));
 
-	enc_strv = g_settings_get_strv (enc_settings, GEDIT_SETTINGS_ENCODING_AUTO_DETECTED);
+	doc = gedit_tab_get_document (tab);
+	file = gedit_document_get_file (doc);
+	location = gtk_source_file_get_location (file);
 
-	encodings = _gedit_utils_encoding_strv_to_list ((const gchar * const *)enc_strv);
+	/* A single-byte encoding accepts any content, so the directory
+	 * encoding is used only when the content is known not to be UTF-8.
+	 */
+	if (prescan == PRESCAN_NOT_UTF8)
+	{
+		encodings = prepend_encoding (encodings, get_directory_encoding (location));
+	}
+	else if (prescan == PRESCAN_UTF8)
+	{
+		encodings = prepend_encoding (encodings, gtk_source_encoding_get_utf8 ());
+	}
 
-	doc = gedit_tab_get_document (tab);
 	metadata_charset = gedit_document_get_metadata (doc, GEDIT_METADATA_ATTRIBUTE_ENCODING);
 
 	if (metadata_charset != NULL)
@@ -1980,53 +2196,279 @@ get_candidate_encodings (GeditTab *tab)
 		const GtkSourceEncoding *metadata_enc;
 
 		metadata_enc = gtk_source_encoding_get_from_charset (metadata_charset);
+		encodings = prepend_encoding (encodings, metadata_enc);
 
-		if (metadata_enc != NULL)
-		{
-			encodings = g_slist_prepend (encodings, (gpointer)metadata_enc);
-		}
+		g_free (metadata_charset);
 	}
 
-	file = gedit_document_get_file (doc);
 	file_encoding = gtk_source_file_get_encoding (file);
+	encodings = prepend_encoding (encodings, file_encoding);
+
+	return encodings;
+}
+
+typedef struct
+{
+	PrescanResult  result;
+
+	/* The first and last lines of the file, when it is valid UTF-8. The
+	 * tail is NULL if the head contains the whole file.
+	 */
+	gchar         *head;
+	gchar         *tail;
+} PrescanData;
 
-	if (file_encoding != NULL)
+static void
+prescan_data_free (PrescanData *data)
+{
+	g_free (data->head);
+	g_free (data->tail);
+	g_slice_free (PrescanData, data);
+}
+
+/* Returns a copy of the complete lines at the beginning of @text. */
+static gchar *
+get_preview_head (const gchar *text,
+		  gsize        length)
+{
+	const gchar *end;
+
+	length = MIN (length, LOAD_PREVIEW_SIZE);
+	end = text + length;
+
+	while (end > text && end[-1] != '\n')
 	{
-		encodings = g_slist_prepend (encodings, (gpointer)file_encoding);
+		end--;
 	}
 
-	g_object_unref (enc_settings);
-	g_strfreev (enc_strv);
-	g_free (metadata_charset);
+	return g_strndup (text, end - text);
+}
 
-	return encodings;
+/* Returns a copy of the complete lines at the end of @text, or NULL if they
+ * are not valid UTF-8.
+ */
+static gchar *
+get_preview_tail (const gchar *text,
+		  gsize        length)
+{
+	const gchar *start;
+
+	start = memchr (text, '\n', length);
+
+	if (start == NULL)
+	{
+		return g_strdup ("");
+	}
+
+	start++;
+	length -= start - text;
+
+	if (!_gedit_utils_is_valid_utf8_prefix (start, length))
+	{
+		return NULL;
+	}
+
+	return g_strndup (start, length);
 }
 
-static void
-load (GeditTab                *tab,
-      const GtkSourceEncoding *encoding,
-      gint                     line_pos,
-      gint                     column_pos)
+static gchar *
+read_preview_tail (GFileInputStream *stream,
+		   GCancellable     *cancellable)
 {
-	GSList *candidate_encodings = NULL;
-	GeditDocument *doc;
+	gchar *buffer;
+	gchar *tail = NULL;
+	gsize n_read = 0;
 
-	g_return_if_fail (GTK_SOURCE_IS_FILE_LOADER (tab->priv->loader));
+	if (!g_seekable_can_seek (G_SEEKABLE (stream)) ||
+	    !g_seekable_seek (G_SEEKABLE (stream),
+			      -LOAD_PREVIEW_SIZE,
+			      G_SEEK_END,
+			      cancellable,
+			      NULL))
+	{
+		return NULL;
+	}
 
-	if (encoding != NULL)
+	buffer = g_malloc (LOAD_PREVIEW_SIZE);
+
+	if (g_input_stream_read_all (G_INPUT_STREAM (stream),
+				     buffer,
+				     LOAD_PREVIEW_SIZE,
+				     &n_read,
+				     cancellable,
+				     NULL))
 	{
-		tab->priv->user_requested_encoding = TRUE;
-		candidate_encodings = g_slist_append (NULL, (gpointer) encoding);
+		tail = get_preview_tail (buffer, n_read);
+	}
+
+	g_free (buffer);
+
+	return tail;
+}
+
+static void
+prescan_thread (GTask        *task,
+		gpointer      source_object,
+		GFile        *location,
+		GCancellable *cancellable)
+{
+	GFileInputStream *stream;
+	PrescanData *data;
+	gchar *buffer;
+	gsize n_read = 0;
+	GError *error = NULL;
+
+	stream = g_file_read (location, cancellable, &error);
+
+	if (stream == NULL)
+	{
+		g_task_return_error (task, error);
+		return;
+	}
+
+	buffer = g_malloc (ENCODING_PRESCAN_SIZE);
+
+	g_input_stream_read_all (G_INPUT_STREAM (stream),
+				 buffer,
+				 ENCODING_PRESCAN_SIZE,
+				 &n_read,
+				 cancellable,
+				 &error);
+
+	if (error != NULL)
+	{
+		g_free (buffer);
+		g_object_unref (stream);
+		g_task_return_error (task, error);
+		return;
+	}
+
+	data = g_slice_new0 (PrescanData);
+
+	if (_gedit_utils_is_valid_utf8_prefix (buffer, n_read))
+	{
+		data->result = PRESCAN_UTF8;
+
+		/* The whole file has been read. */
+		if (n_read < ENCODING_PRESCAN_SIZE)
+		{
+			data->head = g_strndup (buffer, n_read);
+		}
+		else
+		{
+			data->tail = read_preview_tail (stream, cancellable);
+
+			if (data->tail != NULL)
+			{
+				data->head = get_preview_head (buffer, n_read);
+			}
+		}
 	}
 	else
 	{
-		tab->priv->user_requested_encoding = FALSE;
-		candidate_encodings = get_candidate_encodings (tab);
+		data->result = PRESCAN_NOT_UTF8;
 	}
 
+	g_free (buffer);
+	g_object_unref (stream);
+
+	g_task_return_pointer (task, data, (GDestroyNotify) prescan_data_free);
+}
+
+static void
+start_file_loader (GeditTab *tab,
+		   GSList   *candidate_encodings)
+{
 	gtk_source_file_loader_set_candidate_encodings (tab->priv->loader, candidate_encodings);
 	g_slist_free (candidate_encodings);
 
+	gtk_source_file_loader_load_async (tab->priv->loader,
+					   G_PRIORITY_DEFAULT,
+					   tab->priv->cancellable,
+					   (GFileProgressCallback) loader_progress_cb,
+					   tab,
+					   NULL,
+					   (GAsyncReadyCallback) load_cb,
+					   tab);
+}
+
+static void
+prescan_cb (GObject      *source_object,
+	    GAsyncResult *result,
+	    GeditTab     *tab)
+{
+	PrescanData *data;
+	PrescanResult prescan = PRESCAN_UNKNOWN;
+	GError *error = NULL;
+
+	data = g_task_propagate_pointer (G_TASK (result), &error);
+
+	/* If the file cannot be read, or if the loading has been cancelled,
+	 * the file loader reports the error.
+	 */
+	if (error != NULL)
+	{
+		g_error_free (error);
+	}
+	else
+	{
+		prescan = data->result;
+	}
+
+	gedit_debug_message (DEBUG_TAB, "Prescan result: %d", prescan);
+
+	/* Let the plugins configure the view (e.g. from the modelines) while
+	 * the buffer is still empty, so that the content is laid out and
+	 * highlighted only once.
+	 */
+	if (data != NULL && data->head != NULL)
+	{
+		g_signal_emit_by_name (gedit_tab_get_document (tab),
+				       "load-preview",
+				       data->head,
+				       data->tail);
+	}
+
+	if (data != NULL)
+	{
+		prescan_data_free (data);
+	}
+
+	start_file_loader (tab, get_candidate_encodings (tab, prescan));
+}
+
+/* Check in a thread whether the beginning of a local file is valid UTF-8, in
+ * which case UTF-8 is tried first and the directory encoding is skipped.
+ */
+static void
+prescan_encoding (GeditTab *tab,
+		  GFile    *location)
+{
+	GTask *task;
+
+	task = g_task_new (NULL,
+			   tab->priv->cancellable,
+			   (GAsyncReadyCallback) prescan_cb,
+			   tab);
+
+	g_task_set_task_data (task, g_object_ref (location), g_object_unref);
+	g_task_run_in_thread (task, (GTaskThreadFunc) prescan_thread);
+	g_object_unref (task);
+}
+
+static void
+load (GeditTab                *tab,
+      const GtkSourceEncoding *encoding,
+      gint                     line_pos,
+      gint                     column_pos)
+{
+	GeditDocument *doc;
+	GFile *location;
+
+	g_return_if_fail (GTK_SOURCE_IS_FILE_LOADER (tab->priv->loader));
+
+	tab->priv->user_requested_encoding = encoding != NULL;
+
 	tab->priv->tmp_line_pos = line_pos;
 	tab->priv->tmp_column_pos = column_pos;
 
@@ -2036,17 +2478,36 @@ load (GeditTab                *tab,
 	doc = gedit_tab_get_document (tab);
 	g_signal_emit_by_name (doc, "load");
 
+	stop_watching_loaded_lines (tab);
+
+	if (line_pos > 0)
+	{
+		tab->priv->loading_insert_text_id =
+			g_signal_connect_after (doc,
+						"insert-text",
+						G_CALLBACK (loading_insert_text_cb),
+						tab);
+	}
+
 	/* Keep the tab alive during the async operation. */
 	g_object_ref (tab);
 
-	gtk_source_file_loader_load_async (tab->priv->loader,
-					   G_PRIORITY_DEFAULT,
-					   tab->priv->cancellable,
-					   (GFileProgressCallback) loader_progress_cb,
-					   tab,
-					   NULL,
-					   (GAsyncReadyCallback) load_cb,
-					   tab);
+	tab->priv->load_span = gedit_debug_span_begin (GEDIT_DEBUG_TAB);
+
+	location = gtk_source_file_loader_get_location (tab->priv->loader);
+
+	if (encoding != NULL)
+	{
+		start_file_loader (tab, g_slist_append (NULL, (gpointer) encoding));
+	}
+	else if (location != NULL && g_file_is_native (location))
+	{
+		prescan_encoding (tab, location);
+	}
+	else
+	{
+		start_file_loader (tab, get_candidate_encodings (tab, PRESCAN_UNKNOWN));
+	}
 }
 
 void
@@ -2178,7 +2639,7 @@ saver_progress_cb (goffset   size,
 	remaining_time = total_time - elapsed_time;
 
 	/* Approximately more than 3 seconds remaining. */
-	if (remaining_time > 3.0)
+	if (remaining_time > 3.0 && !tab->priv->batch_saving)
 	{
 		show_saving_info_bar (tab);
 	}
@@ -2200,6 +2661,8 @@ save_cb (GtkSourceFileSaver *saver,
 
 	gtk_source_file_saver_save_finish (saver, result, &error);
 
+	end_span (&tab->priv->save_span, "tab-save", location);
+
 	if (error != NULL)
 	{
 		gedit_debug_message (DEBUG_TAB, "File saving error: %s", error->message);
@@ -2211,6 +2674,9 @@ save_cb (GtkSourceFileSaver *saver,
 		tab->priv->timer = NULL;
 	}
 
+	/* If the user retries from the error info bar, the tab is on its own. */
+	tab->priv->batch_saving = FALSE;
+
 	set_info_bar (tab, NULL, GTK_RESPONSE_NONE);
 
 	if (error != NULL)
@@ -2334,6 +2800,8 @@ save (GeditTab *tab)
 
 	data = g_task_get_task_data (tab->priv->task_saver);
 
+	tab->priv->save_span = gedit_debug_span_begin (GEDIT_DEBUG_TAB);
+
 	gtk_source_file_saver_save_async (data->saver,
 					  G_PRIORITY_DEFAULT,
 					  g_task_get_cancellable (tab->priv->task_saver),
@@ -2436,6 +2904,19 @@ _gedit_tab_save_finish (GeditTab     *tab,
 	return success;
 }
 
+/* When several tabs are saved together, the caller shows a single aggregated
+ * progress, so the per-tab progress info bar is not displayed. Errors are still
+ * shown in the tab since they need the user's intervention.
+ */
+void
+_gedit_tab_set_batch_saving (GeditTab *tab,
+			     gboolean  batch_saving)
+{
+	g_return_if_fail (GEDIT_IS_TAB (tab));
+
+	tab->priv->batch_saving = batch_saving != FALSE;
+}
+
 static void
 auto_save_finished_cb (GeditTab     *tab,
 		       GAsyncResult *result,
@@ -144,6 +144,9 @@ void		 _gedit_tab_save_async		(GeditTab            *tab,
 gboolean	 _gedit_tab_save_finish		(GeditTab            *tab,
 						 GAsyncResult        *result);
 
+void		 _gedit_tab_set_batch_saving	(GeditTab            *tab,
+						 gboolean             batch_saving);
+
 void		 _gedit_tab_save_as_async	(GeditTab                 *tab,
 						 GFile                    *location,
 						 const GtkSourceEncoding  *encoding,
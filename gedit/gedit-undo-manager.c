@@ -0,0 +1,1465 @@
+/*
+ * gedit-undo-manager.c
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-undo-manager.h"
+
+#include <string.h>
+
+#include "gedit-debug.h"
+
+/* The undo history of a document, with a memory budget.
+ *
+ * The default undo manager of GtkSourceView keeps a copy of all the inserted
+ * and deleted text, so a few replace-all or sort operations on a big file use
+ * gigabytes. Here the texts bigger than COMPRESS_THRESHOLD are compressed.
+ * When the history uses more than the "max-memory" budget, the compressed
+ * texts are moved to a temporary file, from which they are read back when the
+ * action is undone or redone. If it is still not enough, the oldest actions
+ * are forgotten.
+ */
+
+/* Texts smaller than that are kept as they are, in bytes */
+#define COMPRESS_THRESHOLD (64 * 1024)
+
+/* Size of the temporary file beyond which the oldest actions are forgotten */
+#define MAX_DISK_USAGE ((guint64) 2 * 1024 * 1024 * 1024)
+
+/* The temporary file is compacted when more than this part of it is free */
+#define MAX_SPILL_WASTE_RATIO 2
+
+#define CONVERT_CHUNK_SIZE (64 * 1024)
+
+typedef enum
+{
+	TEXT_PLAIN,
+	TEXT_COMPRESSED,
+	TEXT_SPILLED
+} TextStorage;
+
+typedef struct
+{
+	TextStorage storage;
+
+	/* Length of the uncompressed text, in bytes */
+	gsize length;
+
+	gchar *plain;
+	GBytes *compressed;
+
+	/* Position of the compressed text in the temporary file */
+	goffset spill_offset;
+	gsize spill_size;
+} UndoText;
+
+typedef enum
+{
+	ACTION_INSERT,
+	ACTION_DELETE
+} ActionType;
+
+typedef struct
+{
+	ActionType type;
+
+	/* Character offsets of the text in the buffer */
+	gint start;
+	gint end;
+
+	UndoText text;
+
+	/* Whether the deleted text was selected */
+	guint selected : 1;
+} Action;
+
+typedef struct
+{
+	/* Action, in the order they were done */
+	GQueue actions;
+} ActionGroup;
+
+struct _GeditUndoManagerPrivate
+{
+	GtkTextBuffer *buffer;
+
+	/* ActionGroup, the newest at the tail */
+	GQueue undo_stack;
+
+	/* ActionGroup, the next one to redo at the head */
+	GQueue redo_stack;
+
+	/* The group of the current user action, NULL until its first change */
+	ActionGroup *user_action_group;
+
+	/* The last group of the undo stack when the document was saved, NULL
+	 * if the undo stack was empty. Only valid if has_saved_location.
+	 */
+	ActionGroup *saved_location;
+
+	GFile *spill_file;
+	GFileIOStream *spill_stream;
+	goffset spill_end;
+
+	guint64 memory_usage;
+	guint64 disk_usage;
+
+	/* Number of texts which can be moved to the temporary file */
+	guint n_compressed;
+
+	gint max_undo_levels;
+	guint max_memory;
+
+	gint not_undoable_level;
+
+	guint in_user_action : 1;
+	guint in_undo_redo : 1;
+	guint has_saved_location : 1;
+	guint can_undo : 1;
+	guint can_redo : 1;
+};
+
+enum
+{
+	PROP_0,
+	PROP_MAX_MEMORY
+};
+
+static void gedit_undo_manager_iface_init (GtkSourceUndoManagerIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (GeditUndoManager,
+			 gedit_undo_manager,
+			 G_TYPE_OBJECT,
+			 G_ADD_PRIVATE (GeditUndoManager)
+			 G_IMPLEMENT_INTERFACE (GTK_SOURCE_TYPE_UNDO_MANAGER,
+						gedit_undo_manager_iface_init))
+
+static GByteArray *
+convert_data (GConverter  *converter,
+	      const gchar *data,
+	      gsize        length,
+	      GError     **error)
+{
+	GByteArray *out;
+	gsize in_pos = 0;
+	GConverterResult result;
+
+	out = g_byte_array_new ();
+
+	do
+	{
+		gsize old_length = out->len;
+		gsize bytes_read = 0;
+		gsize bytes_written = 0;
+
+		g_byte_array_set_size (out, old_length + CONVERT_CHUNK_SIZE);
+
+		result = g_converter_convert (converter,
+					      data + in_pos,
+					      length - in_pos,
+					      out->data + old_length,
+					      CONVERT_CHUNK_SIZE,
+					      G_CONVERTER_INPUT_AT_END,
+					      &bytes_read,
+					      &bytes_written,
+					      error);
+
+		g_byte_array_set_size (out, old_length + bytes_written);
+		in_pos += bytes_read;
+	}
+	while (result == G_CONVERTER_CONVERTED);
+
+	if (result == G_CONVERTER_ERROR)
+	{
+		g_byte_array_unref (out);
+		return NULL;
+	}
+
+	return out;
+}
+
+static gsize
+text_get_memory (UndoText *text)
+{
+	switch (text->storage)
+	{
+		case TEXT_PLAIN:
+			return text->length;
+		case TEXT_COMPRESSED:
+			return g_bytes_get_size (text->compressed);
+		default:
+			return 0;
+	}
+}
+
+static void
+text_init (UndoText    *text,
+	   const gchar *str,
+	   gsize        length)
+{
+	GConverter *compressor;
+	GByteArray *compressed = NULL;
+	GError *error = NULL;
+
+	text->length = length;
+
+	if (length >= COMPRESS_THRESHOLD)
+	{
+		/* The fastest level, the user is waiting for the operation
+		 * that is recorded.
+		 */
+		compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, 1));
+		compressed = convert_data (compressor, str, length, &error);
+		g_object_unref (compressor);
+
+		if (error != NULL)
+		{
+			g_warning ("Cannot compress the undo text: %s", error->message);
+			g_error_free (error);
+		}
+	}
+
+	if (compressed != NULL)
+	{
+		text->storage = TEXT_COMPRESSED;
+		text->compressed = g_byte_array_free_to_bytes (compressed);
+	}
+	else
+	{
+		text->storage = TEXT_PLAIN;
+		text->plain = g_strndup (str, length);
+	}
+}
+
+static GBytes *
+read_spilled_text (GeditUndoManager *manager,
+		   UndoText         *text,
+		   GError          **error)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	GInputStream *input;
+	gchar *data;
+	gsize n_read = 0;
+
+	if (!g_seekable_seek (G_SEEKABLE (priv->spill_stream),
+			      text->spill_offset,
+			      G_SEEK_SET,
+			      NULL,
+			      error))
+	{
+		return NULL;
+	}
+
+	input = g_io_stream_get_input_stream (G_IO_STREAM (priv->spill_stream));
+	data = g_malloc (text->spill_size);
+
+	if (!g_input_stream_read_all (input, data, text->spill_size, &n_read, NULL, error))
+	{
+		g_free (data);
+		return NULL;
+	}
+
+	return g_bytes_new_take (data, n_read);
+}
+
+/* Returns a nul-terminated copy of the text, or NULL on error. */
+static gchar *
+text_get (GeditUndoManager *manager,
+	  UndoText         *text)
+{
+	GBytes *compressed;
+	GConverter *decompressor;
+	GByteArray *plain;
+	GError *error = NULL;
+
+	if (text->storage == TEXT_PLAIN)
+	{
+		return g_strndup (text->plain, text->length);
+	}
+
+	if (text->storage == TEXT_COMPRESSED)
+	{
+		compressed = g_bytes_ref (text->compressed);
+	}
+	else
+	{
+		compressed = read_spilled_text (manager, text, &error);
+
+		if (compressed == NULL)
+		{
+			g_warning ("Cannot read the undo text: %s", error->message);
+			g_error_free (error);
+			return NULL;
+		}
+	}
+
+	decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+	plain = convert_data (decompressor,
+			      g_bytes_get_data (compressed, NULL),
+			      g_bytes_get_size (compressed),
+			      &error);
+	g_object_unref (decompressor);
+	g_bytes_unref (compressed);
+
+	if (plain == NULL)
+	{
+		g_warning ("Cannot uncompress the undo text: %s", error->message);
+		g_error_free (error);
+		return NULL;
+	}
+
+	g_byte_array_append (plain, (const guint8 *) "", 1);
+
+	return (gchar *) g_byte_array_free (plain, FALSE);
+}
+
+static gboolean
+ensure_spill_stream (GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	GError *error = NULL;
+
+	if (priv->spill_stream != NULL)
+	{
+		return TRUE;
+	}
+
+	priv->spill_file = g_file_new_tmp ("gedit-undo-XXXXXX", &priv->spill_stream, &error);
+
+	if (priv->spill_file == NULL)
+	{
+		g_warning ("Cannot create the undo file: %s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	/* The file stays readable until the stream is closed, where possible,
+	 * so that it is not left behind after a crash.
+	 */
+	if (g_file_delete (priv->spill_file, NULL, NULL))
+	{
+		g_clear_object (&priv->spill_file);
+	}
+
+	priv->spill_end = 0;
+
+	return TRUE;
+}
+
+static gboolean
+write_spilled_data (GeditUndoManager *manager,
+		    goffset           offset,
+		    GBytes           *data,
+		    GError          **error)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	GOutputStream *output;
+
+	output = g_io_stream_get_output_stream (G_IO_STREAM (priv->spill_stream));
+
+	return g_seekable_seek (G_SEEKABLE (priv->spill_stream),
+				offset,
+				G_SEEK_SET,
+				NULL,
+				error) &&
+	       g_output_stream_write_all (output,
+					  g_bytes_get_data (data, NULL),
+					  g_bytes_get_size (data),
+					  NULL,
+					  NULL,
+					  error);
+}
+
+static void
+collect_spilled_texts (ActionGroup *group,
+		       GPtrArray   *texts)
+{
+	GList *a;
+
+	for (a = group->actions.head; a != NULL; a = a->next)
+	{
+		Action *action = a->data;
+
+		if (action->text.storage == TEXT_SPILLED)
+		{
+			g_ptr_array_add (texts, &action->text);
+		}
+	}
+}
+
+static gint
+compare_spill_offsets (gconstpointer a,
+		       gconstpointer b)
+{
+	const UndoText *text_a = *(UndoText * const *) a;
+	const UndoText *text_b = *(UndoText * const *) b;
+
+	if (text_a->spill_offset < text_b->spill_offset)
+		return -1;
+
+	return text_a->spill_offset > text_b->spill_offset ? 1 : 0;
+}
+
+/* Moves the spilled texts to the start of the temporary file, over the space
+ * of the texts already forgotten, and truncates the file.
+ */
+static void
+compact_spill_file (GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	GPtrArray *texts;
+	goffset end = 0;
+	guint i;
+	GError *error = NULL;
+
+	if (priv->spill_stream == NULL ||
+	    (goffset) priv->disk_usage == priv->spill_end)
+	{
+		return;
+	}
+
+	texts = g_ptr_array_new ();
+
+	g_queue_foreach (&priv->undo_stack, (GFunc) collect_spilled_texts, texts);
+	g_queue_foreach (&priv->redo_stack, (GFunc) collect_spilled_texts, texts);
+
+	if (priv->user_action_group != NULL)
+	{
+		collect_spilled_texts (priv->user_action_group, texts);
+	}
+
+	g_ptr_array_sort (texts, compare_spill_offsets);
+
+	for (i = 0; i < texts->len; i++)
+	{
+		UndoText *text = g_ptr_array_index (texts, i);
+
+		if (text->spill_offset != end)
+		{
+			GBytes *data;
+
+			/* The text is moved down, so it is read before being
+			 * overwritten.
+			 */
+			data = read_spilled_text (manager, text, &error);
+
+			if (data == NULL ||
+			    !write_spilled_data (manager, end, data, &error))
+			{
+				g_warning ("Cannot compact the undo file: %s", error->message);
+				g_error_free (error);
+
+				if (data != NULL)
+				{
+					g_bytes_unref (data);
+				}
+
+				g_ptr_array_free (texts, TRUE);
+				return;
+			}
+
+			g_bytes_unref (data);
+			text->spill_offset = end;
+		}
+
+		end += text->spill_size;
+	}
+
+	g_ptr_array_free (texts, TRUE);
+
+	gedit_debug_message (DEBUG_DOCUMENT,
+			     "Undo file compacted from %" G_GOFFSET_FORMAT
+			     " to %" G_GOFFSET_FORMAT " bytes",
+			     priv->spill_end,
+			     end);
+
+	priv->spill_end = end;
+	g_seekable_truncate (G_SEEKABLE (priv->spill_stream), end, NULL, NULL);
+}
+
+static gboolean
+text_spill (GeditUndoManager *manager,
+	    UndoText         *text)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	gsize size;
+	GError *error = NULL;
+
+	g_return_val_if_fail (text->storage == TEXT_COMPRESSED, FALSE);
+
+	if (!ensure_spill_stream (manager))
+	{
+		return FALSE;
+	}
+
+	size = g_bytes_get_size (text->compressed);
+
+	/* The size of the file is bounded, not only the size of the texts
+	 * still in the history.
+	 */
+	if ((guint64) priv->spill_end + size > MAX_DISK_USAGE)
+	{
+		compact_spill_file (manager);
+
+		if ((guint64) priv->spill_end + size > MAX_DISK_USAGE)
+		{
+			return FALSE;
+		}
+	}
+
+	if (!write_spilled_data (manager, priv->spill_end, text->compressed, &error))
+	{
+		g_warning ("Cannot write the undo file: %s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	text->storage = TEXT_SPILLED;
+	text->spill_offset = priv->spill_end;
+	text->spill_size = size;
+	g_bytes_unref (text->compressed);
+	text->compressed = NULL;
+
+	priv->spill_end += size;
+	priv->memory_usage -= size;
+	priv->disk_usage += size;
+	priv->n_compressed--;
+
+	return TRUE;
+}
+
+static void
+text_clear (GeditUndoManager *manager,
+	    UndoText         *text)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+
+	priv->memory_usage -= text_get_memory (text);
+
+	if (text->storage == TEXT_COMPRESSED)
+	{
+		priv->n_compressed--;
+	}
+	else if (text->storage == TEXT_SPILLED)
+	{
+		priv->disk_usage -= text->spill_size;
+
+		/* The space is reclaimed once nothing is left in the file. */
+		if (priv->disk_usage == 0 && priv->spill_stream != NULL)
+		{
+			g_seekable_truncate (G_SEEKABLE (priv->spill_stream), 0, NULL, NULL);
+			priv->spill_end = 0;
+		}
+	}
+
+	g_free (text->plain);
+	text->plain = NULL;
+
+	if (text->compressed != NULL)
+	{
+		g_bytes_unref (text->compressed);
+		text->compressed = NULL;
+	}
+}
+
+static Action *
+action_new (GeditUndoManager *manager,
+	    ActionType        type,
+	    gint              start,
+	    gint              end,
+	    const gchar      *text,
+	    gsize             length)
+{
+	Action *action;
+
+	action = g_slice_new0 (Action);
+	action->type = type;
+	action->start = start;
+	action->end = end;
+
+	text_init (&action->text, text, length);
+
+	manager->priv->memory_usage += sizeof (Action) + text_get_memory (&action->text);
+
+	if (action->text.storage == TEXT_COMPRESSED)
+	{
+		manager->priv->n_compressed++;
+	}
+
+	return action;
+}
+
+static void
+action_free (GeditUndoManager *manager,
+	     Action           *action)
+{
+	manager->priv->memory_usage -= sizeof (Action);
+
+	text_clear (manager, &action->text);
+	g_slice_free (Action, action);
+}
+
+static void
+group_free (GeditUndoManager *manager,
+	    ActionGroup      *group)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	Action *action;
+
+	if (priv->has_saved_location && priv->saved_location == group)
+	{
+		priv->has_saved_location = FALSE;
+	}
+
+	while ((action = g_queue_pop_head (&group->actions)) != NULL)
+	{
+		action_free (manager, action);
+	}
+
+	g_slice_free (ActionGroup, group);
+}
+
+static void
+update_can_undo_redo (GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	gboolean can_undo;
+	gboolean can_redo;
+
+	can_undo = !g_queue_is_empty (&priv->undo_stack);
+	can_redo = !g_queue_is_empty (&priv->redo_stack);
+
+	if (priv->can_undo != can_undo)
+	{
+		priv->can_undo = can_undo;
+		gtk_source_undo_manager_can_undo_changed (GTK_SOURCE_UNDO_MANAGER (manager));
+	}
+
+	if (priv->can_redo != can_redo)
+	{
+		priv->can_redo = can_redo;
+		gtk_source_undo_manager_can_redo_changed (GTK_SOURCE_UNDO_MANAGER (manager));
+	}
+}
+
+static void
+clear_redo_stack (GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	ActionGroup *group;
+
+	while ((group = g_queue_pop_head (&priv->redo_stack)) != NULL)
+	{
+		group_free (manager, group);
+	}
+}
+
+static void
+clear_history (GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	ActionGroup *group;
+
+	clear_redo_stack (manager);
+
+	while ((group = g_queue_pop_head (&priv->undo_stack)) != NULL)
+	{
+		group_free (manager, group);
+	}
+
+	if (priv->user_action_group != NULL)
+	{
+		group_free (manager, priv->user_action_group);
+		priv->user_action_group = NULL;
+	}
+
+	priv->has_saved_location = FALSE;
+
+	g_clear_object (&priv->spill_stream);
+	g_clear_object (&priv->spill_file);
+}
+
+/* Forgets the oldest undo group. The history is kept consistent: the saved
+ * location can still be reached if it was after the group.
+ */
+static void
+drop_oldest_group (GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	ActionGroup *group;
+
+	group = g_queue_pop_head (&priv->undo_stack);
+
+	if (priv->has_saved_location)
+	{
+		if (priv->saved_location == NULL)
+		{
+			priv->has_saved_location = FALSE;
+		}
+		else if (priv->saved_location == group)
+		{
+			priv->saved_location = NULL;
+		}
+	}
+
+	group_free (manager, group);
+}
+
+/* Returns FALSE when the spilling must stop. */
+static gboolean
+spill_group (GeditUndoManager *manager,
+	     ActionGroup      *group,
+	     guint64           max_memory)
+{
+	GList *a;
+
+	for (a = group->actions.head; a != NULL; a = a->next)
+	{
+		Action *action = a->data;
+
+		if (manager->priv->memory_usage <= max_memory ||
+		    manager->priv->n_compressed == 0)
+		{
+			return FALSE;
+		}
+
+		if (action->text.storage == TEXT_COMPRESSED &&
+		    !text_spill (manager, &action->text))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+spill_groups (GeditUndoManager *manager,
+	      GQueue           *groups,
+	      guint64           max_memory)
+{
+	GList *g;
+
+	for (g = groups->head; g != NULL; g = g->next)
+	{
+		if (!spill_group (manager, g->data, max_memory))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+enforce_limits (GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	guint64 max_memory;
+	guint min_groups;
+
+	if (priv->max_undo_levels >= 0)
+	{
+		while (g_queue_get_length (&priv->undo_stack) > (guint) priv->max_undo_levels)
+		{
+			drop_oldest_group (manager);
+		}
+	}
+
+	max_memory = (guint64) priv->max_memory * 1024 * 1024;
+
+	if (priv->memory_usage > max_memory)
+	{
+		/* The oldest texts are the least likely to be needed. */
+		if (spill_groups (manager, &priv->undo_stack, max_memory) &&
+		    (priv->user_action_group == NULL ||
+		     spill_group (manager, priv->user_action_group, max_memory)))
+		{
+			spill_groups (manager, &priv->redo_stack, max_memory);
+		}
+	}
+
+	/* The last action can always be undone, the user action being
+	 * recorded counts as the last one.
+	 */
+	min_groups = priv->user_action_group != NULL ? 0 : 1;
+
+	while ((priv->memory_usage > max_memory || priv->disk_usage > MAX_DISK_USAGE) &&
+	       g_queue_get_length (&priv->undo_stack) > min_groups)
+	{
+		drop_oldest_group (manager);
+	}
+
+	if ((guint64) priv->spill_end > MAX_SPILL_WASTE_RATIO * priv->disk_usage)
+	{
+		compact_spill_file (manager);
+	}
+
+	gedit_debug_message (DEBUG_DOCUMENT,
+			     "Undo history: %u groups, %" G_GUINT64_FORMAT " bytes in memory, %"
+			     G_GUINT64_FORMAT " bytes on disk",
+			     g_queue_get_length (&priv->undo_stack),
+			     priv->memory_usage,
+			     priv->disk_usage);
+}
+
+/* Typing or erasing several characters is undone at once, by words. */
+static gboolean
+try_merge (GeditUndoManager *manager,
+	   ActionGroup      *previous,
+	   ActionGroup      *group)
+{
+	Action *prev;
+	Action *action;
+	const gchar *prev_last;
+	gchar *text;
+
+	if (g_queue_get_length (&previous->actions) != 1 ||
+	    g_queue_get_length (&group->actions) != 1)
+	{
+		return FALSE;
+	}
+
+	/* Keep the location where the document was saved. */
+	if (manager->priv->has_saved_location &&
+	    manager->priv->saved_location == previous)
+	{
+		return FALSE;
+	}
+
+	prev = g_queue_peek_head (&previous->actions);
+	action = g_queue_peek_head (&group->actions);
+
+	if (prev->type != action->type ||
+	    prev->text.storage != TEXT_PLAIN ||
+	    action->text.storage != TEXT_PLAIN ||
+	    action->end - action->start != 1 ||
+	    prev->selected ||
+	    action->selected)
+	{
+		return FALSE;
+	}
+
+	/* A space after a word starts a new group. */
+	prev_last = g_utf8_find_prev_char (prev->text.plain,
+					   prev->text.plain + prev->text.length);
+
+	if (g_unichar_isspace (g_utf8_get_char (action->text.plain)) &&
+	    !g_unichar_isspace (g_utf8_get_char (prev_last)))
+	{
+		return FALSE;
+	}
+
+	if (action->type == ACTION_INSERT && action->start == prev->end)
+	{
+		text = g_strconcat (prev->text.plain, action->text.plain, NULL);
+		prev->end = action->end;
+	}
+	else if (action->type == ACTION_DELETE && action->end == prev->start)
+	{
+		/* Backspace */
+		text = g_strconcat (action->text.plain, prev->text.plain, NULL);
+		prev->start = action->start;
+	}
+	else if (action->type == ACTION_DELETE && action->start == prev->start)
+	{
+		/* Delete */
+		text = g_strconcat (prev->text.plain, action->text.plain, NULL);
+		prev->end += 1;
+	}
+	else
+	{
+		return FALSE;
+	}
+
+	manager->priv->memory_usage += action->text.length;
+
+	g_free (prev->text.plain);
+	prev->text.plain = text;
+	prev->text.length += action->text.length;
+
+	group_free (manager, group);
+
+	return TRUE;
+}
+
+static void
+finish_group (GeditUndoManager *manager,
+	      ActionGroup      *group)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	ActionGroup *previous;
+
+	previous = g_queue_peek_tail (&priv->undo_stack);
+
+	if (previous == NULL || !try_merge (manager, previous, group))
+	{
+		g_queue_push_tail (&priv->undo_stack, group);
+	}
+
+	enforce_limits (manager);
+	update_can_undo_redo (manager);
+}
+
+static void
+add_action (GeditUndoManager *manager,
+	    Action           *action)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	ActionGroup *group;
+
+	clear_redo_stack (manager);
+
+	if (priv->in_user_action)
+	{
+		if (priv->user_action_group == NULL)
+		{
+			priv->user_action_group = g_slice_new0 (ActionGroup);
+		}
+
+		g_queue_push_tail (&priv->user_action_group->actions, action);
+
+		/* A user action like a replace all can make many changes
+		 * before it ends.
+		 */
+		enforce_limits (manager);
+		update_can_undo_redo (manager);
+		return;
+	}
+
+	group = g_slice_new0 (ActionGroup);
+	g_queue_push_tail (&group->actions, action);
+
+	finish_group (manager, group);
+}
+
+static gboolean
+is_recording (GeditUndoManager *manager)
+{
+	return manager->priv->not_undoable_level == 0 &&
+	       !manager->priv->in_undo_redo;
+}
+
+static void
+insert_text_cb (GtkTextBuffer    *buffer,
+		GtkTextIter      *location,
+		const gchar      *text,
+		gint              length,
+		GeditUndoManager *manager)
+{
+	gint start;
+	Action *action;
+
+	if (!is_recording (manager) || length == 0)
+	{
+		return;
+	}
+
+	start = gtk_text_iter_get_offset (location);
+
+	action = action_new (manager,
+			     ACTION_INSERT,
+			     start,
+			     start + g_utf8_strlen (text, length),
+			     text,
+			     length);
+
+	add_action (manager, action);
+}
+
+static void
+delete_range_cb (GtkTextBuffer    *buffer,
+		 GtkTextIter      *start,
+		 GtkTextIter      *end,
+		 GeditUndoManager *manager)
+{
+	GtkTextIter sel_start;
+	GtkTextIter sel_end;
+	gchar *text;
+	Action *action;
+
+	if (!is_recording (manager) || gtk_text_iter_equal (start, end))
+	{
+		return;
+	}
+
+	text = gtk_text_buffer_get_slice (buffer, start, end, TRUE);
+
+	action = action_new (manager,
+			     ACTION_DELETE,
+			     gtk_text_iter_get_offset (start),
+			     gtk_text_iter_get_offset (end),
+			     text,
+			     strlen (text));
+
+	if (gtk_text_buffer_get_selection_bounds (buffer, &sel_start, &sel_end))
+	{
+		action->selected = gtk_text_iter_equal (start, &sel_start) &&
+				   gtk_text_iter_equal (end, &sel_end);
+	}
+
+	g_free (text);
+
+	add_action (manager, action);
+}
+
+static void
+begin_user_action_cb (GtkTextBuffer    *buffer,
+		      GeditUndoManager *manager)
+{
+	if (!is_recording (manager))
+	{
+		return;
+	}
+
+	manager->priv->in_user_action = TRUE;
+	manager->priv->user_action_group = NULL;
+}
+
+static void
+end_user_action_cb (GtkTextBuffer    *buffer,
+		    GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	ActionGroup *group;
+
+	if (!priv->in_user_action)
+	{
+		return;
+	}
+
+	priv->in_user_action = FALSE;
+
+	group = priv->user_action_group;
+	priv->user_action_group = NULL;
+
+	if (group != NULL)
+	{
+		finish_group (manager, group);
+	}
+}
+
+static void
+modified_changed_cb (GtkTextBuffer    *buffer,
+		     GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+
+	if (priv->in_undo_redo || gtk_text_buffer_get_modified (buffer))
+	{
+		return;
+	}
+
+	priv->has_saved_location = TRUE;
+	priv->saved_location = g_queue_peek_tail (&priv->undo_stack);
+}
+
+static void
+max_undo_levels_notify_cb (GtkSourceBuffer  *buffer,
+			   GParamSpec       *pspec,
+			   GeditUndoManager *manager)
+{
+	manager->priv->max_undo_levels = gtk_source_buffer_get_max_undo_levels (buffer);
+
+	if (manager->priv->max_undo_levels == 0)
+	{
+		clear_history (manager);
+	}
+
+	enforce_limits (manager);
+	update_can_undo_redo (manager);
+}
+
+static void
+insert_action_text (GeditUndoManager *manager,
+		    Action           *action)
+{
+	GtkTextBuffer *buffer = manager->priv->buffer;
+	GtkTextIter iter;
+	gchar *text;
+
+	text = text_get (manager, &action->text);
+
+	if (text == NULL)
+	{
+		return;
+	}
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &iter, action->start);
+	gtk_text_buffer_insert (buffer, &iter, text, action->text.length);
+
+	g_free (text);
+}
+
+static void
+delete_action_text (GeditUndoManager *manager,
+		    Action           *action)
+{
+	GtkTextBuffer *buffer = manager->priv->buffer;
+	GtkTextIter start;
+	GtkTextIter end;
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, action->start);
+	gtk_text_buffer_get_iter_at_offset (buffer, &end, action->end);
+	gtk_text_buffer_delete (buffer, &start, &end);
+}
+
+static void
+place_cursor (GtkTextBuffer *buffer,
+	      gint           offset,
+	      gint           bound_offset)
+{
+	GtkTextIter iter;
+	GtkTextIter bound;
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &iter, offset);
+	gtk_text_buffer_get_iter_at_offset (buffer, &bound, bound_offset);
+	gtk_text_buffer_select_range (buffer, &iter, &bound);
+}
+
+static void
+restore_modified (GeditUndoManager *manager)
+{
+	GeditUndoManagerPrivate *priv = manager->priv;
+	gboolean saved;
+
+	saved = priv->has_saved_location &&
+		priv->saved_location == g_queue_peek_tail (&priv->undo_stack);
+
+	gtk_text_buffer_set_modified (priv->buffer, !saved);
+}
+
+static gboolean
+gedit_undo_manager_can_undo_impl (GtkSourceUndoManager *undo_manager)
+{
+	return GEDIT_UNDO_MANAGER (undo_manager)->priv->can_undo;
+}
+
+static gboolean
+gedit_undo_manager_can_redo_impl (GtkSourceUndoManager *undo_manager)
+{
+	return GEDIT_UNDO_MANAGER (undo_manager)->priv->can_redo;
+}
+
+static void
+gedit_undo_manager_undo_impl (GtkSourceUndoManager *undo_manager)
+{
+	GeditUndoManager *manager = GEDIT_UNDO_MANAGER (undo_manager);
+	GeditUndoManagerPrivate *priv = manager->priv;
+	ActionGroup *group;
+	GList *l;
+
+	group = g_queue_pop_tail (&priv->undo_stack);
+	g_return_if_fail (group != NULL);
+
+	priv->in_undo_redo = TRUE;
+	gtk_text_buffer_begin_user_action (priv->buffer);
+
+	for (l = group->actions.tail; l != NULL; l = l->prev)
+	{
+		Action *action = l->data;
+
+		if (action->type == ACTION_INSERT)
+		{
+			delete_action_text (manager, action);
+			place_cursor (priv->buffer, action->start, action->start);
+		}
+		else
+		{
+			insert_action_text (manager, action);
+
+			if (action->selected)
+			{
+				place_cursor (priv->buffer, action->end, action->start);
+			}
+			else
+			{
+				place_cursor (priv->buffer, action->end, action->end);
+			}
+		}
+	}
+
+	gtk_text_buffer_end_user_action (priv->buffer);
+
+	g_queue_push_head (&priv->redo_stack, group);
+
+	restore_modified (manager);
+	priv->in_undo_redo = FALSE;
+
+	update_can_undo_redo (manager);
+}
+
+static void
+gedit_undo_manager_redo_impl (GtkSourceUndoManager *undo_manager)
+{
+	GeditUndoManager *manager = GEDIT_UNDO_MANAGER (undo_manager);
+	GeditUndoManagerPrivate *priv = manager->priv;
+	ActionGroup *group;
+	GList *l;
+
+	group = g_queue_pop_head (&priv->redo_stack);
+	g_return_if_fail (group != NULL);
+
+	priv->in_undo_redo = TRUE;
+	gtk_text_buffer_begin_user_action (priv->buffer);
+
+	for (l = group->actions.head; l != NULL; l = l->next)
+	{
+		Action *action = l->data;
+
+		if (action->type == ACTION_INSERT)
+		{
+			insert_action_text (manager, action);
+			place_cursor (priv->buffer, action->end, action->end);
+		}
+		else
+		{
+			delete_action_text (manager, action);
+			place_cursor (priv->buffer, action->start, action->start);
+		}
+	}
+
+	gtk_text_buffer_end_user_action (priv->buffer);
+
+	g_queue_push_tail (&priv->undo_stack, group);
+
+	restore_modified (manager);
+	priv->in_undo_redo = FALSE;
+
+	update_can_undo_redo (manager);
+}
+
+static void
+gedit_undo_manager_begin_not_undoable_action_impl (GtkSourceUndoManager *undo_manager)
+{
+	GEDIT_UNDO_MANAGER (undo_manager)->priv->not_undoable_level++;
+}
+
+static void
+gedit_undo_manager_end_not_undoable_action_impl (GtkSourceUndoManager *undo_manager)
+{
+	GeditUndoManager *manager = GEDIT_UNDO_MANAGER (undo_manager);
+	GeditUndoManagerPrivate *priv = manager->priv;
+
+	g_return_if_fail (priv->not_undoable_level > 0);
+
+	priv->not_undoable_level--;
+
+	if (priv->not_undoable_level == 0)
+	{
+		clear_history (manager);
+
+		if (!gtk_text_buffer_get_modified (priv->buffer))
+		{
+			priv->has_saved_location = TRUE;
+			priv->saved_location = NULL;
+		}
+
+		update_can_undo_redo (manager);
+	}
+}
+
+static void
+gedit_undo_manager_dispose (GObject *object)
+{
+	GeditUndoManager *manager = GEDIT_UNDO_MANAGER (object);
+
+	if (manager->priv->buffer != NULL)
+	{
+		g_signal_handlers_disconnect_by_data (manager->priv->buffer, manager);
+		g_object_remove_weak_pointer (G_OBJECT (manager->priv->buffer),
+					      (gpointer *) &manager->priv->buffer);
+		manager->priv->buffer = NULL;
+	}
+
+	clear_history (manager);
+
+	G_OBJECT_CLASS (gedit_undo_manager_parent_class)->dispose (object);
+}
+
+static void
+gedit_undo_manager_set_property (GObject      *object,
+				 guint         prop_id,
+				 const GValue *value,
+				 GParamSpec   *pspec)
+{
+	GeditUndoManager *manager = GEDIT_UNDO_MANAGER (object);
+
+	switch (prop_id)
+	{
+		case PROP_MAX_MEMORY:
+			manager->priv->max_memory = g_value_get_uint (value);
+			enforce_limits (manager);
+			update_can_undo_redo (manager);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+gedit_undo_manager_get_property (GObject    *object,
+				 guint       prop_id,
+				 GValue     *value,
+				 GParamSpec *pspec)
+{
+	GeditUndoManager *manager = GEDIT_UNDO_MANAGER (object);
+
+	switch (prop_id)
+	{
+		case PROP_MAX_MEMORY:
+			g_value_set_uint (value, manager->priv->max_memory);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+gedit_undo_manager_class_init (GeditUndoManagerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gedit_undo_manager_dispose;
+	object_class->set_property = gedit_undo_manager_set_property;
+	object_class->get_property = gedit_undo_manager_get_property;
+
+	g_object_class_install_property (object_class, PROP_MAX_MEMORY,
+					 g_param_spec_uint ("max-memory",
+							    "Max Memory",
+							    "Memory used by the history before moving it to the disk, in megabytes",
+							    1,
+							    G_MAXUINT,
+							    64,
+							    G_PARAM_READWRITE |
+							    G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gedit_undo_manager_iface_init (GtkSourceUndoManagerIface *iface)
+{
+	iface->can_undo = gedit_undo_manager_can_undo_impl;
+	iface->can_redo = gedit_undo_manager_can_redo_impl;
+	iface->undo = gedit_undo_manager_undo_impl;
+	iface->redo = gedit_undo_manager_redo_impl;
+	iface->begin_not_undoable_action = gedit_undo_manager_begin_not_undoable_action_impl;
+	iface->end_not_undoable_action = gedit_undo_manager_end_not_undoable_action_impl;
+}
+
+static void
+gedit_undo_manager_init (GeditUndoManager *manager)
+{
+	manager->priv = gedit_undo_manager_get_instance_private (manager);
+
+	g_queue_init (&manager->priv->undo_stack);
+	g_queue_init (&manager->priv->redo_stack);
+
+	manager->priv->max_memory = 64;
+}
+
+/**
+ * gedit_undo_manager_new:
+ * @buffer: the buffer whose changes are recorded.
+ *
+ * The manager does not keep a reference on @buffer, it is meant to be set
+ * with gtk_source_buffer_set_undo_manager().
+ *
+ * Returns: a new #GeditUndoManager.
+ */
+GeditUndoManager *
+gedit_undo_manager_new (GtkSourceBuffer *buffer)
+{
+	GeditUndoManager *manager;
+
+	g_return_val_if_fail (GTK_SOURCE_IS_BUFFER (buffer), NULL);
+
+	manager = g_object_new (GEDIT_TYPE_UNDO_MANAGER, NULL);
+
+	manager->priv->buffer = GTK_TEXT_BUFFER (buffer);
+	g_object_add_weak_pointer (G_OBJECT (buffer),
+				   (gpointer *) &manager->priv->buffer);
+
+	manager->priv->max_undo_levels = gtk_source_buffer_get_max_undo_levels (buffer);
+	manager->priv->has_saved_location = !gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (buffer));
+
+	g_signal_connect (buffer,
+			  "insert-text",
+			  G_CALLBACK (insert_text_cb),
+			  manager);
+
+	g_signal_connect (buffer,
+			  "delete-range",
+			  G_CALLBACK (delete_range_cb),
+			  manager);
+
+	g_signal_connect (buffer,
+			  "begin-user-action",
+			  G_CALLBACK (begin_user_action_cb),
+			  manager);
+
+	g_signal_connect (buffer,
+			  "end-user-action",
+			  G_CALLBACK (end_user_action_cb),
+			  manager);
+
+	g_signal_connect (buffer,
+			  "modified-changed",
+			  G_CALLBACK (modified_changed_cb),
+			  manager);
+
+	g_signal_connect (buffer,
+			  "notify::max-undo-levels",
+			  G_CALLBACK (max_undo_levels_notify_cb),
+			  manager);
+
+	return manager;
+}
+
+/**
+ * gedit_undo_manager_get_usage:
+ * @manager: a #GeditUndoManager.
+ * @memory: (out) (allow-none): return location for the memory used by the
+ * history, in bytes.
+ * @disk: (out) (allow-none): return location for the size of the history moved
+ * to the temporary file, in bytes.
+ */
+void
+gedit_undo_manager_get_usage (GeditUndoManager *manager,
+			      guint64          *memory,
+			      guint64          *disk)
+{
+	g_return_if_fail (GEDIT_IS_UNDO_MANAGER (manager));
+
+	if (memory != NULL)
+	{
+		*memory = manager->priv->memory_usage;
+	}
+
+	if (disk != NULL)
+	{
+		*disk = manager->priv->disk_usage;
+	}
+}
+
+/* ex:set ts=8 noet: */
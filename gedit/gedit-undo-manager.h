@@ -0,0 +1,61 @@
+/*
+ * gedit-undo-manager.h
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_UNDO_MANAGER_H__
+#define __GEDIT_UNDO_MANAGER_H__
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_UNDO_MANAGER			(gedit_undo_manager_get_type ())
+#define GEDIT_UNDO_MANAGER(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_UNDO_MANAGER, GeditUndoManager))
+#define GEDIT_UNDO_MANAGER_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GEDIT_TYPE_UNDO_MANAGER, GeditUndoManagerClass))
+#define GEDIT_IS_UNDO_MANAGER(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_UNDO_MANAGER))
+#define GEDIT_IS_UNDO_MANAGER_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_UNDO_MANAGER))
+#define GEDIT_UNDO_MANAGER_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_UNDO_MANAGER, GeditUndoManagerClass))
+
+typedef struct _GeditUndoManager		GeditUndoManager;
+typedef struct _GeditUndoManagerClass		GeditUndoManagerClass;
+typedef struct _GeditUndoManagerPrivate		GeditUndoManagerPrivate;
+
+struct _GeditUndoManager
+{
+	GObject parent;
+
+	GeditUndoManagerPrivate *priv;
+};
+
+struct _GeditUndoManagerClass
+{
+	GObjectClass parent_class;
+};
+
+GType			 gedit_undo_manager_get_type		(void) G_GNUC_CONST;
+
+GeditUndoManager	*gedit_undo_manager_new			(GtkSourceBuffer  *buffer);
+
+void			 gedit_undo_manager_get_usage		(GeditUndoManager *manager,
+								 guint64          *memory,
+								 guint64          *disk);
+
+G_END_DECLS
+
+#endif /* __GEDIT_UNDO_MANAGER_H__ */
+
+/* ex:set ts=8 noet: */
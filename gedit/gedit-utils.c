@@ -1529,4 +1529,283 @@ _gedit_utils_encoding_list_to_strv (const GSList *enc_list)
 	return (gchar **)g_ptr_array_free (array, FALSE);
 }
 
+/*
+ * _gedit_utils_is_valid_utf8_prefix:
+ * @text: the beginning of a file content.
+ * @length: the length of @text, in bytes.
+ *
+ * Checks whether @text is valid UTF-8 text. An incomplete character at the end
+ * is accepted, since @text can be cut in the middle of a file. A nul byte is
+ * considered invalid, it is most probably UTF-16 or binary content.
+ *
+ * ASCII is skipped eight bytes at a time, so that mostly ASCII files are
+ * validated at memory speed.
+ *
+ * Returns: whether @text is valid UTF-8.
+ */
+gboolean
+_gedit_utils_is_valid_utf8_prefix (const gchar *text,
+				   gsize        length)
+{
+	const guint64 high_bits = G_GUINT64_CONSTANT (0x8080808080808080);
+	const guint64 low_bits = G_GUINT64_CONSTANT (0x0101010101010101);
+	const gchar *p = text;
+	const gchar *end = text + length;
+
+	while (p < end)
+	{
+		gunichar c;
+
+		while (end - p >= 8)
+		{
+			guint64 chunk;
+
+			memcpy (&chunk, p, 8);
+
+			/* Stop at a non-ASCII byte or at a nul byte. */
+			if ((chunk & high_bits) != 0 ||
+			    ((chunk - low_bits) & ~chunk & high_bits) != 0)
+			{
+				break;
+			}
+
+			p += 8;
+		}
+
+		if (p == end)
+		{
+			break;
+		}
+
+		if (*p == '\0')
+		{
+			return FALSE;
+		}
+
+		if ((guchar) *p < 0x80)
+		{
+			p++;
+			continue;
+		}
+
+		c = g_utf8_get_char_validated (p, end - p);
+
+		if (c == (gunichar) -2)
+		{
+			/* Truncated character at the end. */
+			return TRUE;
+		}
+
+		if (c == (gunichar) -1)
+		{
+			return FALSE;
+		}
+
+		p = g_utf8_next_char (p);
+	}
+
+	return TRUE;
+}
+
+/* Compiled regexes, shared by all the searches of the application. */
+#define REGEX_CACHE_SIZE 32
+
+typedef struct
+{
+	gchar *pattern;
+	GRegexCompileFlags compile_options;
+	GRegexMatchFlags match_options;
+} RegexKey;
+
+static GMutex regex_cache_mutex;
+static GHashTable *regex_cache = NULL;
+
+/* The keys, the most recently used first */
+static GQueue regex_cache_lru = G_QUEUE_INIT;
+
+static guint regex_cache_n_compiled = 0;
+static guint regex_cache_n_hits = 0;
+
+static guint
+regex_key_hash (gconstpointer key)
+{
+	const RegexKey *regex_key = key;
+
+	return g_str_hash (regex_key->pattern) ^
+	       (regex_key->compile_options * 31) ^
+	       regex_key->match_options;
+}
+
+static gboolean
+regex_key_equal (gconstpointer a,
+		 gconstpointer b)
+{
+	const RegexKey *key_a = a;
+	const RegexKey *key_b = b;
+
+	return key_a->compile_options == key_b->compile_options &&
+	       key_a->match_options == key_b->match_options &&
+	       strcmp (key_a->pattern, key_b->pattern) == 0;
+}
+
+static void
+regex_key_free (RegexKey *key)
+{
+	g_free (key->pattern);
+	g_slice_free (RegexKey, key);
+}
+
+/**
+ * gedit_utils_get_regex:
+ * @pattern: the regular expression.
+ * @compile_options: compile options for the regular expression.
+ * @match_options: match options for the regular expression.
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Gets a compiled regular expression, like g_regex_new(). The regular
+ * expressions are kept in a cache shared by the whole application, so that
+ * searching several times for the same pattern compiles it only once.
+ * %G_REGEX_OPTIMIZE is always added to @compile_options, so that the pattern
+ * is studied once when it is compiled. It only enables the PCRE JIT compiler
+ * with the PCRE2 based GLib 2.74 or later.
+ *
+ * Returns: (transfer full): a #GRegex, or %NULL if @pattern is not valid.
+ *
+ * Since: 3.16
+ */
+GRegex *
+gedit_utils_get_regex (const gchar         *pattern,
+		       GRegexCompileFlags   compile_options,
+		       GRegexMatchFlags     match_options,
+		       GError             **error)
+{
+	RegexKey lookup_key;
+	RegexKey *key;
+	GRegex *regex;
+
+	g_return_val_if_fail (pattern != NULL, NULL);
+
+	lookup_key.pattern = (gchar *) pattern;
+	lookup_key.compile_options = compile_options | G_REGEX_OPTIMIZE;
+	lookup_key.match_options = match_options;
+
+	g_mutex_lock (&regex_cache_mutex);
+
+	if (regex_cache == NULL)
+	{
+		regex_cache = g_hash_table_new_full (regex_key_hash,
+						     regex_key_equal,
+						     (GDestroyNotify) regex_key_free,
+						     (GDestroyNotify) g_regex_unref);
+	}
+
+	if (g_hash_table_lookup_extended (regex_cache,
+					  &lookup_key,
+					  (gpointer *) &key,
+					  (gpointer *) &regex))
+	{
+		GList *link = g_queue_find (&regex_cache_lru, key);
+
+		g_queue_unlink (&regex_cache_lru, link);
+		g_queue_push_head_link (&regex_cache_lru, link);
+
+		regex_cache_n_hits++;
+		g_mutex_unlock (&regex_cache_mutex);
+
+		return g_regex_ref (regex);
+	}
+
+	/* Don't hold the lock while compiling */
+	g_mutex_unlock (&regex_cache_mutex);
+
+	regex = g_regex_new (pattern,
+			     lookup_key.compile_options,
+			     match_options,
+			     error);
+
+	if (regex == NULL)
+	{
+		return NULL;
+	}
+
+	g_mutex_lock (&regex_cache_mutex);
+
+	regex_cache_n_compiled++;
+
+	/* Another thread can have compiled the same pattern meanwhile */
+	if (regex_cache != NULL &&
+	    !g_hash_table_contains (regex_cache, &lookup_key))
+	{
+		if (g_queue_get_length (&regex_cache_lru) >= REGEX_CACHE_SIZE)
+		{
+			RegexKey *oldest = g_queue_pop_tail (&regex_cache_lru);
+
+			g_hash_table_remove (regex_cache, oldest);
+		}
+
+		key = g_slice_new (RegexKey);
+		key->pattern = g_strdup (pattern);
+		key->compile_options = lookup_key.compile_options;
+		key->match_options = match_options;
+
+		g_hash_table_insert (regex_cache, key, g_regex_ref (regex));
+		g_queue_push_head (&regex_cache_lru, key);
+	}
+
+	g_mutex_unlock (&regex_cache_mutex);
+
+	return regex;
+}
+
+/**
+ * gedit_utils_get_regex_cache_stats:
+ * @n_compiled: (out) (allow-none): return location for the number of
+ *   regular expressions compiled by gedit_utils_get_regex().
+ * @n_hits: (out) (allow-none): return location for the number of
+ *   regular expressions found in the cache by gedit_utils_get_regex().
+ *
+ * Gets the statistics of the cache of gedit_utils_get_regex().
+ *
+ * Since: 3.16
+ */
+void
+gedit_utils_get_regex_cache_stats (guint *n_compiled,
+				   guint *n_hits)
+{
+	g_mutex_lock (&regex_cache_mutex);
+
+	if (n_compiled != NULL)
+	{
+		*n_compiled = regex_cache_n_compiled;
+	}
+
+	if (n_hits != NULL)
+	{
+		*n_hits = regex_cache_n_hits;
+	}
+
+	g_mutex_unlock (&regex_cache_mutex);
+}
+
+void
+_gedit_utils_regex_cache_shutdown (void)
+{
+	g_mutex_lock (&regex_cache_mutex);
+
+	gedit_debug_message (DEBUG_UTILS,
+			     "Regex cache: %u compiled, %u hits",
+			     regex_cache_n_compiled,
+			     regex_cache_n_hits);
+
+	if (regex_cache != NULL)
+	{
+		g_hash_table_destroy (regex_cache);
+		regex_cache = NULL;
+	}
+
+	g_queue_clear (&regex_cache_lru);
+
+	g_mutex_unlock (&regex_cache_mutex);
+}
+
 /* ex:set ts=8 noet: */
@@ -131,11 +131,24 @@ gchar           *gedit_utils_set_direct_save_filename	(GdkDragContext *context);
 
 const gchar     *gedit_utils_newline_type_to_string	(GtkSourceNewlineType newline_type);
 
+GRegex		*gedit_utils_get_regex			(const gchar        *pattern,
+							 GRegexCompileFlags  compile_options,
+							 GRegexMatchFlags    match_options,
+							 GError            **error);
+
+void		 gedit_utils_get_regex_cache_stats	(guint              *n_compiled,
+							 guint              *n_hits);
+
 /* Private */
 GSList		*_gedit_utils_encoding_strv_to_list	(const gchar * const *enc_str);
 
 gchar	       **_gedit_utils_encoding_list_to_strv	(const GSList *enc_list);
 
+gboolean	 _gedit_utils_is_valid_utf8_prefix	(const gchar *text,
+							 gsize        length);
+
+void		 _gedit_utils_regex_cache_shutdown	(void);
+
 G_END_DECLS
 
 #endif /* __GEDIT_UTILS_H__ */
@@ -31,6 +31,7 @@
 #include <gdk/gdkkeysyms.h>
 #include <glib/gi18n.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "gedit-window.h"
 #include "gedit-view-holder.h"
@@ -42,6 +43,12 @@
 
 #define SEARCH_POPUP_MARGIN 12
 
+/* In bigger buffers, the search text is updated only when the user stops
+ * typing, to not restart the scan of the whole buffer on each keystroke.
+ */
+#define SEARCH_DEBOUNCE_MIN_CHARS 100000
+#define SEARCH_DEBOUNCE_MAX_DELAY 300 /* in milliseconds */
+
 typedef enum
 {
 	GOTO_LINE,
@@ -76,6 +83,7 @@ struct _GeditViewFramePrivate
 	guint flush_timeout_id;
 	guint idle_update_entry_tag_id;
 	guint remove_entry_tag_timeout_id;
+	guint update_search_timeout_id;
 	gulong view_scroll_event_id;
 	gulong search_entry_focus_out_id;
 	gulong search_entry_changed_id;
@@ -96,6 +104,11 @@ struct _GeditViewFramePrivate
 	gchar *old_search_text;
 
 	gint window_state_changed_handler_id;
+
+	/* TRUE if the search text of search_settings is not the one of the
+	 * search entry, because the latter can't have any occurrences.
+	 */
+	guint search_text_outdated : 1;
 };
 
 enum
@@ -142,6 +155,12 @@ gedit_view_frame_dispose (GObject *object)
 		frame->priv->remove_entry_tag_timeout_id = 0;
 	}
 
+	if (frame->priv->update_search_timeout_id != 0)
+	{
+		g_source_remove (frame->priv->update_search_timeout_id);
+		frame->priv->update_search_timeout_id = 0;
+	}
+
 	if (buffer != NULL)
 	{
 		GtkSourceFile *file = gedit_document_get_file (GEDIT_DOCUMENT (buffer));
@@ -198,6 +217,9 @@ gedit_view_frame_get_property (GObject    *object,
 	}
 }
 
+static void flush_search_text (GeditViewFrame *frame);
+static void cancel_search_text_update (GeditViewFrame *frame);
+
 static void
 hide_search_widget (GeditViewFrame *frame,
                     gboolean        cancel)
@@ -209,6 +231,8 @@ hide_search_widget (GeditViewFrame *frame,
 		return;
 	}
 
+	flush_search_text (frame);
+
 	if (frame->priv->view_scroll_event_id != 0)
 	{
 		g_signal_handler_disconnect (frame->priv->view,
@@ -435,6 +459,8 @@ forward_search (GeditViewFrame *frame)
 
 	g_return_if_fail (frame->priv->search_mode == SEARCH);
 
+	flush_search_text (frame);
+
 	search_context = get_search_context (frame);
 
 	if (search_context == NULL)
@@ -492,6 +518,8 @@ backward_search (GeditViewFrame *frame)
 
 	g_return_if_fail (frame->priv->search_mode == SEARCH);
 
+	flush_search_text (frame);
+
 	search_context = get_search_context (frame);
 
 	if (search_context == NULL)
@@ -588,6 +616,8 @@ search_widget_key_press_event (GtkWidget      *widget,
 	{
 		GtkSourceSearchContext *search_context = get_search_context (frame);
 
+		cancel_search_text_update (frame);
+
 		if (frame->priv->search_mode == SEARCH &&
 		    search_context != NULL)
 		{
@@ -761,34 +791,158 @@ install_update_entry_tag_idle (GeditViewFrame *frame)
 	}
 }
 
+/* If the current search text has no occurrences in the buffer, a text
+ * containing it has no occurrences either.
+ */
+static gboolean
+search_text_cannot_match (GeditViewFrame *frame,
+			  const gchar    *text)
+{
+	GtkSourceSearchSettings *settings = frame->priv->search_settings;
+	GtkSourceSearchContext *search_context;
+	const gchar *current_text;
+	gboolean ret;
+
+	search_context = get_search_context (frame);
+
+	if (search_context == NULL ||
+	    gtk_source_search_settings_get_regex_enabled (settings) ||
+	    gtk_source_search_settings_get_at_word_boundaries (settings))
+	{
+		return FALSE;
+	}
+
+	current_text = gtk_source_search_settings_get_search_text (settings);
+
+	if (current_text == NULL ||
+	    text == NULL ||
+	    gtk_source_search_context_get_occurrences_count (search_context) != 0)
+	{
+		return FALSE;
+	}
+
+	if (gtk_source_search_settings_get_case_sensitive (settings))
+	{
+		ret = strstr (text, current_text) != NULL;
+	}
+	else
+	{
+		gchar *folded_text = g_utf8_casefold (text, -1);
+		gchar *folded_current_text = g_utf8_casefold (current_text, -1);
+
+		ret = strstr (folded_text, folded_current_text) != NULL;
+
+		g_free (folded_text);
+		g_free (folded_current_text);
+	}
+
+	return ret;
+}
+
+/* If @narrow is TRUE and the search entry text can't have any occurrences, the
+ * search settings are not updated, to avoid a useless scan of the buffer.
+ */
 static void
-update_search_text (GeditViewFrame *frame)
+update_search_text (GeditViewFrame *frame,
+		    gboolean        narrow)
 {
 	const gchar *entry_text = gtk_entry_get_text (GTK_ENTRY (frame->priv->search_entry));
+	gchar *text;
+
+	if (frame->priv->update_search_timeout_id != 0)
+	{
+		g_source_remove (frame->priv->update_search_timeout_id);
+		frame->priv->update_search_timeout_id = 0;
+	}
 
 	g_free (frame->priv->search_text);
 	frame->priv->search_text = g_strdup (entry_text);
 
 	if (gtk_source_search_settings_get_regex_enabled (frame->priv->search_settings))
 	{
-		gtk_source_search_settings_set_search_text (frame->priv->search_settings,
-							    entry_text);
+		text = g_strdup (entry_text);
 	}
 	else
 	{
-		gchar *unescaped_entry_text = gtk_source_utils_unescape_search_text (entry_text);
+		text = gtk_source_utils_unescape_search_text (entry_text);
+	}
 
+	if (narrow && search_text_cannot_match (frame, text))
+	{
+		frame->priv->search_text_outdated = TRUE;
+	}
+	else
+	{
 		gtk_source_search_settings_set_search_text (frame->priv->search_settings,
-							    unescaped_entry_text);
+							    text);
+		frame->priv->search_text_outdated = FALSE;
+	}
 
-		g_free (unescaped_entry_text);
+	g_free (text);
+}
+
+static gboolean
+update_search_timeout_cb (GeditViewFrame *frame)
+{
+	frame->priv->update_search_timeout_id = 0;
+
+	update_search_text (frame, TRUE);
+	start_search (frame);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Returns the delay before updating the search text, in milliseconds. */
+static guint
+get_search_debounce_delay (GeditViewFrame *frame)
+{
+	GtkTextBuffer *buffer;
+	gint char_count;
+
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (frame->priv->view));
+	char_count = gtk_text_buffer_get_char_count (buffer);
+
+	if (char_count < SEARCH_DEBOUNCE_MIN_CHARS)
+	{
+		return 0;
 	}
+
+	/* 50ms, plus 1ms for every 10000 characters */
+	return MIN (50 + char_count / 10000, SEARCH_DEBOUNCE_MAX_DELAY);
+}
+
+/* Applies the search entry text to the search settings, if it is not already
+ * the case.
+ */
+static void
+flush_search_text (GeditViewFrame *frame)
+{
+	if (frame->priv->search_mode == SEARCH &&
+	    (frame->priv->update_search_timeout_id != 0 ||
+	     frame->priv->search_text_outdated))
+	{
+		update_search_text (frame, FALSE);
+	}
+}
+
+static void
+cancel_search_text_update (GeditViewFrame *frame)
+{
+	if (frame->priv->update_search_timeout_id != 0)
+	{
+		g_source_remove (frame->priv->update_search_timeout_id);
+		frame->priv->update_search_timeout_id = 0;
+	}
+
+	frame->priv->search_text_outdated = FALSE;
 }
 
 static void
 regex_toggled_cb (GtkCheckMenuItem *menu_item,
 		  GeditViewFrame   *frame)
 {
+	flush_search_text (frame);
+
 	gtk_source_search_settings_set_regex_enabled (frame->priv->search_settings,
 						      gtk_check_menu_item_get_active (menu_item));
 
@@ -799,6 +953,8 @@ static void
 at_word_boundaries_toggled_cb (GtkCheckMenuItem *menu_item,
 			       GeditViewFrame   *frame)
 {
+	flush_search_text (frame);
+
 	gtk_source_search_settings_set_at_word_boundaries (frame->priv->search_settings,
 							   gtk_check_menu_item_get_active (menu_item));
 
@@ -809,6 +965,8 @@ static void
 case_sensitive_toggled_cb (GtkCheckMenuItem *menu_item,
 			   GeditViewFrame   *frame)
 {
+	flush_search_text (frame);
+
 	gtk_source_search_settings_set_case_sensitive (frame->priv->search_settings,
 						       gtk_check_menu_item_get_active (menu_item));
 
@@ -1141,7 +1299,11 @@ update_goto_line (GeditViewFrame *frame)
 
 	gedit_view_scroll_to_cursor (frame->priv->view);
 
-	if (!moved || !moved_offset)
+	/* If the line is not loaded yet, the goto-line is done again when the
+	 * document is loaded, see document_loaded_cb().
+	 */
+	if ((!moved || !moved_offset) &&
+	    !_gedit_document_line_is_pending (doc, line))
 	{
 		set_search_state (frame, SEARCH_STATE_NOT_FOUND);
 	}
@@ -1151,6 +1313,17 @@ update_goto_line (GeditViewFrame *frame)
 	}
 }
 
+static void
+document_loaded_cb (GeditDocument  *doc,
+		    GeditViewFrame *frame)
+{
+	if (frame->priv->search_mode == GOTO_LINE &&
+	    gtk_revealer_get_reveal_child (frame->priv->revealer))
+	{
+		update_goto_line (frame);
+	}
+}
+
 static void
 search_entry_changed_cb (GtkEntry       *entry,
 			 GeditViewFrame *frame)
@@ -1159,8 +1332,25 @@ search_entry_changed_cb (GtkEntry       *entry,
 
 	if (frame->priv->search_mode == SEARCH)
 	{
-		update_search_text (frame);
-		start_search (frame);
+		guint delay = get_search_debounce_delay (frame);
+
+		if (delay == 0)
+		{
+			update_search_text (frame, TRUE);
+			start_search (frame);
+		}
+		else
+		{
+			if (frame->priv->update_search_timeout_id != 0)
+			{
+				g_source_remove (frame->priv->update_search_timeout_id);
+			}
+
+			frame->priv->update_search_timeout_id =
+				g_timeout_add (delay,
+					       (GSourceFunc)update_search_timeout_cb,
+					       frame);
+		}
 	}
 	else
 	{
@@ -1568,6 +1758,11 @@ gedit_view_frame_init (GeditViewFrame *frame)
 			  G_CALLBACK (mark_set_cb),
 			  frame);
 
+	g_signal_connect_after (doc,
+				"loaded",
+				G_CALLBACK (document_loaded_cb),
+				frame);
+
 	g_signal_connect (frame->priv->revealer,
 			  "key-press-event",
 	                  G_CALLBACK (search_widget_key_press_event),
@@ -1669,6 +1864,8 @@ gedit_view_frame_clear_search (GeditViewFrame *frame)
 {
 	g_return_if_fail (GEDIT_IS_VIEW_FRAME (frame));
 
+	cancel_search_text_update (frame);
+
 	g_signal_handler_block (frame->priv->search_entry,
 	                        frame->priv->search_entry_changed_id);
 
@@ -564,7 +564,14 @@ extension_added (PeasExtensionSet *extensions,
 		 PeasExtension    *exten,
 		 GeditView        *view)
 {
+	gint64 span;
+
+	span = gedit_debug_span_begin (GEDIT_DEBUG_PLUGINS);
+
 	gedit_view_activatable_activate (GEDIT_VIEW_ACTIVATABLE (exten));
+
+	gedit_debug_span_end (GEDIT_DEBUG_PLUGINS, span, "view-activate",
+			      peas_plugin_info_get_module_name (info));
 }
 
 static void
@@ -640,11 +640,13 @@ update_actions_sensitivity (GeditWindow *window)
 	action = g_action_map_lookup_action (G_ACTION_MAP (window), "undo");
 	g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
 	                             (state == GEDIT_TAB_STATE_NORMAL) &&
+	                             editable &&
 	                             (doc != NULL) && gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER (doc)));
 
 	action = g_action_map_lookup_action (G_ACTION_MAP (window), "redo");
 	g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
 	                             (state == GEDIT_TAB_STATE_NORMAL) &&
+	                             editable &&
 	                             (doc != NULL) && gtk_source_buffer_can_redo (GTK_SOURCE_BUFFER (doc)));
 
 	action = g_action_map_lookup_action (G_ACTION_MAP (window), "cut");
@@ -1908,6 +1910,11 @@ editable_changed (GeditView  *view,
                   GParamSpec  *arg1,
                   GeditWindow *window)
 {
+	if (view == gedit_window_get_active_view (window))
+	{
+		update_actions_sensitivity (window);
+	}
+
 	peas_extension_set_foreach (window->priv->extensions,
 	                            (PeasExtensionSetForeachFunc) extension_update_state,
 	                            window);
@@ -2655,7 +2662,14 @@ extension_added (PeasExtensionSet *extensions,
 		 PeasExtension    *exten,
 		 GeditWindow      *window)
 {
+	gint64 span;
+
+	span = gedit_debug_span_begin (GEDIT_DEBUG_PLUGINS);
+
 	gedit_window_activatable_activate (GEDIT_WINDOW_ACTIVATABLE (exten));
+
+	gedit_debug_span_end (GEDIT_DEBUG_PLUGINS, span, "window-activate",
+			      peas_plugin_info_get_module_name (info));
 }
 
 static void
@@ -57,6 +57,8 @@ struct _GeditDocinfoPluginPrivate
 	GtkWidget *document_chars_label;
 	GtkWidget *document_chars_ns_label;
 	GtkWidget *document_bytes_label;
+	GtkWidget *undo_label;
+	GtkWidget *document_undo_label;
 	GtkWidget *selection_label;
 	GtkWidget *selected_lines_label;
 	GtkWidget *selected_words_label;
@@ -154,6 +156,8 @@ update_document_info (GeditDocinfoPlugin *plugin,
 	gint white_chars = 0;
 	gint lines = 0;
 	gint bytes = 0;
+	guint64 undo_memory = 0;
+	guint64 undo_disk = 0;
 	gchar *doc_name;
 	gchar *tmp_str;
 
@@ -205,6 +209,35 @@ update_document_info (GeditDocinfoPlugin *plugin,
 	tmp_str = g_strdup_printf("%d", bytes);
 	gtk_label_set_text (GTK_LABEL (priv->document_bytes_label), tmp_str);
 	g_free (tmp_str);
+
+	gedit_document_get_undo_usage (doc, &undo_memory, &undo_disk);
+
+	gedit_debug_message (DEBUG_PLUGINS, "Undo memory: %" G_GUINT64_FORMAT, undo_memory);
+	gedit_debug_message (DEBUG_PLUGINS, "Undo disk: %" G_GUINT64_FORMAT, undo_disk);
+
+	if (undo_disk > 0)
+	{
+		gchar *memory_str;
+		gchar *disk_str;
+
+		memory_str = g_format_size (undo_memory);
+		disk_str = g_format_size (undo_disk);
+
+		/* Translators: the first %s is the memory used by the undo
+		 * history, the second one is the size of the part moved to the
+		 * disk, e.g. "64.0 MB (1.2 GB on disk)". */
+		tmp_str = g_strdup_printf (_("%s (%s on disk)"), memory_str, disk_str);
+
+		g_free (memory_str);
+		g_free (disk_str);
+	}
+	else
+	{
+		tmp_str = g_format_size (undo_memory);
+	}
+
+	gtk_label_set_text (GTK_LABEL (priv->document_undo_label), tmp_str);
+	g_free (tmp_str);
 }
 
 static void
@@ -349,6 +382,8 @@ create_docinfo_dialog (GeditDocinfoPlugin *plugin)
 	priv->document_lines_label = GTK_WIDGET (gtk_builder_get_object (builder, "document_lines_label"));
 	priv->document_chars_label = GTK_WIDGET (gtk_builder_get_object (builder, "document_chars_label"));
 	priv->document_chars_ns_label = GTK_WIDGET (gtk_builder_get_object (builder, "document_chars_ns_label"));
+	priv->undo_label = GTK_WIDGET (gtk_builder_get_object (builder, "undo_label"));
+	priv->document_undo_label = GTK_WIDGET (gtk_builder_get_object (builder, "document_undo_label"));
 	priv->selection_label = GTK_WIDGET (gtk_builder_get_object (builder, "selection_label"));
 	priv->selected_words_label = GTK_WIDGET (gtk_builder_get_object (builder, "selected_words_label"));
 	priv->selected_bytes_label = GTK_WIDGET (gtk_builder_get_object (builder, "selected_bytes_label"));
@@ -388,6 +423,8 @@ create_docinfo_dialog (GeditDocinfoPlugin *plugin)
 	gtk_widget_set_can_focus (priv->document_lines_label, FALSE);
 	gtk_widget_set_can_focus (priv->document_chars_label, FALSE);
 	gtk_widget_set_can_focus (priv->document_chars_ns_label, FALSE);
+	gtk_widget_set_can_focus (priv->undo_label, FALSE);
+	gtk_widget_set_can_focus (priv->document_undo_label, FALSE);
 	gtk_widget_set_can_focus (priv->selection_label, FALSE);
 	gtk_widget_set_can_focus (priv->selected_words_label, FALSE);
 	gtk_widget_set_can_focus (priv->selected_bytes_label, FALSE);
@@ -24,6 +24,7 @@ import signal
 import locale
 import subprocess
 import fcntl
+import codecs
 from gi.repository import GLib, GObject
 
 
@@ -34,7 +35,15 @@ class Capture(GObject.Object):
     CAPTURE_NEEDS_SHELL = 0x04
 
     WRITE_BUFFER_SIZE = 0x4000
+    READ_BUFFER_SIZE = 0x10000
 
+    # Maximum number of reads from a pipe, or writes to it, in one iteration
+    # of the main loop
+    MAX_READS = 16
+    MAX_WRITES = 16
+
+    # The std*-line signals carry one or more complete lines, except the last
+    # one of the output and the prompts which aren't followed by a newline.
     __gsignals__ = {
         'stdout-line': (GObject.SIGNAL_RUN_LAST, GObject.TYPE_NONE, (GObject.TYPE_STRING,)),
         'stderr-line': (GObject.SIGNAL_RUN_LAST, GObject.TYPE_NONE, (GObject.TYPE_STRING,)),
@@ -49,7 +58,8 @@ class Capture(GObject.Object):
         self.cwd = cwd
         self.flags = self.CAPTURE_BOTH | self.CAPTURE_NEEDS_SHELL
         self.command = command
-        self.input_text = None
+        self.input_reader = None
+        self.input_buffer = None
 
     def set_env(self, **values):
         self.env.update(**values)
@@ -61,7 +71,20 @@ class Capture(GObject.Object):
         self.flags = flags
 
     def set_input(self, text):
-        self.input_text = text.encode("UTF-8") if text else None
+        if text:
+            chunks = [text.encode("UTF-8")]
+            self.set_input_reader(lambda: chunks.pop() if chunks else b'')
+        else:
+            self.set_input_reader(None)
+
+    def set_input_reader(self, reader):
+        """
+        Sets the function giving the standard input of the command, by
+        chunks. It is called without arguments each time the previous chunk
+        has been written, and returns bytes, empty at the end of the input.
+        """
+        self.input_reader = reader
+        self.input_buffer = None
 
     def set_cwd(self, cwd):
         self.cwd = cwd
@@ -77,7 +100,7 @@ class Capture(GObject.Object):
             'env': self.env
         }
 
-        if self.input_text is not None:
+        if self.input_reader is not None:
             popen_args['stdin'] = subprocess.PIPE
         if self.flags & self.CAPTURE_STDOUT:
             popen_args['stdout'] = subprocess.PIPE
@@ -92,16 +115,24 @@ class Capture(GObject.Object):
         self.out_channel_id = 0
         self.err_channel_id = 0
 
+        self.decoders = {}
+        self.partial_lines = {}
+
+        for signalname in ('stdout-line', 'stderr-line'):
+            self.decoders[signalname] = codecs.getincrementaldecoder('utf-8')('replace')
+            self.partial_lines[signalname] = ''
+
         try:
             self.pipe = subprocess.Popen(self.command, **popen_args)
         except OSError as e:
             self.pipe = None
             self.emit('stderr-line', _('Could not execute command: %s') % (e, ))
+            GLib.idle_add(self.emit_end_execute, -1)
             return
 
         self.emit('begin-execute')
 
-        if self.input_text is not None:
+        if self.input_reader is not None:
             self.in_channel, self.in_channel_id = self.add_in_watch(self.pipe.stdin.fileno(),
                                                                     self.on_in_writable)
 
@@ -131,6 +162,7 @@ class Capture(GObject.Object):
     def add_out_watch(self, fd, io_func):
         channel = GLib.IOChannel.unix_new(fd)
         channel.set_flags(channel.get_flags() | GLib.IOFlags.NONBLOCK)
+        channel.set_encoding(None)
         channel_id = GLib.io_add_watch(channel,
                                        GLib.PRIORITY_DEFAULT,
                                        GLib.IOCondition.IN | GLib.IOCondition.HUP | GLib.IOCondition.ERR,
@@ -139,20 +171,26 @@ class Capture(GObject.Object):
 
     def write_chunk(self, dest, condition):
         if condition & (GObject.IO_OUT):
-            status = GLib.IOStatus.NORMAL
-            l = len(self.input_text)
-            while status == GLib.IOStatus.NORMAL:
-                if l == 0:
-                    return False
-                m = min(l, self.WRITE_BUFFER_SIZE)
+            fd = dest.unix_get_fd()
+
+            # Only one chunk of the input is in memory at a time
+            for i in range(self.MAX_WRITES):
+                if not self.input_buffer:
+                    data = self.input_reader()
+
+                    if not data:
+                        return False
+
+                    self.input_buffer = memoryview(data)
+
                 try:
-                    (status, length) = dest.write_chars(self.input_text, m)
-                    self.input_text = self.input_text[length:]
-                    l -= length
-                except Exception as e:
+                    length = os.write(fd, self.input_buffer[:self.WRITE_BUFFER_SIZE])
+                except BlockingIOError:
+                    break
+                except OSError:
                     return False
-            if status != GLib.IOStatus.AGAIN:
-                return False
+
+                self.input_buffer = self.input_buffer[length:]
 
         if condition & ~(GObject.IO_OUT):
             return False
@@ -162,7 +200,8 @@ class Capture(GObject.Object):
     def on_in_writable(self, dest, condition):
         ret = self.write_chunk(dest, condition)
         if ret is False:
-            self.input_text = None
+            self.input_reader = None
+            self.input_buffer = None
             try:
                 self.in_channel.shutdown(True)
             except:
@@ -173,20 +212,53 @@ class Capture(GObject.Object):
 
         return ret
 
+    def emit_text(self, signalname, data, drained, final):
+        text = self.partial_lines[signalname] + \
+               self.decoders[signalname].decode(data, final)
+
+        # Keep the last line until it is complete, so that the receivers
+        # don't get the links cut in two
+        end = text.rfind('\n') + 1
+
+        if final or (drained and end == 0):
+            end = len(text)
+
+        self.partial_lines[signalname] = text[end:]
+
+        if end > 0:
+            self.emit(signalname, text[:end])
+
     def handle_source(self, source, condition, signalname):
         if condition & (GObject.IO_IN | GObject.IO_PRI):
-            status = GLib.IOStatus.NORMAL
-            while status == GLib.IOStatus.NORMAL:
+            fd = source.unix_get_fd()
+            chunks = []
+            drained = False
+            eof = False
+
+            # Read by blocks rather than by lines, but give back the hand
+            # to the main loop from time to time
+            for i in range(self.MAX_READS):
                 try:
-                    (status, buf, length, terminator_pos) = source.read_line()
-                except Exception as e:
-                    return False
-                if buf:
-                    self.emit(signalname, buf)
-            if status != GLib.IOStatus.AGAIN:
-                return False
+                    data = os.read(fd, self.READ_BUFFER_SIZE)
+                except BlockingIOError:
+                    drained = True
+                    break
+                except OSError:
+                    eof = True
+                    break
+
+                if not data:
+                    eof = True
+                    break
+
+                chunks.append(data)
+
+            self.emit_text(signalname, b''.join(chunks), drained, eof)
+
+            return not eof
 
         if condition & ~(GObject.IO_IN | GObject.IO_PRI):
+            self.emit_text(signalname, b'', True, True)
             return False
 
         return True
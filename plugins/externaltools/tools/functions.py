@@ -19,6 +19,92 @@
 import os
 from gi.repository import Gio, Gtk, Gdk, GtkSource, Gedit
 from .capture import *
+from .jobs import JobQueue
+
+
+class DocumentReader:
+    """
+    Gives a range of a document by chunks, so that it can be streamed to a
+    tool without copying all the text at once.
+    """
+
+    CHUNK_SIZE = 0x10000
+
+    def __init__(self, document, start, end):
+        self.document = document
+
+        # The text inserted at the end of the range is not read
+        self.start_mark = document.create_mark(None, start, True)
+        self.end_mark = document.create_mark(None, end, True)
+
+    def __call__(self):
+        if self.start_mark is None:
+            return b''
+
+        start = self.document.get_iter_at_mark(self.start_mark)
+        end = self.document.get_iter_at_mark(self.end_mark)
+
+        if start.compare(end) >= 0:
+            self.close()
+            return b''
+
+        chunk_end = start.copy()
+        chunk_end.forward_chars(self.CHUNK_SIZE)
+
+        if chunk_end.compare(end) > 0:
+            chunk_end = end
+
+        text = self.document.get_text(start, chunk_end, False)
+        self.document.move_mark(self.start_mark, chunk_end)
+
+        return text.encode('UTF-8')
+
+    def close(self):
+        if self.start_mark is not None:
+            self.document.delete_mark(self.start_mark)
+            self.document.delete_mark(self.end_mark)
+            self.start_mark = None
+            self.end_mark = None
+
+
+class DocumentReplacer:
+    """
+    Stages the output of a tool in a separate buffer, and replaces a range
+    of a document with it in a single step once the tool has finished.
+    """
+
+    def __init__(self, document, start, end):
+        self.document = document
+        self.start_mark = document.create_mark(None, start, True)
+        self.end_mark = document.create_mark(None, end, False)
+
+        # Inserting a range from another buffer requires the same tag table
+        self.staging = Gtk.TextBuffer(tag_table=document.get_tag_table())
+
+    def append(self, text):
+        self.staging.insert(self.staging.get_end_iter(), text)
+
+    def replace(self):
+        document = self.document
+
+        # Nothing is replaced if the tool didn't output anything
+        if self.staging.get_char_count() > 0:
+            document.begin_user_action()
+
+            document.delete(document.get_iter_at_mark(self.start_mark),
+                            document.get_iter_at_mark(self.end_mark))
+            document.insert_range(document.get_iter_at_mark(self.start_mark),
+                                  self.staging.get_start_iter(),
+                                  self.staging.get_end_iter())
+
+            document.end_user_action()
+
+        self.discard()
+
+    def discard(self):
+        self.document.delete_mark(self.start_mark)
+        self.document.delete_mark(self.end_mark)
+        self.staging.set_text('')
 
 
 def default(val, d):
@@ -57,7 +143,30 @@ def file_browser_root(window):
 
 
 # ==== Capture related functions ====
-def run_external_tool(window, panel, node):
+
+# View -> number of running tools writing to it
+_locked_views = {}
+
+
+def lock_view(view):
+    if view not in _locked_views:
+        view.set_editable(False)
+        view.set_cursor_visible(False)
+
+    _locked_views[view] = _locked_views.get(view, 0) + 1
+
+
+def unlock_view(view):
+    _locked_views[view] -= 1
+
+    # Editing comes back when the last tool writing to the view ends
+    if _locked_views[view] == 0:
+        del _locked_views[view]
+        view.set_cursor_visible(True)
+        view.set_editable(True)
+
+
+def run_external_tool(window, panel, node, view, job):
     # Configure capture environment
     try:
         cwd = os.getcwd()
@@ -68,9 +177,12 @@ def run_external_tool(window, panel, node):
     capture.env = os.environ.copy()
     capture.set_env(GEDIT_CWD=cwd)
 
-    view = window.get_active_view()
     document = None
 
+    # The view may have been closed while the job was waiting
+    if view is not None and view not in window.get_views():
+        view = None
+
     if view is not None:
         # Environment vars relative to current document
         document = view.get_buffer()
@@ -145,14 +257,15 @@ def run_external_tool(window, panel, node):
     input_type = node.input
     output_type = node.output
 
-    # Clear the panel
-    panel.clear()
+    # Each tool has its own page in the panel
+    output = panel.get_view(node, node.name)
+    output.clear()
 
     if output_type == 'output-panel':
-        panel.show()
+        output.show()
 
     # Assign the error output to the output panel
-    panel.set_process(capture)
+    output.set_process(capture)
 
     if input_type != 'nothing' and view is not None:
         if input_type == 'document':
@@ -181,16 +294,22 @@ def run_external_tool(window, panel, node):
             start = document.get_iter_at_mark(document.get_insert())
             end = start.copy()
             if not start.inside_word():
-                panel.write(_('You must be inside a word to run this command'),
-                            panel.command_tag)
-                return
+                output.write(_('You must be inside a word to run this command'),
+                             panel.error_tag)
+                output.set_process(None)
+                return None
             if not start.starts_word():
                 start.backward_word_start()
             if not end.ends_word():
                 end.forward_word_end()
 
-        input_text = document.get_text(start, end, False)
-        capture.set_input(input_text)
+        # The output inserted at the cursor could land in the input range
+        if output_type == 'insert':
+            capture.set_input(document.get_text(start, end, False))
+        else:
+            reader = DocumentReader(document, start, end)
+            capture.set_input_reader(reader)
+            capture.connect('end-execute', capture_end_execute_reader, reader)
 
     # Assign the standard output to the chosen "file"
     if output_type == 'new-document':
@@ -200,12 +319,10 @@ def run_external_tool(window, panel, node):
         pos = document.get_start_iter()
         capture.connect('stdout-line', capture_stdout_line_document, document, pos)
         document.begin_user_action()
-        view.set_editable(False)
-        view.set_cursor_visible(False)
+        lock_view(view)
     elif output_type != 'output-panel' and output_type != 'nothing' and view is not None:
         document.begin_user_action()
-        view.set_editable(False)
-        view.set_cursor_visible(False)
+        lock_view(view)
 
         if output_type.startswith('replace-'):
             if output_type == 'replace-selection':
@@ -216,8 +333,9 @@ def run_external_tool(window, panel, node):
                     end_iter = start_iter.copy()
             elif output_type == 'replace-document':
                 start_iter, end_iter = document.get_bounds()
-            capture.connect('stdout-line', capture_delayed_replace,
-                            document, start_iter, end_iter)
+            replacer = DocumentReplacer(document, start_iter, end_iter)
+            capture.connect('stdout-line', capture_stdout_line_replacer, replacer)
+            capture.connect('end-execute', capture_end_execute_replacer, replacer, output, job)
         else:
             if output_type == 'insert':
                 pos = document.get_iter_at_mark(document.get_insert())
@@ -225,14 +343,16 @@ def run_external_tool(window, panel, node):
                 pos = document.get_end_iter()
             capture.connect('stdout-line', capture_stdout_line_document, document, pos)
     elif output_type != 'nothing':
-        capture.connect('stdout-line', capture_stdout_line_panel, panel)
+        capture.connect('stdout-line', capture_stdout_line_panel, output)
 
         if not document is None:
             document.begin_user_action()
 
-    capture.connect('stderr-line', capture_stderr_line_panel, panel)
-    capture.connect('begin-execute', capture_begin_execute_panel, panel, view, node.name)
-    capture.connect('end-execute', capture_end_execute_panel, panel, view, output_type)
+    capture.connect('stderr-line', capture_stderr_line_panel, output)
+    capture.connect('begin-execute', capture_begin_execute_panel, output, view, node.name)
+    capture.connect('end-execute', capture_end_execute_panel, output, view,
+                    output_type != 'output-panel' and output_type != 'nothing',
+                    output_type)
 
     # Run the command
     capture.execute()
@@ -241,6 +361,9 @@ def run_external_tool(window, panel, node):
         if not document is None:
             document.end_user_action()
 
+    return capture
+
+
 class MultipleDocumentsSaver:
     def __init__(self, window, panel, all_docs, node):
         self._window = window
@@ -258,7 +381,7 @@ class MultipleDocumentsSaver:
     def save_next_document(self):
         if len(self._docs_to_save) == 0:
             # The documents are saved, we can run the tool.
-            run_external_tool(self._window, self._panel, self._node)
+            queue_external_tool(self._window, self._panel, self._node)
         else:
             next_doc = self._docs_to_save[0]
             self._docs_to_save.remove(next_doc)
@@ -283,28 +406,40 @@ def capture_menu_action(action, parameter, window, panel, node):
         MultipleDocumentsSaver(window, panel, True, node)
         return
 
-    run_external_tool(window, panel, node)
+    queue_external_tool(window, panel, node)
+
 
+def queue_external_tool(window, panel, node):
+    view = window.get_active_view()
+    document = None
+
+    if view is not None and node.output not in ('output-panel', 'new-document', 'nothing'):
+        document = view.get_buffer()
 
-def capture_stderr_line_panel(capture, line, panel):
-    if not panel.visible():
-        panel.show()
+    # A new run of a tool in a window replaces the previous one
+    JobQueue.get_default().submit((window, node),
+                                  lambda job: run_external_tool(window, panel, node, view, job),
+                                  document)
 
-    panel.write(line, panel.error_tag)
 
+def capture_stderr_line_panel(capture, line, output):
+    if not output.visible():
+        output.show()
 
-def capture_begin_execute_panel(capture, panel, view, label):
+    output.write(line, output.panel.error_tag)
+
+
+def capture_begin_execute_panel(capture, output, view, label):
     if view:
         view.get_window(Gtk.TextWindowType.TEXT).set_cursor(Gdk.Cursor.new(Gdk.CursorType.WATCH))
 
-    panel['stop'].set_sensitive(True)
-    panel.clear()
-    panel.write(_("Running tool:"), panel.italic_tag)
-    panel.write(" %s\n\n" % label, panel.bold_tag)
+    output.clear()
+    output.write(_("Running tool:"), output.panel.italic_tag)
+    output.write(" %s\n\n" % label, output.panel.bold_tag)
 
 
-def capture_end_execute_panel(capture, exit_code, panel, view, output_type):
-    panel['stop'].set_sensitive(False)
+def capture_end_execute_panel(capture, exit_code, output, view, locked, output_type):
+    output.set_process(None)
 
     if view:
         if output_type in ('new-document', 'replace-document'):
@@ -325,34 +460,41 @@ def capture_end_execute_panel(capture, exit_code, panel, view, output_type):
             if language is not None:
                 doc.set_language(language)
 
-        view.get_window(Gtk.TextWindowType.TEXT).set_cursor(Gdk.Cursor.new(Gdk.CursorType.XTERM))
-        view.set_cursor_visible(True)
-        view.set_editable(True)
+        if locked:
+            unlock_view(view)
+
+        if view not in _locked_views:
+            view.get_window(Gtk.TextWindowType.TEXT).set_cursor(Gdk.Cursor.new(Gdk.CursorType.XTERM))
 
     if exit_code == 0:
-        panel.write("\n" + _("Done.") + "\n", panel.italic_tag)
+        output.write("\n" + _("Done.") + "\n", output.panel.italic_tag)
     else:
-        panel.write("\n" + _("Exited") + ":", panel.italic_tag)
-        panel.write(" %d\n" % exit_code, panel.bold_tag)
+        output.write("\n" + _("Exited") + ":", output.panel.italic_tag)
+        output.write(" %d\n" % exit_code, output.panel.bold_tag)
 
 
-def capture_stdout_line_panel(capture, line, panel):
-    panel.write(line)
+def capture_stdout_line_panel(capture, line, output):
+    output.write(line)
 
 
 def capture_stdout_line_document(capture, line, document, pos):
     document.insert(pos, line)
 
 
-def capture_delayed_replace(capture, line, document, start_iter, end_iter):
-    document.delete(start_iter, end_iter)
+def capture_stdout_line_replacer(capture, line, replacer):
+    replacer.append(line)
+
 
-    # Must be done after deleting the text
-    pos = document.get_iter_at_mark(document.get_insert())
+def capture_end_execute_replacer(capture, exit_code, replacer, output, job):
+    # The output of a cancelled, stopped or failed run may be incomplete
+    if exit_code == 0 and not job.cancelled and not capture.tried_killing:
+        replacer.replace()
+    else:
+        replacer.discard()
+        output.write(_("The document was not modified.") + "\n", output.panel.italic_tag)
 
-    capture_stdout_line_document(capture, line, document, pos)
 
-    capture.disconnect_by_func(capture_delayed_replace)
-    capture.connect('stdout-line', capture_stdout_line_document, document, pos)
+def capture_end_execute_reader(capture, exit_code, reader):
+    reader.close()
 
 # ex:ts=4:et:
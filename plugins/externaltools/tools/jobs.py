@@ -0,0 +1,141 @@
+# -*- coding: utf-8 -*-
+#    Gedit External Tools plugin
+#
+#    This program is free software; you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation; either version 2 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program; if not, write to the Free Software
+#    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+__all__ = ('JobQueue', )
+
+from gi.repository import GLib, Gio
+
+
+class Job:
+    def __init__(self, key, start, document):
+        self.key = key
+        self.start = start
+        self.document = document
+        self.capture = None
+        self.timeout_id = 0
+        self.cancelled = False
+
+
+class JobQueue:
+    """
+    Runs the external tools, several at a time. The jobs are identified by a
+    key: a new run of a job stops the previous one, and is delayed a little
+    so that repeated runs only start the last one. The jobs writing to the
+    same document run one after the other.
+    """
+
+    # Delay before starting a job that replaces another, in milliseconds
+    DEBOUNCE_DELAY = 300
+
+    __instance = None
+
+    def __init__(self):
+        self.settings = Gio.Settings.new("org.gnome.gedit.plugins.externaltools")
+
+        # Key -> job waiting for the debounce delay
+        self.delayed = {}
+
+        # Jobs waiting for a free slot, in order
+        self.queued = []
+
+        # Key -> job started
+        self.running = {}
+
+        # Document -> job started writing to it
+        self.documents = {}
+
+    @classmethod
+    def get_default(cls):
+        if cls.__instance is None:
+            cls.__instance = JobQueue()
+
+        return cls.__instance
+
+    def submit(self, key, start, document=None):
+        """
+        Queues a job. 'start' is called with the job when it can run, and
+        returns the Capture it executed, or None if it didn't execute
+        anything. 'document' is the document the job writes to, if any.
+        """
+        job = Job(key, start, document)
+        replaced = key in self.running or key in self.delayed
+
+        old = self.delayed.pop(key, None)
+
+        if old is not None:
+            GLib.source_remove(old.timeout_id)
+
+        self.queued = [j for j in self.queued if j.key != key]
+
+        # The output of the stopped run must not be applied
+        if key in self.running:
+            self.running[key].cancelled = True
+            self.running[key].capture.stop()
+
+        if replaced:
+            job.timeout_id = GLib.timeout_add(self.DEBOUNCE_DELAY, self.on_delay_timeout, job)
+            self.delayed[key] = job
+        else:
+            self.queued.append(job)
+            self.schedule()
+
+    def on_delay_timeout(self, job):
+        job.timeout_id = 0
+        del self.delayed[job.key]
+
+        self.queued.append(job)
+        self.schedule()
+
+        return False
+
+    def schedule(self):
+        max_jobs = self.settings.get_int('max-jobs')
+
+        for job in list(self.queued):
+            if len(self.running) >= max_jobs:
+                break
+
+            # Wait for the previous run to be stopped
+            if job.key in self.running:
+                continue
+
+            # Wait for the job writing to the same document
+            if job.document is not None and job.document in self.documents:
+                continue
+
+            self.queued.remove(job)
+            capture = job.start(job)
+
+            if capture is not None:
+                job.capture = capture
+                self.running[job.key] = job
+
+                if job.document is not None:
+                    self.documents[job.document] = job
+
+                capture.connect('end-execute', self.on_end_execute, job)
+
+    def on_end_execute(self, capture, exit_code, job):
+        if self.running.get(job.key) is job:
+            del self.running[job.key]
+
+        if job.document is not None and self.documents.get(job.document) is job:
+            del self.documents[job.document]
+
+        self.schedule()
+
+# ex:ts=4:et:
@@ -43,144 +43,244 @@ class UniqueById:
         return self.__class__.__shared_state
 
 
-class OutputPanel(UniqueById):
-    def __init__(self, datadir, window):
-        if UniqueById.__init__(self, window):
-            return
+class OutputView:
+    """
+    The output of one tool: a page of the output panel, with the process
+    writing to it.
+    """
 
-        callbacks = {
-            'on_stop_clicked': self.on_stop_clicked,
-            'on_view_visibility_notify_event': self.on_view_visibility_notify_event,
-            'on_view_motion_notify_event': self.on_view_motion_notify_event
-        }
+    # The output is inserted in the view at most this often, in milliseconds
+    FLUSH_INTERVAL = 40
 
-        self.profile_settings = self.get_profile_settings()
-        self.profile_settings.connect("changed", self.font_changed)
-        self.system_settings = Gio.Settings.new("org.gnome.desktop.interface")
-        self.system_settings.connect("changed::monospace-font-name", self.font_changed)
+    # Number of lines kept in the view, the oldest ones are removed
+    MAX_LINES = 10000
 
-        self.window = window
-        self.ui = Gtk.Builder()
-        self.ui.add_from_file(os.path.join(datadir, 'ui', 'outputpanel.ui'))
-        self.ui.connect_signals(callbacks)
-        self['view'].connect('button-press-event', self.on_view_button_press_event)
-
-        self.panel = self["output-panel"]
-        self.font_changed()
+    def __init__(self, panel, label):
+        self.panel = panel
+        self.window = panel.window
+        self.label = label
 
-        buffer = self['view'].get_buffer()
-
-        self.normal_tag = buffer.create_tag('normal')
-
-        self.error_tag = buffer.create_tag('error')
-        self.error_tag.set_property('foreground', 'red')
-
-        self.italic_tag = buffer.create_tag('italic')
-        self.italic_tag.set_property('style', Pango.Style.OBLIQUE)
+        view = Gtk.TextView(buffer=Gtk.TextBuffer(tag_table=panel.tag_table),
+                            editable=False,
+                            wrap_mode=Gtk.WrapMode.WORD,
+                            cursor_visible=False,
+                            accepts_tab=False)
 
-        self.bold_tag = buffer.create_tag('bold')
-        self.bold_tag.set_property('weight', Pango.Weight.BOLD)
+        view.connect('visibility-notify-event', self.on_view_visibility_notify_event)
+        view.connect('motion-notify-event', self.on_view_motion_notify_event)
+        view.connect('button-press-event', self.on_view_button_press_event)
+        view.connect('size-allocate', self.on_view_size_allocate)
 
-        self.invalid_link_tag = buffer.create_tag('invalid_link')
+        self.view = view
 
-        self.link_tag = buffer.create_tag('link')
-        self.link_tag.set_property('underline', Pango.Underline.SINGLE)
+        self.widget = Gtk.ScrolledWindow(hexpand=True, vexpand=True)
+        self.widget.add(view)
+        self.widget.show_all()
 
-        self.link_cursor = Gdk.Cursor.new(Gdk.CursorType.HAND2)
-        self.normal_cursor = Gdk.Cursor.new(Gdk.CursorType.XTERM)
+        view.get_vadjustment().connect('value-changed', self.on_view_scrolled)
 
         self.process = None
 
-        self.links = []
-
-        self.link_parser = linkparsing.LinkParser()
-        self.file_lookup = filelookup.FileLookup(window)
+        # The links are only looked for in the lines scrolled into view.
+        # Line number counted from the start of the output -> valid links of
+        # the line, with the offsets of the link in the line.
+        self.line_links = {}
+        self.trimmed_lines = 0
+        self.partial_line = -1
+        self.links_id = 0
 
-    def get_profile_settings(self):
-        #FIXME return either the gnome-terminal settings or the gedit one
-        return Gio.Settings.new("org.gnome.gedit.plugins.externaltools")
-
-    def font_changed(self, settings=None, key=None):
-        if self.profile_settings.get_boolean("use-system-font"):
-            font = self.system_settings.get_string("monospace-font-name")
-        else:
-            font = self.profile_settings.get_string("font")
-
-        font_desc = Pango.font_description_from_string(font)
-
-        self["view"].override_font(font_desc)
+        self.pending = []
+        self.flush_id = 0
+        self.scroll_id = 0
 
     def set_process(self, process):
         self.process = process
+        self.panel.update_stop()
 
-    def __getitem__(self, key):
-        # Convenience function to get an object from its name
-        return self.ui.get_object(key)
-
-    def on_stop_clicked(self, widget, *args):
+    def stop(self):
         if self.process is not None:
             self.write("\n" + _('Stopped.') + "\n",
-                       self.italic_tag)
+                       self.panel.italic_tag)
             self.process.stop(-1)
 
+    def destroy(self):
+        self.cancel_flush()
+
+        for source_id in (self.links_id, self.scroll_id):
+            if source_id != 0:
+                GLib.source_remove(source_id)
+
+        self.links_id = 0
+        self.scroll_id = 0
+
     def scroll_to_end(self):
-        iter = self['view'].get_buffer().get_end_iter()
-        self['view'].scroll_to_iter(iter, 0.0, False, 0.5, 0.5)
+        self.scroll_id = 0
+        iter = self.view.get_buffer().get_end_iter()
+        self.view.scroll_to_iter(iter, 0.0, False, 0.5, 0.5)
         return False  # don't requeue this handler
 
     def clear(self):
-        self['view'].get_buffer().set_text("")
-        self.links = []
+        self.cancel_flush()
+        self.view.get_buffer().set_text("")
+        self.line_links = {}
+        self.trimmed_lines = 0
+        self.partial_line = -1
 
     def visible(self):
-        panel = self.window.get_bottom_panel()
-        return panel.props.visible and panel.props.visible_child == self.panel
+        return self.panel.visible() and self.panel.get_current_view() is self
+
+    def show(self):
+        self.panel.show(self)
 
     def write(self, text, tag=None):
-        buffer = self['view'].get_buffer()
+        # Queue the text, so that a tool printing many lines doesn't insert
+        # and scroll for each of them
+        if self.pending and self.pending[-1][1] is tag:
+            self.pending[-1][0].append(text)
+        else:
+            self.pending.append(([text], tag))
+
+        if self.flush_id == 0:
+            self.flush_id = GLib.timeout_add(self.FLUSH_INTERVAL, self.on_flush_timeout)
 
+    def cancel_flush(self):
+        if self.flush_id != 0:
+            GLib.source_remove(self.flush_id)
+            self.flush_id = 0
+
+        self.pending = []
+
+    def on_flush_timeout(self):
+        self.flush_id = 0
+        self.flush()
+        return False
+
+    def flush(self):
+        pending = self.pending
+        self.cancel_flush()
+
+        if not pending:
+            return
+
+        buffer = self.view.get_buffer()
+
+        for texts, tag in pending:
+            self.insert(buffer, ''.join(texts), tag)
+
+        self.trim(buffer)
+
+        if self.scroll_id == 0:
+            self.scroll_id = GLib.idle_add(self.scroll_to_end)
+
+        self.queue_update_links()
+
+    def trim(self, buffer):
+        excess = buffer.get_line_count() - self.MAX_LINES
+
+        if excess <= 0:
+            return
+
+        buffer.delete(buffer.get_start_iter(), buffer.get_iter_at_line(excess))
+        self.trimmed_lines += excess
+
+        for line in [l for l in self.line_links if l < self.trimmed_lines]:
+            del self.line_links[line]
+
+    def insert(self, buffer, text, tag):
         end_iter = buffer.get_end_iter()
-        insert = buffer.create_mark(None, end_iter, True)
 
         if tag is None:
             buffer.insert(end_iter, text)
         else:
             buffer.insert_with_tags(end_iter, text, tag)
 
-        # find all links and apply the appropriate tag for them
-        links = self.link_parser.parse(text)
-        for lnk in links:
-            insert_iter = buffer.get_iter_at_mark(insert)
-            lnk.start = insert_iter.get_offset() + lnk.start
-            lnk.end = insert_iter.get_offset() + lnk.end
+    def queue_update_links(self):
+        # Before the redraw, so that the links are drawn with their tag
+        if self.links_id == 0:
+            self.links_id = GLib.idle_add(self.update_links,
+                                          priority=GLib.PRIORITY_HIGH_IDLE)
 
-            start_iter = buffer.get_iter_at_offset(lnk.start)
-            end_iter = buffer.get_iter_at_offset(lnk.end)
+    def remove_link_tags(self, buffer, line):
+        start_iter = buffer.get_iter_at_line(line)
+        end_iter = start_iter.copy()
 
-            tag = None
+        if not end_iter.ends_line():
+            end_iter.forward_to_line_end()
 
-            # if the link points to an existing file then it is a valid link
-            if self.file_lookup.lookup(lnk.path) is not None:
-                self.links.append(lnk)
-                tag = self.link_tag
-            else:
-                tag = self.invalid_link_tag
+        buffer.remove_tag(self.panel.link_tag, start_iter, end_iter)
+        buffer.remove_tag(self.panel.invalid_link_tag, start_iter, end_iter)
 
-            buffer.apply_tag(tag, start_iter, end_iter)
+    def update_links(self):
+        self.links_id = 0
 
-        buffer.delete_mark(insert)
-        GLib.idle_add(self.scroll_to_end)
+        view = self.view
+        buffer = view.get_buffer()
+        rect = view.get_visible_rect()
 
-    def show(self):
-        panel = self.window.get_bottom_panel()
-        panel.props.visible_child = self.panel
-        panel.show()
+        first = view.get_line_at_y(rect.y)[0].get_line()
+        last = view.get_line_at_y(rect.y + rect.height)[0].get_line()
+
+        tags = []
+
+        for line in range(first, last + 1):
+            if line + self.trimmed_lines in self.line_links and \
+               line + self.trimmed_lines != self.partial_line:
+                continue
+
+            start_iter = buffer.get_iter_at_line(line)
+            end_iter = start_iter.copy()
+
+            if not end_iter.ends_line():
+                end_iter.forward_to_line_end()
+
+            # The line was parsed before the end of it was written
+            if line + self.trimmed_lines == self.partial_line:
+                self.remove_link_tags(buffer, line)
+
+            links = []
+
+            for lnk in self.panel.link_parser.parse(buffer.get_text(start_iter, end_iter, True)):
+                # if the link points to an existing file then it is a valid link
+                if self.panel.file_lookup.lookup(lnk.path) is not None:
+                    links.append(lnk)
+                    tag = self.panel.link_tag
+                else:
+                    tag = self.panel.invalid_link_tag
+
+                tags.append((tag, line, lnk.start, lnk.end))
+
+            self.line_links[line + self.trimmed_lines] = links
+
+        # The last line can still be written to, it is parsed again then
+        partial_line = buffer.get_line_count() - 1 + self.trimmed_lines
+        line = self.partial_line - self.trimmed_lines
+
+        if self.partial_line != partial_line and \
+           self.partial_line in self.line_links and not first <= line <= last:
+            self.remove_link_tags(buffer, line)
+            del self.line_links[self.partial_line]
+
+        self.partial_line = partial_line
+
+        # Apply the tags once all the visible lines are parsed
+        for tag, line, start, end in tags:
+            buffer.apply_tag(tag,
+                             buffer.get_iter_at_line_offset(line, start),
+                             buffer.get_iter_at_line_offset(line, end))
+
+        return False
+
+    def on_view_scrolled(self, adjustment):
+        self.queue_update_links()
+
+    def on_view_size_allocate(self, view, allocation):
+        self.queue_update_links()
 
     def update_cursor_style(self, view, x, y):
         if self.get_link_at_location(view, x, y) is not None:
-            cursor = self.link_cursor
+            cursor = self.panel.link_cursor
         else:
-            cursor = self.normal_cursor
+            cursor = self.panel.normal_cursor
 
         view.get_window(Gtk.TextWindowType.TEXT).set_cursor(cursor)
 
@@ -210,10 +310,11 @@ class OutputPanel(UniqueById):
         # get the offset within the buffer from the x,y coordinates
         buff_x, buff_y = view.window_to_buffer_coords(Gtk.TextWindowType.TEXT, x, y)
         iter_at_xy = view.get_iter_at_location(buff_x, buff_y)
-        offset = iter_at_xy.get_offset()
+        line = iter_at_xy.get_line() + self.trimmed_lines
+        offset = iter_at_xy.get_line_offset()
 
         # find the first link that contains the offset
-        for lnk in self.links:
+        for lnk in self.line_links.get(line, []):
             if offset >= lnk.start and offset <= lnk.end:
                 return lnk
 
@@ -229,10 +330,166 @@ class OutputPanel(UniqueById):
         if link is None:
             return False
 
-        gfile = self.file_lookup.lookup(link.path)
+        gfile = self.panel.file_lookup.lookup(link.path)
 
         if gfile:
             Gedit.commands_load_location(self.window, gfile, None, link.line_nr, link.col_nr)
             GLib.idle_add(self.idle_grab_focus)
 
+
+class OutputPanel(UniqueById):
+    """
+    The output of the tools of a window, with one page for each tool.
+    """
+
+    def __init__(self, datadir, window):
+        if UniqueById.__init__(self, window):
+            return
+
+        callbacks = {
+            'on_stop_clicked': self.on_stop_clicked,
+            'on_notebook_switch_page': self.on_notebook_switch_page
+        }
+
+        self.profile_settings = self.get_profile_settings()
+        self.profile_settings.connect("changed", self.font_changed)
+        self.system_settings = Gio.Settings.new("org.gnome.desktop.interface")
+        self.system_settings.connect("changed::monospace-font-name", self.font_changed)
+
+        self.window = window
+        self.ui = Gtk.Builder()
+        self.ui.add_from_file(os.path.join(datadir, 'ui', 'outputpanel.ui'))
+        self.ui.connect_signals(callbacks)
+
+        self.panel = self["output-panel"]
+
+        # Shared by the views, so that the tags can be used with all of them
+        self.tag_table = Gtk.TextTagTable()
+
+        self.normal_tag = self.create_tag('normal')
+
+        self.error_tag = self.create_tag('error')
+        self.error_tag.set_property('foreground', 'red')
+
+        self.italic_tag = self.create_tag('italic')
+        self.italic_tag.set_property('style', Pango.Style.OBLIQUE)
+
+        self.bold_tag = self.create_tag('bold')
+        self.bold_tag.set_property('weight', Pango.Weight.BOLD)
+
+        self.invalid_link_tag = self.create_tag('invalid_link')
+
+        self.link_tag = self.create_tag('link')
+        self.link_tag.set_property('underline', Pango.Underline.SINGLE)
+
+        self.link_cursor = Gdk.Cursor.new(Gdk.CursorType.HAND2)
+        self.normal_cursor = Gdk.Cursor.new(Gdk.CursorType.XTERM)
+
+        # Tool -> OutputView
+        self.views = {}
+
+        self.link_parser = linkparsing.LinkParser()
+        self.file_lookup = filelookup.FileLookup(window)
+
+        self.font_changed()
+
+    def create_tag(self, name):
+        tag = Gtk.TextTag(name=name)
+        self.tag_table.add(tag)
+        return tag
+
+    def get_profile_settings(self):
+        #FIXME return either the gnome-terminal settings or the gedit one
+        return Gio.Settings.new("org.gnome.gedit.plugins.externaltools")
+
+    def font_changed(self, settings=None, key=None):
+        if self.profile_settings.get_boolean("use-system-font"):
+            font = self.system_settings.get_string("monospace-font-name")
+        else:
+            font = self.profile_settings.get_string("font")
+
+        self.font_desc = Pango.font_description_from_string(font)
+
+        for view in self.views.values():
+            view.view.override_font(self.font_desc)
+
+    def __getitem__(self, key):
+        # Convenience function to get an object from its name
+        return self.ui.get_object(key)
+
+    def get_view(self, tool, label):
+        """
+        Gets the output view of a tool, created the first time.
+        """
+        if tool in self.views:
+            return self.views[tool]
+
+        view = OutputView(self, label)
+        view.view.override_font(self.font_desc)
+        self.views[tool] = view
+
+        box = Gtk.Box(orientation=Gtk.Orientation.HORIZONTAL, spacing=4)
+        box.pack_start(Gtk.Label(label=label), True, True, 0)
+
+        close = Gtk.Button(relief=Gtk.ReliefStyle.NONE, focus_on_click=False)
+        close.set_tooltip_text(_('Close'))
+        close.add(Gtk.Image.new_from_icon_name('window-close-symbolic', Gtk.IconSize.MENU))
+        close.connect('clicked', self.on_close_clicked, tool)
+        box.pack_start(close, False, False, 0)
+        box.show_all()
+
+        notebook = self['notebook']
+        notebook.append_page(view.widget, box)
+        notebook.set_tab_reorderable(view.widget, True)
+        notebook.set_show_tabs(notebook.get_n_pages() > 1)
+
+        return view
+
+    def get_current_view(self):
+        notebook = self['notebook']
+        page = notebook.get_nth_page(notebook.get_current_page())
+
+        for view in self.views.values():
+            if view.widget is page:
+                return view
+
+        return None
+
+    def update_stop(self):
+        view = self.get_current_view()
+        self['stop'].set_sensitive(view is not None and view.process is not None)
+
+    def on_stop_clicked(self, widget, *args):
+        view = self.get_current_view()
+
+        if view is not None:
+            view.stop()
+
+    def on_close_clicked(self, button, tool):
+        view = self.views.pop(tool)
+        view.stop()
+        view.destroy()
+
+        notebook = self['notebook']
+        notebook.remove_page(notebook.page_num(view.widget))
+        notebook.set_show_tabs(notebook.get_n_pages() > 1)
+
+        self.update_stop()
+
+    def on_notebook_switch_page(self, notebook, page, page_num):
+        GLib.idle_add(self.update_stop)
+
+    def visible(self):
+        panel = self.window.get_bottom_panel()
+        return panel.props.visible and panel.props.visible_child == self.panel
+
+    def show(self, view=None):
+        if view is not None:
+            notebook = self['notebook']
+            notebook.set_current_page(notebook.page_num(view.widget))
+
+        panel = self.window.get_bottom_panel()
+        panel.props.visible_child = self.panel
+        panel.show()
+
 # ex:ts=4:et:
@@ -26,6 +26,9 @@
 #define MESSAGE_OBJECT_PATH 	"/plugins/filebrowser"
 #define WINDOW_DATA_KEY	       	"GeditFileBrowserMessagesWindowData"
 
+/* Upper bound of the pending uris of the batch messages */
+#define MAX_BATCH_SIZE		1000
+
 #define BUS_CONNECT(bus, name, data) gedit_message_bus_connect(bus, MESSAGE_OBJECT_PATH, #name, (GeditMessageCallback)  message_##name##_cb, data, NULL)
 #define BUS_DISCONNECT(bus, name, data) gedit_message_bus_disconnect_by_func(bus, MESSAGE_OBJECT_PATH, #name, (GeditMessageCallback)  message_##name##_cb, data)
 
@@ -48,6 +51,20 @@ typedef struct
 	GHashTable *row_tracking;
 
 	GHashTable *filters;
+
+	/* The per row messages are only built when somebody listens to them */
+	GeditMessageHandle *inserted_handle;
+	GeditMessageHandle *deleted_handle;
+
+	/* Uris of the rows not sent yet with inserted_batch or deleted_batch.
+	 * Only one of them is non empty at a time, to keep the order of the
+	 * notifications.
+	 */
+	GeditMessageHandle *inserted_batch_handle;
+	GeditMessageHandle *deleted_batch_handle;
+	GPtrArray *pending_inserted;
+	GPtrArray *pending_deleted;
+	guint flush_batches_id;
 } WindowData;
 
 typedef struct
@@ -56,6 +73,12 @@ typedef struct
 
 	GeditWindow  *window;
 	GeditMessage *message;
+
+	/* For the filters receiving a batch of uris: maps the uris of the last
+	 * batch to whether they are filtered.
+	 */
+	gboolean batch;
+	GHashTable *batch_results;
 } FilterData;
 
 static WindowData *
@@ -76,6 +99,23 @@ window_data_new (GeditWindow            *window,
 					       (GDestroyNotify)g_free,
 					       NULL);
 
+	data->inserted_handle = gedit_message_bus_get_handle (data->bus,
+							      MESSAGE_OBJECT_PATH,
+							      "inserted");
+	data->deleted_handle = gedit_message_bus_get_handle (data->bus,
+							     MESSAGE_OBJECT_PATH,
+							     "deleted");
+	data->inserted_batch_handle = gedit_message_bus_get_handle (data->bus,
+								    MESSAGE_OBJECT_PATH,
+								    "inserted_batch");
+	data->deleted_batch_handle = gedit_message_bus_get_handle (data->bus,
+								   MESSAGE_OBJECT_PATH,
+								   "deleted_batch");
+
+	data->pending_inserted = g_ptr_array_new_with_free_func (g_free);
+	data->pending_deleted = g_ptr_array_new_with_free_func (g_free);
+	data->flush_batches_id = 0;
+
 	g_object_set_data (G_OBJECT (window), WINDOW_DATA_KEY, data);
 
 	return data;
@@ -95,6 +135,19 @@ window_data_free (GeditWindow *window)
 	g_hash_table_destroy (data->row_tracking);
 	g_hash_table_destroy (data->filters);
 
+	gedit_message_handle_unref (data->inserted_handle);
+	gedit_message_handle_unref (data->deleted_handle);
+	gedit_message_handle_unref (data->inserted_batch_handle);
+	gedit_message_handle_unref (data->deleted_batch_handle);
+
+	if (data->flush_batches_id != 0)
+	{
+		g_source_remove (data->flush_batches_id);
+	}
+
+	g_ptr_array_unref (data->pending_inserted);
+	g_ptr_array_unref (data->pending_deleted);
+
 	g_slice_free (WindowData, data);
 
 	g_object_set_data (G_OBJECT (window), WINDOW_DATA_KEY, NULL);
@@ -102,7 +155,8 @@ window_data_free (GeditWindow *window)
 
 static FilterData *
 filter_data_new (GeditWindow  *window,
-		 GeditMessage *message)
+		 GeditMessage *message,
+		 gboolean      batch)
 {
 	FilterData *data = g_slice_new (FilterData);
 	WindowData *wdata;
@@ -110,6 +164,16 @@ filter_data_new (GeditWindow  *window,
 	data->window = window;
 	data->id = 0;
 	data->message = message;
+	data->batch = batch;
+	data->batch_results = NULL;
+
+	if (batch)
+	{
+		data->batch_results = g_hash_table_new_full (g_str_hash,
+							     g_str_equal,
+							     (GDestroyNotify)g_free,
+							     NULL);
+	}
 
 	wdata = get_window_data (window);
 
@@ -133,6 +197,11 @@ filter_data_free (FilterData *data)
 	g_hash_table_remove (wdata->filters, identifier);
 	g_free (identifier);
 
+	if (data->batch_results != NULL)
+	{
+		g_hash_table_destroy (data->batch_results);
+	}
+
 	g_object_unref (data->message);
 	g_slice_free (FilterData, data);
 }
@@ -431,6 +500,111 @@ set_item_message (WindowData   *data,
 	g_free (name);
 }
 
+static void
+send_filter_batch (WindowData *wdata,
+		   FilterData *data,
+		   gchar     **uris)
+{
+	gchar **filtered = NULL;
+	gint i;
+
+	g_hash_table_remove_all (data->batch_results);
+
+	g_object_set (data->message,
+		      "uris", uris,
+		      "filtered", NULL,
+		      NULL);
+
+	gedit_message_bus_send_message_sync (wdata->bus, data->message);
+	g_object_get (data->message, "filtered", &filtered, NULL);
+
+	for (i = 0; uris[i] != NULL; i++)
+	{
+		g_hash_table_insert (data->batch_results,
+				     g_strdup (uris[i]),
+				     GINT_TO_POINTER (FALSE));
+	}
+
+	for (i = 0; filtered != NULL && filtered[i] != NULL; i++)
+	{
+		g_hash_table_insert (data->batch_results,
+				     g_strdup (filtered[i]),
+				     GINT_TO_POINTER (TRUE));
+	}
+
+	/* Do not keep the uris alive in the message */
+	g_object_set (data->message,
+		      "uris", NULL,
+		      "filtered", NULL,
+		      NULL);
+
+	g_strfreev (filtered);
+}
+
+static void
+store_prefilter (GeditFileBrowserStore *store,
+		 GPtrArray             *locations,
+		 WindowData            *wdata)
+{
+	GHashTableIter iter;
+	FilterData *data;
+	gchar **uris = NULL;
+
+	g_hash_table_iter_init (&iter, wdata->filters);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&data))
+	{
+		if (!data->batch)
+		{
+			continue;
+		}
+
+		if (uris == NULL)
+		{
+			guint i;
+
+			uris = g_new (gchar *, locations->len + 1);
+
+			for (i = 0; i < locations->len; i++)
+			{
+				uris[i] = g_file_get_uri (g_ptr_array_index (locations, i));
+			}
+
+			uris[locations->len] = NULL;
+		}
+
+		send_filter_batch (wdata, data, uris);
+	}
+
+	g_strfreev (uris);
+}
+
+static gboolean
+custom_message_batch_filter (WindowData *wdata,
+			     FilterData *data,
+			     GFile      *location)
+{
+	gchar *uri;
+	gpointer filter;
+
+	uri = g_file_get_uri (location);
+
+	/* The row is not part of the last batch, for instance when the filter
+	 * mode changes: send a batch with this single row.
+	 */
+	if (!g_hash_table_lookup_extended (data->batch_results, uri, NULL, &filter))
+	{
+		gchar *uris[2] = { uri, NULL };
+
+		send_filter_batch (wdata, data, uris);
+		filter = g_hash_table_lookup (data->batch_results, uri);
+	}
+
+	g_free (uri);
+
+	return GPOINTER_TO_INT (filter);
+}
+
 static gboolean
 custom_message_filter_func (GeditFileBrowserWidget *widget,
 			    GeditFileBrowserStore  *store,
@@ -451,6 +625,14 @@ custom_message_filter_func (GeditFileBrowserWidget *widget,
 	if (!location || FILE_IS_DUMMY (flags))
 		return FALSE;
 
+	if (data->batch)
+	{
+		filter = custom_message_batch_filter (wdata, data, location);
+		g_object_unref (location);
+
+		return !filter;
+	}
+
 	path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), iter);
 	set_item_message (wdata, iter, path, data->message);
 	gtk_tree_path_free (path);
@@ -477,6 +659,7 @@ message_add_filter_cb (GeditMessageBus *bus,
 	FilterData *filter_data;
 	WindowData *data;
 	GType message_type;
+	gboolean batch;
 
 	data = get_window_data (window);
 
@@ -490,26 +673,42 @@ message_add_filter_cb (GeditMessageBus *bus,
 		return;
 	}
 
-	/* Check if the message type has the correct arguments */
-	if (!gedit_message_type_check (message_type, "id", G_TYPE_STRING) ||
-	    !gedit_message_type_check (message_type, "location", G_TYPE_FILE) ||
-	    !gedit_message_type_check (message_type, "is-directory", G_TYPE_BOOLEAN) ||
-	    !gedit_message_type_check (message_type, "filter", G_TYPE_BOOLEAN))
+	/* A filter message with a list of uris, and the list of those to
+	 * filter out, receives the rows in batches.
+	 */
+	batch = gedit_message_type_check (message_type, "uris", G_TYPE_STRV) &&
+	        gedit_message_type_check (message_type, "filtered", G_TYPE_STRV);
+
+	if (batch)
 	{
-		return;
+		cbmessage = g_object_new (message_type,
+		                          "object-path", object_path,
+		                          "method", method,
+		                          NULL);
 	}
+	else
+	{
+		/* Check if the message type has the correct arguments */
+		if (!gedit_message_type_check (message_type, "id", G_TYPE_STRING) ||
+		    !gedit_message_type_check (message_type, "location", G_TYPE_FILE) ||
+		    !gedit_message_type_check (message_type, "is-directory", G_TYPE_BOOLEAN) ||
+		    !gedit_message_type_check (message_type, "filter", G_TYPE_BOOLEAN))
+		{
+			return;
+		}
 
-	cbmessage = g_object_new (message_type,
-	                          "object-path", object_path,
-	                          "method", method,
-	                          "id", NULL,
-	                          "location", NULL,
-	                          "is-directory", FALSE,
-	                          "filter", FALSE,
-	                          NULL);
+		cbmessage = g_object_new (message_type,
+		                          "object-path", object_path,
+		                          "method", method,
+		                          "id", NULL,
+		                          "location", NULL,
+		                          "is-directory", FALSE,
+		                          "filter", FALSE,
+		                          NULL);
+	}
 
 	/* Register the custom filter on the widget */
-	filter_data = filter_data_new (window, cbmessage);
+	filter_data = filter_data_new (window, cbmessage, batch);
 
 	id = gedit_file_browser_widget_add_filter (data->widget,
 	                                           (GeditFileBrowserWidgetFilterFunc)custom_message_filter_func,
@@ -766,6 +965,84 @@ register_methods (GeditWindow            *window,
 	BUS_CONNECT (bus, get_view, data);
 }
 
+static void
+send_batch (WindowData         *data,
+	    GeditMessageHandle *handle,
+	    GPtrArray          *pending)
+{
+	GeditMessage *message;
+
+	if (pending->len == 0)
+	{
+		return;
+	}
+
+	g_ptr_array_add (pending, NULL);
+
+	message = gedit_message_handle_send_sync (handle,
+						  "uris", (gchar **)pending->pdata,
+						  NULL);
+
+	g_clear_object (&message);
+	g_ptr_array_set_size (pending, 0);
+}
+
+static void
+flush_batches (WindowData *data)
+{
+	if (data->flush_batches_id != 0)
+	{
+		g_source_remove (data->flush_batches_id);
+		data->flush_batches_id = 0;
+	}
+
+	send_batch (data, data->inserted_batch_handle, data->pending_inserted);
+	send_batch (data, data->deleted_batch_handle, data->pending_deleted);
+}
+
+static gboolean
+flush_batches_idle (WindowData *data)
+{
+	data->flush_batches_id = 0;
+	flush_batches (data);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+add_to_batch (WindowData  *data,
+	      GPtrArray   *pending,
+	      GPtrArray   *other,
+	      GtkTreeIter *iter)
+{
+	GeditFileBrowserStore *store;
+	GFile *location = NULL;
+
+	/* Keep the order between insertions and deletions */
+	if (other->len > 0 || pending->len >= MAX_BATCH_SIZE)
+	{
+		flush_batches (data);
+	}
+
+	store = gedit_file_browser_widget_get_browser_store (data->widget);
+	gtk_tree_model_get (GTK_TREE_MODEL (store), iter,
+			    GEDIT_FILE_BROWSER_STORE_COLUMN_LOCATION, &location,
+			    -1);
+
+	if (location == NULL)
+	{
+		return;
+	}
+
+	g_ptr_array_add (pending, g_file_get_uri (location));
+	g_object_unref (location);
+
+	if (data->flush_batches_id == 0)
+	{
+		data->flush_batches_id = g_idle_add ((GSourceFunc)flush_batches_idle, data);
+	}
+}
+
 static void
 store_row_inserted (GeditFileBrowserStore *store,
 		    GtkTreePath		  *path,
@@ -782,8 +1059,16 @@ store_row_inserted (GeditFileBrowserStore *store,
 	{
 		WindowData *wdata = get_window_data (data->window);
 
-		set_item_message (wdata, iter, path, data->message);
-		gedit_message_bus_send_message_sync (wdata->bus, data->message);
+		if (gedit_message_handle_has_listeners (wdata->inserted_handle))
+		{
+			set_item_message (wdata, iter, path, data->message);
+			gedit_message_bus_send_message_sync (wdata->bus, data->message);
+		}
+
+		if (gedit_message_handle_has_listeners (wdata->inserted_batch_handle))
+		{
+			add_to_batch (wdata, wdata->pending_inserted, wdata->pending_deleted, iter);
+		}
 	}
 }
 
@@ -806,8 +1091,16 @@ store_row_deleted (GeditFileBrowserStore *store,
 	{
 		WindowData *wdata = get_window_data (data->window);
 
-		set_item_message (wdata, &iter, path, data->message);
-		gedit_message_bus_send_message_sync (wdata->bus, data->message);
+		if (gedit_message_handle_has_listeners (wdata->deleted_handle))
+		{
+			set_item_message (wdata, &iter, path, data->message);
+			gedit_message_bus_send_message_sync (wdata->bus, data->message);
+		}
+
+		if (gedit_message_handle_has_listeners (wdata->deleted_batch_handle))
+		{
+			add_to_batch (wdata, wdata->pending_deleted, wdata->pending_inserted, &iter);
+		}
 	}
 }
 
@@ -826,6 +1119,8 @@ store_virtual_root_changed (GeditFileBrowserStore *store,
 		return;
 	}
 
+	flush_batches (wdata);
+
 	g_object_set (data->message,
 	              "location", vroot,
 	              NULL);
@@ -843,6 +1138,8 @@ store_begin_loading (GeditFileBrowserStore *store,
 	GtkTreePath *path;
 	WindowData *wdata = get_window_data (data->window);
 
+	flush_batches (wdata);
+
 	path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), iter);
 
 	set_item_message (wdata, iter, path, data->message);
@@ -859,6 +1156,8 @@ store_end_loading (GeditFileBrowserStore *store,
 	GtkTreePath *path;
 	WindowData *wdata = get_window_data (data->window);
 
+	flush_batches (wdata);
+
 	path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), iter);
 
 	set_item_message (wdata, iter, path, data->message);
@@ -903,6 +1202,17 @@ register_signals (GeditWindow            *window,
 	                            MESSAGE_OBJECT_PATH,
 	                            "deleted");
 
+	/* Same as inserted and deleted, with the uris of several rows */
+	gedit_message_bus_register (bus,
+	                            GEDIT_TYPE_FILE_BROWSER_MESSAGE_URIS,
+	                            MESSAGE_OBJECT_PATH,
+	                            "inserted_batch");
+
+	gedit_message_bus_register (bus,
+	                            GEDIT_TYPE_FILE_BROWSER_MESSAGE_URIS,
+	                            MESSAGE_OBJECT_PATH,
+	                            "deleted_batch");
+
 	store = gedit_file_browser_widget_get_browser_store (widget);
 
 	message = g_object_new (GEDIT_TYPE_FILE_BROWSER_MESSAGE_ID_LOCATION,
@@ -971,6 +1281,10 @@ register_signals (GeditWindow            *window,
 		                       message_cache_data_new (window, message),
 		                       (GClosureNotify)message_cache_data_free,
 		                       0);
+
+	gedit_file_browser_store_set_prefilter_func (store,
+	                                             (GeditFileBrowserStorePrefilterFunc)store_prefilter,
+	                                             data);
 }
 
 static void
@@ -1027,6 +1341,8 @@ cleanup_signals (GeditWindow *window)
 	g_signal_handler_disconnect (store, data->begin_loading_id);
 	g_signal_handler_disconnect (store, data->end_loading_id);
 
+	gedit_file_browser_store_set_prefilter_func (store, NULL, NULL);
+
 	g_signal_handlers_disconnect_by_func (data->bus, message_unregistered, window);
 }
 
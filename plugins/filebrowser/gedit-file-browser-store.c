@@ -26,6 +26,7 @@
 #include <glib/gi18n-lib.h>
 #include <gio/gio.h>
 #include <gedit/gedit-utils.h>
+#include <gedit/gedit-debug.h>
 
 #include "gedit-file-browser-store.h"
 #include "gedit-file-browser-marshal.h"
@@ -73,6 +74,9 @@ struct _AsyncNode
 	FileBrowserNodeDir *dir;
 	GCancellable *cancellable;
 	GSList *original_children;
+
+	/* Profiling span of the directory loading */
+	gint64 span;
 };
 
 typedef struct {
@@ -117,6 +121,9 @@ struct _GeditFileBrowserStorePrivate
 	GeditFileBrowserStoreFilterFunc filter_func;
 	gpointer filter_user_data;
 
+	GeditFileBrowserStorePrefilterFunc prefilter_func;
+	gpointer prefilter_user_data;
+
 	gchar **binary_patterns;
 	GPtrArray *binary_pattern_specs;
 
@@ -2223,6 +2230,9 @@ model_add_nodes_from_files (GeditFileBrowserStore *model,
 {
 	GList *item;
 	GSList *nodes = NULL;
+	GSList *infos = NULL;
+	GSList *l;
+	GSList *i;
 
 	for (item = files; item; item = item->next)
 	{
@@ -2263,17 +2273,44 @@ model_add_nodes_from_files (GeditFileBrowserStore *model,
 			else
 				node = file_browser_node_new (file, parent);
 
-			file_browser_node_set_from_info (model, node, info, FALSE);
-
 			nodes = g_slist_prepend (nodes, node);
+			infos = g_slist_prepend (infos, info);
+		}
+		else
+		{
+			g_object_unref (info);
 		}
 
 		g_object_unref (file);
-		g_object_unref (info);
 	}
 
-	if (nodes)
-		model_add_nodes_batch (model, nodes, parent);
+	if (nodes == NULL)
+		return;
+
+	/* Let the prefilter see the whole chunk before the visibility of
+	 * each node is computed */
+	if (model->priv->prefilter_func != NULL)
+	{
+		GPtrArray *locations;
+
+		locations = g_ptr_array_new ();
+
+		for (l = nodes; l; l = l->next)
+			g_ptr_array_add (locations, ((FileBrowserNode *)l->data)->file);
+
+		model->priv->prefilter_func (model,
+					     locations,
+					     model->priv->prefilter_user_data);
+
+		g_ptr_array_unref (locations);
+	}
+
+	for (l = nodes, i = infos; l; l = l->next, i = i->next)
+		file_browser_node_set_from_info (model, l->data, i->data, FALSE);
+
+	g_slist_free_full (infos, g_object_unref);
+
+	model_add_nodes_batch (model, nodes, parent);
 }
 
 static FileBrowserNode *
@@ -2351,12 +2388,25 @@ model_iterate_next_files_cb (GFileEnumerator *enumerator,
 
 	if (files == NULL)
 	{
+		gint64 span = async->span;
+
 		g_file_enumerator_close (enumerator, NULL, NULL);
 		g_object_unref (enumerator);
 		async_node_free (async);
 
 		if (!error)
 		{
+			if (span != 0)
+			{
+				gchar *basename;
+
+				basename = g_file_get_basename (parent->file);
+				gedit_debug_span_end (GEDIT_DEBUG_PLUGINS, span,
+						      "filebrowser-load-directory",
+						      basename);
+				g_free (basename);
+			}
+
 			/* We're done loading */
 			g_object_unref (dir->cancellable);
 			dir->cancellable = NULL;
@@ -2411,7 +2461,11 @@ model_iterate_next_files_cb (GFileEnumerator *enumerator,
 	}
 	else
 	{
+		gint64 span;
+
+		span = gedit_debug_span_begin (GEDIT_DEBUG_PLUGINS);
 		model_add_nodes_from_files (dir->model, parent, async->original_children, files);
+		gedit_debug_span_end (GEDIT_DEBUG_PLUGINS, span, "filebrowser-add-files", NULL);
 
 		g_list_free (files);
 		next_files_async (enumerator, async);
@@ -2492,6 +2546,7 @@ model_load_directory (GeditFileBrowserStore *model,
 	async->dir = dir;
 	async->cancellable = g_object_ref (dir->cancellable);
 	async->original_children = g_slist_copy (dir->children);
+	async->span = gedit_debug_span_begin (GEDIT_DEBUG_PLUGINS);
 
 	/* Start loading async */
 	g_file_enumerate_children_async (node->file,
@@ -3333,6 +3388,20 @@ gedit_file_browser_store_set_filter_func (GeditFileBrowserStore           *model
 	model_refilter (model);
 }
 
+/* The prefilter function is called with the locations of each chunk of files
+ * read from a directory, before the filter function is called on each of them.
+ */
+void
+gedit_file_browser_store_set_prefilter_func (GeditFileBrowserStore              *model,
+					     GeditFileBrowserStorePrefilterFunc  func,
+					     gpointer                            user_data)
+{
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+
+	model->priv->prefilter_func = func;
+	model->priv->prefilter_user_data = user_data;
+}
+
 const gchar * const *
 gedit_file_browser_store_get_binary_patterns (GeditFileBrowserStore *model)
 {
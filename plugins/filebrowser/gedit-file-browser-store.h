@@ -87,6 +87,10 @@ typedef gboolean (*GeditFileBrowserStoreFilterFunc) (GeditFileBrowserStore *mode
 						     GtkTreeIter           *iter,
 						     gpointer               user_data);
 
+typedef void (*GeditFileBrowserStorePrefilterFunc) (GeditFileBrowserStore *model,
+						    GPtrArray             *locations,
+						    gpointer               user_data);
+
 struct _GeditFileBrowserStore
 {
 	GObject parent;
@@ -166,6 +170,9 @@ void		 gedit_file_browser_store_set_filter_mode	(GeditFileBrowserStore
 void		 gedit_file_browser_store_set_filter_func	(GeditFileBrowserStore            *model,
 								 GeditFileBrowserStoreFilterFunc   func,
 								 gpointer                          user_data);
+void		 gedit_file_browser_store_set_prefilter_func	(GeditFileBrowserStore              *model,
+								 GeditFileBrowserStorePrefilterFunc  func,
+								 gpointer                            user_data);
 
 const gchar * const *
                  gedit_file_browser_store_get_binary_patterns	(GeditFileBrowserStore            *model);
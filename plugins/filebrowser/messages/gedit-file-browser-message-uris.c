@@ -0,0 +1,126 @@
+
+/*
+ * gedit-file-browser-message-uris.c
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-file-browser-message-uris.h"
+
+enum
+{
+	PROP_0,
+
+	PROP_URIS,
+};
+
+struct _GeditFileBrowserMessageUrisPrivate
+{
+	gchar **uris;
+};
+
+G_DEFINE_TYPE_EXTENDED (GeditFileBrowserMessageUris,
+                        gedit_file_browser_message_uris,
+                        GEDIT_TYPE_MESSAGE,
+                        0,
+                        G_ADD_PRIVATE (GeditFileBrowserMessageUris))
+
+static void
+gedit_file_browser_message_uris_finalize (GObject *obj)
+{
+	GeditFileBrowserMessageUris *msg = GEDIT_FILE_BROWSER_MESSAGE_URIS (obj);
+
+	if (msg->priv->uris != NULL)
+	{
+		g_boxed_free (G_TYPE_STRV, msg->priv->uris);
+	}
+
+	G_OBJECT_CLASS (gedit_file_browser_message_uris_parent_class)->finalize (obj);
+}
+
+static void
+gedit_file_browser_message_uris_get_property (GObject    *obj,
+                                              guint       prop_id,
+                                              GValue     *value,
+                                              GParamSpec *pspec)
+{
+	GeditFileBrowserMessageUris *msg;
+
+	msg = GEDIT_FILE_BROWSER_MESSAGE_URIS (obj);
+
+	switch (prop_id)
+	{
+		case PROP_URIS:
+			g_value_set_boxed (value, msg->priv->uris);
+			break;
+	}
+}
+
+static void
+gedit_file_browser_message_uris_set_property (GObject      *obj,
+                                              guint         prop_id,
+                                              GValue const *value,
+                                              GParamSpec   *pspec)
+{
+	GeditFileBrowserMessageUris *msg;
+
+	msg = GEDIT_FILE_BROWSER_MESSAGE_URIS (obj);
+
+	switch (prop_id)
+	{
+		case PROP_URIS:
+		{
+			if (msg->priv->uris != NULL)
+			{
+				g_boxed_free (G_TYPE_STRV, msg->priv->uris);
+			}
+			msg->priv->uris = g_value_dup_boxed (value);
+			break;
+		}
+	}
+}
+
+static void
+gedit_file_browser_message_uris_class_init (GeditFileBrowserMessageUrisClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	object_class->finalize = gedit_file_browser_message_uris_finalize;
+
+	object_class->get_property = gedit_file_browser_message_uris_get_property;
+	object_class->set_property = gedit_file_browser_message_uris_set_property;
+
+	g_object_class_install_property (object_class,
+	                                 PROP_URIS,
+	                                 g_param_spec_boxed ("uris",
+	                                                     "Uris",
+	                                                     "Uris",
+	                                                     G_TYPE_STRV,
+	                                                     G_PARAM_READWRITE |
+	                                                     G_PARAM_CONSTRUCT |
+	                                                     G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gedit_file_browser_message_uris_init (GeditFileBrowserMessageUris *message)
+{
+	message->priv = gedit_file_browser_message_uris_get_instance_private (message);
+}
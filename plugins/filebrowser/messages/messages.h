@@ -11,6 +11,7 @@
 #include "gedit-file-browser-message-set-emblem.h"
 #include "gedit-file-browser-message-set-markup.h"
 #include "gedit-file-browser-message-set-root.h"
+#include "gedit-file-browser-message-uris.h"
 
 #endif /* __GEDIT_FILE_BROWER_MESSAGES_MESSAGES_H__ */
 
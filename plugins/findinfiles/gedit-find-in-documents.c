@@ -0,0 +1,802 @@
+/*
+ * gedit-find-in-documents.c
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-find-in-documents.h"
+
+#include <string.h>
+
+#include <gedit/gedit-debug.h>
+#include <gedit/gedit-utils.h>
+
+/* The documents are searched in the main loop, a chunk at a time, and the
+ * search gives the control back after this time.
+ */
+#define TIME_SLICE_USEC 5000
+
+#define CHUNK_LINES 500
+#define CHUNK_SIZE (64 * 1024)
+
+/* A modified document is searched again when it has not changed for this
+ * time.
+ */
+#define CHANGED_TIMEOUT_MSEC 300
+
+#define MAX_DOCUMENT_MATCHES 10000
+
+#define MAX_LINE_LENGTH 256
+
+typedef enum
+{
+	SCAN_STATE_IDLE,
+	SCAN_STATE_QUEUED,
+	SCAN_STATE_LOADING
+} ScanState;
+
+typedef struct
+{
+	GeditFindInDocuments *search;
+	GeditTab *tab;
+	GeditDocument *doc;
+
+	ScanState state;
+
+	/* Start of the next chunk to search */
+	guint line;
+	gsize offset;
+
+	/* The contents of the file, for a tab which is not loaded */
+	gchar *contents;
+	gsize length;
+	GCancellable *cancellable;
+
+	GPtrArray *matches;
+
+	guint changed_id;
+} DocumentScan;
+
+struct _GeditFindInDocumentsPrivate
+{
+	GeditWindow *window;
+
+	/* The same regex is used for all the documents. */
+	GRegex *regex;
+
+	/* mapping from GeditTab to DocumentScan */
+	GHashTable *scans;
+
+	/* The queued DocumentScan, the head is being searched */
+	GQueue queue;
+
+	guint n_loading;
+	guint idle_id;
+
+	guint running : 1;
+};
+
+enum
+{
+	TAB_UPDATED,
+	TAB_REMOVED,
+	FINISHED,
+	LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFindInDocuments,
+				gedit_find_in_documents,
+				G_TYPE_OBJECT,
+				0,
+				G_ADD_PRIVATE_DYNAMIC (GeditFindInDocuments))
+
+static void
+match_free (GeditFindInDocumentsMatch *match)
+{
+	g_free (match->text);
+	g_slice_free (GeditFindInDocumentsMatch, match);
+}
+
+static void
+stop_scan (DocumentScan *scan)
+{
+	GeditFindInDocumentsPrivate *priv = scan->search->priv;
+
+	if (scan->state == SCAN_STATE_QUEUED)
+	{
+		g_queue_remove (&priv->queue, scan);
+	}
+	else if (scan->state == SCAN_STATE_LOADING)
+	{
+		priv->n_loading--;
+	}
+
+	scan->state = SCAN_STATE_IDLE;
+
+	if (scan->cancellable != NULL)
+	{
+		g_cancellable_cancel (scan->cancellable);
+		g_clear_object (&scan->cancellable);
+	}
+
+	if (scan->changed_id != 0)
+	{
+		g_source_remove (scan->changed_id);
+		scan->changed_id = 0;
+	}
+
+	g_clear_pointer (&scan->contents, g_free);
+	scan->length = 0;
+	scan->line = 0;
+	scan->offset = 0;
+
+	g_ptr_array_set_size (scan->matches, 0);
+}
+
+static void
+document_scan_free (DocumentScan *scan)
+{
+	stop_scan (scan);
+
+	g_signal_handlers_disconnect_by_data (scan->doc, scan);
+	g_signal_handlers_disconnect_by_data (scan->tab, scan);
+
+	g_ptr_array_unref (scan->matches);
+	g_object_unref (scan->tab);
+	g_slice_free (DocumentScan, scan);
+}
+
+static void
+clear_scans (GeditFindInDocuments *search)
+{
+	GeditFindInDocumentsPrivate *priv = search->priv;
+
+	priv->running = FALSE;
+
+	if (priv->idle_id != 0)
+	{
+		g_source_remove (priv->idle_id);
+		priv->idle_id = 0;
+	}
+
+	if (priv->window != NULL)
+	{
+		g_signal_handlers_disconnect_by_data (priv->window, search);
+	}
+
+	g_hash_table_remove_all (priv->scans);
+}
+
+static void
+gedit_find_in_documents_dispose (GObject *object)
+{
+	GeditFindInDocuments *search = GEDIT_FIND_IN_DOCUMENTS (object);
+
+	clear_scans (search);
+
+	g_clear_object (&search->priv->window);
+
+	G_OBJECT_CLASS (gedit_find_in_documents_parent_class)->dispose (object);
+}
+
+static void
+gedit_find_in_documents_finalize (GObject *object)
+{
+	GeditFindInDocuments *search = GEDIT_FIND_IN_DOCUMENTS (object);
+
+	if (search->priv->regex != NULL)
+	{
+		g_regex_unref (search->priv->regex);
+	}
+
+	g_hash_table_unref (search->priv->scans);
+
+	G_OBJECT_CLASS (gedit_find_in_documents_parent_class)->finalize (object);
+}
+
+static void
+gedit_find_in_documents_class_init (GeditFindInDocumentsClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gedit_find_in_documents_dispose;
+	object_class->finalize = gedit_find_in_documents_finalize;
+
+	/**
+	 * GeditFindInDocuments::tab-updated:
+	 * @search: the #GeditFindInDocuments.
+	 * @tab: the #GeditTab which has been searched.
+	 * @matches: (element-type GeditFindInDocumentsMatch): all the
+	 *   matches in the document of @tab, owned by @search.
+	 *
+	 * Emitted each time a document has been searched, when the search
+	 * starts and then when the document changes.
+	 */
+	signals[TAB_UPDATED] =
+		g_signal_new ("tab-updated",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GeditFindInDocumentsClass, tab_updated),
+			      NULL, NULL, NULL,
+			      G_TYPE_NONE,
+			      2,
+			      GEDIT_TYPE_TAB,
+			      G_TYPE_POINTER);
+
+	signals[TAB_REMOVED] =
+		g_signal_new ("tab-removed",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GeditFindInDocumentsClass, tab_removed),
+			      NULL, NULL, NULL,
+			      G_TYPE_NONE,
+			      1,
+			      GEDIT_TYPE_TAB);
+
+	/**
+	 * GeditFindInDocuments::finished:
+	 * @search: the #GeditFindInDocuments.
+	 *
+	 * Emitted when all the documents waiting to be searched have been
+	 * searched. The documents which change afterwards are searched again.
+	 */
+	signals[FINISHED] =
+		g_signal_new ("finished",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GeditFindInDocumentsClass, finished),
+			      NULL, NULL, NULL,
+			      G_TYPE_NONE,
+			      0);
+}
+
+static void
+gedit_find_in_documents_class_finalize (GeditFindInDocumentsClass *klass)
+{
+}
+
+static void
+gedit_find_in_documents_init (GeditFindInDocuments *search)
+{
+	search->priv = gedit_find_in_documents_get_instance_private (search);
+
+	search->priv->scans = g_hash_table_new_full (g_direct_hash,
+						     g_direct_equal,
+						     NULL,
+						     (GDestroyNotify) document_scan_free);
+
+	g_queue_init (&search->priv->queue);
+}
+
+/**
+ * gedit_find_in_documents_new:
+ * @window: the #GeditWindow whose documents are searched.
+ * @search_text: the text to search.
+ * @regex_enabled: whether @search_text is a regular expression.
+ * @case_sensitive: whether the search is case sensitive.
+ * @error: location of a #GError, or %NULL.
+ *
+ * Returns: a new #GeditFindInDocuments, or %NULL if @search_text is not a
+ * valid regular expression.
+ */
+GeditFindInDocuments *
+gedit_find_in_documents_new (GeditWindow  *window,
+			     const gchar  *search_text,
+			     gboolean      regex_enabled,
+			     gboolean      case_sensitive,
+			     GError      **error)
+{
+	GeditFindInDocuments *search;
+	GRegexCompileFlags flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+	GRegex *regex;
+	gchar *pattern;
+
+	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
+	g_return_val_if_fail (search_text != NULL && search_text[0] != '\0', NULL);
+
+	if (!case_sensitive)
+	{
+		flags |= G_REGEX_CASELESS;
+	}
+
+	if (regex_enabled)
+	{
+		pattern = g_strdup (search_text);
+	}
+	else
+	{
+		pattern = g_regex_escape_string (search_text, -1);
+	}
+
+	regex = gedit_utils_get_regex (pattern, flags, 0, error);
+	g_free (pattern);
+
+	if (regex == NULL)
+	{
+		return NULL;
+	}
+
+	search = g_object_new (GEDIT_TYPE_FIND_IN_DOCUMENTS, NULL);
+
+	search->priv->window = g_object_ref (window);
+	search->priv->regex = regex;
+
+	return search;
+}
+
+static gboolean
+tab_is_loaded (GeditTab *tab)
+{
+	GeditTabState state = gedit_tab_get_state (tab);
+
+	return state != GEDIT_TAB_STATE_LOADING &&
+	       state != GEDIT_TAB_STATE_REVERTING &&
+	       state != GEDIT_TAB_STATE_LOADING_ERROR;
+}
+
+static gboolean scan_idle_cb (GeditFindInDocuments *search);
+
+static void
+enqueue_scan (DocumentScan *scan)
+{
+	GeditFindInDocumentsPrivate *priv = scan->search->priv;
+
+	g_queue_push_tail (&priv->queue, scan);
+	scan->state = SCAN_STATE_QUEUED;
+
+	if (priv->idle_id == 0)
+	{
+		priv->idle_id = g_idle_add ((GSourceFunc) scan_idle_cb, scan->search);
+	}
+}
+
+static void
+restart_scan (DocumentScan *scan)
+{
+	stop_scan (scan);
+	enqueue_scan (scan);
+}
+
+static gboolean
+changed_timeout_cb (DocumentScan *scan)
+{
+	scan->changed_id = 0;
+
+	restart_scan (scan);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* A modified document is searched again once the user pauses. */
+static void
+document_changed_cb (DocumentScan *scan)
+{
+	if (!tab_is_loaded (scan->tab))
+	{
+		return;
+	}
+
+	stop_scan (scan);
+
+	scan->changed_id = g_timeout_add (CHANGED_TIMEOUT_MSEC,
+					  (GSourceFunc) changed_timeout_cb,
+					  scan);
+}
+
+static void
+add_match (DocumentScan *scan,
+	   guint         line,
+	   const gchar  *line_start,
+	   const gchar  *text_end)
+{
+	GeditFindInDocumentsMatch *match;
+	const gchar *line_end;
+	const gchar *valid_end;
+
+	line_end = memchr (line_start, '\n', text_end - line_start);
+
+	if (line_end == NULL)
+	{
+		line_end = text_end;
+	}
+
+	if (line_end > line_start && line_end[-1] == '\r')
+	{
+		line_end--;
+	}
+
+	/* The text is valid UTF-8, only the truncation can make it invalid. */
+	if (line_end - line_start > MAX_LINE_LENGTH)
+	{
+		g_utf8_validate (line_start, MAX_LINE_LENGTH, &valid_end);
+		line_end = valid_end;
+	}
+
+	match = g_slice_new (GeditFindInDocumentsMatch);
+	match->line = line;
+	match->text = g_strndup (line_start, line_end - line_start);
+
+	g_ptr_array_add (scan->matches, match);
+}
+
+/* Searches @text, a chunk of whole lines starting at line @first_line, and
+ * returns the number of newlines in it.
+ */
+static guint
+search_chunk (DocumentScan *scan,
+	      const gchar  *text,
+	      gsize         length,
+	      guint         first_line)
+{
+	GMatchInfo *match_info;
+	const gchar *text_end = text + length;
+	const gchar *pos = text;
+	const gchar *line_start = text;
+	const gchar *nl;
+	guint line = first_line;
+	gboolean line_matched = FALSE;
+
+	g_regex_match_full (scan->search->priv->regex,
+			    text,
+			    length,
+			    0,
+			    0,
+			    &match_info,
+			    NULL);
+
+	while (g_match_info_matches (match_info) &&
+	       scan->matches->len < MAX_DOCUMENT_MATCHES)
+	{
+		gint start_pos;
+
+		g_match_info_fetch_pos (match_info, 0, &start_pos, NULL);
+
+		while ((nl = memchr (pos, '\n', text + start_pos - pos)) != NULL)
+		{
+			line++;
+			pos = nl + 1;
+			line_start = pos;
+			line_matched = FALSE;
+		}
+
+		pos = text + start_pos;
+
+		/* One match per line is enough. */
+		if (!line_matched)
+		{
+			add_match (scan, line, line_start, text_end);
+			line_matched = TRUE;
+		}
+
+		g_match_info_next (match_info, NULL);
+	}
+
+	g_match_info_free (match_info);
+
+	while ((nl = memchr (pos, '\n', text_end - pos)) != NULL)
+	{
+		line++;
+		pos = nl + 1;
+	}
+
+	return line - first_line;
+}
+
+static void
+load_contents_cb (GFile        *location,
+		  GAsyncResult *result,
+		  DocumentScan *scan)
+{
+	gchar *contents = NULL;
+	gsize length = 0;
+	GError *error = NULL;
+
+	if (!g_file_load_contents_finish (location, result, &contents, &length, NULL, &error))
+	{
+		/* The scan has been stopped, and may have been freed. */
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			g_error_free (error);
+			return;
+		}
+
+		gedit_debug_message (DEBUG_PLUGINS, "Cannot read the file: %s", error->message);
+		g_error_free (error);
+	}
+	else if (!g_utf8_validate (contents, length, NULL))
+	{
+		/* Another encoding, it will be searched once the document is
+		 * loaded.
+		 */
+		g_clear_pointer (&contents, g_free);
+	}
+
+	g_clear_object (&scan->cancellable);
+	scan->search->priv->n_loading--;
+
+	if (contents == NULL)
+	{
+		contents = g_strdup ("");
+		length = 0;
+	}
+
+	scan->contents = contents;
+	scan->length = length;
+
+	enqueue_scan (scan);
+}
+
+static void
+load_contents (DocumentScan *scan,
+	       GFile        *location)
+{
+	scan->state = SCAN_STATE_LOADING;
+	scan->search->priv->n_loading++;
+
+	scan->cancellable = g_cancellable_new ();
+
+	g_file_load_contents_async (location,
+				    scan->cancellable,
+				    (GAsyncReadyCallback) load_contents_cb,
+				    scan);
+}
+
+static gboolean
+search_next_buffer_chunk (DocumentScan *scan)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (scan->doc);
+	GtkTextIter start;
+	GtkTextIter end;
+	gint line_count;
+	gchar *text;
+
+	line_count = gtk_text_buffer_get_line_count (buffer);
+
+	if ((gint) scan->line >= line_count)
+	{
+		return TRUE;
+	}
+
+	gtk_text_buffer_get_iter_at_line (buffer, &start, scan->line);
+
+	if ((gint) scan->line + CHUNK_LINES < line_count)
+	{
+		gtk_text_buffer_get_iter_at_line (buffer, &end, scan->line + CHUNK_LINES);
+	}
+	else
+	{
+		gtk_text_buffer_get_end_iter (buffer, &end);
+	}
+
+	text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+	search_chunk (scan, text, strlen (text), scan->line);
+	g_free (text);
+
+	scan->line += CHUNK_LINES;
+
+	return gtk_text_iter_is_end (&end);
+}
+
+static gboolean
+search_next_contents_chunk (DocumentScan *scan)
+{
+	const gchar *text = scan->contents + scan->offset;
+	gsize remaining = scan->length - scan->offset;
+	gsize length;
+
+	length = MIN (CHUNK_SIZE, remaining);
+
+	/* Only whole lines */
+	if (length < remaining)
+	{
+		const gchar *nl;
+
+		nl = memchr (text + length, '\n', remaining - length);
+		length = nl != NULL ? (gsize) (nl - text) + 1 : remaining;
+	}
+
+	scan->line += search_chunk (scan, text, length, scan->line);
+	scan->offset += length;
+
+	return scan->offset >= scan->length;
+}
+
+/* Searches the next chunk of the document, and returns whether the scan is
+ * over or waits for the file to be loaded.
+ */
+static gboolean
+search_next_chunk (DocumentScan *scan)
+{
+	if (scan->matches->len >= MAX_DOCUMENT_MATCHES)
+	{
+		return TRUE;
+	}
+
+	if (scan->contents != NULL)
+	{
+		return search_next_contents_chunk (scan);
+	}
+
+	if (!tab_is_loaded (scan->tab))
+	{
+		GtkSourceFile *file = gedit_document_get_file (scan->doc);
+		GFile *location = gtk_source_file_get_location (file);
+
+		if (location != NULL)
+		{
+			load_contents (scan, location);
+		}
+
+		return TRUE;
+	}
+
+	return search_next_buffer_chunk (scan);
+}
+
+static gboolean
+scan_idle_cb (GeditFindInDocuments *search)
+{
+	GeditFindInDocumentsPrivate *priv = search->priv;
+	gint64 deadline;
+
+	deadline = g_get_monotonic_time () + TIME_SLICE_USEC;
+
+	while (!g_queue_is_empty (&priv->queue))
+	{
+		DocumentScan *scan = g_queue_peek_head (&priv->queue);
+
+		if (search_next_chunk (scan))
+		{
+			g_queue_pop_head (&priv->queue);
+
+			if (scan->state == SCAN_STATE_QUEUED)
+			{
+				scan->state = SCAN_STATE_IDLE;
+				g_clear_pointer (&scan->contents, g_free);
+
+				g_signal_emit (search, signals[TAB_UPDATED], 0, scan->tab, scan->matches);
+
+				/* Cancelled by a signal handler */
+				if (!priv->running)
+				{
+					return G_SOURCE_REMOVE;
+				}
+			}
+		}
+
+		if (g_get_monotonic_time () >= deadline)
+		{
+			return G_SOURCE_CONTINUE;
+		}
+	}
+
+	priv->idle_id = 0;
+
+	if (priv->n_loading == 0)
+	{
+		g_signal_emit (search, signals[FINISHED], 0);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+add_tab (GeditFindInDocuments *search,
+	 GeditTab             *tab)
+{
+	DocumentScan *scan;
+
+	scan = g_slice_new0 (DocumentScan);
+	scan->search = search;
+	scan->tab = g_object_ref (tab);
+	scan->doc = gedit_tab_get_document (tab);
+	scan->matches = g_ptr_array_new_with_free_func ((GDestroyNotify) match_free);
+
+	g_hash_table_insert (search->priv->scans, tab, scan);
+
+	g_signal_connect_swapped (scan->doc,
+				  "changed",
+				  G_CALLBACK (document_changed_cb),
+				  scan);
+
+	g_signal_connect_swapped (tab,
+				  "notify::state",
+				  G_CALLBACK (document_changed_cb),
+				  scan);
+
+	enqueue_scan (scan);
+}
+
+static void
+tab_added_cb (GeditWindow          *window,
+	      GeditTab             *tab,
+	      GeditFindInDocuments *search)
+{
+	add_tab (search, tab);
+}
+
+static void
+tab_removed_cb (GeditWindow          *window,
+		GeditTab             *tab,
+		GeditFindInDocuments *search)
+{
+	if (g_hash_table_remove (search->priv->scans, tab))
+	{
+		g_signal_emit (search, signals[TAB_REMOVED], 0, tab);
+	}
+}
+
+void
+gedit_find_in_documents_start (GeditFindInDocuments *search)
+{
+	GList *docs;
+	GList *l;
+
+	g_return_if_fail (GEDIT_IS_FIND_IN_DOCUMENTS (search));
+	g_return_if_fail (!search->priv->running);
+
+	search->priv->running = TRUE;
+
+	docs = gedit_window_get_documents (search->priv->window);
+
+	for (l = docs; l != NULL; l = l->next)
+	{
+		add_tab (search, gedit_tab_get_from_document (l->data));
+	}
+
+	g_list_free (docs);
+
+	g_signal_connect (search->priv->window,
+			  "tab-added",
+			  G_CALLBACK (tab_added_cb),
+			  search);
+
+	g_signal_connect (search->priv->window,
+			  "tab-removed",
+			  G_CALLBACK (tab_removed_cb),
+			  search);
+}
+
+/* Stops the search, and following the changes of the documents. */
+void
+gedit_find_in_documents_cancel (GeditFindInDocuments *search)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_DOCUMENTS (search));
+
+	clear_scans (search);
+}
+
+/* Whether some documents are waiting to be searched. */
+gboolean
+gedit_find_in_documents_is_running (GeditFindInDocuments *search)
+{
+	g_return_val_if_fail (GEDIT_IS_FIND_IN_DOCUMENTS (search), FALSE);
+
+	return search->priv->idle_id != 0 || search->priv->n_loading > 0;
+}
+
+void
+_gedit_find_in_documents_register_type (GTypeModule *type_module)
+{
+	gedit_find_in_documents_register_type (type_module);
+}
+
+/* ex:set ts=8 noet: */
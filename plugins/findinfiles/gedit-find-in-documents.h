@@ -0,0 +1,91 @@
+/*
+ * gedit-find-in-documents.h
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_FIND_IN_DOCUMENTS_H__
+#define __GEDIT_FIND_IN_DOCUMENTS_H__
+
+#include <gedit/gedit-window.h>
+#include <gedit/gedit-tab.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_FIND_IN_DOCUMENTS			(gedit_find_in_documents_get_type ())
+#define GEDIT_FIND_IN_DOCUMENTS(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_FIND_IN_DOCUMENTS, GeditFindInDocuments))
+#define GEDIT_FIND_IN_DOCUMENTS_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GEDIT_TYPE_FIND_IN_DOCUMENTS, GeditFindInDocumentsClass))
+#define GEDIT_IS_FIND_IN_DOCUMENTS(obj)			(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_FIND_IN_DOCUMENTS))
+#define GEDIT_IS_FIND_IN_DOCUMENTS_CLASS(klass)		(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_FIND_IN_DOCUMENTS))
+#define GEDIT_FIND_IN_DOCUMENTS_GET_CLASS(obj)		(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_FIND_IN_DOCUMENTS, GeditFindInDocumentsClass))
+
+typedef struct _GeditFindInDocuments		GeditFindInDocuments;
+typedef struct _GeditFindInDocumentsClass	GeditFindInDocumentsClass;
+typedef struct _GeditFindInDocumentsPrivate	GeditFindInDocumentsPrivate;
+typedef struct _GeditFindInDocumentsMatch	GeditFindInDocumentsMatch;
+
+struct _GeditFindInDocuments
+{
+	GObject parent;
+
+	GeditFindInDocumentsPrivate *priv;
+};
+
+struct _GeditFindInDocumentsClass
+{
+	GObjectClass parent_class;
+
+	/* Signals */
+	void (* tab_updated)	(GeditFindInDocuments *search,
+				 GeditTab             *tab,
+				 GPtrArray            *matches);
+	void (* tab_removed)	(GeditFindInDocuments *search,
+				 GeditTab             *tab);
+	void (* finished)	(GeditFindInDocuments *search);
+};
+
+/* One line of a document containing at least one occurrence of the searched
+ * text.
+ */
+struct _GeditFindInDocumentsMatch
+{
+	/* Line number, starting at 0 */
+	guint line;
+
+	/* Content of the line, valid UTF-8 */
+	gchar *text;
+};
+
+GType			 gedit_find_in_documents_get_type	(void) G_GNUC_CONST;
+
+GeditFindInDocuments	*gedit_find_in_documents_new		(GeditWindow          *window,
+								 const gchar          *search_text,
+								 gboolean              regex_enabled,
+								 gboolean              case_sensitive,
+								 GError              **error);
+
+void			 gedit_find_in_documents_start		(GeditFindInDocuments *search);
+
+void			 gedit_find_in_documents_cancel		(GeditFindInDocuments *search);
+
+gboolean		 gedit_find_in_documents_is_running	(GeditFindInDocuments *search);
+
+void			 _gedit_find_in_documents_register_type	(GTypeModule          *type_module);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FIND_IN_DOCUMENTS_H__ */
+
+/* ex:set ts=8 noet: */
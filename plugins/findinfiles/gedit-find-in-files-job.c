@@ -0,0 +1,937 @@
+/*
+ * gedit-find-in-files-job.c
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-find-in-files-job.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include <gedit/gedit-debug.h>
+#include <gedit/gedit-utils.h>
+
+/* The crawler waits when the workers have that many files to search. It
+ * bounds the memory used on very big trees.
+ */
+#define MAX_QUEUED_FILES 4096
+
+/* The search stops after this number of matching lines. */
+#define MAX_MATCHES 100000
+
+/* The matches found by the workers are handed to the main loop in batches. */
+#define FLUSH_INTERVAL 100
+
+#define MAX_LINE_LENGTH 256
+
+/* A nul byte near the start of a file means that it is binary. */
+#define BINARY_CHECK_SIZE 8192
+
+struct _GeditFindInFilesJobPrivate
+{
+	gchar *root_path;
+	gchar *search_text;
+	gsize search_length;
+
+	/* NULL for a case sensitive literal search */
+	GRegex *regex;
+
+	/* Boyer-Moore-Horspool shift table for the literal search */
+	gsize skip_table[256];
+
+	GPatternSpec *filter_pattern;
+	GPtrArray *binary_pattern_specs;
+
+	GCancellable *cancellable;
+
+	/* Protects pending_matches */
+	GMutex mutex;
+	GPtrArray *pending_matches;
+
+	/* Files pushed to the workers and not searched yet. The crawler
+	 * waits on queue_cond while there are too many.
+	 */
+	GMutex queue_mutex;
+	GCond queue_cond;
+	guint n_queued;
+
+	gint n_files;
+	gint n_matches;
+	gint truncated;
+
+	guint flush_id;
+
+	guint hide_hidden : 1;
+	guint hide_binary : 1;
+	guint running : 1;
+};
+
+enum
+{
+	MATCHES_FOUND,
+	FINISHED,
+	LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFindInFilesJob,
+				gedit_find_in_files_job,
+				G_TYPE_OBJECT,
+				0,
+				G_ADD_PRIVATE_DYNAMIC (GeditFindInFilesJob))
+
+static void
+match_free (GeditFindInFilesMatch *match)
+{
+	g_free (match->path);
+	g_free (match->text);
+	g_slice_free (GeditFindInFilesMatch, match);
+}
+
+static void
+gedit_find_in_files_job_dispose (GObject *object)
+{
+	GeditFindInFilesJob *job = GEDIT_FIND_IN_FILES_JOB (object);
+
+	if (job->priv->cancellable != NULL)
+	{
+		g_cancellable_cancel (job->priv->cancellable);
+		g_clear_object (&job->priv->cancellable);
+	}
+
+	if (job->priv->flush_id != 0)
+	{
+		g_source_remove (job->priv->flush_id);
+		job->priv->flush_id = 0;
+	}
+
+	G_OBJECT_CLASS (gedit_find_in_files_job_parent_class)->dispose (object);
+}
+
+static void
+gedit_find_in_files_job_finalize (GObject *object)
+{
+	GeditFindInFilesJob *job = GEDIT_FIND_IN_FILES_JOB (object);
+
+	g_free (job->priv->root_path);
+	g_free (job->priv->search_text);
+
+	if (job->priv->regex != NULL)
+	{
+		g_regex_unref (job->priv->regex);
+	}
+
+	if (job->priv->filter_pattern != NULL)
+	{
+		g_pattern_spec_free (job->priv->filter_pattern);
+	}
+
+	g_ptr_array_unref (job->priv->binary_pattern_specs);
+	g_ptr_array_unref (job->priv->pending_matches);
+	g_mutex_clear (&job->priv->mutex);
+	g_mutex_clear (&job->priv->queue_mutex);
+	g_cond_clear (&job->priv->queue_cond);
+
+	G_OBJECT_CLASS (gedit_find_in_files_job_parent_class)->finalize (object);
+}
+
+static void
+gedit_find_in_files_job_class_init (GeditFindInFilesJobClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gedit_find_in_files_job_dispose;
+	object_class->finalize = gedit_find_in_files_job_finalize;
+
+	/**
+	 * GeditFindInFilesJob::matches-found:
+	 * @job: the #GeditFindInFilesJob.
+	 * @matches: (element-type GeditFindInFilesMatch): the new matches,
+	 *   owned by @job.
+	 *
+	 * Emitted in the main loop with the matches found since the last
+	 * emission.
+	 */
+	signals[MATCHES_FOUND] =
+		g_signal_new ("matches-found",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GeditFindInFilesJobClass, matches_found),
+			      NULL, NULL, NULL,
+			      G_TYPE_NONE,
+			      1,
+			      G_TYPE_POINTER);
+
+	signals[FINISHED] =
+		g_signal_new ("finished",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GeditFindInFilesJobClass, finished),
+			      NULL, NULL, NULL,
+			      G_TYPE_NONE,
+			      0);
+}
+
+static void
+gedit_find_in_files_job_class_finalize (GeditFindInFilesJobClass *klass)
+{
+}
+
+static void
+gedit_find_in_files_job_init (GeditFindInFilesJob *job)
+{
+	job->priv = gedit_find_in_files_job_get_instance_private (job);
+
+	job->priv->cancellable = g_cancellable_new ();
+	job->priv->binary_pattern_specs = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+	job->priv->pending_matches = g_ptr_array_new_with_free_func ((GDestroyNotify) match_free);
+	job->priv->hide_hidden = TRUE;
+	job->priv->hide_binary = TRUE;
+
+	g_mutex_init (&job->priv->mutex);
+	g_mutex_init (&job->priv->queue_mutex);
+	g_cond_init (&job->priv->queue_cond);
+}
+
+/**
+ * gedit_find_in_files_job_new:
+ * @root_path: the directory to search, in the GLib file name encoding.
+ * @search_text: the text to search.
+ * @regex_enabled: whether @search_text is a regular expression.
+ * @case_sensitive: whether the search is case sensitive.
+ * @error: location of a #GError, or %NULL.
+ *
+ * Returns: a new #GeditFindInFilesJob, or %NULL if @search_text is not a valid
+ * regular expression.
+ */
+GeditFindInFilesJob *
+gedit_find_in_files_job_new (const gchar  *root_path,
+			     const gchar  *search_text,
+			     gboolean      regex_enabled,
+			     gboolean      case_sensitive,
+			     GError      **error)
+{
+	GeditFindInFilesJob *job;
+	GRegex *regex = NULL;
+
+	g_return_val_if_fail (root_path != NULL, NULL);
+	g_return_val_if_fail (search_text != NULL && search_text[0] != '\0', NULL);
+
+	if (regex_enabled || !case_sensitive)
+	{
+		GRegexCompileFlags flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+		gchar *pattern;
+
+		if (!case_sensitive)
+		{
+			flags |= G_REGEX_CASELESS;
+		}
+
+		if (regex_enabled)
+		{
+			pattern = g_strdup (search_text);
+		}
+		else
+		{
+			pattern = g_regex_escape_string (search_text, -1);
+		}
+
+		regex = gedit_utils_get_regex (pattern, flags, 0, error);
+		g_free (pattern);
+
+		if (regex == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	job = g_object_new (GEDIT_TYPE_FIND_IN_FILES_JOB, NULL);
+
+	job->priv->root_path = g_strdup (root_path);
+	job->priv->search_text = g_strdup (search_text);
+	job->priv->search_length = strlen (search_text);
+	job->priv->regex = regex;
+
+	if (regex == NULL)
+	{
+		gsize i;
+
+		for (i = 0; i < G_N_ELEMENTS (job->priv->skip_table); i++)
+		{
+			job->priv->skip_table[i] = job->priv->search_length;
+		}
+
+		for (i = 0; i + 1 < job->priv->search_length; i++)
+		{
+			guchar c = (guchar) search_text[i];
+
+			job->priv->skip_table[c] = job->priv->search_length - 1 - i;
+		}
+	}
+
+	return job;
+}
+
+void
+gedit_find_in_files_job_set_hide_hidden (GeditFindInFilesJob *job,
+					 gboolean             hide_hidden)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_JOB (job));
+	g_return_if_fail (!job->priv->running);
+
+	job->priv->hide_hidden = hide_hidden != FALSE;
+}
+
+void
+gedit_find_in_files_job_set_hide_binary (GeditFindInFilesJob *job,
+					 gboolean             hide_binary)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_JOB (job));
+	g_return_if_fail (!job->priv->running);
+
+	job->priv->hide_binary = hide_binary != FALSE;
+}
+
+/* Glob pattern on the file names, like the file browser filter. */
+void
+gedit_find_in_files_job_set_filter_pattern (GeditFindInFilesJob *job,
+					    const gchar         *pattern)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_JOB (job));
+	g_return_if_fail (!job->priv->running);
+
+	if (job->priv->filter_pattern != NULL)
+	{
+		g_pattern_spec_free (job->priv->filter_pattern);
+		job->priv->filter_pattern = NULL;
+	}
+
+	if (pattern != NULL && pattern[0] != '\0')
+	{
+		job->priv->filter_pattern = g_pattern_spec_new (pattern);
+	}
+}
+
+void
+gedit_find_in_files_job_set_binary_patterns (GeditFindInFilesJob *job,
+					     const gchar * const *patterns)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_JOB (job));
+	g_return_if_fail (!job->priv->running);
+
+	g_ptr_array_set_size (job->priv->binary_pattern_specs, 0);
+
+	for (; patterns != NULL && *patterns != NULL; patterns++)
+	{
+		g_ptr_array_add (job->priv->binary_pattern_specs,
+				 g_pattern_spec_new (*patterns));
+	}
+}
+
+static gboolean
+is_stopped (GeditFindInFilesJob *job)
+{
+	return g_cancellable_is_cancelled (job->priv->cancellable) ||
+	       g_atomic_int_get (&job->priv->truncated);
+}
+
+static gchar *
+make_valid_utf8 (const gchar *text,
+		 gsize        length)
+{
+	GString *str;
+	const gchar *end;
+
+	str = g_string_sized_new (length);
+
+	while (!g_utf8_validate (text, length, &end))
+	{
+		gsize valid_length = end - text;
+
+		g_string_append_len (str, text, valid_length);
+
+		/* U+FFFD REPLACEMENT CHARACTER */
+		g_string_append (str, "\357\277\275");
+
+		text = end + 1;
+		length -= valid_length + 1;
+	}
+
+	g_string_append_len (str, text, length);
+
+	return g_string_free (str, FALSE);
+}
+
+typedef struct
+{
+	const gchar *data;
+	gsize length;
+
+	/* Position up to which the newlines have been counted */
+	gsize pos;
+
+	guint line;
+	gsize line_start;
+} LineCursor;
+
+static void
+line_cursor_move_to (LineCursor *cursor,
+		     gsize       offset)
+{
+	while (cursor->pos < offset)
+	{
+		const gchar *nl;
+
+		nl = memchr (cursor->data + cursor->pos, '\n', offset - cursor->pos);
+
+		if (nl == NULL)
+		{
+			break;
+		}
+
+		cursor->line++;
+		cursor->pos = nl - cursor->data + 1;
+		cursor->line_start = cursor->pos;
+	}
+
+	cursor->pos = offset;
+}
+
+static gsize
+line_cursor_get_line_end (LineCursor *cursor)
+{
+	const gchar *nl;
+
+	nl = memchr (cursor->data + cursor->pos, '\n', cursor->length - cursor->pos);
+
+	return nl != NULL ? (gsize) (nl - cursor->data) : cursor->length;
+}
+
+static void
+add_match (GPtrArray   *matches,
+	   const gchar *path,
+	   LineCursor  *cursor,
+	   gsize        line_end)
+{
+	GeditFindInFilesMatch *match;
+	gsize length;
+
+	length = line_end - cursor->line_start;
+
+	if (length > 0 && cursor->data[cursor->line_start + length - 1] == '\r')
+	{
+		length--;
+	}
+
+	match = g_slice_new (GeditFindInFilesMatch);
+	match->path = g_strdup (path);
+	match->line = cursor->line;
+	match->text = make_valid_utf8 (cursor->data + cursor->line_start,
+				       MIN (length, MAX_LINE_LENGTH));
+
+	g_ptr_array_add (matches, match);
+}
+
+static const gchar *
+find_literal (GeditFindInFilesJob *job,
+	      const gchar         *haystack,
+	      gsize                haystack_length)
+{
+	const gchar *needle = job->priv->search_text;
+	gsize needle_length = job->priv->search_length;
+	gsize pos = 0;
+
+	if (haystack_length < needle_length)
+	{
+		return NULL;
+	}
+
+	while (pos <= haystack_length - needle_length)
+	{
+		guchar last = (guchar) haystack[pos + needle_length - 1];
+
+		if (last == (guchar) needle[needle_length - 1] &&
+		    memcmp (haystack + pos, needle, needle_length - 1) == 0)
+		{
+			return haystack + pos;
+		}
+
+		pos += job->priv->skip_table[last];
+	}
+
+	return NULL;
+}
+
+static void
+search_literal (GeditFindInFilesJob *job,
+		const gchar         *path,
+		LineCursor          *cursor,
+		GPtrArray           *matches)
+{
+	gsize offset = 0;
+
+	while (offset < cursor->length &&
+	       matches->len < MAX_MATCHES &&
+	       !is_stopped (job))
+	{
+		const gchar *hit;
+		gsize line_end;
+
+		hit = find_literal (job, cursor->data + offset, cursor->length - offset);
+
+		if (hit == NULL)
+		{
+			break;
+		}
+
+		line_cursor_move_to (cursor, hit - cursor->data);
+		line_end = line_cursor_get_line_end (cursor);
+
+		add_match (matches, path, cursor, line_end);
+
+		/* One match per line is enough. */
+		offset = line_end + 1;
+	}
+}
+
+static void
+search_regex (GeditFindInFilesJob *job,
+	      const gchar         *path,
+	      LineCursor          *cursor,
+	      GPtrArray           *matches)
+{
+	GMatchInfo *match_info;
+	gchar *valid_data = NULL;
+	gint last_line = -1;
+
+	if (cursor->length > G_MAXINT)
+	{
+		return;
+	}
+
+	/* PCRE must not be given invalid UTF-8. The invalid bytes of a file
+	 * in another encoding are replaced, which keeps the newlines and
+	 * thus the line numbers, and the matches on the ASCII text.
+	 */
+	if (!g_utf8_validate (cursor->data, cursor->length, NULL))
+	{
+		valid_data = make_valid_utf8 (cursor->data, cursor->length);
+
+		cursor->data = valid_data;
+		cursor->length = strlen (valid_data);
+
+		if (cursor->length > G_MAXINT)
+		{
+			g_free (valid_data);
+			return;
+		}
+	}
+
+	g_regex_match_full (job->priv->regex,
+			    cursor->data,
+			    cursor->length,
+			    0,
+			    0,
+			    &match_info,
+			    NULL);
+
+	while (g_match_info_matches (match_info) &&
+	       matches->len < MAX_MATCHES &&
+	       !is_stopped (job))
+	{
+		gint start_pos;
+
+		g_match_info_fetch_pos (match_info, 0, &start_pos, NULL);
+		line_cursor_move_to (cursor, start_pos);
+
+		if ((gint) cursor->line != last_line)
+		{
+			add_match (matches, path, cursor, line_cursor_get_line_end (cursor));
+			last_line = cursor->line;
+		}
+
+		g_match_info_next (match_info, NULL);
+	}
+
+	g_match_info_free (match_info);
+	g_free (valid_data);
+}
+
+static void
+push_matches (GeditFindInFilesJob *job,
+	      GPtrArray           *matches)
+{
+	gint n_before;
+	guint n_kept;
+	guint i;
+
+	n_before = g_atomic_int_add (&job->priv->n_matches, matches->len);
+	n_kept = matches->len;
+
+	if (n_before + matches->len >= MAX_MATCHES)
+	{
+		n_kept = n_before < MAX_MATCHES ? MAX_MATCHES - n_before : 0;
+		g_atomic_int_set (&job->priv->truncated, TRUE);
+	}
+
+	g_mutex_lock (&job->priv->mutex);
+
+	for (i = 0; i < n_kept; i++)
+	{
+		g_ptr_array_add (job->priv->pending_matches,
+				 g_ptr_array_index (matches, i));
+	}
+
+	g_mutex_unlock (&job->priv->mutex);
+
+	for (i = n_kept; i < matches->len; i++)
+	{
+		match_free (g_ptr_array_index (matches, i));
+	}
+}
+
+static void
+search_path (gchar               *path,
+	     GeditFindInFilesJob *job)
+{
+	GMappedFile *mapped_file;
+	LineCursor cursor = { 0 };
+	GPtrArray *matches;
+
+	if (is_stopped (job))
+	{
+		g_free (path);
+		return;
+	}
+
+	mapped_file = g_mapped_file_new (path, FALSE, NULL);
+
+	if (mapped_file == NULL)
+	{
+		g_free (path);
+		return;
+	}
+
+	g_atomic_int_inc (&job->priv->n_files);
+
+	cursor.data = g_mapped_file_get_contents (mapped_file);
+	cursor.length = g_mapped_file_get_length (mapped_file);
+
+	if (cursor.length == 0 ||
+	    (job->priv->hide_binary &&
+	     memchr (cursor.data, '\0', MIN (cursor.length, BINARY_CHECK_SIZE)) != NULL))
+	{
+		g_mapped_file_unref (mapped_file);
+		g_free (path);
+		return;
+	}
+
+	matches = g_ptr_array_new ();
+
+	if (job->priv->regex != NULL)
+	{
+		search_regex (job, path, &cursor, matches);
+	}
+	else
+	{
+		search_literal (job, path, &cursor, matches);
+	}
+
+	if (matches->len > 0)
+	{
+		push_matches (job, matches);
+	}
+
+	g_ptr_array_free (matches, TRUE);
+	g_mapped_file_unref (mapped_file);
+	g_free (path);
+}
+
+/* Runs in a worker of the thread pool. */
+static void
+search_file (gchar               *path,
+	     GeditFindInFilesJob *job)
+{
+	search_path (path, job);
+
+	g_mutex_lock (&job->priv->queue_mutex);
+	job->priv->n_queued--;
+	g_cond_signal (&job->priv->queue_cond);
+	g_mutex_unlock (&job->priv->queue_mutex);
+}
+
+static gboolean
+is_hidden_name (const gchar *name)
+{
+	return name[0] == '.' || g_str_has_suffix (name, "~");
+}
+
+static gboolean
+file_name_is_accepted (GeditFindInFilesJob *job,
+		       const gchar         *name)
+{
+	if (job->priv->filter_pattern != NULL &&
+	    !g_pattern_match_string (job->priv->filter_pattern, name))
+	{
+		return FALSE;
+	}
+
+	if (job->priv->hide_binary)
+	{
+		guint i;
+
+		for (i = 0; i < job->priv->binary_pattern_specs->len; i++)
+		{
+			GPatternSpec *spec = g_ptr_array_index (job->priv->binary_pattern_specs, i);
+
+			if (g_pattern_match_string (spec, name))
+			{
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+crawl_directory (GeditFindInFilesJob *job,
+		 GThreadPool         *pool,
+		 const gchar         *dir_path,
+		 GQueue              *dirs)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open (dir_path, 0, NULL);
+
+	if (dir == NULL)
+	{
+		return;
+	}
+
+	while ((name = g_dir_read_name (dir)) != NULL && !is_stopped (job))
+	{
+		gchar *path;
+		GStatBuf buf;
+
+		if (job->priv->hide_hidden && is_hidden_name (name))
+		{
+			continue;
+		}
+
+		path = g_build_filename (dir_path, name, NULL);
+
+		/* Symbolic links are not followed, to avoid cycles. */
+		if (g_lstat (path, &buf) != 0)
+		{
+			g_free (path);
+		}
+		else if (S_ISDIR (buf.st_mode))
+		{
+			g_queue_push_head (dirs, path);
+		}
+		else if (S_ISREG (buf.st_mode) && file_name_is_accepted (job, name))
+		{
+			/* The workers keep signaling when the job is stopped,
+			 * they return at once then.
+			 */
+			g_mutex_lock (&job->priv->queue_mutex);
+
+			while (job->priv->n_queued >= MAX_QUEUED_FILES)
+			{
+				g_cond_wait (&job->priv->queue_cond, &job->priv->queue_mutex);
+			}
+
+			job->priv->n_queued++;
+			g_mutex_unlock (&job->priv->queue_mutex);
+
+			g_thread_pool_push (pool, path, NULL);
+		}
+		else
+		{
+			g_free (path);
+		}
+	}
+
+	g_dir_close (dir);
+}
+
+/* Walks the tree and feeds the thread pool of workers. */
+static void
+crawl_thread (GTask               *task,
+	      GeditFindInFilesJob *job,
+	      gpointer             task_data,
+	      GCancellable        *cancellable)
+{
+	GThreadPool *pool;
+	GQueue dirs = G_QUEUE_INIT;
+
+	pool = g_thread_pool_new ((GFunc) search_file,
+				  job,
+				  MAX (g_get_num_processors (), 1),
+				  FALSE,
+				  NULL);
+
+	g_queue_push_tail (&dirs, g_strdup (job->priv->root_path));
+
+	while (!g_queue_is_empty (&dirs))
+	{
+		gchar *dir_path = g_queue_pop_head (&dirs);
+
+		if (!is_stopped (job))
+		{
+			crawl_directory (job, pool, dir_path, &dirs);
+		}
+
+		g_free (dir_path);
+	}
+
+	/* Wait for the workers, they return quickly when the job is stopped. */
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+flush_matches (GeditFindInFilesJob *job)
+{
+	GPtrArray *matches;
+
+	g_mutex_lock (&job->priv->mutex);
+
+	matches = job->priv->pending_matches;
+
+	if (matches->len == 0)
+	{
+		g_mutex_unlock (&job->priv->mutex);
+		return;
+	}
+
+	job->priv->pending_matches = g_ptr_array_new_with_free_func ((GDestroyNotify) match_free);
+
+	g_mutex_unlock (&job->priv->mutex);
+
+	g_signal_emit (job, signals[MATCHES_FOUND], 0, matches);
+
+	g_ptr_array_unref (matches);
+}
+
+static gboolean
+flush_matches_cb (GeditFindInFilesJob *job)
+{
+	flush_matches (job);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+crawl_finished_cb (GeditFindInFilesJob *job,
+		   GAsyncResult        *result,
+		   gpointer             user_data)
+{
+	g_task_propagate_boolean (G_TASK (result), NULL);
+
+	if (job->priv->flush_id != 0)
+	{
+		g_source_remove (job->priv->flush_id);
+		job->priv->flush_id = 0;
+	}
+
+	flush_matches (job);
+
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "Searched %d files, %d matching lines",
+			     g_atomic_int_get (&job->priv->n_files),
+			     g_atomic_int_get (&job->priv->n_matches));
+
+	job->priv->running = FALSE;
+
+	g_signal_emit (job, signals[FINISHED], 0);
+}
+
+void
+gedit_find_in_files_job_start (GeditFindInFilesJob *job)
+{
+	GTask *task;
+
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_JOB (job));
+	g_return_if_fail (!job->priv->running);
+
+	job->priv->running = TRUE;
+
+	/* The task keeps a reference to the job until it is finished. */
+	task = g_task_new (job,
+			   job->priv->cancellable,
+			   (GAsyncReadyCallback) crawl_finished_cb,
+			   NULL);
+
+	g_task_run_in_thread (task, (GTaskThreadFunc) crawl_thread);
+	g_object_unref (task);
+
+	job->priv->flush_id = g_timeout_add (FLUSH_INTERVAL,
+					     (GSourceFunc) flush_matches_cb,
+					     job);
+}
+
+void
+gedit_find_in_files_job_cancel (GeditFindInFilesJob *job)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_JOB (job));
+
+	if (job->priv->cancellable != NULL)
+	{
+		g_cancellable_cancel (job->priv->cancellable);
+	}
+}
+
+gboolean
+gedit_find_in_files_job_is_running (GeditFindInFilesJob *job)
+{
+	g_return_val_if_fail (GEDIT_IS_FIND_IN_FILES_JOB (job), FALSE);
+
+	return job->priv->running;
+}
+
+guint
+gedit_find_in_files_job_get_n_files (GeditFindInFilesJob *job)
+{
+	g_return_val_if_fail (GEDIT_IS_FIND_IN_FILES_JOB (job), 0);
+
+	return g_atomic_int_get (&job->priv->n_files);
+}
+
+/* Whether the search stopped because too many lines matched. */
+gboolean
+gedit_find_in_files_job_get_truncated (GeditFindInFilesJob *job)
+{
+	g_return_val_if_fail (GEDIT_IS_FIND_IN_FILES_JOB (job), FALSE);
+
+	return g_atomic_int_get (&job->priv->truncated);
+}
+
+void
+_gedit_find_in_files_job_register_type (GTypeModule *type_module)
+{
+	gedit_find_in_files_job_register_type (type_module);
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,104 @@
+/*
+ * gedit-find-in-files-job.h
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_FIND_IN_FILES_JOB_H__
+#define __GEDIT_FIND_IN_FILES_JOB_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_FIND_IN_FILES_JOB		(gedit_find_in_files_job_get_type ())
+#define GEDIT_FIND_IN_FILES_JOB(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_FIND_IN_FILES_JOB, GeditFindInFilesJob))
+#define GEDIT_FIND_IN_FILES_JOB_CLASS(klass)	(G_TYPE_CHECK_CLASS_CAST ((klass), GEDIT_TYPE_FIND_IN_FILES_JOB, GeditFindInFilesJobClass))
+#define GEDIT_IS_FIND_IN_FILES_JOB(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_FIND_IN_FILES_JOB))
+#define GEDIT_IS_FIND_IN_FILES_JOB_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_FIND_IN_FILES_JOB))
+#define GEDIT_FIND_IN_FILES_JOB_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_FIND_IN_FILES_JOB, GeditFindInFilesJobClass))
+
+typedef struct _GeditFindInFilesJob		GeditFindInFilesJob;
+typedef struct _GeditFindInFilesJobClass	GeditFindInFilesJobClass;
+typedef struct _GeditFindInFilesJobPrivate	GeditFindInFilesJobPrivate;
+typedef struct _GeditFindInFilesMatch		GeditFindInFilesMatch;
+
+struct _GeditFindInFilesJob
+{
+	GObject parent;
+
+	GeditFindInFilesJobPrivate *priv;
+};
+
+struct _GeditFindInFilesJobClass
+{
+	GObjectClass parent_class;
+
+	/* Signals */
+	void (* matches_found)	(GeditFindInFilesJob *job,
+				 GPtrArray           *matches);
+	void (* finished)	(GeditFindInFilesJob *job);
+};
+
+/* One line containing at least one occurrence of the searched text. */
+struct _GeditFindInFilesMatch
+{
+	/* Path in the GLib file name encoding */
+	gchar *path;
+
+	/* Line number, starting at 0 */
+	guint line;
+
+	/* Content of the line, valid UTF-8 */
+	gchar *text;
+};
+
+GType			 gedit_find_in_files_job_get_type		(void) G_GNUC_CONST;
+
+GeditFindInFilesJob	*gedit_find_in_files_job_new			(const gchar          *root_path,
+									 const gchar          *search_text,
+									 gboolean              regex_enabled,
+									 gboolean              case_sensitive,
+									 GError              **error);
+
+void			 gedit_find_in_files_job_set_hide_hidden	(GeditFindInFilesJob  *job,
+									 gboolean              hide_hidden);
+
+void			 gedit_find_in_files_job_set_hide_binary	(GeditFindInFilesJob  *job,
+									 gboolean              hide_binary);
+
+void			 gedit_find_in_files_job_set_filter_pattern	(GeditFindInFilesJob  *job,
+									 const gchar          *pattern);
+
+void			 gedit_find_in_files_job_set_binary_patterns	(GeditFindInFilesJob  *job,
+									 const gchar * const  *patterns);
+
+void			 gedit_find_in_files_job_start			(GeditFindInFilesJob  *job);
+
+void			 gedit_find_in_files_job_cancel			(GeditFindInFilesJob  *job);
+
+gboolean		 gedit_find_in_files_job_is_running		(GeditFindInFilesJob  *job);
+
+guint			 gedit_find_in_files_job_get_n_files		(GeditFindInFilesJob  *job);
+
+gboolean		 gedit_find_in_files_job_get_truncated		(GeditFindInFilesJob  *job);
+
+void			 _gedit_find_in_files_job_register_type		(GTypeModule          *type_module);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FIND_IN_FILES_JOB_H__ */
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,1232 @@
+/*
+ * gedit-find-in-files-panel.c
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-find-in-files-panel.h"
+
+#include <string.h>
+#include <glib/gi18n.h>
+#include <gtksourceview/gtksource.h>
+
+#include <gedit/gedit-commands.h>
+#include <gedit/gedit-debug.h>
+
+#include "gedit-find-in-documents.h"
+#include "gedit-find-in-files-job.h"
+#include "gedit-find-in-files-replace.h"
+
+#define FILEBROWSER_BASE_SETTINGS	"org.gnome.gedit.plugins.filebrowser"
+#define FILEBROWSER_FILTER_MODE		"filter-mode"
+#define FILEBROWSER_FILTER_PATTERN	"filter-pattern"
+#define FILEBROWSER_BINARY_PATTERNS	"binary-patterns"
+
+/* Same values as GeditFileBrowserStoreFilterMode */
+#define FILTER_MODE_HIDE_HIDDEN	(1 << 0)
+#define FILTER_MODE_HIDE_BINARY	(1 << 1)
+
+enum
+{
+	COLUMN_PATH,
+	COLUMN_LINE,
+	COLUMN_LOCATION,
+	COLUMN_TEXT,
+	COLUMN_TAB,
+	N_COLUMNS
+};
+
+#define SCOPE_FOLDER	"folder"
+#define SCOPE_DOCUMENTS	"documents"
+
+struct _GeditFindInFilesPanelPrivate
+{
+	GeditWindow *window;
+
+	GtkWidget *search_entry;
+	GtkWidget *replace_entry;
+	GtkWidget *scope_combo;
+	GtkWidget *folder_button;
+	GtkWidget *match_case_checkbutton;
+	GtkWidget *regex_checkbutton;
+	GtkWidget *find_button;
+	GtkWidget *stop_button;
+	GtkWidget *replace_all_button;
+	GtkWidget *status_label;
+	GtkWidget *treeview;
+
+	GtkListStore *store;
+
+	GeditFindInFilesJob *job;
+	gchar *root_path;
+	guint n_matches;
+
+	/* The search in the open documents, with a row for each document
+	 * containing the matching lines.
+	 */
+	GtkTreeStore *documents_store;
+	GeditFindInDocuments *documents_search;
+	GHashTable *document_rows;
+
+	/* The settings of the last search, used by "Replace All" */
+	GtkSourceSearchSettings *search_settings;
+
+	GCancellable *replace_cancellable;
+};
+
+enum
+{
+	PROP_0,
+	PROP_WINDOW
+};
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFindInFilesPanel,
+				gedit_find_in_files_panel,
+				GTK_TYPE_BOX,
+				0,
+				G_ADD_PRIVATE_DYNAMIC (GeditFindInFilesPanel))
+
+static gboolean
+is_documents_scope (GeditFindInFilesPanel *panel)
+{
+	const gchar *scope;
+
+	scope = gtk_combo_box_get_active_id (GTK_COMBO_BOX (panel->priv->scope_combo));
+
+	return g_strcmp0 (scope, SCOPE_DOCUMENTS) == 0;
+}
+
+static void
+update_sensitivity (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	gboolean searching;
+	gboolean replacing;
+	gboolean documents;
+	const gchar *text;
+
+	searching = (priv->job != NULL && gedit_find_in_files_job_is_running (priv->job)) ||
+		    (priv->documents_search != NULL && gedit_find_in_documents_is_running (priv->documents_search));
+	replacing = priv->replace_cancellable != NULL;
+	documents = is_documents_scope (panel);
+	text = gtk_entry_get_text (GTK_ENTRY (priv->search_entry));
+
+	gtk_widget_set_visible (priv->find_button, !searching);
+	gtk_widget_set_visible (priv->stop_button, searching);
+
+	gtk_widget_set_sensitive (priv->folder_button, !documents);
+	gtk_widget_set_sensitive (priv->find_button, !replacing && text[0] != '\0');
+
+	/* Replacing in the open documents is done with the search and
+	 * replace dialog.
+	 */
+	gtk_widget_set_sensitive (priv->replace_all_button,
+				  !documents && !searching && !replacing && priv->n_matches > 0);
+}
+
+static void
+set_status (GeditFindInFilesPanel *panel,
+	    const gchar           *text)
+{
+	gtk_label_set_text (GTK_LABEL (panel->priv->status_label), text);
+}
+
+static void
+stop_job (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+
+	if (priv->job == NULL)
+	{
+		return;
+	}
+
+	g_signal_handlers_disconnect_by_data (priv->job, panel);
+	gedit_find_in_files_job_cancel (priv->job);
+	g_clear_object (&priv->job);
+}
+
+static void
+stop_documents_search (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+
+	if (priv->documents_search == NULL)
+	{
+		return;
+	}
+
+	g_signal_handlers_disconnect_by_data (priv->documents_search, panel);
+	gedit_find_in_documents_cancel (priv->documents_search);
+	g_clear_object (&priv->documents_search);
+}
+
+static void
+gedit_find_in_files_panel_dispose (GObject *object)
+{
+	GeditFindInFilesPanel *panel = GEDIT_FIND_IN_FILES_PANEL (object);
+
+	stop_job (panel);
+	stop_documents_search (panel);
+
+	if (panel->priv->replace_cancellable != NULL)
+	{
+		g_cancellable_cancel (panel->priv->replace_cancellable);
+		g_clear_object (&panel->priv->replace_cancellable);
+	}
+
+	g_clear_object (&panel->priv->store);
+	g_clear_object (&panel->priv->documents_store);
+	g_clear_object (&panel->priv->search_settings);
+	g_clear_object (&panel->priv->window);
+
+	G_OBJECT_CLASS (gedit_find_in_files_panel_parent_class)->dispose (object);
+}
+
+static void
+gedit_find_in_files_panel_finalize (GObject *object)
+{
+	GeditFindInFilesPanel *panel = GEDIT_FIND_IN_FILES_PANEL (object);
+
+	g_free (panel->priv->root_path);
+	g_hash_table_unref (panel->priv->document_rows);
+
+	G_OBJECT_CLASS (gedit_find_in_files_panel_parent_class)->finalize (object);
+}
+
+static void
+gedit_find_in_files_panel_set_property (GObject      *object,
+					guint         prop_id,
+					const GValue *value,
+					GParamSpec   *pspec)
+{
+	GeditFindInFilesPanel *panel = GEDIT_FIND_IN_FILES_PANEL (object);
+
+	switch (prop_id)
+	{
+		case PROP_WINDOW:
+			panel->priv->window = g_value_dup_object (value);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+gedit_find_in_files_panel_get_property (GObject    *object,
+					guint       prop_id,
+					GValue     *value,
+					GParamSpec *pspec)
+{
+	GeditFindInFilesPanel *panel = GEDIT_FIND_IN_FILES_PANEL (object);
+
+	switch (prop_id)
+	{
+		case PROP_WINDOW:
+			g_value_set_object (value, panel->priv->window);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+gedit_find_in_files_panel_class_init (GeditFindInFilesPanelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gedit_find_in_files_panel_dispose;
+	object_class->finalize = gedit_find_in_files_panel_finalize;
+	object_class->set_property = gedit_find_in_files_panel_set_property;
+	object_class->get_property = gedit_find_in_files_panel_get_property;
+
+	g_object_class_install_property (object_class,
+					 PROP_WINDOW,
+					 g_param_spec_object ("window",
+							      "Window",
+							      "The GeditWindow",
+							      GEDIT_TYPE_WINDOW,
+							      G_PARAM_READWRITE |
+							      G_PARAM_CONSTRUCT_ONLY |
+							      G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gedit_find_in_files_panel_class_finalize (GeditFindInFilesPanelClass *klass)
+{
+}
+
+static GSettings *
+settings_try_new (const gchar *schema_id)
+{
+	GSettings *settings = NULL;
+	GSettingsSchemaSource *source;
+	GSettingsSchema *schema;
+
+	source = g_settings_schema_source_get_default ();
+
+	schema = g_settings_schema_source_lookup (source, schema_id, TRUE);
+
+	if (schema != NULL)
+	{
+		settings = g_settings_new_full (schema, NULL, NULL);
+		g_settings_schema_unref (schema);
+	}
+
+	return settings;
+}
+
+/* The files hidden in the file browser are not searched. */
+static void
+apply_file_browser_filters (GeditFindInFilesJob *job)
+{
+	GSettings *settings;
+	guint filter_mode;
+	gchar *pattern;
+	gchar **binary_patterns;
+
+	settings = settings_try_new (FILEBROWSER_BASE_SETTINGS);
+
+	if (settings == NULL)
+	{
+		return;
+	}
+
+	filter_mode = g_settings_get_flags (settings, FILEBROWSER_FILTER_MODE);
+	pattern = g_settings_get_string (settings, FILEBROWSER_FILTER_PATTERN);
+	binary_patterns = g_settings_get_strv (settings, FILEBROWSER_BINARY_PATTERNS);
+
+	gedit_find_in_files_job_set_hide_hidden (job, (filter_mode & FILTER_MODE_HIDE_HIDDEN) != 0);
+	gedit_find_in_files_job_set_hide_binary (job, (filter_mode & FILTER_MODE_HIDE_BINARY) != 0);
+	gedit_find_in_files_job_set_filter_pattern (job, pattern);
+	gedit_find_in_files_job_set_binary_patterns (job, (const gchar * const *) binary_patterns);
+
+	g_free (pattern);
+	g_strfreev (binary_patterns);
+	g_object_unref (settings);
+}
+
+static void
+update_searching_status (GeditFindInFilesPanel *panel)
+{
+	gchar *msg;
+
+	msg = g_strdup_printf (ngettext ("Searching\342\200\246 %u match",
+					 "Searching\342\200\246 %u matches",
+					 panel->priv->n_matches),
+			       panel->priv->n_matches);
+
+	set_status (panel, msg);
+	g_free (msg);
+}
+
+static gchar *
+get_display_location (GeditFindInFilesPanel *panel,
+		      GeditFindInFilesMatch *match)
+{
+	const gchar *relative_path = match->path;
+	gchar *display_name;
+	gchar *location;
+	gsize root_length;
+
+	root_length = strlen (panel->priv->root_path);
+
+	if (strncmp (match->path, panel->priv->root_path, root_length) == 0)
+	{
+		relative_path = match->path + root_length;
+
+		while (G_IS_DIR_SEPARATOR (*relative_path))
+		{
+			relative_path++;
+		}
+	}
+
+	display_name = g_filename_display_name (relative_path);
+	location = g_strdup_printf ("%s:%u", display_name, match->line + 1);
+	g_free (display_name);
+
+	return location;
+}
+
+static void
+matches_found_cb (GeditFindInFilesJob   *job,
+		  GPtrArray             *matches,
+		  GeditFindInFilesPanel *panel)
+{
+	guint i;
+
+	for (i = 0; i < matches->len; i++)
+	{
+		GeditFindInFilesMatch *match = g_ptr_array_index (matches, i);
+		gchar *location;
+
+		location = get_display_location (panel, match);
+
+		gtk_list_store_insert_with_values (panel->priv->store,
+						   NULL,
+						   -1,
+						   COLUMN_PATH, match->path,
+						   COLUMN_LINE, match->line + 1,
+						   COLUMN_LOCATION, location,
+						   COLUMN_TEXT, match->text,
+						   -1);
+
+		g_free (location);
+	}
+
+	panel->priv->n_matches += matches->len;
+
+	update_searching_status (panel);
+	update_sensitivity (panel);
+}
+
+static void
+job_finished_cb (GeditFindInFilesJob   *job,
+		 GeditFindInFilesPanel *panel)
+{
+	GString *msg;
+	guint n_files;
+
+	n_files = gedit_find_in_files_job_get_n_files (job);
+	msg = g_string_new (NULL);
+
+	g_string_append_printf (msg,
+				ngettext ("%u match", "%u matches", panel->priv->n_matches),
+				panel->priv->n_matches);
+
+	g_string_append (msg, " \342\200\224 ");
+
+	g_string_append_printf (msg,
+				ngettext ("%u file searched", "%u files searched", n_files),
+				n_files);
+
+	if (gedit_find_in_files_job_get_truncated (job))
+	{
+		g_string_append (msg, " \342\200\224 ");
+		g_string_append (msg, _("too many matches, the search has been stopped"));
+	}
+
+	set_status (panel, msg->str);
+	g_string_free (msg, TRUE);
+
+	g_signal_handlers_disconnect_by_data (job, panel);
+	g_clear_object (&panel->priv->job);
+
+	update_sensitivity (panel);
+}
+
+static void
+clear_results (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+
+	stop_job (panel);
+	stop_documents_search (panel);
+
+	gtk_list_store_clear (priv->store);
+	g_hash_table_remove_all (priv->document_rows);
+	gtk_tree_store_clear (priv->documents_store);
+	priv->n_matches = 0;
+
+	g_clear_object (&priv->search_settings);
+}
+
+static void
+update_documents_status (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	GString *msg;
+	guint n_documents;
+
+	if (priv->documents_search != NULL &&
+	    gedit_find_in_documents_is_running (priv->documents_search))
+	{
+		update_searching_status (panel);
+		return;
+	}
+
+	n_documents = g_hash_table_size (priv->document_rows);
+	msg = g_string_new (NULL);
+
+	g_string_append_printf (msg,
+				ngettext ("%u match", "%u matches", priv->n_matches),
+				priv->n_matches);
+
+	g_string_append (msg, " \342\200\224 ");
+
+	g_string_append_printf (msg,
+				ngettext ("%u document", "%u documents", n_documents),
+				n_documents);
+
+	set_status (panel, msg->str);
+	g_string_free (msg, TRUE);
+}
+
+static void
+remove_document_row (GeditFindInFilesPanel *panel,
+		     GeditTab              *tab)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	GtkTreeIter *iter;
+
+	iter = g_hash_table_lookup (priv->document_rows, tab);
+
+	if (iter == NULL)
+	{
+		return;
+	}
+
+	priv->n_matches -= gtk_tree_model_iter_n_children (GTK_TREE_MODEL (priv->documents_store), iter);
+
+	gtk_tree_store_remove (priv->documents_store, iter);
+	g_hash_table_remove (priv->document_rows, tab);
+}
+
+/* The rows of a document are replaced each time it is searched again. */
+static void
+tab_updated_cb (GeditFindInDocuments  *search,
+		GeditTab              *tab,
+		GPtrArray             *matches,
+		GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	GtkTreeModel *model = GTK_TREE_MODEL (priv->documents_store);
+	GtkTreeIter *parent;
+	GtkTreeIter child;
+	GtkTreePath *path;
+	gboolean expanded = TRUE;
+	gchar *name;
+	gchar *location;
+	guint i;
+
+	parent = g_hash_table_lookup (priv->document_rows, tab);
+
+	if (parent != NULL)
+	{
+		path = gtk_tree_model_get_path (model, parent);
+		expanded = gtk_tree_view_row_expanded (GTK_TREE_VIEW (priv->treeview), path);
+		gtk_tree_path_free (path);
+	}
+
+	if (matches->len == 0)
+	{
+		remove_document_row (panel, tab);
+		update_documents_status (panel);
+		update_sensitivity (panel);
+		return;
+	}
+
+	if (parent == NULL)
+	{
+		GtkTreeIter iter;
+
+		gtk_tree_store_append (priv->documents_store, &iter, NULL);
+
+		parent = gtk_tree_iter_copy (&iter);
+		g_hash_table_insert (priv->document_rows, tab, parent);
+	}
+	else
+	{
+		priv->n_matches -= gtk_tree_model_iter_n_children (model, parent);
+
+		while (gtk_tree_model_iter_children (model, &child, parent))
+		{
+			gtk_tree_store_remove (priv->documents_store, &child);
+		}
+	}
+
+	name = gedit_document_get_short_name_for_display (gedit_tab_get_document (tab));
+	location = g_strdup_printf ("%s (%u)", name, matches->len);
+
+	gtk_tree_store_set (priv->documents_store, parent,
+			    COLUMN_LINE, 0,
+			    COLUMN_LOCATION, location,
+			    COLUMN_TAB, tab,
+			    -1);
+
+	g_free (location);
+	g_free (name);
+
+	for (i = 0; i < matches->len; i++)
+	{
+		GeditFindInDocumentsMatch *match = g_ptr_array_index (matches, i);
+
+		location = g_strdup_printf ("%u", match->line + 1);
+
+		gtk_tree_store_insert_with_values (priv->documents_store,
+						   NULL,
+						   parent,
+						   -1,
+						   COLUMN_LINE, match->line + 1,
+						   COLUMN_LOCATION, location,
+						   COLUMN_TEXT, match->text,
+						   COLUMN_TAB, tab,
+						   -1);
+
+		g_free (location);
+	}
+
+	priv->n_matches += matches->len;
+
+	if (expanded)
+	{
+		path = gtk_tree_model_get_path (model, parent);
+		gtk_tree_view_expand_row (GTK_TREE_VIEW (priv->treeview), path, FALSE);
+		gtk_tree_path_free (path);
+	}
+
+	update_documents_status (panel);
+	update_sensitivity (panel);
+}
+
+static void
+documents_tab_removed_cb (GeditFindInDocuments  *search,
+			  GeditTab              *tab,
+			  GeditFindInFilesPanel *panel)
+{
+	remove_document_row (panel, tab);
+
+	update_documents_status (panel);
+	update_sensitivity (panel);
+}
+
+static void
+documents_search_finished_cb (GeditFindInDocuments  *search,
+			      GeditFindInFilesPanel *panel)
+{
+	update_documents_status (panel);
+	update_sensitivity (panel);
+}
+
+static void
+start_documents_search (GeditFindInFilesPanel *panel,
+			const gchar           *search_text,
+			gboolean               regex_enabled,
+			gboolean               case_sensitive)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	GError *error = NULL;
+
+	priv->documents_search = gedit_find_in_documents_new (priv->window,
+							      search_text,
+							      regex_enabled,
+							      case_sensitive,
+							      &error);
+
+	if (priv->documents_search == NULL)
+	{
+		set_status (panel, error->message);
+		g_error_free (error);
+		update_sensitivity (panel);
+		return;
+	}
+
+	g_signal_connect (priv->documents_search,
+			  "tab-updated",
+			  G_CALLBACK (tab_updated_cb),
+			  panel);
+
+	g_signal_connect (priv->documents_search,
+			  "tab-removed",
+			  G_CALLBACK (documents_tab_removed_cb),
+			  panel);
+
+	g_signal_connect (priv->documents_search,
+			  "finished",
+			  G_CALLBACK (documents_search_finished_cb),
+			  panel);
+
+	gedit_find_in_documents_start (priv->documents_search);
+
+	update_documents_status (panel);
+	update_sensitivity (panel);
+}
+
+static void
+start_search (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	const gchar *search_text;
+	gboolean regex_enabled;
+	gboolean case_sensitive;
+	gchar *root_path;
+	GError *error = NULL;
+
+	search_text = gtk_entry_get_text (GTK_ENTRY (priv->search_entry));
+
+	if (search_text[0] == '\0' || priv->replace_cancellable != NULL)
+	{
+		return;
+	}
+
+	if (is_documents_scope (panel))
+	{
+		clear_results (panel);
+
+		start_documents_search (panel,
+					search_text,
+					gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->regex_checkbutton)),
+					gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->match_case_checkbutton)));
+		return;
+	}
+
+	root_path = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (priv->folder_button));
+
+	if (root_path == NULL)
+	{
+		set_status (panel, _("Only local folders can be searched"));
+		return;
+	}
+
+	clear_results (panel);
+
+	regex_enabled = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->regex_checkbutton));
+	case_sensitive = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->match_case_checkbutton));
+
+	priv->job = gedit_find_in_files_job_new (root_path,
+						 search_text,
+						 regex_enabled,
+						 case_sensitive,
+						 &error);
+
+	if (priv->job == NULL)
+	{
+		set_status (panel, error->message);
+		g_error_free (error);
+		g_free (root_path);
+		update_sensitivity (panel);
+		return;
+	}
+
+	g_free (priv->root_path);
+	priv->root_path = root_path;
+
+	priv->search_settings = gtk_source_search_settings_new ();
+	gtk_source_search_settings_set_search_text (priv->search_settings, search_text);
+	gtk_source_search_settings_set_regex_enabled (priv->search_settings, regex_enabled);
+	gtk_source_search_settings_set_case_sensitive (priv->search_settings, case_sensitive);
+
+	apply_file_browser_filters (priv->job);
+
+	g_signal_connect (priv->job,
+			  "matches-found",
+			  G_CALLBACK (matches_found_cb),
+			  panel);
+
+	g_signal_connect (priv->job,
+			  "finished",
+			  G_CALLBACK (job_finished_cb),
+			  panel);
+
+	gedit_find_in_files_job_start (priv->job);
+
+	update_searching_status (panel);
+	update_sensitivity (panel);
+}
+
+static void
+replace_finished_cb (GObject               *source_object,
+		     GAsyncResult          *result,
+		     GeditFindInFilesPanel *panel)
+{
+	guint n_replaced = 0;
+	guint n_files = 0;
+	guint n_failed = 0;
+	GString *msg;
+	GError *error = NULL;
+
+	gedit_find_in_files_replace_finish (result, &n_replaced, &n_files, &n_failed, &error);
+
+	/* The panel has been destroyed meanwhile. */
+	if (panel->priv->store == NULL)
+	{
+		g_clear_error (&error);
+		g_object_unref (panel);
+		return;
+	}
+
+	g_clear_object (&panel->priv->replace_cancellable);
+
+	clear_results (panel);
+
+	msg = g_string_new (NULL);
+
+	g_string_append_printf (msg,
+				ngettext ("%u occurrence replaced", "%u occurrences replaced", n_replaced),
+				n_replaced);
+
+	g_string_append (msg, " \342\200\224 ");
+
+	g_string_append_printf (msg,
+				ngettext ("%u file modified", "%u files modified", n_files),
+				n_files);
+
+	if (n_failed > 0)
+	{
+		g_string_append (msg, " \342\200\224 ");
+		g_string_append_printf (msg,
+					ngettext ("%u file could not be modified",
+						  "%u files could not be modified",
+						  n_failed),
+					n_failed);
+	}
+
+	if (error != NULL)
+	{
+		g_string_append (msg, " \342\200\224 ");
+		g_string_append (msg, error->message);
+		g_error_free (error);
+	}
+
+	set_status (panel, msg->str);
+	g_string_free (msg, TRUE);
+
+	update_sensitivity (panel);
+
+	g_object_unref (panel);
+}
+
+static GList *
+get_result_locations (GeditFindInFilesPanel *panel)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL (panel->priv->store);
+	GHashTable *seen;
+	GList *locations = NULL;
+	GtkTreeIter iter;
+	gboolean valid;
+
+	seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (valid = gtk_tree_model_get_iter_first (model, &iter);
+	     valid;
+	     valid = gtk_tree_model_iter_next (model, &iter))
+	{
+		gchar *path;
+
+		gtk_tree_model_get (model, &iter, COLUMN_PATH, &path, -1);
+
+		if (g_hash_table_contains (seen, path))
+		{
+			g_free (path);
+			continue;
+		}
+
+		locations = g_list_prepend (locations, g_file_new_for_path (path));
+		g_hash_table_add (seen, path);
+	}
+
+	g_hash_table_unref (seen);
+
+	return g_list_reverse (locations);
+}
+
+static void
+replace_all (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	GList *locations;
+
+	if (priv->search_settings == NULL || priv->replace_cancellable != NULL)
+	{
+		return;
+	}
+
+	locations = get_result_locations (panel);
+
+	if (locations == NULL)
+	{
+		return;
+	}
+
+	priv->replace_cancellable = g_cancellable_new ();
+
+	set_status (panel, _("Replacing\342\200\246"));
+	update_sensitivity (panel);
+
+	gedit_find_in_files_replace_async (locations,
+					   priv->search_settings,
+					   gtk_entry_get_text (GTK_ENTRY (priv->replace_entry)),
+					   priv->replace_cancellable,
+					   (GAsyncReadyCallback) replace_finished_cb,
+					   g_object_ref (panel));
+
+	g_list_free_full (locations, g_object_unref);
+}
+
+static void
+activate_document_row (GeditFindInFilesPanel *panel,
+		       GtkTreeIter           *iter)
+{
+	GeditTab *tab;
+	guint line;
+
+	gtk_tree_model_get (GTK_TREE_MODEL (panel->priv->documents_store), iter,
+			    COLUMN_LINE, &line,
+			    COLUMN_TAB, &tab,
+			    -1);
+
+	/* The tab may have been closed or moved since the search was stopped. */
+	if (gtk_widget_get_toplevel (GTK_WIDGET (tab)) != GTK_WIDGET (panel->priv->window))
+	{
+		g_object_unref (tab);
+		return;
+	}
+
+	gedit_window_set_active_tab (panel->priv->window, tab);
+
+	/* The rows of the documents have no line. */
+	if (line > 0)
+	{
+		gedit_document_goto_line (gedit_tab_get_document (tab), line - 1);
+		gedit_view_scroll_to_cursor (gedit_tab_get_view (tab));
+	}
+
+	gtk_widget_grab_focus (GTK_WIDGET (gedit_tab_get_view (tab)));
+
+	g_object_unref (tab);
+}
+
+static void
+row_activated_cb (GtkTreeView           *treeview,
+		  GtkTreePath           *path,
+		  GtkTreeViewColumn     *column,
+		  GeditFindInFilesPanel *panel)
+{
+	GtkTreeModel *model = gtk_tree_view_get_model (treeview);
+	GtkTreeIter iter;
+	gchar *file_path;
+	guint line;
+	GFile *location;
+
+	if (!gtk_tree_model_get_iter (model, &iter, path))
+	{
+		return;
+	}
+
+	if (model == GTK_TREE_MODEL (panel->priv->documents_store))
+	{
+		activate_document_row (panel, &iter);
+		return;
+	}
+
+	gtk_tree_model_get (model, &iter,
+			    COLUMN_PATH, &file_path,
+			    COLUMN_LINE, &line,
+			    -1);
+
+	location = g_file_new_for_path (file_path);
+	gedit_commands_load_location (panel->priv->window, location, NULL, line, 0);
+
+	g_object_unref (location);
+	g_free (file_path);
+}
+
+static void
+search_entry_changed_cb (GtkEntry              *entry,
+			 GeditFindInFilesPanel *panel)
+{
+	update_sensitivity (panel);
+}
+
+static void
+scope_changed_cb (GtkComboBox           *combo,
+		  GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	GtkTreeModel *model;
+
+	clear_results (panel);
+	set_status (panel, "");
+
+	if (is_documents_scope (panel))
+	{
+		model = GTK_TREE_MODEL (priv->documents_store);
+	}
+	else
+	{
+		model = GTK_TREE_MODEL (priv->store);
+	}
+
+	gtk_tree_view_set_model (GTK_TREE_VIEW (priv->treeview), model);
+
+	update_sensitivity (panel);
+}
+
+static void
+create_result_column (GtkTreeView *treeview,
+		      const gchar *title,
+		      gint         column_id,
+		      gint         fixed_width)
+{
+	GtkCellRenderer *renderer;
+	GtkTreeViewColumn *column;
+
+	renderer = gtk_cell_renderer_text_new ();
+	g_object_set (renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+
+	column = gtk_tree_view_column_new_with_attributes (title,
+							   renderer,
+							   "text", column_id,
+							   NULL);
+
+	/* Required by the fixed height mode. */
+	gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_resizable (column, TRUE);
+
+	if (fixed_width > 0)
+	{
+		gtk_tree_view_column_set_fixed_width (column, fixed_width);
+	}
+	else
+	{
+		gtk_tree_view_column_set_expand (column, TRUE);
+	}
+
+	gtk_tree_view_append_column (treeview, column);
+}
+
+static void
+gedit_find_in_files_panel_init (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv;
+	GtkWidget *grid;
+	GtkWidget *label;
+	GtkWidget *scrolled_window;
+
+	panel->priv = gedit_find_in_files_panel_get_instance_private (panel);
+	priv = panel->priv;
+
+	gtk_orientable_set_orientation (GTK_ORIENTABLE (panel), GTK_ORIENTATION_VERTICAL);
+	gtk_box_set_spacing (GTK_BOX (panel), 6);
+	gtk_container_set_border_width (GTK_CONTAINER (panel), 6);
+
+	grid = gtk_grid_new ();
+	gtk_grid_set_row_spacing (GTK_GRID (grid), 6);
+	gtk_grid_set_column_spacing (GTK_GRID (grid), 6);
+	gtk_box_pack_start (GTK_BOX (panel), grid, FALSE, FALSE, 0);
+
+	label = gtk_label_new_with_mnemonic (_("_Find:"));
+	gtk_widget_set_halign (label, GTK_ALIGN_END);
+	gtk_grid_attach (GTK_GRID (grid), label, 0, 0, 1, 1);
+
+	priv->search_entry = gtk_search_entry_new ();
+	gtk_widget_set_hexpand (priv->search_entry, TRUE);
+	gtk_label_set_mnemonic_widget (GTK_LABEL (label), priv->search_entry);
+	gtk_grid_attach (GTK_GRID (grid), priv->search_entry, 1, 0, 1, 1);
+
+	label = gtk_label_new_with_mnemonic (_("_In:"));
+	gtk_widget_set_halign (label, GTK_ALIGN_END);
+	gtk_grid_attach (GTK_GRID (grid), label, 2, 0, 1, 1);
+
+	priv->scope_combo = gtk_combo_box_text_new ();
+	gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (priv->scope_combo),
+				   SCOPE_FOLDER,
+				   _("Folder"));
+	gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (priv->scope_combo),
+				   SCOPE_DOCUMENTS,
+				   _("Open Documents"));
+	gtk_combo_box_set_active_id (GTK_COMBO_BOX (priv->scope_combo), SCOPE_FOLDER);
+	gtk_label_set_mnemonic_widget (GTK_LABEL (label), priv->scope_combo);
+	gtk_grid_attach (GTK_GRID (grid), priv->scope_combo, 3, 0, 1, 1);
+
+	priv->folder_button = gtk_file_chooser_button_new (_("Select a Folder"),
+							   GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER);
+	gtk_file_chooser_set_local_only (GTK_FILE_CHOOSER (priv->folder_button), TRUE);
+	gtk_grid_attach (GTK_GRID (grid), priv->folder_button, 4, 0, 1, 1);
+
+	priv->find_button = gtk_button_new_with_mnemonic (_("F_ind"));
+	gtk_grid_attach (GTK_GRID (grid), priv->find_button, 5, 0, 1, 1);
+
+	priv->stop_button = gtk_button_new_with_mnemonic (_("_Stop"));
+	gtk_widget_set_no_show_all (priv->stop_button, TRUE);
+	gtk_grid_attach (GTK_GRID (grid), priv->stop_button, 6, 0, 1, 1);
+
+	label = gtk_label_new_with_mnemonic (_("Replace _with:"));
+	gtk_widget_set_halign (label, GTK_ALIGN_END);
+	gtk_grid_attach (GTK_GRID (grid), label, 0, 1, 1, 1);
+
+	priv->replace_entry = gtk_entry_new ();
+	gtk_widget_set_hexpand (priv->replace_entry, TRUE);
+	gtk_label_set_mnemonic_widget (GTK_LABEL (label), priv->replace_entry);
+	gtk_grid_attach (GTK_GRID (grid), priv->replace_entry, 1, 1, 1, 1);
+
+	priv->match_case_checkbutton = gtk_check_button_new_with_mnemonic (_("_Match case"));
+	gtk_grid_attach (GTK_GRID (grid), priv->match_case_checkbutton, 2, 1, 1, 1);
+
+	priv->regex_checkbutton = gtk_check_button_new_with_mnemonic (_("Re_gular expression"));
+	gtk_grid_attach (GTK_GRID (grid), priv->regex_checkbutton, 3, 1, 2, 1);
+
+	priv->replace_all_button = gtk_button_new_with_mnemonic (_("Replace _All"));
+	gtk_grid_attach (GTK_GRID (grid), priv->replace_all_button, 5, 1, 1, 1);
+
+	priv->status_label = gtk_label_new (NULL);
+	gtk_widget_set_halign (priv->status_label, GTK_ALIGN_START);
+	gtk_label_set_ellipsize (GTK_LABEL (priv->status_label), PANGO_ELLIPSIZE_END);
+	gtk_box_pack_start (GTK_BOX (panel), priv->status_label, FALSE, FALSE, 0);
+
+	priv->store = gtk_list_store_new (N_COLUMNS,
+					  G_TYPE_STRING,
+					  G_TYPE_UINT,
+					  G_TYPE_STRING,
+					  G_TYPE_STRING,
+					  GEDIT_TYPE_TAB);
+
+	priv->documents_store = gtk_tree_store_new (N_COLUMNS,
+						    G_TYPE_STRING,
+						    G_TYPE_UINT,
+						    G_TYPE_STRING,
+						    G_TYPE_STRING,
+						    GEDIT_TYPE_TAB);
+
+	/* mapping from GeditTab to its GtkTreeIter in documents_store */
+	priv->document_rows = g_hash_table_new_full (g_direct_hash,
+						     g_direct_equal,
+						     NULL,
+						     (GDestroyNotify) gtk_tree_iter_free);
+
+	/* The results can be very numerous: with the fixed height mode, only
+	 * the visible rows are measured and rendered.
+	 */
+	priv->treeview = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->store));
+	gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (priv->treeview), TRUE);
+	gtk_tree_view_set_enable_search (GTK_TREE_VIEW (priv->treeview), FALSE);
+
+	create_result_column (GTK_TREE_VIEW (priv->treeview), _("Location"), COLUMN_LOCATION, 300);
+	create_result_column (GTK_TREE_VIEW (priv->treeview), _("Line"), COLUMN_TEXT, -1);
+
+	scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+	gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled_window), GTK_SHADOW_IN);
+	gtk_widget_set_vexpand (scrolled_window, TRUE);
+	gtk_container_add (GTK_CONTAINER (scrolled_window), priv->treeview);
+	gtk_box_pack_start (GTK_BOX (panel), scrolled_window, TRUE, TRUE, 0);
+
+	g_signal_connect_swapped (priv->search_entry,
+				  "activate",
+				  G_CALLBACK (start_search),
+				  panel);
+
+	g_signal_connect (priv->search_entry,
+			  "changed",
+			  G_CALLBACK (search_entry_changed_cb),
+			  panel);
+
+	g_signal_connect (priv->scope_combo,
+			  "changed",
+			  G_CALLBACK (scope_changed_cb),
+			  panel);
+
+	g_signal_connect_swapped (priv->find_button,
+				  "clicked",
+				  G_CALLBACK (start_search),
+				  panel);
+
+	g_signal_connect_swapped (priv->stop_button,
+				  "clicked",
+				  G_CALLBACK (gedit_find_in_files_panel_cancel),
+				  panel);
+
+	g_signal_connect_swapped (priv->replace_all_button,
+				  "clicked",
+				  G_CALLBACK (replace_all),
+				  panel);
+
+	g_signal_connect (priv->treeview,
+			  "row-activated",
+			  G_CALLBACK (row_activated_cb),
+			  panel);
+
+	gtk_widget_show_all (GTK_WIDGET (panel));
+
+	update_sensitivity (panel);
+}
+
+GtkWidget *
+gedit_find_in_files_panel_new (GeditWindow *window)
+{
+	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
+
+	return g_object_new (GEDIT_TYPE_FIND_IN_FILES_PANEL,
+			     "window", window,
+			     NULL);
+}
+
+void
+gedit_find_in_files_panel_set_root (GeditFindInFilesPanel *panel,
+				    GFile                 *root)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_PANEL (panel));
+	g_return_if_fail (G_IS_FILE (root));
+
+	gtk_file_chooser_set_file (GTK_FILE_CHOOSER (panel->priv->folder_button), root, NULL);
+}
+
+void
+gedit_find_in_files_panel_set_search_text (GeditFindInFilesPanel *panel,
+					   const gchar           *text)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_PANEL (panel));
+	g_return_if_fail (text != NULL);
+
+	gtk_entry_set_text (GTK_ENTRY (panel->priv->search_entry), text);
+}
+
+void
+gedit_find_in_files_panel_grab_search_focus (GeditFindInFilesPanel *panel)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_PANEL (panel));
+
+	gtk_widget_grab_focus (panel->priv->search_entry);
+}
+
+void
+gedit_find_in_files_panel_cancel (GeditFindInFilesPanel *panel)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_PANEL (panel));
+
+	/* The "finished" signal still comes, with the results found so far. */
+	if (panel->priv->job != NULL)
+	{
+		gedit_find_in_files_job_cancel (panel->priv->job);
+	}
+
+	/* The results are kept, but not updated anymore. */
+	if (panel->priv->documents_search != NULL)
+	{
+		stop_documents_search (panel);
+		update_documents_status (panel);
+		update_sensitivity (panel);
+	}
+
+	if (panel->priv->replace_cancellable != NULL)
+	{
+		g_cancellable_cancel (panel->priv->replace_cancellable);
+	}
+}
+
+void
+_gedit_find_in_files_panel_register_type (GTypeModule *type_module)
+{
+	gedit_find_in_files_panel_register_type (type_module);
+}
+
+/* ex:set ts=8 noet: */
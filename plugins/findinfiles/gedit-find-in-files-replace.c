@@ -0,0 +1,392 @@
+/*
+ * gedit-find-in-files-replace.c
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-find-in-files-replace.h"
+
+#include <gedit/gedit-app.h>
+#include <gedit/gedit-commands.h>
+#include <gedit/gedit-debug.h>
+#include <gedit/gedit-document.h>
+#include <gedit/gedit-tab.h>
+#include <gedit/gedit-window.h>
+
+/* The files are handled one at a time: the documents which are not opened are
+ * loaded with a GtkSourceFileLoader, modified and written back with a
+ * GtkSourceFileSaver, so the encoding, the line endings and the compression
+ * of each file are kept. The documents opened in gedit are modified in their
+ * buffer, and saved with the usual save command if they had no other unsaved
+ * changes.
+ */
+
+typedef struct
+{
+	/* Reffed GFile's still to handle */
+	GQueue *locations;
+
+	GtkSourceSearchSettings *settings;
+	gchar *replace_text;
+
+	GSettings *editor_settings;
+
+	/* The file being handled */
+	GeditDocument *doc;
+	GtkSourceFileLoader *loader;
+	GtkSourceFileSaver *saver;
+	guint n_pending;
+
+	guint n_replaced;
+	guint n_files;
+	guint n_failed;
+} ReplaceData;
+
+static void replace_next (GTask *task);
+
+static void
+replace_data_free (ReplaceData *data)
+{
+	g_queue_free_full (data->locations, g_object_unref);
+	g_object_unref (data->settings);
+	g_free (data->replace_text);
+	g_object_unref (data->editor_settings);
+	g_clear_object (&data->doc);
+	g_clear_object (&data->loader);
+	g_clear_object (&data->saver);
+	g_slice_free (ReplaceData, data);
+}
+
+static guint
+replace_in_buffer (ReplaceData   *data,
+		   GeditDocument *doc)
+{
+	GtkSourceSearchContext *search_context;
+	GError *error = NULL;
+	guint count;
+
+	search_context = gtk_source_search_context_new (GTK_SOURCE_BUFFER (doc),
+							data->settings);
+	gtk_source_search_context_set_highlight (search_context, FALSE);
+
+	count = gtk_source_search_context_replace_all (search_context,
+						       data->replace_text,
+						       -1,
+						       &error);
+
+	if (error != NULL)
+	{
+		gedit_debug_message (DEBUG_PLUGINS, "Replace error: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_object_unref (search_context);
+
+	return count;
+}
+
+static GeditDocument *
+get_open_document (GFile *location)
+{
+	GList *docs;
+	GList *l;
+	GeditDocument *ret = NULL;
+
+	docs = gedit_app_get_documents (GEDIT_APP (g_application_get_default ()));
+
+	for (l = docs; l != NULL; l = l->next)
+	{
+		GtkSourceFile *file = gedit_document_get_file (l->data);
+		GFile *doc_location = gtk_source_file_get_location (file);
+
+		if (doc_location != NULL && g_file_equal (doc_location, location))
+		{
+			ret = l->data;
+			break;
+		}
+	}
+
+	g_list_free (docs);
+
+	return ret;
+}
+
+static void
+save_open_document_cb (GeditDocument *doc,
+		       GAsyncResult  *result,
+		       gpointer       user_data)
+{
+	gedit_commands_save_document_finish (doc, result);
+}
+
+static void
+replace_in_open_document (ReplaceData   *data,
+			  GeditDocument *doc)
+{
+	gboolean had_changes;
+	GeditTab *tab;
+	GtkWidget *window;
+	guint count;
+
+	tab = gedit_tab_get_from_document (doc);
+
+	/* The document is being loaded, reverted or saved, or shows an error:
+	 * editing it now would corrupt the operation.
+	 */
+	if (tab == NULL || gedit_tab_get_state (tab) != GEDIT_TAB_STATE_NORMAL)
+	{
+		gchar *name = gedit_document_get_short_name_for_display (doc);
+
+		gedit_debug_message (DEBUG_PLUGINS, "Document busy, not replaced: %s", name);
+		g_free (name);
+
+		data->n_failed++;
+		return;
+	}
+
+	had_changes = gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (doc));
+
+	count = replace_in_buffer (data, doc);
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	data->n_replaced += count;
+	data->n_files++;
+
+	window = gtk_widget_get_toplevel (GTK_WIDGET (tab));
+
+	/* Do not save changes the user has not saved yet. */
+	if (!had_changes &&
+	    !gedit_document_get_readonly (doc) &&
+	    GEDIT_IS_WINDOW (window))
+	{
+		gedit_commands_save_document_async (doc,
+						    GEDIT_WINDOW (window),
+						    NULL,
+						    (GAsyncReadyCallback) save_open_document_cb,
+						    NULL);
+	}
+}
+
+static void
+finish_current_file (ReplaceData *data)
+{
+	g_clear_object (&data->doc);
+	g_clear_object (&data->loader);
+	g_clear_object (&data->saver);
+	data->n_pending = 0;
+}
+
+static void
+save_cb (GtkSourceFileSaver *saver,
+	 GAsyncResult       *result,
+	 GTask              *task)
+{
+	ReplaceData *data = g_task_get_task_data (task);
+	GError *error = NULL;
+
+	if (gtk_source_file_saver_save_finish (saver, result, &error))
+	{
+		data->n_replaced += data->n_pending;
+		data->n_files++;
+	}
+	else
+	{
+		gedit_debug_message (DEBUG_PLUGINS, "Saving error: %s", error->message);
+		g_error_free (error);
+		data->n_failed++;
+	}
+
+	finish_current_file (data);
+	replace_next (task);
+}
+
+static void
+load_cb (GtkSourceFileLoader *loader,
+	 GAsyncResult        *result,
+	 GTask               *task)
+{
+	ReplaceData *data = g_task_get_task_data (task);
+	GtkSourceFileSaverFlags flags = GTK_SOURCE_FILE_SAVER_FLAGS_NONE;
+	GError *error = NULL;
+
+	if (!gtk_source_file_loader_load_finish (loader, result, &error))
+	{
+		gedit_debug_message (DEBUG_PLUGINS, "Loading error: %s", error->message);
+		g_error_free (error);
+		data->n_failed++;
+
+		finish_current_file (data);
+		replace_next (task);
+		return;
+	}
+
+	data->n_pending = replace_in_buffer (data, data->doc);
+
+	if (data->n_pending == 0)
+	{
+		finish_current_file (data);
+		replace_next (task);
+		return;
+	}
+
+	if (g_settings_get_boolean (data->editor_settings, "create-backup-copy"))
+	{
+		flags |= GTK_SOURCE_FILE_SAVER_FLAGS_CREATE_BACKUP;
+	}
+
+	data->saver = gtk_source_file_saver_new (GTK_SOURCE_BUFFER (data->doc),
+						 gedit_document_get_file (data->doc));
+	gtk_source_file_saver_set_flags (data->saver, flags);
+
+	gtk_source_file_saver_save_async (data->saver,
+					  G_PRIORITY_DEFAULT,
+					  g_task_get_cancellable (task),
+					  NULL, NULL, NULL,
+					  (GAsyncReadyCallback) save_cb,
+					  task);
+}
+
+static void
+replace_next (GTask *task)
+{
+	ReplaceData *data = g_task_get_task_data (task);
+
+	while (!g_queue_is_empty (data->locations))
+	{
+		GFile *location;
+		GeditDocument *doc;
+		GtkSourceFile *file;
+
+		if (g_task_return_error_if_cancelled (task))
+		{
+			g_object_unref (task);
+			return;
+		}
+
+		location = g_queue_pop_head (data->locations);
+		doc = get_open_document (location);
+
+		if (doc != NULL)
+		{
+			replace_in_open_document (data, doc);
+			g_object_unref (location);
+			continue;
+		}
+
+		data->doc = gedit_document_new ();
+		file = gedit_document_get_file (data->doc);
+		gtk_source_file_set_location (file, location);
+		g_object_unref (location);
+
+		data->loader = gtk_source_file_loader_new (GTK_SOURCE_BUFFER (data->doc), file);
+
+		gtk_source_file_loader_load_async (data->loader,
+						   G_PRIORITY_DEFAULT,
+						   g_task_get_cancellable (task),
+						   NULL, NULL, NULL,
+						   (GAsyncReadyCallback) load_cb,
+						   task);
+		return;
+	}
+
+	g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
+
+/**
+ * gedit_find_in_files_replace_async:
+ * @locations: (element-type GFile): the files where to replace.
+ * @settings: the search settings.
+ * @replace_text: the replacement, with the escape sequences of the search
+ *   and replace dialog.
+ * @cancellable: (nullable): optional #GCancellable object, %NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to the @callback function.
+ *
+ * Replaces all the occurrences in @locations, one file at a time.
+ */
+void
+gedit_find_in_files_replace_async (GList                   *locations,
+				   GtkSourceSearchSettings *settings,
+				   const gchar             *replace_text,
+				   GCancellable            *cancellable,
+				   GAsyncReadyCallback      callback,
+				   gpointer                 user_data)
+{
+	GTask *task;
+	ReplaceData *data;
+	GList *l;
+
+	g_return_if_fail (GTK_SOURCE_IS_SEARCH_SETTINGS (settings));
+	g_return_if_fail (replace_text != NULL);
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+
+	data = g_slice_new0 (ReplaceData);
+	data->locations = g_queue_new ();
+	data->settings = g_object_ref (settings);
+	data->replace_text = gtk_source_utils_unescape_search_text (replace_text);
+	data->editor_settings = g_settings_new ("org.gnome.gedit.preferences.editor");
+
+	for (l = locations; l != NULL; l = l->next)
+	{
+		g_queue_push_tail (data->locations, g_object_ref (l->data));
+	}
+
+	g_task_set_task_data (task, data, (GDestroyNotify) replace_data_free);
+
+	replace_next (task);
+}
+
+gboolean
+gedit_find_in_files_replace_finish (GAsyncResult  *result,
+				    guint         *n_replaced,
+				    guint         *n_files,
+				    guint         *n_failed,
+				    GError       **error)
+{
+	ReplaceData *data;
+
+	g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+	data = g_task_get_task_data (G_TASK (result));
+
+	if (n_replaced != NULL)
+	{
+		*n_replaced = data->n_replaced;
+	}
+
+	if (n_files != NULL)
+	{
+		*n_files = data->n_files;
+	}
+
+	if (n_failed != NULL)
+	{
+		*n_failed = data->n_failed;
+	}
+
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/* ex:set ts=8 noet: */
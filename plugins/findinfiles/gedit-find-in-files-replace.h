@@ -0,0 +1,43 @@
+/*
+ * gedit-find-in-files-replace.h
+ * This file is part of gedit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_FIND_IN_FILES_REPLACE_H__
+#define __GEDIT_FIND_IN_FILES_REPLACE_H__
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+void		gedit_find_in_files_replace_async	(GList                    *locations,
+							 GtkSourceSearchSettings  *settings,
+							 const gchar              *replace_text,
+							 GCancellable             *cancellable,
+							 GAsyncReadyCallback       callback,
+							 gpointer                  user_data);
+
+gboolean	gedit_find_in_files_replace_finish	(GAsyncResult             *result,
+							 guint                    *n_replaced,
+							 guint                    *n_files,
+							 guint                    *n_failed,
+							 GError                  **error);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FIND_IN_FILES_REPLACE_H__ */
+
+/* ex:set ts=8 noet: */
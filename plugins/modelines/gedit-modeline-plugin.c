@@ -35,6 +35,7 @@ struct _GeditModelinePluginPrivate
 {
 	GeditView *view;
 
+	gulong document_load_preview_handler_id;
 	gulong document_loaded_handler_id;
 	gulong document_saved_handler_id;
 };
@@ -147,6 +148,20 @@ on_document_loaded_or_saved (GeditDocument *document,
 	modeline_parser_apply_modeline (view);
 }
 
+/* The modelines are applied before the content is inserted, so that the view
+ * is not laid out and highlighted a second time at the end of the loading. The
+ * "loaded" handler then finds the same options, which does nothing, unless the
+ * preview was not available or the content changed meanwhile.
+ */
+static void
+on_document_load_preview (GeditDocument *document,
+			  const gchar   *head,
+			  const gchar   *tail,
+			  GtkSourceView *view)
+{
+	modeline_parser_apply_modeline_from_text (view, head, tail);
+}
+
 static void
 gedit_modeline_plugin_activate (GeditViewActivatable *activatable)
 {
@@ -161,6 +176,10 @@ gedit_modeline_plugin_activate (GeditViewActivatable *activatable)
 
 	doc = gtk_text_view_get_buffer (GTK_TEXT_VIEW (plugin->priv->view));
 
+	plugin->priv->document_load_preview_handler_id =
+		g_signal_connect (doc, "load-preview",
+				  G_CALLBACK (on_document_load_preview),
+				  plugin->priv->view);
 	plugin->priv->document_loaded_handler_id =
 		g_signal_connect (doc, "loaded",
 				  G_CALLBACK (on_document_loaded_or_saved),
@@ -183,6 +202,7 @@ gedit_modeline_plugin_deactivate (GeditViewActivatable *activatable)
 
 	doc = gtk_text_view_get_buffer (GTK_TEXT_VIEW (plugin->priv->view));
 
+	g_signal_handler_disconnect (doc, plugin->priv->document_load_preview_handler_id);
 	g_signal_handler_disconnect (doc, plugin->priv->document_loaded_handler_id);
 	g_signal_handler_disconnect (doc, plugin->priv->document_saved_handler_id);
 }
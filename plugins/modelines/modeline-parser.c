@@ -674,84 +674,20 @@ free_modeline_options (ModelineOptions *options)
 	g_slice_free (ModelineOptions, options);
 }
 
-void
-modeline_parser_apply_modeline (GtkSourceView *view)
+static void
+apply_options (GtkSourceView   *view,
+	       ModelineOptions *options)
 {
-	ModelineOptions options;
 	GtkTextBuffer *buffer;
-	GtkTextIter iter, liter;
-	gint line_count;
+	ModelineOptions *previous;
 	GSettings *settings;
 
-	options.language_id = NULL;
-	options.set = MODELINE_SET_NONE;
-
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
-	gtk_text_buffer_get_start_iter (buffer, &iter);
-
-	line_count = gtk_text_buffer_get_line_count (buffer);
-
-	/* Parse the modelines on the 10 first lines... */
-	while ((gtk_text_iter_get_line (&iter) < 10) &&
-	       !gtk_text_iter_is_end (&iter))
-	{
-		gchar *line;
-
-		liter = iter;
-		gtk_text_iter_forward_to_line_end (&iter);
-		line = gtk_text_buffer_get_text (buffer, &liter, &iter, TRUE);
-
-		parse_modeline (line,
-				1 + gtk_text_iter_get_line (&iter),
-				line_count,
-				&options);
-
-		gtk_text_iter_forward_line (&iter);
-
-		g_free (line);
-	}
-
-	/* ...and on the 10 last ones (modelines are not allowed in between) */
-	if (!gtk_text_iter_is_end (&iter))
-	{
-		gint cur_line;
-		guint remaining_lines;
-
-		/* we are on the 11th line (count from 0) */
-		cur_line = gtk_text_iter_get_line (&iter);
-		/* g_assert (10 == cur_line); */
-
-		remaining_lines = line_count - cur_line - 1;
-
-		if (remaining_lines > 10)
-		{
-			gtk_text_buffer_get_end_iter (buffer, &iter);
-			gtk_text_iter_backward_lines (&iter, 9);
-		}
-	}
-
-	while (!gtk_text_iter_is_end (&iter))
-	{
-		gchar *line;
-
-		liter = iter;
-		gtk_text_iter_forward_to_line_end (&iter);
-		line = gtk_text_buffer_get_text (buffer, &liter, &iter, TRUE);
-
-		parse_modeline (line,
-				1 + gtk_text_iter_get_line (&iter),
-				line_count,
-				&options);
-
-		gtk_text_iter_forward_line (&iter);
-
-		g_free (line);
-	}
 
 	/* Try to set language */
-	if (has_option (&options, MODELINE_SET_LANGUAGE) && options.language_id)
+	if (has_option (options, MODELINE_SET_LANGUAGE) && options->language_id)
 	{
-		if (g_ascii_strcasecmp (options.language_id, "text") == 0)
+		if (g_ascii_strcasecmp (options->language_id, "text") == 0)
 		{
 			gedit_document_set_language (GEDIT_DOCUMENT (buffer),
 			                             NULL);
@@ -764,7 +700,7 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 		        manager = gtk_source_language_manager_get_default ();
 
 			language = gtk_source_language_manager_get_language
-					(manager, options.language_id);
+					(manager, options->language_id);
 			if (language != NULL)
 			{
 				gedit_document_set_language (GEDIT_DOCUMENT (buffer),
@@ -774,22 +710,22 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 			{
 				gedit_debug_message (DEBUG_PLUGINS,
 						     "Unknown language `%s'",
-						     options.language_id);
+						     options->language_id);
 			}
 		}
 	}
 
-	ModelineOptions *previous = g_object_get_data (G_OBJECT (buffer),
-	                                               MODELINE_OPTIONS_DATA_KEY);
+	previous = g_object_get_data (G_OBJECT (buffer),
+	                              MODELINE_OPTIONS_DATA_KEY);
 
 	settings = g_settings_new ("org.gnome.gedit.preferences.editor");
 
 	/* Apply the options we got from modelines and restore defaults if
 	   we set them before */
-	if (has_option (&options, MODELINE_SET_INSERT_SPACES))
+	if (has_option (options, MODELINE_SET_INSERT_SPACES))
 	{
 		gtk_source_view_set_insert_spaces_instead_of_tabs
-							(view, options.insert_spaces);
+							(view, options->insert_spaces);
 	}
 	else if (check_previous (view, previous, MODELINE_SET_INSERT_SPACES))
 	{
@@ -800,9 +736,9 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 		gtk_source_view_set_insert_spaces_instead_of_tabs (view, insert_spaces);
 	}
 
-	if (has_option (&options, MODELINE_SET_TAB_WIDTH))
+	if (has_option (options, MODELINE_SET_TAB_WIDTH))
 	{
-		gtk_source_view_set_tab_width (view, options.tab_width);
+		gtk_source_view_set_tab_width (view, options->tab_width);
 	}
 	else if (check_previous (view, previous, MODELINE_SET_TAB_WIDTH))
 	{
@@ -813,18 +749,18 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 		gtk_source_view_set_tab_width (view, tab_width);
 	}
 
-	if (has_option (&options, MODELINE_SET_INDENT_WIDTH))
+	if (has_option (options, MODELINE_SET_INDENT_WIDTH))
 	{
-		gtk_source_view_set_indent_width (view, options.indent_width);
+		gtk_source_view_set_indent_width (view, options->indent_width);
 	}
 	else if (check_previous (view, previous, MODELINE_SET_INDENT_WIDTH))
 	{
 		gtk_source_view_set_indent_width (view, -1);
 	}
 
-	if (has_option (&options, MODELINE_SET_WRAP_MODE))
+	if (has_option (options, MODELINE_SET_WRAP_MODE))
 	{
-		gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (view), options.wrap_mode);
+		gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (view), options->wrap_mode);
 	}
 	else if (check_previous (view, previous, MODELINE_SET_WRAP_MODE))
 	{
@@ -835,9 +771,9 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 		gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (view), mode);
 	}
 
-	if (has_option (&options, MODELINE_SET_RIGHT_MARGIN_POSITION))
+	if (has_option (options, MODELINE_SET_RIGHT_MARGIN_POSITION))
 	{
-		gtk_source_view_set_right_margin_position (view, options.right_margin_position);
+		gtk_source_view_set_right_margin_position (view, options->right_margin_position);
 	}
 	else if (check_previous (view, previous, MODELINE_SET_RIGHT_MARGIN_POSITION))
 	{
@@ -849,9 +785,9 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 		                                           right_margin_pos);
 	}
 
-	if (has_option (&options, MODELINE_SET_SHOW_RIGHT_MARGIN))
+	if (has_option (options, MODELINE_SET_SHOW_RIGHT_MARGIN))
 	{
-		gtk_source_view_set_show_right_margin (view, options.display_right_margin);
+		gtk_source_view_set_show_right_margin (view, options->display_right_margin);
 	}
 	else if (check_previous (view, previous, MODELINE_SET_SHOW_RIGHT_MARGIN))
 	{
@@ -865,14 +801,14 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 	if (previous)
 	{
 		g_free (previous->language_id);
-		*previous = options;
-		previous->language_id = g_strdup (options.language_id);
+		*previous = *options;
+		previous->language_id = g_strdup (options->language_id);
 	}
 	else
 	{
 		previous = g_slice_new (ModelineOptions);
-		*previous = options;
-		previous->language_id = g_strdup (options.language_id);
+		*previous = *options;
+		previous->language_id = g_strdup (options->language_id);
 
 		g_object_set_data_full (G_OBJECT (buffer),
 		                        MODELINE_OPTIONS_DATA_KEY,
@@ -881,6 +817,211 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 	}
 
 	g_object_unref (settings);
+}
+
+void
+modeline_parser_apply_modeline (GtkSourceView *view)
+{
+	ModelineOptions options;
+	GtkTextBuffer *buffer;
+	GtkTextIter iter, liter;
+	gint line_count;
+
+	options.language_id = NULL;
+	options.set = MODELINE_SET_NONE;
+
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+	gtk_text_buffer_get_start_iter (buffer, &iter);
+
+	line_count = gtk_text_buffer_get_line_count (buffer);
+
+	/* Parse the modelines on the 10 first lines... */
+	while ((gtk_text_iter_get_line (&iter) < 10) &&
+	       !gtk_text_iter_is_end (&iter))
+	{
+		gchar *line;
+
+		liter = iter;
+		gtk_text_iter_forward_to_line_end (&iter);
+		line = gtk_text_buffer_get_text (buffer, &liter, &iter, TRUE);
+
+		parse_modeline (line,
+				1 + gtk_text_iter_get_line (&iter),
+				line_count,
+				&options);
+
+		gtk_text_iter_forward_line (&iter);
+
+		g_free (line);
+	}
+
+	/* ...and on the 10 last ones (modelines are not allowed in between) */
+	if (!gtk_text_iter_is_end (&iter))
+	{
+		gint cur_line;
+		guint remaining_lines;
+
+		/* we are on the 11th line (count from 0) */
+		cur_line = gtk_text_iter_get_line (&iter);
+		/* g_assert (10 == cur_line); */
+
+		remaining_lines = line_count - cur_line - 1;
+
+		if (remaining_lines > 10)
+		{
+			gtk_text_buffer_get_end_iter (buffer, &iter);
+			gtk_text_iter_backward_lines (&iter, 9);
+		}
+	}
+
+	while (!gtk_text_iter_is_end (&iter))
+	{
+		gchar *line;
+
+		liter = iter;
+		gtk_text_iter_forward_to_line_end (&iter);
+		line = gtk_text_buffer_get_text (buffer, &liter, &iter, TRUE);
+
+		parse_modeline (line,
+				1 + gtk_text_iter_get_line (&iter),
+				line_count,
+				&options);
+
+		gtk_text_iter_forward_line (&iter);
+
+		g_free (line);
+	}
+
+	apply_options (view, &options);
+
+	g_free (options.language_id);
+}
+
+/* Parses the lines of @text, numbering them from @first_line. */
+static void
+parse_text_lines (const gchar     *text,
+		  gint             first_line,
+		  gint             line_count,
+		  ModelineOptions *options)
+{
+	gchar **lines;
+	guint n_lines;
+	guint i;
+
+	lines = g_strsplit (text, "\n", -1);
+	n_lines = g_strv_length (lines);
+
+	for (i = 0; i < n_lines && i < 10; i++)
+	{
+		parse_modeline (lines[i], first_line + i, line_count, options);
+	}
+
+	g_strfreev (lines);
+}
+
+static gint
+count_text_lines (const gchar *text)
+{
+	gint n_lines = 1;
+
+	while ((text = strchr (text, '\n')) != NULL)
+	{
+		n_lines++;
+		text++;
+	}
+
+	return n_lines;
+}
+
+/* Applies the modelines found in the first and last lines of a file, before
+ * it is loaded in the buffer. @tail is %NULL if @head is the whole file.
+ */
+void
+modeline_parser_apply_modeline_from_text (GtkSourceView *view,
+					  const gchar   *head,
+					  const gchar   *tail)
+{
+	ModelineOptions options;
+	gint line_count;
+
+	g_return_if_fail (head != NULL);
+
+	options.language_id = NULL;
+	options.set = MODELINE_SET_NONE;
+
+	if (tail == NULL)
+	{
+		const gchar *end;
+
+		/* The file loader removes the trailing newline, with the
+		 * default settings.
+		 */
+		line_count = count_text_lines (head);
+
+		if (g_str_has_suffix (head, "\n"))
+		{
+			line_count--;
+		}
+
+		parse_text_lines (head, 1, line_count, &options);
+
+		/* Modelines are only looked for on the first and last 10
+		 * lines.
+		 */
+		if (line_count > 10)
+		{
+			gint first_line = MAX (11, line_count - 9);
+			gint i;
+
+			end = head;
+
+			for (i = 1; i < first_line; i++)
+			{
+				end = strchr (end, '\n') + 1;
+			}
+
+			parse_text_lines (end, first_line, line_count, &options);
+		}
+	}
+	else
+	{
+		gint n_tail_lines;
+		gint first_line;
+		gchar **lines;
+		gchar *last_lines;
+
+		/* The real number of lines is not known, it is big enough for
+		 * the head and the tail not to overlap.
+		 */
+		line_count = G_MAXINT / 2;
+
+		parse_text_lines (head, 1, line_count, &options);
+
+		/* Keep the 10 last lines of the tail. */
+		lines = g_strsplit (tail, "\n", -1);
+		n_tail_lines = g_strv_length (lines);
+
+		if (g_str_has_suffix (tail, "\n"))
+		{
+			g_free (lines[n_tail_lines - 1]);
+			lines[n_tail_lines - 1] = NULL;
+			n_tail_lines--;
+		}
+
+		first_line = MAX (0, n_tail_lines - 10);
+		last_lines = g_strjoinv ("\n", lines + first_line);
+
+		parse_text_lines (last_lines,
+				  line_count - (n_tail_lines - first_line) + 1,
+				  line_count,
+				  &options);
+
+		g_free (last_lines);
+		g_strfreev (lines);
+	}
+
+	apply_options (view, &options);
+
 	g_free (options.language_id);
 }
 
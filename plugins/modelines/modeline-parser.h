@@ -29,6 +29,10 @@ G_BEGIN_DECLS
 void	modeline_parser_init		(const gchar *data_dir);
 void	modeline_parser_shutdown	(void);
 void	modeline_parser_apply_modeline	(GtkSourceView *view);
+void	modeline_parser_apply_modeline_from_text
+					(GtkSourceView *view,
+					 const gchar   *head,
+					 const gchar   *tail);
 
 G_END_DECLS
 
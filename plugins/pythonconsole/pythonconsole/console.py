@@ -27,6 +27,7 @@ import string
 import sys
 import re
 import traceback
+import threading
 
 from gi.repository import GLib, Gio, Gtk, Gdk, Pango
 
@@ -46,6 +47,13 @@ class PythonConsole(Gtk.ScrolledWindow):
 
     CONSOLE_KEY_COMMAND_COLOR = 'command-color'
     CONSOLE_KEY_ERROR_COLOR = 'error-color'
+    CONSOLE_KEY_THREADED_EVALUATION = 'threaded-evaluation'
+
+    # The output is inserted at most this often, in milliseconds
+    FLUSH_INTERVAL = 16
+
+    # Number of lines kept before the input line, the oldest ones are removed
+    MAX_LINES = 10000
 
     def __init__(self, namespace = {}):
         Gtk.ScrolledWindow.__init__(self)
@@ -81,6 +89,15 @@ class PythonConsole(Gtk.ScrolledWindow):
 
         self.block_command = False
 
+        # Written by the evaluations, possibly from the worker thread
+        self._pending = []
+        self._pending_lock = threading.Lock()
+        self._flush_id = 0
+        self._scroll_id = 0
+
+        # Whether a command is evaluated in the worker thread
+        self.running = False
+
         # Init first line
         buf.create_mark("input-line", buf.get_end_iter(), True)
         buf.insert(buf.get_end_iter(), ">>> ")
@@ -150,6 +167,10 @@ class PythonConsole(Gtk.ScrolledWindow):
         modifier_mask = Gtk.accelerator_get_default_mod_mask()
         event_state = event.state & modifier_mask
 
+        # Wait for the command being evaluated
+        if self.running:
+            return True
+
         if event.keyval == Gdk.KEY_D and event_state == Gdk.ModifierType.CONTROL_MASK:
             self.destroy()
 
@@ -208,19 +229,17 @@ class PythonConsole(Gtk.ScrolledWindow):
                 com_mark = "... "
             else:
                 # Eval the command
-                self.__run(self.current_command)
+                command = self.current_command
                 self.current_command = ''
                 self.block_command = False
+
+                # The prompt is added once the worker thread is done
+                if self.__run(command, True):
+                    return True
+
                 com_mark = ">>> "
 
-            # Prepare the new line
-            cur = buf.get_end_iter()
-            buf.move_mark(lin_mark, cur)
-            buf.insert(cur, com_mark)
-            cur = buf.get_end_iter()
-            buf.move_mark(inp_mark, cur)
-            buf.place_cursor(cur)
-            GLib.idle_add(self.scroll_to_end)
+            self.__prompt(com_mark)
             return True
 
         elif event.keyval == Gdk.KEY_KP_Down or event.keyval == Gdk.KEY_Down:
@@ -296,7 +315,7 @@ class PythonConsole(Gtk.ScrolledWindow):
     def __mark_set_cb(self, buf, it, name):
         input = buf.get_iter_at_mark(buf.get_mark("input"))
         pos   = buf.get_iter_at_mark(buf.get_insert())
-        self.view.set_editable(pos.compare(input) != -1)
+        self.view.set_editable(not self.running and pos.compare(input) != -1)
 
     def get_command_line(self):
         buf = self.view.get_buffer()
@@ -331,19 +350,84 @@ class PythonConsole(Gtk.ScrolledWindow):
             self.history_pos = self.history_pos + 1
             self.set_command_line(self.history[self.history_pos])
 
+    def __prompt(self, com_mark):
+        # Prepare the new line
+        buf = self.view.get_buffer()
+        cur = buf.get_end_iter()
+        buf.move_mark_by_name("input-line", cur)
+        buf.insert(cur, com_mark)
+        cur = buf.get_end_iter()
+        buf.move_mark_by_name("input", cur)
+        buf.place_cursor(cur)
+        GLib.idle_add(self.scroll_to_end)
+
     def scroll_to_end(self):
+        self._scroll_id = 0
         i = self.view.get_buffer().get_end_iter()
         self.view.scroll_to_iter(i, 0.0, False, 0.5, 0.5)
         return False
 
     def write(self, text, tag = None):
+        # Can be called from the worker thread, the text is inserted later
+        # from the main loop
+        with self._pending_lock:
+            if self._pending and self._pending[-1][1] is tag:
+                self._pending[-1][0].append(text)
+            else:
+                self._pending.append(([text], tag))
+
+            if self._flush_id == 0:
+                self._flush_id = GLib.timeout_add(self.FLUSH_INTERVAL, self.__flush_timeout)
+
+    def __flush_timeout(self):
+        self.flush()
+        return False
+
+    def flush(self):
+        with self._pending_lock:
+            pending = self._pending
+            self._pending = []
+
+            if self._flush_id != 0:
+                GLib.source_remove(self._flush_id)
+                self._flush_id = 0
+
+        if not pending:
+            return
+
         buf = self.view.get_buffer()
-        if tag is None:
-            buf.insert(buf.get_end_iter(), text)
-        else:
-            buf.insert_with_tags(buf.get_end_iter(), text, tag)
 
-        GLib.idle_add(self.scroll_to_end)
+        for texts, tag in pending:
+            text = ''.join(texts)
+
+            if tag is None:
+                buf.insert(buf.get_end_iter(), text)
+            else:
+                buf.insert_with_tags(buf.get_end_iter(), text, tag)
+
+        self.__trim()
+
+        if self._scroll_id == 0:
+            self._scroll_id = GLib.idle_add(self.scroll_to_end)
+
+    def __trim(self):
+        buf = self.view.get_buffer()
+        excess = buf.get_line_count() - self.MAX_LINES
+
+        if excess <= 0:
+            return
+
+        # Never remove the command being typed
+        end = buf.get_iter_at_line(excess)
+        input_line = buf.get_iter_at_mark(buf.get_mark("input-line"))
+
+        if not input_line.starts_line():
+            input_line.set_line_offset(0)
+
+        if end.compare(input_line) > 0:
+            end = input_line
+
+        buf.delete(buf.get_start_iter(), end)
 
     def eval(self, command, display_command = False):
         buf = self.view.get_buffer()
@@ -368,10 +452,44 @@ class PythonConsole(Gtk.ScrolledWindow):
         buf.move_mark_by_name("input", cur)
         self.view.scroll_to_iter(buf.get_end_iter(), 0.0, False, 0.5, 0.5)
 
-    def __run(self, command):
+    def __redirect(self):
         sys.stdout, self.stdout = self.stdout, sys.stdout
         sys.stderr, self.stderr = self.stderr, sys.stderr
 
+    # Returns True if the command is evaluated in the worker thread
+    def __run(self, command, allow_thread = False):
+        if allow_thread and self._settings.get_boolean(self.CONSOLE_KEY_THREADED_EVALUATION):
+            self.running = True
+            self.view.set_editable(False)
+            self.__redirect()
+
+            thread = threading.Thread(target = self.__run_thread, args = (command,))
+            thread.daemon = True
+            thread.start()
+
+            return True
+
+        self.__redirect()
+        self.__execute(command)
+        self.__redirect()
+        self.flush()
+
+        return False
+
+    def __run_thread(self, command):
+        self.__execute(command)
+        GLib.idle_add(self.__run_finished)
+
+    def __run_finished(self):
+        self.__redirect()
+        self.flush()
+        self.running = False
+        self.__prompt(">>> ")
+        self.view.set_editable(True)
+
+        return False
+
+    def __execute(self, command):
         try:
             try:
                 r = eval(command, self.namespace, self.namespace)
@@ -385,9 +503,6 @@ class PythonConsole(Gtk.ScrolledWindow):
             else:
                 traceback.print_exc()
 
-        sys.stdout, self.stdout = self.stdout, sys.stdout
-        sys.stderr, self.stderr = self.stderr, sys.stderr
-
     def destroy(self):
         pass
         #gtk.ScrolledWindow.destroy(self)
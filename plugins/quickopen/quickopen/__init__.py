@@ -66,6 +66,7 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
 
     def _create_popup(self):
         paths = []
+        roots = []
 
         # Open documents
         paths.append(CurrentDocumentsDirectory(self.window))
@@ -77,6 +78,11 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
             gfile = doc.get_location()
             paths.append(gfile.get_parent())
 
+            project = self._project_dir(gfile.get_parent())
+
+            if project:
+                roots.append(project)
+
         # File browser root directory
         bus = self.window.get_message_bus()
 
@@ -88,6 +94,7 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
 
                 if gfile and gfile.is_native():
                     paths.append(gfile)
+                    roots.insert(0, gfile)
 
         # Recent documents
         paths.append(RecentDocumentsDirectory())
@@ -96,6 +103,11 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
         for path in self._local_bookmarks():
             paths.append(path)
 
+            # Only the bookmark containing the current document is indexed,
+            # not all of them at each popup
+            if doc and doc.is_local() and doc.get_location().has_prefix(path):
+                roots.append(path)
+
         # Desktop directory
         desktopdir = self._desktop_dir()
 
@@ -105,7 +117,12 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
         # Home directory
         paths.append(Gio.file_new_for_path(os.path.expanduser('~')))
 
-        self._popup = Popup(self.window, paths, self.on_activated)
+        # The indexed directories are the ones chosen by the user, but not
+        # the whole home directory
+        home = Gio.file_new_for_path(os.path.expanduser('~'))
+        roots = [r for r in roots if r.get_parent() and not r.equal(home)]
+
+        self._popup = Popup(self.window, paths, self.on_activated, roots)
         self.window.get_group().add_window(self._popup)
 
         self._popup.set_default_size(*self.get_popup_size())
@@ -113,6 +130,20 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
         self._popup.set_position(Gtk.WindowPosition.CENTER_ON_PARENT)
         self._popup.connect('destroy', self.on_popup_destroy)
 
+    # The closest directory containing a version control directory, so that
+    # opening /etc/hosts does not scan /etc
+    def _project_dir(self, gfile):
+        home = Gio.file_new_for_path(os.path.expanduser('~'))
+
+        while gfile and gfile.get_parent() and not gfile.equal(home):
+            for marker in ('.git', '.hg', '.bzr', '.svn', '_darcs'):
+                if gfile.get_child(marker).query_exists(None):
+                    return gfile
+
+            gfile = gfile.get_parent()
+
+        return None
+
     def _local_bookmarks(self):
         filename = os.path.expanduser('~/.config/gtk-3.0/bookmarks')
 
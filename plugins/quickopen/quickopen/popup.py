@@ -16,8 +16,8 @@
 #  along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 import os
+import sys
 import platform
-import functools
 import fnmatch
 from gi.repository import GLib, Gio, GObject, Pango, Gtk, Gdk, Gedit
 import xml.sax.saxutils
@@ -27,7 +27,10 @@ from .virtualdirs import VirtualDirectory
 class Popup(Gtk.Dialog):
     __gtype_name__ = "QuickOpenPopup"
 
-    def __init__(self, window, paths, handler):
+    # Maximum number of files listed from the project indexes
+    MAX_INDEX_RESULTS = 100
+
+    def __init__(self, window, paths, handler, roots=[]):
         Gtk.Dialog.__init__(self,
                             title=_('Quick Open'),
                             transient_for=window,
@@ -44,6 +47,7 @@ class Popup(Gtk.Dialog):
         self._size = (0, 0)
         self._dirs = []
         self._cache = {}
+        self._icons = {}
         self._theme = None
         self._cursor = None
         self._shift_start = None
@@ -65,7 +69,21 @@ class Popup(Gtk.Dialog):
                 self._dirs.append(path)
                 unique.append(path.get_uri())
 
+        # The indexes are shared by the application, and kept between the
+        # popups, so that only the first search waits for the scan.
+        self._indexes = []
+        self._index_changed_id = 0
+        self._index_uris = []
+
+        for root in roots:
+            index = Gedit.FileIndex.get_for_root(root)
+
+            if index and not index in [i[0] for i in self._indexes]:
+                handler_id = index.connect('changed', self.on_index_changed)
+                self._indexes.append((index, handler_id))
+
         self.connect('show', self.on_show)
+        self.connect('destroy', self.on_destroy)
 
     def get_final_size(self):
         return self._size
@@ -204,21 +222,11 @@ class Popup(Gtk.Dialog):
 
         return children
 
-    def _compare_entries(self, a, b, lpart):
-        if lpart in a:
-            if lpart in b:
-                if a.index(lpart) < b.index(lpart):
-                    return -1
-                elif a.index(lpart) > b.index(lpart):
-                    return 1
-                else:
-                    return 0
-            else:
-                return -1
-        elif lpart in b:
-            return 1
-        else:
-            return 0
+    def _entry_sort_key(self, entry, lpart):
+        # The entries containing lpart first, the earliest match first
+        i = entry[1].lower().find(lpart)
+
+        return i if i != -1 else sys.maxsize
 
     def _match_glob(self, s, glob):
         if glob:
@@ -258,7 +266,7 @@ class Popup(Gtk.Dialog):
                         (not lpart or len(parts) == 1):
                     found.append(entry)
 
-        found.sort(key=functools.cmp_to_key(lambda a, b: self._compare_entries(a[1].lower(), b[1].lower(), lpart)))
+        found.sort(key=lambda x: self._entry_sort_key(x, lpart))
 
         if lpart == '..':
             newdirs.append(d.get_parent())
@@ -349,6 +357,90 @@ class Popup(Gtk.Dialog):
     def _clear_store(self):
         self._store.clear()
         self._stored_items = set()
+        self._index_uris = []
+
+    def _make_fuzzy_markup(self, text, query):
+        # Highlights the matched characters, preferably in the file name
+        ltext = text.lower()
+        start = ltext.rfind(os.sep) + 1
+
+        for offset in (start, 0):
+            positions = []
+            i = offset
+
+            for c in query:
+                i = ltext.find(c, i)
+
+                if i == -1:
+                    break
+
+                positions.append(i)
+                i += 1
+
+            if len(positions) == len(query):
+                break
+        else:
+            return xml.sax.saxutils.escape(text)
+
+        out = ''
+        last = 0
+
+        for i in positions:
+            out += xml.sax.saxutils.escape(text[last:i]) + \
+                   '<b>%s</b>' % (xml.sax.saxutils.escape(text[i]),)
+            last = i + 1
+
+        return out + xml.sax.saxutils.escape(text[last:])
+
+    def _get_content_type_icon(self, name):
+        content_type, uncertain = Gio.content_type_guess(name, None)
+
+        if content_type not in self._icons:
+            self._icons[content_type] = Gio.content_type_get_icon(content_type)
+
+        return self._icons[content_type]
+
+    def _is_indexed(self, d):
+        if isinstance(d, VirtualDirectory):
+            return False
+
+        for index, handler_id in self._indexes:
+            root = index.get_root()
+
+            if d.equal(root) or d.has_prefix(root):
+                return True
+
+        return False
+
+    # The results of the indexes are the first rows of the store
+    def _search_indexes(self, text):
+        query = text.lower()
+
+        for index, handler_id in self._indexes:
+            root = index.get_root()
+
+            for path in index.query(query, self.MAX_INDEX_RESULTS):
+                gfile = root.resolve_relative_path(path)
+                uri = gfile.get_uri()
+
+                if uri in self._stored_items:
+                    continue
+
+                self._store.insert(len(self._index_uris),
+                                   (self._get_content_type_icon(path),
+                                    self._make_fuzzy_markup(path, query),
+                                    gfile,
+                                    Gio.FileType.REGULAR))
+
+                self._stored_items.add(uri)
+                self._index_uris.append(uri)
+
+    def _clear_index_results(self):
+        for uri in self._index_uris:
+            self._store.remove(self._store.get_iter_first())
+            self._stored_items.remove(uri)
+
+        self._index_uris = []
 
     def _show_virtuals(self):
         for d in self._dirs:
@@ -386,7 +478,16 @@ class Popup(Gtk.Dialog):
             parts = self.normalize_relative(text.split(os.sep))
             files = []
 
+            indexed = not '..' in parts
+
+            if indexed:
+                self._search_indexes(text)
+
             for d in self._dirs:
+                # The index already lists the files of d
+                if indexed and self._is_indexed(d):
+                    continue
+
                 for entry in self.do_search_dir(parts, d):
                     pathparts = self._make_parts(d, entry[0], parts)
                     self._append_to_store((entry[3],
@@ -411,6 +512,47 @@ class Popup(Gtk.Dialog):
 
         self.do_search()
 
+    def on_destroy(self, widget):
+        if self._index_changed_id != 0:
+            GLib.source_remove(self._index_changed_id)
+            self._index_changed_id = 0
+
+        for index, handler_id in self._indexes:
+            index.disconnect(handler_id)
+
+        self._indexes = []
+
+    def _on_index_changed_timeout(self):
+        self._index_changed_id = 0
+
+        text = self._entry.get_text().strip()
+
+        if text == '' or '..' in self.normalize_relative(text.split(os.sep)):
+            return False
+
+        # Only the results of the indexes change
+        self._remove_cursor()
+        self._clear_index_results()
+        self._search_indexes(text)
+
+        selection = self._treeview.get_selection()
+
+        if selection.count_selected_rows() == 0:
+            piter = self._store.get_iter_first()
+
+            if piter:
+                selection.select_iter(piter)
+
+        self.on_selection_changed(selection)
+
+        return False
+
+    # Refresh the results while the indexes are scanned, but not at each
+    # batch of files
+    def on_index_changed(self, index):
+        if self._index_changed_id == 0:
+            self._index_changed_id = GLib.timeout_add(500, self._on_index_changed_timeout)
+
     def on_changed(self, editable):
         self.do_search()
         self.on_selection_changed(self._treeview.get_selection())
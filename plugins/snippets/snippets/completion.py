@@ -15,6 +15,7 @@
 #    along with this program; if not, write to the Free Software
 #    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
+from weakref import WeakKeyDictionary, ref
 from gi.repository import GObject, Gtk, GtkSource, Gedit
 
 from .library import Library
@@ -26,17 +27,43 @@ class Proposal(GObject.Object, GtkSource.CompletionProposal):
 
     def __init__(self, snippet):
         super(Proposal, self).__init__()
-        self._snippet = Snippet(snippet)
+
+        # The proposal is cached with the snippet as key, it must not keep
+        # it alive
+        self._snippet = ref(snippet)
 
     def snippet(self):
-        return self._snippet.data
+        return self._snippet()
 
     # Interface implementation
     def do_get_markup(self):
-        return self._snippet.display()
+        snippet = self.snippet()
+
+        if snippet is None:
+            return ''
+
+        return Snippet(snippet).display()
 
     def do_get_info(self):
-        return self._snippet.data['text']
+        snippet = self.snippet()
+
+        if snippet is None:
+            return ''
+
+        return snippet['text']
+
+# The proposals of the snippets, kept between the completions, and dropped
+# with their snippet
+_proposals = WeakKeyDictionary()
+
+def get_proposal(snippet):
+    proposal = _proposals.get(snippet)
+
+    if proposal is None:
+        proposal = Proposal(snippet)
+        _proposals[snippet] = proposal
+
+    return proposal
 
 class Provider(GObject.Object, GtkSource.CompletionProvider):
     __gtype_name__ = "GeditSnippetsProvider"
@@ -101,17 +128,19 @@ class Provider(GObject.Object, GtkSource.CompletionProvider):
     def get_proposals(self, word):
         if self.proposals:
             proposals = self.proposals
+
+            # Filter based on the current word
+            if word:
+                proposals = (x for x in proposals if x['tag'].startswith(word))
+        elif word:
+            proposals = Library().from_tag_prefix(word, self.language_id)
         else:
             proposals = Library().get_snippets(None)
 
             if self.language_id:
                 proposals += Library().get_snippets(self.language_id)
 
-        # Filter based on the current word
-        if word:
-            proposals = (x for x in proposals if x['tag'].startswith(word))
-
-        return [Proposal(x) for x in proposals]
+        return [get_proposal(x) for x in proposals]
 
     def do_populate(self, context):
         proposals = self.get_proposals(self.get_word(context))
@@ -124,6 +124,7 @@ class Document(GObject.Object, Gedit.ViewActivatable, Signals):
             Library().unref(langid)
 
         Library().ref(self.language_id)
+        Library().warm_up(self.language_id)
         self.provider.language_id = self.language_id
 
         SharedData().update_state(self.view.get_toplevel())
@@ -939,14 +940,20 @@ class Document(GObject.Object, Gedit.ViewActivatable, Signals):
         if not self.view.get_editable():
             return False
 
+        # The snippet was removed while the completion was shown
+        snippet = proposal.snippet()
+
+        if snippet is None:
+            return False
+
         buf = self.view.get_buffer()
         bounds = buf.get_selection_bounds()
 
         if bounds:
-            self.apply_snippet(proposal.snippet(), None, None)
+            self.apply_snippet(snippet, None, None)
         else:
             (word, start, end) = self.get_tab_tag(buf, piter)
-            self.apply_snippet(proposal.snippet(), start, end)
+            self.apply_snippet(snippet, start, end)
 
         return True
 
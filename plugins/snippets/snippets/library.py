@@ -19,8 +19,9 @@ import os
 import weakref
 import sys
 import re
+import pickle
 
-from gi.repository import Gdk, Gtk
+from gi.repository import GLib, Gdk, Gtk
 
 import xml.etree.ElementTree as et
 from . import helper
@@ -265,11 +266,76 @@ class SnippetsTreeBuilder(et.TreeBuilder):
 
         return result
 
+class TagTrie:
+    """
+    Prefix tree of the tab triggers, to find the snippets completing a word
+    without going through all of them. A node is a dictionary of its children
+    by character, with the snippets of the node under the None key.
+    """
+
+    def __init__(self):
+        self.root = {}
+
+    def add(self, tag, snippet):
+        node = self.root
+
+        for c in tag:
+            node = node.setdefault(c, {})
+
+        node.setdefault(None, []).append(snippet)
+
+    def remove(self, tag, snippet):
+        path = []
+        node = self.root
+
+        for c in tag:
+            if not c in node:
+                return
+
+            path.append((node, c))
+            node = node[c]
+
+        try:
+            node[None].remove(snippet)
+        except (KeyError, ValueError):
+            return
+
+        if not node[None]:
+            del node[None]
+
+        # Prune the nodes left empty
+        while path and not node:
+            node, c = path.pop()
+            del node[c]
+
+    def find(self, prefix):
+        node = self.root
+
+        for c in prefix:
+            node = node.get(c)
+
+            if node is None:
+                return []
+
+        result = []
+        stack = [node]
+
+        # Depth first, in the order of the tags
+        while stack:
+            node = stack.pop()
+            result.extend(node.get(None, []))
+
+            children = sorted(c for c in node if c is not None)
+            stack.extend(node[c] for c in reversed(children))
+
+        return result
+
 class LanguageContainer:
     def __init__(self, language):
         self.language = language
         self.snippets = []
         self.snippets_by_prop = {'tag': {}, 'accelerator': {}, 'drop-targets': {}}
+        self.tag_trie = TagTrie()
         self.accel_group = Gtk.AccelGroup()
         self._refs = 0
 
@@ -298,6 +364,9 @@ class LanguageContainer:
             else:
                 snippets[val] = [snippet]
 
+            if prop == 'tag':
+                self.tag_trie.add(val, snippet)
+
     def _remove_prop(self, snippet, prop, value=0):
         if value == 0:
             value = snippet[prop]
@@ -322,6 +391,9 @@ class LanguageContainer:
             except:
                 True
 
+            if prop == 'tag':
+                self.tag_trie.remove(val, snippet)
+
     def append(self, snippet):
         self.snippets.append(snippet)
 
@@ -371,6 +443,9 @@ class LanguageContainer:
             else:
                 return []
 
+    def from_tag_prefix(self, prefix):
+        return self.tag_trie.find(prefix)
+
     def ref(self):
         self._refs += 1
 
@@ -400,7 +475,10 @@ class SnippetsSystemFile:
             self.loading_elements.append(element)
 
     def set_language(self, element):
-        self.language = element.attrib.get('language')
+        self.set_language_id(element.attrib.get('language'))
+
+    def set_language_id(self, language):
+        self.language = language
 
         if self.language:
             self.language = self.language.lower()
@@ -416,6 +494,7 @@ class SnippetsSystemFile:
                 return False
             else:
                 self._set_root(element)
+                self.parsed_root = element
                 self.loaded = True
         elif element.tag != 'snippet' and not self.insnippet:
             self.load_error("Element should be `snippet' instead of `%s'" \
@@ -456,6 +535,7 @@ class SnippetsSystemFile:
             f = open(self.path, "r", encoding='utf-8')
         except IOError:
             self.ok = False
+            self.parse_failed = True
             return
 
         while True:
@@ -463,6 +543,7 @@ class SnippetsSystemFile:
                 data = f.read(readsize)
             except IOError:
                 self.ok = False
+                self.parse_failed = True
                 break
 
             if not data:
@@ -472,6 +553,7 @@ class SnippetsSystemFile:
                 parser.feed(data)
             except Exception:
                 self.ok = False
+                self.parse_failed = True
                 break
 
             for element in elements:
@@ -491,6 +573,8 @@ class SnippetsSystemFile:
         self.loaded = False
         self.ok = False
         self.loading_elements = []
+        self.parsed_root = None
+        self.parse_failed = False
 
         for element in self.parse_xml():
             if element[1]:
@@ -502,6 +586,32 @@ class SnippetsSystemFile:
                     del self.loading_elements[:]
                     return
 
+        self._add_loading_elements()
+
+    # Returns the root element of the file, if it has been entirely parsed by
+    # the last load
+    def get_parsed_root(self):
+        if self.ok and not self.parse_failed:
+            return self.parsed_root
+        else:
+            return None
+
+    # Loads the snippets from the root element of a previous parse of the
+    # file, see SnippetsCache
+    def load_root(self, root):
+        helper.snippets_debug("Loading cached library (" + str(self.language) + "): " + \
+                self.path)
+
+        self._set_root(root)
+        self.loaded = True
+        self.loading_elements = []
+
+        for element in root:
+            self._add_snippet(element)
+
+        self._add_loading_elements()
+
+    def _add_loading_elements(self):
         for element in self.loading_elements:
             Library().add_snippet(self, element)
 
@@ -565,8 +675,8 @@ class SnippetsUserFile(SnippetsSystemFile):
 
         return Library().add_snippet(self, element)
 
-    def set_language(self, element):
-        SnippetsSystemFile.set_language(self, element)
+    def set_language_id(self, language):
+        SnippetsSystemFile.set_language_id(self, language)
 
         filename = os.path.basename(self.path).lower()
 
@@ -633,6 +743,72 @@ class SnippetsUserFile(SnippetsSystemFile):
         SnippetsSystemFile.unload(self)
         self.root = None
 
+class SnippetsCache:
+    """
+    Keeps the parsed snippet files, so that they are not parsed again until
+    they change. There is a cache file for each language, holding the root
+    elements of the files of the language, and an index of the languages of
+    the files. The files are identified by their modification time and size.
+    """
+
+    VERSION = 1
+
+    def __init__(self, path):
+        self.path = path
+
+    def file_state(self, path):
+        try:
+            st = os.stat(path)
+        except OSError:
+            return None
+
+        return (st.st_mtime_ns, st.st_size)
+
+    def _filename(self, name):
+        return os.path.join(self.path, name + '.cache')
+
+    def _read(self, name):
+        try:
+            with open(self._filename(name), 'rb') as f:
+                data = pickle.loads(f.read())
+        except Exception:
+            return {}
+
+        if not isinstance(data, dict) or data.get('version') != self.VERSION:
+            return {}
+
+        return data.get('files', {})
+
+    def _write(self, name, files):
+        filename = self._filename(name)
+        tmpname = filename + '.tmp'
+
+        try:
+            if not os.path.isdir(self.path):
+                os.makedirs(self.path, 0o755)
+
+            with open(tmpname, 'wb') as f:
+                pickle.dump({'version': self.VERSION, 'files': files}, f,
+                            pickle.HIGHEST_PROTOCOL)
+
+            os.replace(tmpname, filename)
+        except (OSError, pickle.PicklingError):
+            helper.snippets_debug('Could not write the snippets cache ' + filename)
+
+    # Path -> (state, language, ok)
+    def read_index(self):
+        return self._read('index')
+
+    def write_index(self, index):
+        self._write('index', index)
+
+    # Path -> (state, root element)
+    def read_roots(self, language):
+        return self._read('roots-' + (language or 'global'))
+
+    def write_roots(self, language, roots):
+        self._write('roots-' + (language or 'global'), roots)
+
 class Singleton(object):
     _instance = None
 
@@ -659,6 +835,12 @@ class Library(Singleton):
         self.overridden = {}
         self.loaded_ids = []
 
+        self.cache = SnippetsCache(os.path.join(GLib.get_user_cache_dir(), 'gedit', 'snippets'))
+        self.index = self.cache.read_index()
+        self.index_changed = False
+        self.warm_up_languages = []
+        self.warm_up_id = 0
+
         self.loaded = False
 
     def add_accelerator_callback(self, cb):
@@ -787,7 +969,16 @@ class Library(Singleton):
             self.overridden[snippet.override] = None
 
     def add_library(self, library):
-        library.ensure_language()
+        state = self.cache.file_state(library.path)
+        entry = self.index.get(library.path)
+
+        if entry and entry[0] == state:
+            library.set_language_id(entry[1])
+            library.ok = entry[2]
+        else:
+            library.ensure_language()
+            self.index[library.path] = (state, library.language, library.ok)
+            self.index_changed = True
 
         if not library.ok:
             helper.snippets_debug('Library in wrong format, ignoring')
@@ -913,14 +1104,83 @@ class Library(Singleton):
             if lang in self.libraries:
                 # Ensure the container exists
                 self.container(lang)
+                self.ensure_libraries(lang)
+
+    def ensure_libraries(self, language):
+        libraries = self.libraries[language]
+
+        if all(not library.ok or library.loaded for library in libraries):
+            return
+
+        roots = self.cache.read_roots(language)
+        changed = False
+
+        for library in libraries:
+            if not library.ok or library.loaded:
+                continue
+
+            state = self.cache.file_state(library.path)
+            entry = roots.get(library.path)
+
+            if entry and entry[0] == state:
+                library.load_root(entry[1])
+            else:
+                library.load()
+                root = library.get_parsed_root()
+
+                if root is not None:
+                    roots[library.path] = (state, root)
+                    changed = True
+
+        # Forget the files which are not there anymore
+        paths = set(library.path for library in libraries)
 
-                for library in self.libraries[lang]:
-                    library.ensure()
+        for path in list(roots):
+            if not path in paths:
+                del roots[path]
+                changed = True
+
+        if changed:
+            self.cache.write_roots(language, roots)
+
+    # Loads the snippets of a language in the background, so that they are
+    # ready when they are needed
+    def warm_up(self, language):
+        language = self.normalize_language(language)
+
+        if not language in self.warm_up_languages:
+            self.warm_up_languages.append(language)
+
+        if self.warm_up_id == 0:
+            self.warm_up_id = GLib.idle_add(self.on_warm_up_idle,
+                                            priority=GLib.PRIORITY_LOW)
+
+    def on_warm_up_idle(self):
+        language = self.warm_up_languages.pop(0)
+
+        # Only if it is still used
+        if language in self.containers:
+            self.ensure(language)
+
+        if self.warm_up_languages:
+            return True
+
+        self.warm_up_id = 0
+        return False
 
     def ensure_files(self):
         if self.loaded:
             return
 
+        # Only keep the files found in the index
+        cached_index = self.index
+        self.index = {}
+        self.index_changed = False
+
+        for path, entry in cached_index.items():
+            if os.path.isfile(path):
+                self.index[path] = entry
+
         searched = []
         searched = self.find_libraries(self.userdir, searched, \
                 self.add_user_library)
@@ -929,6 +1189,9 @@ class Library(Singleton):
             searched = self.find_libraries(d, searched, \
                     self.add_system_library)
 
+        if self.index_changed or len(self.index) != len(cached_index):
+            self.cache.write_index(self.index)
+
         self.loaded = True
 
     def valid_accelerator(self, keyval, mod):
@@ -974,6 +1237,28 @@ class Library(Singleton):
 
         return list(self.containers[language].snippets)
 
+    # Get the global snippets and the snippets of a language whose tag starts
+    # with a given prefix
+    def from_tag_prefix(self, prefix, language=None):
+        self.ensure_files()
+        language = self.normalize_language(language)
+
+        self.ensure(language)
+        result = []
+
+        # The global snippets first, like get_snippets(None) followed by
+        # get_snippets(language)
+        if language:
+            languages = (None, language)
+        else:
+            languages = (None,)
+
+        for lang in languages:
+            if lang in self.containers:
+                result += self.containers[lang].from_tag_prefix(prefix)
+
+        return result
+
     # Get snippets for a given accelerator
     def from_accelerator(self, accelerator, language=None):
         return self._from_prop('accelerator', accelerator, language)
@@ -43,12 +43,33 @@ struct _GeditAutomaticSpellChecker {
 	GtkTextMark		*mark_insert_end;
 	gboolean 		 deferred_check;
 
+	/* Ranges modified during the user actions, a queue of CheckRange.
+	 * They are checked when the user action ends, a slice at a time
+	 * from an idle when there is a lot to check. */
+	GQueue			 pending_ranges;
+	guint			 check_idle_id;
+	gboolean		 in_user_action;
+
 	GtkTextTag 		*tag_highlight;
 	GtkTextMark		*mark_click;
 
        	GeditSpellChecker	*spell_checker;
 };
 
+/* Beyond that many pending ranges, the new ones are merged in the last one */
+#define MAX_PENDING_RANGES	256
+
+/* The pending ranges are checked by chunks of that many characters, for
+ * that long at most between two iterations of the main loop. */
+#define CHECK_CHUNK_CHARS	2048
+#define CHECK_SLICE_USEC	5000
+
+typedef struct
+{
+	GtkTextMark *start;
+	GtkTextMark *end;
+} CheckRange;
+
 static GQuark automatic_spell_checker_id = 0;
 static GQuark suggestion_id = 0;
 
@@ -229,6 +250,110 @@ insert_text_before (GtkTextBuffer *buffer, GtkTextIter *iter,
 	gtk_text_buffer_move_mark (buffer, spell->mark_insert_start, iter);
 }
 
+static void
+check_range_free (GeditAutomaticSpellChecker *spell,
+		  CheckRange                 *range)
+{
+	gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (spell->doc), range->start);
+	gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (spell->doc), range->end);
+	g_slice_free (CheckRange, range);
+}
+
+static void
+add_pending_range (GeditAutomaticSpellChecker *spell,
+		   const GtkTextIter          *start,
+		   const GtkTextIter          *end)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (spell->doc);
+	CheckRange *range;
+
+	range = g_queue_peek_tail (&spell->pending_ranges);
+
+	if (range != NULL)
+	{
+		GtkTextIter range_start, range_end;
+
+		gtk_text_buffer_get_iter_at_mark (buffer, &range_start, range->start);
+		gtk_text_buffer_get_iter_at_mark (buffer, &range_end, range->end);
+
+		/* The edits of a Replace All follow each other, only the
+		 * overlapping ones are merged. */
+		if (spell->pending_ranges.length >= MAX_PENDING_RANGES ||
+		    (gtk_text_iter_compare (start, &range_end) <= 0 &&
+		     gtk_text_iter_compare (end, &range_start) >= 0))
+		{
+			if (gtk_text_iter_compare (start, &range_start) < 0)
+				gtk_text_buffer_move_mark (buffer, range->start, start);
+
+			if (gtk_text_iter_compare (end, &range_end) > 0)
+				gtk_text_buffer_move_mark (buffer, range->end, end);
+
+			return;
+		}
+	}
+
+	range = g_slice_new (CheckRange);
+	range->start = gtk_text_buffer_create_mark (buffer, NULL, start, TRUE);
+	range->end = gtk_text_buffer_create_mark (buffer, NULL, end, FALSE);
+
+	g_queue_push_tail (&spell->pending_ranges, range);
+}
+
+/* Returns TRUE when all the pending ranges have been checked. */
+static gboolean
+check_pending_ranges (GeditAutomaticSpellChecker *spell)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (spell->doc);
+	CheckRange *range;
+	gint64 deadline;
+
+	deadline = g_get_monotonic_time () + CHECK_SLICE_USEC;
+
+	while ((range = g_queue_peek_head (&spell->pending_ranges)) != NULL)
+	{
+		GtkTextIter start, end, chunk_end;
+
+		gtk_text_buffer_get_iter_at_mark (buffer, &start, range->start);
+		gtk_text_buffer_get_iter_at_mark (buffer, &end, range->end);
+
+		chunk_end = start;
+		gtk_text_iter_forward_chars (&chunk_end, CHECK_CHUNK_CHARS);
+
+		if (gtk_text_iter_inside_word (&chunk_end))
+			gtk_text_iter_forward_word_end (&chunk_end);
+
+		if (gtk_text_iter_compare (&chunk_end, &end) >= 0)
+		{
+			check_range (spell, start, end, FALSE);
+
+			g_queue_pop_head (&spell->pending_ranges);
+			check_range_free (spell, range);
+		}
+		else
+		{
+			check_range (spell, start, chunk_end, FALSE);
+			gtk_text_buffer_move_mark (buffer, range->start, &chunk_end);
+		}
+
+		if (g_get_monotonic_time () >= deadline)
+			return g_queue_is_empty (&spell->pending_ranges);
+	}
+
+	return TRUE;
+}
+
+static gboolean
+check_pending_ranges_idle_cb (GeditAutomaticSpellChecker *spell)
+{
+	if (check_pending_ranges (spell))
+	{
+		spell->check_idle_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
 static void
 insert_text_after (GtkTextBuffer *buffer, GtkTextIter *iter,
                   gchar *text, gint len, GeditAutomaticSpellChecker *spell)
@@ -238,7 +363,10 @@ insert_text_after (GtkTextBuffer *buffer, GtkTextIter *iter,
 	/* we need to check a range of text. */
 	gtk_text_buffer_get_iter_at_mark (buffer, &start, spell->mark_insert_start);
 
-	check_range (spell, start, *iter, FALSE);
+	if (spell->in_user_action)
+		add_pending_range (spell, &start, iter);
+	else
+		check_range (spell, start, *iter, FALSE);
 
 	gtk_text_buffer_move_mark (buffer, spell->mark_insert_end, iter);
 }
@@ -254,7 +382,34 @@ static void
 delete_range_after (GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end,
 		GeditAutomaticSpellChecker *spell)
 {
-	check_range (spell, *start, *end, FALSE);
+	if (spell->in_user_action)
+		add_pending_range (spell, start, end);
+	else
+		check_range (spell, *start, *end, FALSE);
+}
+
+/* a user action like a Replace All can modify the buffer many times, so the
+ * modified ranges are only checked at the end: at once for the usual small
+ * edits, and from an idle for the rest. */
+
+static void
+begin_user_action (GtkTextBuffer              *buffer,
+		   GeditAutomaticSpellChecker *spell)
+{
+	spell->in_user_action = TRUE;
+}
+
+static void
+end_user_action (GtkTextBuffer              *buffer,
+		 GeditAutomaticSpellChecker *spell)
+{
+	spell->in_user_action = FALSE;
+
+	if (spell->check_idle_id != 0 || check_pending_ranges (spell))
+		return;
+
+	spell->check_idle_id = g_idle_add ((GSourceFunc) check_pending_ranges_idle_cb,
+					   spell);
 }
 
 static void
@@ -748,6 +903,14 @@ gedit_automatic_spell_checker_new (GeditDocument     *doc,
 			  "mark-set",
 			  G_CALLBACK (mark_set),
 			  spell);
+	g_signal_connect (doc,
+			  "begin-user-action",
+			  G_CALLBACK (begin_user_action),
+			  spell);
+	g_signal_connect (doc,
+			  "end-user-action",
+			  G_CALLBACK (end_user_action),
+			  spell);
 
 	g_signal_connect (doc,
 	                  "highlight-updated",
@@ -894,6 +1057,16 @@ gedit_automatic_spell_checker_free_internal (GeditAutomaticSpellChecker *spell)
 
 	g_return_if_fail (spell != NULL);
 
+	if (spell->check_idle_id != 0)
+	{
+		g_source_remove (spell->check_idle_id);
+	}
+
+	while (!g_queue_is_empty (&spell->pending_ranges))
+	{
+		check_range_free (spell, g_queue_pop_head (&spell->pending_ranges));
+	}
+
 	table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (spell->doc));
 
 	if (table != NULL && spell->tag_highlight != NULL)
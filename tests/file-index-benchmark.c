@@ -0,0 +1,219 @@
+/*
+ * file-index-benchmark.c
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Measures how long a GeditFileIndex takes to scan a tree, then the time
+ * of fuzzy queries on it. Without a directory, a temporary tree of
+ * N_FILES files is created, and removed at the end.
+ * Usage: file-index-benchmark [directory [query...]]
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include "gedit-file-index.h"
+
+#define N_FILES 500000
+#define FILES_PER_DIR 500
+#define N_RUNS 20
+#define MAX_RESULTS 100
+
+static const gchar *default_queries[] = {
+	"gfi",
+	"main",
+	"docview",
+	"x9z",
+	NULL
+};
+
+static const gchar *words[] = {
+	"document", "view", "window", "utils", "file", "index", "search",
+	"panel", "tab", "commands", "message", "bus", "settings", "print"
+};
+
+static gchar *
+create_tree (void)
+{
+	gchar *root;
+	guint i;
+
+	root = g_dir_make_tmp ("gedit-file-index-XXXXXX", NULL);
+
+	if (root == NULL)
+	{
+		g_error ("Cannot create the temporary directory");
+	}
+
+	for (i = 0; i < N_FILES; i++)
+	{
+		gchar *dir;
+		gchar *name;
+		gchar *path;
+
+		dir = g_strdup_printf ("%s/%s-%u",
+				       root,
+				       words[(i / FILES_PER_DIR) % G_N_ELEMENTS (words)],
+				       i / FILES_PER_DIR);
+
+		if (i % FILES_PER_DIR == 0)
+		{
+			g_mkdir (dir, 0700);
+		}
+
+		name = g_strdup_printf ("%s-%s-%u.c",
+					words[i % G_N_ELEMENTS (words)],
+					words[(i / 7) % G_N_ELEMENTS (words)],
+					i);
+		path = g_build_filename (dir, name, NULL);
+
+		if (!g_file_set_contents (path, "", 0, NULL))
+		{
+			g_error ("Cannot create %s", path);
+		}
+
+		g_free (path);
+		g_free (name);
+		g_free (dir);
+	}
+
+	return root;
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open (path, 0, NULL);
+
+	if (dir != NULL)
+	{
+		while ((name = g_dir_read_name (dir)) != NULL)
+		{
+			gchar *child = g_build_filename (path, name, NULL);
+
+			remove_tree (child);
+			g_free (child);
+		}
+
+		g_dir_close (dir);
+	}
+
+	g_remove (path);
+}
+
+static void
+index_changed_cb (GeditFileIndex *index,
+		  GMainLoop      *loop)
+{
+	if (gedit_file_index_is_ready (index))
+	{
+		g_main_loop_quit (loop);
+	}
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+	GeditFileIndex *index;
+	GMainLoop *loop;
+	GFile *root;
+	GTimer *timer;
+	gchar *tmp_root = NULL;
+	const gchar * const *queries = default_queries;
+	guint i;
+
+	if (argc > 1)
+	{
+		root = g_file_new_for_commandline_arg (argv[1]);
+
+		if (argc > 2)
+		{
+			queries = (const gchar * const *) argv + 2;
+		}
+	}
+	else
+	{
+		g_print ("Creating %u files...\n", N_FILES);
+		tmp_root = create_tree ();
+		root = g_file_new_for_path (tmp_root);
+	}
+
+	loop = g_main_loop_new (NULL, FALSE);
+	timer = g_timer_new ();
+
+	index = gedit_file_index_new (root);
+	g_signal_connect (index, "changed", G_CALLBACK (index_changed_cb), loop);
+
+	if (!gedit_file_index_is_ready (index))
+	{
+		g_main_loop_run (loop);
+	}
+
+	g_print ("%-12s %u files in %.3f s\n",
+		 "scan",
+		 gedit_file_index_get_n_files (index),
+		 g_timer_elapsed (timer, NULL));
+
+	for (i = 0; queries[i] != NULL; i++)
+	{
+		gdouble total = 0;
+		gdouble max = 0;
+		guint n_results = 0;
+		guint run;
+
+		for (run = 0; run < N_RUNS; run++)
+		{
+			gchar **paths;
+			gdouble elapsed;
+
+			g_timer_start (timer);
+			paths = gedit_file_index_query (index, queries[i], MAX_RESULTS);
+			elapsed = g_timer_elapsed (timer, NULL) * 1000;
+
+			n_results = g_strv_length (paths);
+			g_strfreev (paths);
+
+			total += elapsed;
+			max = MAX (max, elapsed);
+		}
+
+		g_print ("%-12s %u results, average %.2f ms, max %.2f ms\n",
+			 queries[i],
+			 n_results,
+			 total / N_RUNS,
+			 max);
+	}
+
+	g_object_unref (index);
+	g_object_unref (root);
+	g_timer_destroy (timer);
+	g_main_loop_unref (loop);
+
+	if (tmp_root != NULL)
+	{
+		remove_tree (tmp_root);
+		g_free (tmp_root);
+	}
+
+	return 0;
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,299 @@
+/*
+ * message-bus-benchmark.c
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Measures how many messages per second go through a GeditMessageBus, when
+ * sending by object path and method, and when sending through a cached
+ * GeditMessageHandle, then the dispatch latency of messages sent from worker
+ * threads. Usage: message-bus-benchmark [n-messages]
+ */
+
+#include <stdlib.h>
+#include "gedit-message-bus.h"
+
+#define OBJECT_PATH "/plugins/benchmark"
+#define METHOD "row_inserted"
+
+#define N_THREADS 4
+
+#define BENCHMARK_TYPE_MESSAGE (benchmark_message_get_type ())
+
+typedef struct
+{
+	GeditMessage parent;
+
+	gint row;
+
+	/* monotonic time at which the message was sent */
+	gint64 sent;
+} BenchmarkMessage;
+
+typedef struct
+{
+	GeditMessageClass parent_class;
+} BenchmarkMessageClass;
+
+enum
+{
+	PROP_0,
+	PROP_ROW
+};
+
+static GType benchmark_message_get_type (void) G_GNUC_CONST;
+
+G_DEFINE_TYPE (BenchmarkMessage, benchmark_message, GEDIT_TYPE_MESSAGE)
+
+static void
+benchmark_message_get_property (GObject    *object,
+                                guint       prop_id,
+                                GValue     *value,
+                                GParamSpec *pspec)
+{
+	BenchmarkMessage *msg = (BenchmarkMessage *)object;
+
+	switch (prop_id)
+	{
+		case PROP_ROW:
+			g_value_set_int (value, msg->row);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+benchmark_message_set_property (GObject      *object,
+                                guint         prop_id,
+                                const GValue *value,
+                                GParamSpec   *pspec)
+{
+	BenchmarkMessage *msg = (BenchmarkMessage *)object;
+
+	switch (prop_id)
+	{
+		case PROP_ROW:
+			msg->row = g_value_get_int (value);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+benchmark_message_class_init (BenchmarkMessageClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->get_property = benchmark_message_get_property;
+	object_class->set_property = benchmark_message_set_property;
+
+	g_object_class_install_property (object_class,
+	                                 PROP_ROW,
+	                                 g_param_spec_int ("row",
+	                                                   "Row",
+	                                                   "Row",
+	                                                   0, G_MAXINT, 0,
+	                                                   G_PARAM_READWRITE |
+	                                                   G_PARAM_STATIC_STRINGS));
+}
+
+static void
+benchmark_message_init (BenchmarkMessage *msg)
+{
+}
+
+static void
+row_inserted_cb (GeditMessageBus *bus,
+                 GeditMessage    *message,
+                 gpointer         user_data)
+{
+	guint *n_received = user_data;
+
+	(*n_received)++;
+}
+
+typedef struct
+{
+	GeditMessageBus *bus;
+	guint n_messages;
+} WorkerData;
+
+typedef struct
+{
+	guint n_received;
+	guint n_expected;
+	gint64 total_latency;
+	gint64 max_latency;
+	GMainLoop *loop;
+} LatencyData;
+
+static gpointer
+worker_thread (WorkerData *data)
+{
+	guint i;
+
+	for (i = 0; i < data->n_messages; i++)
+	{
+		BenchmarkMessage *msg;
+
+		msg = g_object_new (BENCHMARK_TYPE_MESSAGE,
+		                    "object-path", OBJECT_PATH,
+		                    "method", METHOD,
+		                    "row", i,
+		                    NULL);
+
+		msg->sent = g_get_monotonic_time ();
+		gedit_message_bus_send_message (data->bus, GEDIT_MESSAGE (msg));
+		g_object_unref (msg);
+	}
+
+	return NULL;
+}
+
+static void
+latency_cb (GeditMessageBus *bus,
+            GeditMessage    *message,
+            gpointer         user_data)
+{
+	LatencyData *data = user_data;
+	gint64 latency;
+
+	latency = g_get_monotonic_time () - ((BenchmarkMessage *)message)->sent;
+
+	data->total_latency += latency;
+	data->max_latency = MAX (data->max_latency, latency);
+
+	if (++data->n_received == data->n_expected)
+	{
+		g_main_loop_quit (data->loop);
+	}
+}
+
+static void
+report (const gchar *name,
+        guint        n_messages,
+        gdouble      elapsed)
+{
+	g_print ("%-12s %u messages in %.3f s: %.0f messages/s\n",
+	         name,
+	         n_messages,
+	         elapsed,
+	         elapsed > 0 ? n_messages / elapsed : 0);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+	GeditMessageBus *bus;
+	GeditMessageHandle *handle;
+	GTimer *timer;
+	guint n_messages = 1000000;
+	guint n_received = 0;
+	guint i;
+
+	if (argc > 1)
+	{
+		n_messages = strtoul (argv[1], NULL, 10);
+	}
+
+	bus = gedit_message_bus_new ();
+	gedit_message_bus_register (bus, BENCHMARK_TYPE_MESSAGE, OBJECT_PATH, METHOD);
+	gedit_message_bus_connect (bus, OBJECT_PATH, METHOD, row_inserted_cb, &n_received, NULL);
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < n_messages; i++)
+	{
+		GeditMessage *msg;
+
+		msg = gedit_message_bus_send_sync (bus, OBJECT_PATH, METHOD, "row", i, NULL);
+		g_object_unref (msg);
+	}
+
+	report ("send_sync", n_messages, g_timer_elapsed (timer, NULL));
+
+	handle = gedit_message_bus_get_handle (bus, OBJECT_PATH, METHOD);
+	g_timer_start (timer);
+
+	for (i = 0; i < n_messages; i++)
+	{
+		GeditMessage *msg;
+
+		msg = gedit_message_handle_send_sync (handle, "row", i, NULL);
+		g_object_unref (msg);
+	}
+
+	report ("handle", n_messages, g_timer_elapsed (timer, NULL));
+
+	g_assert_cmpuint (n_received, ==, 2 * n_messages);
+
+	gedit_message_handle_unref (handle);
+
+	if (n_messages > 0)
+	{
+		GThread *threads[N_THREADS];
+		WorkerData worker_data;
+		LatencyData latency_data = { 0 };
+		guint id;
+
+		id = gedit_message_bus_connect (bus, OBJECT_PATH, METHOD, latency_cb, &latency_data, NULL);
+		gedit_message_bus_block_by_func (bus, OBJECT_PATH, METHOD, row_inserted_cb, &n_received);
+
+		worker_data.bus = bus;
+		worker_data.n_messages = n_messages / N_THREADS + 1;
+
+		latency_data.n_expected = worker_data.n_messages * N_THREADS;
+		latency_data.loop = g_main_loop_new (NULL, FALSE);
+
+		g_timer_start (timer);
+
+		for (i = 0; i < N_THREADS; i++)
+		{
+			threads[i] = g_thread_new ("benchmark",
+			                           (GThreadFunc) worker_thread,
+			                           &worker_data);
+		}
+
+		g_main_loop_run (latency_data.loop);
+
+		for (i = 0; i < N_THREADS; i++)
+		{
+			g_thread_join (threads[i]);
+		}
+
+		report ("threads", latency_data.n_received, g_timer_elapsed (timer, NULL));
+		g_print ("%-12s average %.1f us, max %" G_GINT64_FORMAT " us\n",
+		         "latency",
+		         (gdouble) latency_data.total_latency / latency_data.n_received,
+		         latency_data.max_latency);
+
+		gedit_message_bus_disconnect (bus, id);
+		g_main_loop_unref (latency_data.loop);
+	}
+
+	g_timer_destroy (timer);
+	g_object_unref (bus);
+
+	return 0;
+}
+
+/* ex:set ts=8 noet: */